@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+/*
+ * Timing helpers of the benchmark programs: the best of a few rounds of a number of repetitions, so that
+ * a single interruption does not show in the results.
+ */
+namespace bench {
+
+// Microseconds taken by one call of f (the best of five rounds of reps calls)
+template<class F>
+double microseconds(int reps, F&& f) {
+    double best = 1e300;
+    for (int round = 0; round < 5; ++round) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < reps; ++i) f();
+        best = std::min(best, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / reps);
+    }
+    return best;
+}
+
+// A json ohlc response of n 1-minute candles, as Bitstamp sends them (prices with 2 decimals, volumes with 8)
+inline std::string ohlcResponse(size_t n) {
+    std::string json = "{\"data\": {\"pair\": \"BTC/USD\", \"ohlc\": [";
+    long price = 5784450;
+    char line[256];
+    for (size_t i = 0; i < n; ++i) {
+        const long open = price;
+        price += static_cast<long>((i * 2654435761u) % 2001) - 1000;
+        std::snprintf(line, sizeof(line),
+            "%s{\"high\": \"%ld.%02ld\", \"timestamp\": \"%ld\", \"volume\": \"%zu.%08zu\", \"low\": \"%ld.%02ld\", \"close\": \"%ld.%02ld\", \"open\": \"%ld.%02ld\"}",
+            i == 0 ? "" : ", ", (std::max(open, price) + 37) / 100, (std::max(open, price) + 37) % 100, 1720656000 + 60 * static_cast<long>(i),
+            i % 13, (i * 7919) % 100000000, (std::min(open, price) - 41) / 100, (std::min(open, price) - 41) % 100, price / 100, price % 100, open / 100, open % 100);
+        json += line;
+    }
+    return json + "]}}";
+}
+
+} // namespace bench
@@ -0,0 +1,108 @@
+#include "bench.h"
+#include "../src/api/candle_series.h"
+#include "../src/api/ticker.h"
+#include "../src/json_reader/json_reader.h"
+#include "../src/json_reader/multi_json_reader.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Allocations of a poll cycle (the ticker and the last candles of every pair, handed over to their consumer),
+ * counted by replacing the global operator new: the maps copied from the readers into the results and from
+ * the results into the shared data, the maps taken from the reader and given back, and the records lent
+ * to the parsers and moved into the consumer. Usage: bench_allocations [pairs] [candles] [cycles]
+ */
+namespace {
+
+std::atomic<size_t> allocations{0};
+std::atomic<size_t> allocatedBytes{0};
+
+void* allocate(size_t size, size_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    size = size == 0 ? 1 : size;
+    void* p = alignment <= alignof(std::max_align_t) ? std::malloc(size) : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+const std::string TICKER = "{\"timestamp\": \"1720719943\", \"open\": \"57700\", \"high\": \"59516\", \"low\": \"57072\", \"last\": \"57844\", "
+                           "\"volume\": \"2236.53575468\", \"vwap\": \"58140\", \"bid\": \"57841\", \"ask\": \"57850\", \"side\": \"0\"}";
+
+using DataMap = std::unordered_map<std::string, std::string>;
+using DataMapVec = std::vector<DataMap>;
+
+} // namespace
+
+void* operator new(size_t size) {return allocate(size, alignof(std::max_align_t));}
+void* operator new(size_t size, std::align_val_t alignment) {return allocate(size, static_cast<size_t>(alignment));}
+void operator delete(void* p) noexcept {std::free(p);}
+void operator delete(void* p, size_t) noexcept {std::free(p);}
+void operator delete(void* p, std::align_val_t) noexcept {std::free(p);}
+void operator delete(void* p, size_t, std::align_val_t) noexcept {std::free(p);}
+
+int main(int argc, char** argv) {
+    const size_t pairs = argc > 1 ? std::stoul(argv[1]) : 20;
+    const size_t candles = argc > 2 ? std::stoul(argv[2]) : 16;
+    const size_t cycles = argc > 3 ? std::stoul(argv[3]) : 100;
+    const std::string ohlc = bench::ohlcResponse(candles);
+    std::printf("%zu pairs, a ticker and %zu candles each, %zu cycles after one warm-up cycle\n", pairs, candles, cycles);
+
+    size_t sink = 0;
+    // Allocations and bytes per cycle, counted once the buffers kept from one cycle to the next have grown
+    const auto report = [&](const char* handoff, auto&& cycle) {
+        cycle();
+        const size_t count = allocations.load(), bytes = allocatedBytes.load();
+        for (size_t i = 0; i < cycles; ++i) cycle();
+        std::printf("  %-26s %10.1f allocations %12.0f bytes per cycle\n", handoff,
+                    double(allocations.load() - count) / cycles, double(allocatedBytes.load() - bytes) / cycles);
+    };
+
+    // The readers returned copies of their maps, copied again into the results and into the shared data
+    std::vector<DataMap> sharedTickers(pairs);
+    std::vector<DataMapVec> sharedCandles(pairs);
+    report("maps copied", [&] {
+        for (size_t p = 0; p < pairs; ++p) {
+            JsonReader ticker(TICKER);
+            const DataMap marketData = ticker.get();
+            sharedTickers[p] = marketData;
+            MultiJsonReader reader(ohlc);
+            const DataMapVec fetched = reader.get();
+            DataMapVec retData = fetched;
+            sharedCandles[p] = retData;
+            sink += sharedCandles[p].size();
+        }
+    });
+
+    // The maps taken from readers kept per pair, moved into the shared data, and given back on the next cycle
+    std::vector<JsonReader> tickerReaders(pairs);
+    std::vector<MultiJsonReader> candleReaders(pairs);
+    report("maps taken and released", [&] {
+        for (size_t p = 0; p < pairs; ++p) {
+            tickerReaders[p].release(std::move(sharedTickers[p]));
+            tickerReaders[p].setFromString(TICKER);
+            sharedTickers[p] = tickerReaders[p].take();
+            candleReaders[p].release(std::move(sharedCandles[p]));
+            candleReaders[p].setFromString(ohlc);
+            sharedCandles[p] = candleReaders[p].take();
+            sink += sharedCandles[p].size();
+        }
+    });
+
+    // The records of each pair lent to the parsers and moved into the consumer, which gives the previous ones back
+    std::vector<Ticker> tickers(pairs);
+    std::vector<CandleSeries> lent(pairs), consumed(pairs);
+    report("records lent and moved", [&] {
+        for (size_t p = 0; p < pairs; ++p) {
+            sink += tickers[p].parse(TICKER) ? tickers[p].present : 0;
+            if (lent[p].parse(ohlc)) std::swap(lent[p], consumed[p]);
+            sink += consumed[p].size();
+        }
+    });
+    return sink == 0;
+}
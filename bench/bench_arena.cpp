@@ -0,0 +1,137 @@
+#include "bench.h"
+#include "../src/api/candle_series.h"
+#include "../src/utils/arena.h"
+#include "../src/utils/utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory_resource>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+/*
+ * Synthetic load of a 200-pair refresh: threads each refreshing the table of their pairs (the closes of
+ * the last candles of every pair, as fetchAndPrintCoinCandlestickData prints them) at the same time, with
+ * the strings and vectors of the table from the global allocator or from the arena of each thread. Every
+ * configuration runs in its own process, so that its RSS is its own.
+ * Usage: bench_arena [pairs] [threads] [cycles] [candles]
+ */
+namespace {
+
+using std::chrono::steady_clock;
+
+size_t residentKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) return std::stoul(line.substr(6));
+    }
+    return 0;
+}
+
+// Table of the closes of the pairs, built with the allocator of the vectors
+template<typename Strings, typename StringMatrix>
+void appendTable(const std::vector<std::string>& names, const CandleSeries& series, Strings& timestamps, StringMatrix& values, std::string& message) {
+    std::string text;
+    timestamps.reserve(series.size());
+    for (size_t j = 0; j < series.size(); ++j) {
+        text.clear();
+        Utils::appendTimestamp(static_cast<int>(series.timestamp[j]), text);
+        timestamps.emplace_back(text);
+    }
+    for (auto& column: values) {
+        column.reserve(series.size());
+        for (size_t j = 0; j < series.size(); ++j) {
+            text.clear();
+            series.appendText(CandleSeries::Close, j, text);
+            column.emplace_back(text);
+        }
+    }
+    message.clear();
+    Utils::appendMatrixMsg(names, timestamps, values, message);
+}
+
+// Runs the cycles of the threads; prints the time of a cycle, the RSS growth after the first cycle and the peak RSS
+int load(bool arena, size_t pairs, size_t threads, size_t cycles, size_t candles) {
+    CandleSeries series;
+    if (!series.parse(bench::ohlcResponse(candles))) return 1;
+    const size_t perThread = (pairs + threads - 1) / threads;
+    const std::vector<std::string> names(perThread, "BTC/USD");
+
+    // The cycles are timed once every thread has run its first one (which grows its buffers or its arena)
+    std::atomic<size_t> warmed{0};
+    size_t warmKb = 0;
+    std::vector<std::thread> workers;
+    std::vector<double> microseconds(threads);
+    std::vector<size_t> sinks(threads);
+    const auto start = steady_clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::string message;
+            const auto cycle = [&] {
+                if (arena) {
+                    Arena::Scope scratch;
+                    std::pmr::vector<std::pmr::string> timestamps(scratch.resource());
+                    std::pmr::vector<std::pmr::vector<std::pmr::string>> values(perThread, scratch.resource());
+                    appendTable(names, series, timestamps, values, message);
+                } else {
+                    std::vector<std::string> timestamps;
+                    std::vector<std::vector<std::string>> values(perThread);
+                    appendTable(names, series, timestamps, values, message);
+                }
+                sinks[t] += message.size();
+            };
+            cycle();
+            if (++warmed == threads) {
+                warmKb = residentKb();
+                ++warmed;
+            }
+            while (warmed.load() <= threads) std::this_thread::yield();
+            const auto begin = steady_clock::now();
+            for (size_t i = 0; i < cycles; ++i) cycle();
+            microseconds[t] = std::chrono::duration<double, std::micro>(steady_clock::now() - begin).count() / cycles;
+        });
+    }
+    for (auto& worker: workers) worker.join();
+    const double wall = std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+
+    double slowest = 0;
+    for (const double us: microseconds) slowest = std::max(slowest, us);
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    const long growthKb = static_cast<long>(residentKb()) - static_cast<long>(warmKb);
+    std::printf("%6zu %8zu  %-7s %10.1f us %10.1f ms %8ld kB %10.1f MB\n", pairs, threads, arena ? "arena" : "global", slowest, wall,
+                growthKb, usage.ru_maxrss / 1024.0);
+    size_t sink = 0;
+    for (const auto s: sinks) sink += s;
+    return sink == 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // Run of a single configuration: bench_arena --run <arena> <pairs> <threads> <cycles> <candles>
+    if (argc == 7 && std::string(argv[1]) == "--run") {
+        return load(std::string(argv[2]) == "1", std::stoul(argv[3]), std::stoul(argv[4]), std::stoul(argv[5]), std::stoul(argv[6]));
+    }
+    const size_t pairs = argc > 1 ? std::stoul(argv[1]) : 200;
+    const size_t threads = argc > 2 ? std::stoul(argv[2]) : std::max(2u, std::thread::hardware_concurrency());
+    const size_t cycles = argc > 3 ? std::stoul(argv[3]) : 200;
+    const size_t candles = argc > 4 ? std::stoul(argv[4]) : 60;
+    std::printf("%zu cycles of the table of %zu candles per pair, the pairs shared by the threads\n", cycles, candles);
+    std::printf("%6s %8s  %-7s %13s %13s %11s %13s\n", "pairs", "threads", "memory", "cycle", "wall", "RSS growth", "peak RSS");
+    for (const size_t n: {size_t(1), threads}) {
+        for (const char* arena: {"0", "1"}) {
+            const std::string command = std::string(argv[0]) + " --run " + arena + " " + std::to_string(pairs) + " " + std::to_string(n) +
+                                        " " + std::to_string(cycles) + " " + std::to_string(candles);
+            std::fflush(stdout);
+            if (std::system(command.c_str()) != 0) return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "bench.h"
+#include "../src/api/bitstamp_api.h"
+#include "../src/api/ticker_catalog.h"
+#include "../src/crypto_market_data/crypto.h"
+#include "../tests/loopback_server.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Startup of the programs: the construction of one BitstampApi and one CryptoDataUpdater per pair, against
+ * a local stand-in of the api listing a few hundred pairs, with the ticker catalog downloaded (cold, no
+ * cache file) or loaded from its cache file (warm). Every run is its own process, so that the catalog is
+ * not shared between runs; the requests received by the stand-in are counted for each run.
+ * Usage: bench_catalog [listed pairs] [pairs...]
+ */
+namespace {
+
+// The ticker endpoint without a pair: the tickers of all the pairs listed
+std::string allTickers(size_t n) {
+    std::string json = "[";
+    for (size_t i = 0; i < n; ++i) {
+        json += (i == 0 ? "" : ", ") + std::string("{\"timestamp\": \"1720719943\", \"last\": \"57844\", \"volume\": \"2236.53575468\", \"pair\": \"C") +
+                std::to_string(i) + "/USD\"}";
+    }
+    return json + "]";
+}
+
+// Constructs the objects of the given number of pairs; prints the time taken
+int start(size_t pairs, const std::string& url, const char* load) {
+    const auto begin = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<BitstampApi>> apis;
+    std::vector<std::unique_ptr<CryptoDataUpdater>> cryptos;
+    for (size_t i = 0; i < pairs; ++i) {
+        apis.push_back(std::make_unique<BitstampApi>(5, url));
+        cryptos.push_back(std::make_unique<CryptoDataUpdater>("c" + std::to_string(i), "usd", *apis.back()));
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    std::printf("%6zu  %-5s %10.2f ms", pairs, load, ms);
+    std::fflush(stdout);
+    TickerCatalog::shutdown();
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // Run of a single configuration: bench_catalog --run <pairs> <url> <cache directory> <cold|warm>
+    if (argc == 6 && std::string(argv[1]) == "--run") {
+        TickerCatalog::setCacheDirectory(argv[4]);
+        return start(std::stoul(argv[2]), argv[3], argv[5]);
+    }
+    const size_t listed = argc > 1 ? std::stoul(argv[1]) : 505;
+    std::vector<size_t> pairs;
+    for (int i = 2; i < argc; ++i) pairs.push_back(std::min<size_t>(std::stoul(argv[i]), listed));
+    if (pairs.empty()) pairs = {5, 50, 500};
+
+    const std::string body = allTickers(listed);
+    std::atomic<size_t> requests{0};
+    LoopbackServer server(LoopbackServer::serve([&](const std::string&) {
+        ++requests;
+        return LoopbackServer::response(body, "Content-Type: application/json\r\n");
+    }));
+    char directory[] = "/tmp/bench_catalogXXXXXX";
+    if (::mkdtemp(directory) == nullptr) return 1;
+
+    std::printf("%zu pairs listed by the stand-in of the api\n", listed);
+    std::printf("%6s  %-5s %13s %10s\n", "pairs", "load", "startup", "requests");
+    int status = 0;
+    for (const auto n: pairs) {
+        std::system(("rm -f " + std::string(directory) + "/*").c_str());
+        for (const char* load: {"cold", "warm"}) {
+            const size_t before = requests.load();
+            const std::string command = std::string(argv[0]) + " --run " + std::to_string(n) + " " + server.url("/") + " " +
+                                        directory + "/ " + load;
+            std::fflush(stdout);
+            if ((status = std::system(command.c_str())) != 0) break;
+            std::printf(" %10zu\n", requests.load() - before);
+        }
+        if (status != 0) break;
+    }
+    std::system(("rm -rf " + std::string(directory)).c_str());
+    return status != 0;
+}
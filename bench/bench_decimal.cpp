@@ -0,0 +1,53 @@
+#include "bench.h"
+#include "../src/utils/decimal.h"
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Conversions of the prices and volumes: Decimal::parse against the conversions to double, and
+ * Decimal::append against snprintf, on values with 0 to 8 decimals.
+ */
+int main(int argc, char** argv) {
+    const size_t n = argc > 1 ? std::stoul(argv[1]) : 100000;
+    std::mt19937_64 random(1);
+    std::vector<std::string> texts;
+    char buffer[48];
+    for (size_t i = 0; i < n; ++i) {
+        std::snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(random() % 9), static_cast<double>(random() % 100000000) / 1000);
+        texts.push_back(buffer);
+    }
+    std::vector<int64_t> units(n);
+    std::vector<unsigned> decimals(n);
+    std::vector<double> doubles(n);
+    for (size_t i = 0; i < n; ++i) {
+        Decimal::parse(texts[i], 8, units[i]);
+        decimals[i] = Decimal::decimals(texts[i]);
+        doubles[i] = std::strtod(texts[i].c_str(), nullptr);
+    }
+
+    int64_t sink = 0;
+    double total = 0;
+    const auto report = [&](const char* name, double us) {std::printf("%-24s %6.1f ns/value\n", name, us * 1000 / n);};
+    report("Decimal::parse", bench::microseconds(10, [&] {
+        for (const auto& text: texts) {int64_t value = 0; if (Decimal::parse(text, 8, value)) sink += value;}
+    }));
+    report("std::strtod", bench::microseconds(10, [&] {
+        for (const auto& text: texts) total += std::strtod(text.c_str(), nullptr);
+    }));
+    report("std::from_chars(double)", bench::microseconds(10, [&] {
+        for (const auto& text: texts) {double value = 0; std::from_chars(text.data(), text.data() + text.size(), value); total += value;}
+    }));
+    std::string out;
+    report("Decimal::append", bench::microseconds(10, [&] {
+        for (size_t i = 0; i < n; ++i) {out.clear(); Decimal::append(units[i], 8, decimals[i], out); sink += static_cast<int64_t>(out.size());}
+    }));
+    report("snprintf(%.*f)", bench::microseconds(10, [&] {
+        for (size_t i = 0; i < n; ++i) sink += std::snprintf(buffer, sizeof(buffer), "%.*f", static_cast<int>(decimals[i]), doubles[i]);
+    }));
+    return sink == 0 && total == 0;
+}
@@ -0,0 +1,51 @@
+#include "bench.h"
+#include "../src/api/connection_pool.h"
+#include "../src/api/web_requests.h"
+#include "../tests/loopback_server.h"
+#include <cstdio>
+#include <string>
+
+/*
+ * Requests served by the in-process client (keep-alive connections) against the curl fallback of
+ * HttpRequest (one process and one connection per request), on a loopback server answering with a
+ * ticker (small) and an ohlc response of 1000 candles (large). Usage: bench_http [requests]
+ */
+namespace {
+
+// Runs the curl command of HttpRequest, as its fallback does; returns the size of the output
+size_t curl(const std::string& command, const std::string& url) {
+    FILE* pipe = ::popen((command + "\"" + url + "\"").c_str(), "r");
+    if (pipe == nullptr) return 0;
+    char buffer[16384];
+    size_t total = 0, n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), pipe)) > 0) total += n;
+    ::pclose(pipe);
+    return total;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const int requests = argc > 1 ? std::stoi(argv[1]) : 200;
+    const std::string ticker = "{\"timestamp\": \"1720719943\", \"open\": \"57700\", \"high\": \"59516\", \"low\": \"57072\", \"last\": \"57844\", "
+                               "\"volume\": \"2236.53575468\", \"vwap\": \"58140\", \"bid\": \"57841\", \"ask\": \"57850\", \"side\": \"0\"}";
+    const std::string ohlc = bench::ohlcResponse(1000);
+    LoopbackServer server(LoopbackServer::serve([&](const std::string& head) {
+        return LoopbackServer::response(head.find("/ohlc") != std::string::npos ? ohlc : ticker, "Content-Type: application/json\r\n");
+    }));
+
+    ConnectionPool pool;
+    HttpClient client(pool);
+    HttpRequest request;
+    for (const char* target: {"/ticker", "/ohlc"}) {
+        const std::string url = server.url(target);
+        size_t bytes = 0;
+        const double native = bench::microseconds(requests, [&] {bytes += client.get(url, {request.getUserAgentHeader()}, Deadline::in(10)).body.size();});
+        const double forked = bench::microseconds(requests / 10 + 1, [&] {bytes += curl(request.getCommand(), url);});
+        std::printf("%-8s %7zu bytes: client %8.1f us/request, curl %8.1f us/request (x%.1f)\n", target, url.find("ohlc") != std::string::npos ? ohlc.size() : ticker.size(),
+                    native, forked, forked / native);
+        if (bytes == 0) return 1;
+    }
+    std::cout << pool.stats() << std::endl;
+    return 0;
+}
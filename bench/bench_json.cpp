@@ -0,0 +1,38 @@
+#include "bench.h"
+#include "../src/api/candle_series.h"
+#include "../src/json_reader/json_tokenizer.h"
+#include "../src/json_reader/multi_json_reader.h"
+#include "../src/json_reader/structural_index.h"
+#include <cstdio>
+#include <string>
+
+/*
+ * Decoding of an ohlc response: the structural index (stage 1) with each kernel, the tokens with and
+ * without the index, the maps of MultiJsonReader and the fixed-point columns of CandleSeries::parse.
+ */
+int main(int argc, char** argv) {
+    const size_t candles = argc > 1 ? std::stoul(argv[1]) : 1000;
+    const std::string json = bench::ohlcResponse(candles);
+    const auto rate = [&](double us) {return json.size() / us / 1000;};
+    std::printf("ohlc response of %zu candles, %zu bytes\n", candles, json.size());
+
+    size_t sink = 0;
+    for (const auto kernel: {StructuralIndex::Kernel::Scalar, StructuralIndex::Kernel::Sse42, StructuralIndex::Kernel::Avx2}) {
+        StructuralIndex index;
+        const double us = bench::microseconds(200, [&] {sink += index.build(json, kernel);});
+        std::printf("  stage 1 %-7s %8.1f us %6.2f GB/s, %zu positions\n", StructuralIndex::kernelName(kernel), us, rate(us), index.size());
+    }
+    const auto tokens = [&](JsonTokenizer& tokenizer) {
+        for (auto token = tokenizer.next(); token.type != JsonTokenizer::TokenType::End && token.type != JsonTokenizer::TokenType::Error; token = tokenizer.next()) ++sink;
+    };
+    double us = bench::microseconds(100, [&] {JsonTokenizer tokenizer(json); tokens(tokenizer);});
+    std::printf("  tokens without index    %8.1f us %6.2f GB/s\n", us, rate(us));
+    us = bench::microseconds(100, [&] {StructuralIndex index(json); JsonTokenizer tokenizer(json, index); tokens(tokenizer);});
+    std::printf("  tokens with index       %8.1f us %6.2f GB/s (stage 1 included)\n", us, rate(us));
+
+    us = bench::microseconds(20, [&] {MultiJsonReader reader; reader.setFromString(json); sink += reader.get().size();});
+    std::printf("  MultiJsonReader         %8.1f us %6.2f GB/s\n", us, rate(us));
+    us = bench::microseconds(100, [&] {CandleSeries series; sink += series.parse(json) ? series.size() : 0;});
+    std::printf("  CandleSeries::parse     %8.1f us %6.2f GB/s\n", us, rate(us));
+    return sink == 0;
+}
@@ -0,0 +1,122 @@
+#include "bench.h"
+#include "../src/api/async_http_client.h"
+#include "../src/api/connection_pool.h"
+#include "../tests/loopback_server.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+/*
+ * Polling of many pairs at a fixed interval against a loopback server answering with a ticker: one thread
+ * per pair sending blocking requests (as the multi-coin loops did before the event loop), against the
+ * requests of all the pairs submitted to the AsyncHttpClient by a single thread. A pair is skipped while
+ * its previous request is outstanding. Each configuration runs in its own process, so that the peak RSS
+ * of one does not hide the others. Usage: bench_polling [seconds] [interval ms] [pairs...]
+ */
+namespace {
+
+using namespace std::chrono;
+
+const std::string TICKER = "{\"timestamp\": \"1720719943\", \"open\": \"57700\", \"high\": \"59516\", \"low\": \"57072\", \"last\": \"57844\", "
+                           "\"volume\": \"2236.53575468\", \"vwap\": \"58140\", \"bid\": \"57841\", \"ask\": \"57850\", \"side\": \"0\"}";
+
+size_t threads() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 8, "Threads:") == 0) return std::stoul(line.substr(8));
+    }
+    return 0;
+}
+
+// Polls the pairs for the given time; prints the max number of threads, the peak RSS and the requests completed
+int poll(bool async, size_t pairs, const std::string& url, int seconds, int intervalMs) {
+    std::atomic<bool> running{true};
+    std::atomic<size_t> maxThreads{0};
+    std::thread sampler([&] {
+        while (running.load()) {
+            maxThreads = std::max(maxThreads.load(), threads());
+            std::this_thread::sleep_for(milliseconds(20));
+        }
+    });
+
+    const auto end = steady_clock::now() + std::chrono::seconds(seconds);
+    const auto interval = milliseconds(intervalMs);
+    std::atomic<uint64_t> completed{0};
+    if (async) {
+        auto& client = AsyncHttpClient::shared();
+        std::vector<std::atomic<bool>> outstanding(pairs);
+        std::vector<steady_clock::time_point> due(pairs, steady_clock::now());
+        while (steady_clock::now() < end) {
+            const auto now = steady_clock::now();
+            for (size_t i = 0; i < pairs; ++i) {
+                if (due[i] > now || outstanding[i].load()) continue;
+                due[i] = now + interval;
+                outstanding[i] = true;
+                client.get(url, {}, Deadline::in(10), [&, i](HttpResponse response) {
+                    if (response.ok()) ++completed;
+                    outstanding[i] = false;
+                });
+            }
+            std::this_thread::sleep_for(milliseconds(10));
+        }
+        while (client.inFlight() > 0) std::this_thread::sleep_for(milliseconds(10));
+    } else {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < pairs; ++i) {
+            workers.emplace_back([&] {
+                HttpClient client;
+                while (steady_clock::now() < end) {
+                    const auto next = steady_clock::now() + interval;
+                    if (client.get(url, {}, Deadline::in(10)).ok()) ++completed;
+                    std::this_thread::sleep_until(next);
+                }
+            });
+        }
+        for (auto& worker: workers) worker.join();
+    }
+    running = false;
+    sampler.join();
+
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    std::printf("%6zu  %-13s %8zu %10.1f MB %10llu\n", pairs, async ? "event loop" : "thread/pair", maxThreads.load(),
+                usage.ru_maxrss / 1024.0, static_cast<unsigned long long>(completed.load()));
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // Run of a single configuration: bench_polling --run <async> <pairs> <url> <seconds> <interval ms>
+    if (argc == 7 && std::string(argv[1]) == "--run") {
+        return poll(std::string(argv[2]) == "1", std::stoul(argv[3]), argv[4], std::stoi(argv[5]), std::stoi(argv[6]));
+    }
+    const int seconds = argc > 1 ? std::stoi(argv[1]) : 5;
+    const int intervalMs = argc > 2 ? std::stoi(argv[2]) : 1000;
+    std::vector<size_t> pairs;
+    for (int i = 3; i < argc; ++i) pairs.push_back(std::stoul(argv[i]));
+    if (pairs.empty()) pairs = {10, 100, 1000};
+
+    LoopbackServer server(LoopbackServer::serve([](const std::string&) {
+        return LoopbackServer::response(TICKER, "Content-Type: application/json\r\n");
+    }));
+    std::printf("%d s, one request per pair every %d ms, at most %zu connections\n", seconds, intervalMs,
+                ConnectionPool::shared().getMaxConnectionsPerHost());
+    std::printf("%6s  %-13s %8s %13s %10s\n", "pairs", "mode", "threads", "peak RSS", "requests");
+    for (const auto n: pairs) {
+        for (const char* async: {"0", "1"}) {
+            const std::string command = std::string(argv[0]) + " --run " + async + " " + std::to_string(n) + " " + server.url("/ticker/") +
+                                        " " + std::to_string(seconds) + " " + std::to_string(intervalMs);
+            std::fflush(stdout);
+            if (std::system(command.c_str()) != 0) return 1;
+        }
+    }
+    return 0;
+}
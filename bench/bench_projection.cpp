@@ -0,0 +1,49 @@
+#include "bench.h"
+#include "../src/api/candle_series.h"
+#include "../src/json_reader/json_reader.h"
+#include "../src/json_reader/multi_json_reader.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/*
+ * Narrow projections of large ohlc responses (e.g. the timestamps and closes of the candles, 2 of their 6
+ * fields): all the fields decoded into maps and the others erased afterwards, the projection pushed down
+ * into MultiJsonReader (the other keys skipped as tokens), and the columns of the mask of CandleSeries::parse.
+ * Usage: bench_projection [candles]
+ */
+int main(int argc, char** argv) {
+    const size_t largest = argc > 1 ? std::stoul(argv[1]) : 10000;
+    const std::vector<std::string> fields = {"timestamp", "close"};
+    const JsonProjection projection(fields);
+    const CandleSeries::Mask mask = CandleSeries::mask(fields);
+    std::printf("projection of %zu of %zu fields\n", fields.size(), size_t(CandleSeries::COLUMNS));
+
+    size_t sink = 0;
+    for (size_t candles = 1000; candles <= largest; candles *= 10) {
+        const std::string json = bench::ohlcResponse(candles);
+        const int reps = static_cast<int>(std::max<size_t>(1, 20000 / candles));
+        const auto rate = [&](double us) {return json.size() / us / 1000;};
+        std::printf("ohlc response of %zu candles, %zu bytes\n", candles, json.size());
+
+        double us = bench::microseconds(reps, [&] {
+            MultiJsonReader reader;
+            reader.setFromString(json);
+            auto objects = reader.take();
+            for (auto& object: objects) {
+                for (auto it = object.begin(); it != object.end();) it = projection.contains(it->first) ? std::next(it) : object.erase(it);
+            }
+            sink += objects.size();
+        });
+        std::printf("  maps, filtered after      %9.1f us %6.2f GB/s\n", us, rate(us));
+        us = bench::microseconds(reps, [&] {MultiJsonReader reader(json, projection); sink += reader.get().size();});
+        std::printf("  maps, projection          %9.1f us %6.2f GB/s\n", us, rate(us));
+        us = bench::microseconds(reps * 5, [&] {CandleSeries series; sink += series.parse(json) ? series.size() : 0;});
+        std::printf("  CandleSeries::parse       %9.1f us %6.2f GB/s\n", us, rate(us));
+        us = bench::microseconds(reps * 5, [&] {CandleSeries series; sink += series.parse(json, mask) ? series.size() : 0;});
+        std::printf("  CandleSeries::parse mask  %9.1f us %6.2f GB/s\n", us, rate(us));
+    }
+    return sink == 0;
+}
@@ -0,0 +1,93 @@
+#include "bench.h"
+#include "../src/api/candle_series.h"
+#include "../src/api/currency_info.h"
+#include "../src/api/ticker.h"
+#include "../src/json_reader/json_reader.h"
+#include "../src/json_reader/json_schema.h"
+#include "../src/json_reader/multi_json_reader.h"
+#include <array>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Decoding of each payload type of the api: the maps of the generic readers (JsonReader, MultiJsonReader)
+ * against the parser specialized for the schema of the payload (see json_schema.h), on the ticker, the
+ * hourly ticker, the ohlc, the currencies and the all-tickers payloads. Usage: bench_schema [pairs] [candles]
+ */
+namespace {
+
+const std::string TICKER = "{\"timestamp\": \"1720719943\", \"open\": \"57700\", \"high\": \"59516\", \"low\": \"57072\", \"last\": \"57844\", "
+                           "\"volume\": \"2236.53575468\", \"vwap\": \"58140\", \"bid\": \"57841\", \"ask\": \"57850\", \"side\": \"0\", "
+                           "\"open_24\": \"57310\", \"percent_change_24\": \"0.93\"}";
+const std::string HOURLY_TICKER = "{\"high\": \"57958\", \"last\": \"57844\", \"timestamp\": \"1720719943\", \"bid\": \"57841\", "
+                                  "\"vwap\": \"57807\", \"volume\": \"61.36740153\", \"low\": \"57640\", \"ask\": \"57850\", \"open\": \"57702\"}";
+
+// Schema of the all-tickers payload when only the pairs are needed, as the ticker catalog reads it
+struct PairSchema {
+    using Record = std::string;
+    static constexpr std::array<std::string_view, 1> KEYS = {"pair"};
+
+    static bool set(Record& pair, size_t, const JsonTokenizer::Token& value) {
+        return value.type == JsonTokenizer::TokenType::String && JsonReader::storeValue(value, pair);
+    }
+};
+
+// The currencies payload, with the members of the crypto currencies which are not fields of the record
+std::string currenciesResponse(size_t n) {
+    std::string json = "[";
+    for (size_t i = 0; i < n; ++i) {
+        const std::string symbol = "C" + std::to_string(i);
+        json += (i == 0 ? "{" : ", {") + std::string("\"name\": \"Currency ") + std::to_string(i) + "\", \"currency\": \"" + symbol +
+                "\", \"type\": \"" + (i % 4 == 0 ? "fiat" : "crypto") + "\", \"symbol\": \"" + symbol + "\", \"decimals\": " +
+                std::to_string(2 + i % 7) + ", \"logo\": \"https://assets.bitstamp.net/static/logos/" + symbol + ".svg\", " +
+                "\"available_supply\": \"" + std::to_string(1000000 + i * 7919) + ".0\", \"deposit\": \"Enabled\", \"withdrawal\": \"Enabled\"}";
+    }
+    return json + "]";
+}
+
+// The all-tickers payload: the ticker of each pair, with its name
+std::string tickersResponse(size_t n) {
+    std::string json = "[";
+    for (size_t i = 0; i < n; ++i) {
+        json += (i == 0 ? "" : ", ") + TICKER.substr(0, TICKER.size() - 1) + ", \"pair\": \"C" + std::to_string(i) + "/USD\"}";
+    }
+    return json + "]";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t pairs = argc > 1 ? std::stoul(argv[1]) : 200;
+    const size_t candles = argc > 2 ? std::stoul(argv[2]) : 1000;
+    std::printf("payloads of %zu pairs and currencies, ohlc of %zu candles\n", pairs, candles);
+    size_t sink = 0;
+    const auto report = [](const char* payload, size_t bytes, double generic, double schema) {
+        std::printf("  %-14s %8zu bytes %10.2f us generic %10.2f us schema, %5.1fx\n", payload, bytes, generic, schema, generic / schema);
+    };
+
+    for (const auto& [payload, json]: {std::pair<const char*, const std::string&>{"ticker", TICKER}, {"hourly ticker", HOURLY_TICKER}}) {
+        const double generic = bench::microseconds(20000, [&] {JsonReader reader(json); sink += reader.get().size();});
+        const double schema = bench::microseconds(20000, [&] {Ticker ticker; sink += ticker.parse(json) ? ticker.present : 0;});
+        report(payload, json.size(), generic, schema);
+    }
+
+    const std::string ohlc = bench::ohlcResponse(candles);
+    double generic = bench::microseconds(20, [&] {MultiJsonReader reader; reader.setFromString(ohlc); sink += reader.get().size();});
+    double schema = bench::microseconds(100, [&] {CandleSeries series; sink += series.parse(ohlc) ? series.size() : 0;});
+    report("ohlc", ohlc.size(), generic, schema);
+
+    const std::string currencies = currenciesResponse(pairs);
+    generic = bench::microseconds(50, [&] {MultiJsonReader reader; reader.setFromString(currencies); sink += reader.get().size();});
+    schema = bench::microseconds(50, [&] {std::vector<CurrencyInfo> out; sink += CurrencyInfo::parseList(currencies, out) ? out.size() : 0;});
+    report("currencies", currencies.size(), generic, schema);
+
+    // The pairs of the all-tickers payload, as the catalog reads them: the generic reader decodes all the
+    // members of the tickers, the schema only their pairs
+    const std::string tickers = tickersResponse(pairs);
+    generic = bench::microseconds(50, [&] {MultiJsonReader reader; reader.setFromString(tickers); for (const auto& ticker: reader.get()) sink += ticker.at("pair").size();});
+    schema = bench::microseconds(50, [&] {JsonSchemaReader<PairSchema>::readArray(tickers, [&](const std::string& pair) {sink += pair.size();});});
+    report("pairs", tickers.size(), generic, schema);
+    return sink == 0;
+}
@@ -0,0 +1,114 @@
+#include "bench.h"
+#include "../tests/fixtures.h"
+#include "../src/storage/candle_archive.h"
+#include "../src/storage/candle_csv.h"
+#include "../src/storage/compressed_series.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+/*
+ * Storage of the candles: reading a csv file against a CandleArchive, the size and speed of the
+ * compressed candles, and the range reads of both. Usage: bench_storage [candles] [directory]
+ */
+namespace {
+
+// 1-minute BTC/USD candles as Bitstamp sends them: prices with 2 decimals, open = previous close, volumes with 8 decimals
+CandleSeries candles(size_t n) {
+    std::mt19937_64 random(7);
+    std::normal_distribution<double> move(0, 1);
+    std::lognormal_distribution<double> volume(-1.5, 1.2);
+    CandleSeries series;
+    for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) series.scale[c] = series.decimals[c] = c == CandleSeries::Volume ? 8 : 2;
+    series.reserve(n);
+    int64_t price = 5784000;
+    for (size_t i = 0; i < n; ++i) {
+        const int64_t open = price;
+        const int64_t close = open + static_cast<int64_t>(move(random) * 1800);
+        series.timestamp.push_back(1720656000 + 60 * static_cast<int64_t>(i));
+        series.open.push_back(open);
+        series.high.push_back(std::max(open, close) + static_cast<int64_t>(std::abs(move(random) * 900)));
+        series.low.push_back(std::min(open, close) - static_cast<int64_t>(std::abs(move(random) * 900)));
+        series.close.push_back(close);
+        series.volume.push_back(static_cast<int64_t>(volume(random) * 1e8));
+        price = close;
+    }
+    return series;
+}
+
+// Candles [first, last) of a series, into out
+void slice(const CandleSeries& series, size_t first, size_t last, CandleSeries& out) {
+    std::copy(series.scale, series.scale + CandleSeries::COLUMNS, out.scale);
+    std::copy(series.decimals, series.decimals + CandleSeries::COLUMNS, out.decimals);
+    out.timestamp.assign(series.timestamp.begin() + first, series.timestamp.begin() + last);
+    for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) {
+        const auto& values = series.values(static_cast<CandleSeries::Column>(c));
+        out.values(static_cast<CandleSeries::Column>(c)).assign(values.begin() + first, values.begin() + last);
+    }
+}
+
+using fixtures::sameCandles;
+
+// Start of the i-th range of count candles read
+int64_t rangeStart(const CandleSeries& series, size_t i, size_t count) {
+    return series.timestamp[(i * 7919) % (series.size() - count)];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    const std::string directory = argc > 2 ? argv[2] : "/tmp";
+    const std::string prefix = directory + "/bench_storage_" + std::to_string(::getpid());
+    if (n < 2000) return 1;
+    const CandleSeries series = candles(n);
+    std::printf("%zu candles\n", n);
+
+    // Csv file and archive
+    const std::string csv = prefix + ".csv", archivePath = prefix + ".cndl";
+    CandleSeries out;
+    if (!CandleCsv::write(csv, "btc/usd", series) || !CandleArchive::append(archivePath, "btc/usd", series)) return 1;
+    double us = bench::microseconds(1, [&] {CandleCsv::read(csv, out);});
+    std::printf("  csv read            %9.1f ms, equal %d\n", us / 1000, sameCandles(series, out));
+    CandleArchive archive;
+    us = bench::microseconds(1, [&] {archive.close(); archive.open(archivePath); archive.copy(0, archive.size(), out);});
+    std::printf("  archive open + copy %9.1f ms, equal %d\n", us / 1000, sameCandles(series, out));
+    size_t range = 0;
+    us = bench::microseconds(1000, [&] {const int64_t from = rangeStart(series, range++, 1000); archive.read(from, from + 60 * 999, out);});
+    std::printf("  archive range of 1000 candles %6.2f us\n", us);
+
+    // Compressed candles, appended as polling would (1000 candles at a time, the last one replaced)
+    CompressedCandles compressed;
+    us = bench::microseconds(1, [&] {
+        compressed.clear();
+        CandleSeries part;
+        for (size_t first = 0; first < n; first += 999) {
+            const size_t count = std::min(n - first, size_t(1000));
+            slice(series, first, first + count, part);
+            compressed.append(part);
+        }
+    });
+    std::printf("  compressed: %zu bytes, %.2f bytes per candle (48 in a CandleSeries), %zu blocks\n", compressed.bytes(), static_cast<double>(compressed.bytes()) / n, compressed.blocks());
+    std::printf("  encode %6.1f M candles/s\n", n / us);
+    us = bench::microseconds(3, [&] {compressed.read(out);});
+    std::printf("  decode %6.1f M candles/s, equal %d\n", n / us, sameCandles(series, out));
+    for (const size_t count: {size_t(10), size_t(1000)}) {
+        us = bench::microseconds(1000, [&] {const int64_t from = rangeStart(series, range++, count); compressed.read(from, from + 60 * static_cast<int64_t>(count - 1), out);});
+        std::printf("  compressed range of %zu candles %6.2f us\n", count, us);
+    }
+    const std::string compressedPath = prefix + ".cc";
+    CompressedCandles loaded;
+    const bool saved = compressed.save(compressedPath);
+    us = bench::microseconds(1, [&] {loaded.load(compressedPath);});
+    loaded.read(out);
+    std::printf("  save %d, load %.1f ms, equal %d\n", saved, us / 1000, sameCandles(series, out));
+
+    std::remove(csv.c_str());
+    std::remove(archivePath.c_str());
+    std::remove(compressedPath.c_str());
+    return 0;
+}
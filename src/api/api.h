@@ -1,8 +1,13 @@
 #pragma once
 
+#include <functional> 
 #include <string> 
 #include <vector> 
 #include <unordered_map> 
+#include "candle_series.h"
+#include "currency_info.h"
+#include "symbol_table.h"
+#include "ticker.h"
 
 using DataMap = std::unordered_map<std::string, std::string>; 
 using DataMapVec = std::vector<std::unordered_map<std::string, std::string>>; 
@@ -25,11 +30,128 @@ public:
     virtual DataMapVec fetchAllPairs() = 0; // gets information about all pairs in the exchange
     virtual DataMap fetchMarketTicker(const std::string& ticker) = 0; // gets the latest market data for a specific ticker 
     virtual DataMap fetchHourlyTicker(const std::string& ticker) = 0; // gets hourly market data for a specific ticker
+
+    // Gets the latest market data for several tickers (by id, see pairId) at once; the default performs 
+    // one request per ticker, exchanges with a bulk endpoint should override it 
+    virtual std::unordered_map<PairId, DataMap> fetchMarketTickers(const std::vector<PairId>& tickers) {
+        std::unordered_map<PairId, DataMap> marketData; 
+        for (const auto id: tickers) marketData[id] = fetchMarketTicker(SymbolTable::shared().name(id)); 
+        return marketData; 
+    }
     
     // Gets candlestick data about a specific ticker -
     // otherArgs is a map in which the keys denote the request parameter names, and the values are the request parameter values
     virtual DataMapVec fetchCandlestickData(const std::string& ticker, const std::unordered_map<std::string,std::string>& otherArgs) = 0;
 
+    // Asynchronous versions: the callback receives the data (empty on failure), possibly on a thread of the Api. 
+    // The defaults perform the request on the calling thread 
+    virtual void fetchMarketTickerAsync(const std::string& ticker, std::function<void(DataMap)> callback) {
+        callback(fetchMarketTicker(ticker)); 
+    }
+    virtual void fetchCandlestickDataAsync(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        std::function<void(DataMapVec)> callback
+    ) {
+        callback(fetchCandlestickData(ticker, otherArgs)); 
+    }
+
+    // Candlestick data as columns (see candle_series.h), only the columns of the mask are kept. The defaults 
+    // convert the maps of fetchCandlestickData: exchanges should decode straight into the columns 
+    CandleSeries fetchCandleSeries(const std::string& ticker, const std::unordered_map<std::string,std::string>& otherArgs) {
+        return fetchCandleSeries(ticker, otherArgs, CandleSeries::ALL); 
+    }
+    virtual CandleSeries fetchCandleSeries(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        CandleSeries::Mask columns
+    ) {
+        auto series = CandleSeries::fromRecords(fetchCandlestickData(ticker, otherArgs)); 
+        series.select(columns); 
+        return series; 
+    }
+    void fetchCandleSeriesAsync(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        std::function<void(CandleSeries)> callback
+    ) {
+        fetchCandleSeriesAsync(ticker, otherArgs, std::move(callback), CandleSeries::ALL); 
+    }
+    virtual void fetchCandleSeriesAsync(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        std::function<void(CandleSeries)> callback, 
+        CandleSeries::Mask columns
+    ) {
+        fetchCandlestickDataAsync(ticker, otherArgs, [callback = std::move(callback), columns](DataMapVec candlestickData) {
+            auto series = CandleSeries::fromRecords(candlestickData); 
+            series.select(columns); 
+            callback(std::move(series)); 
+        }); 
+    }
+
+    // Same, decoding into a lent series whose buffers are reused and handed back to the callback. 
+    // The default cannot decode into it (it converts maps): the series is released 
+    void fetchCandleSeriesIntoAsync(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        CandleSeries series, 
+        std::function<void(CandleSeries)> callback
+    ) {
+        fetchCandleSeriesIntoAsync(ticker, otherArgs, std::move(series), std::move(callback), CandleSeries::ALL); 
+    }
+    virtual void fetchCandleSeriesIntoAsync(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        CandleSeries /* series */, 
+        std::function<void(CandleSeries)> callback, 
+        CandleSeries::Mask columns
+    ) {
+        fetchCandleSeriesAsync(ticker, otherArgs, std::move(callback), columns); 
+    }
+
+    // Restricts the candlestick request otherArgs to the candles from timestamp on (window: candles of the 
+    // whole request, 0 if unknown); returns false if it cannot (the default) 
+    virtual bool sinceCandlestickArgs(
+        const std::unordered_map<std::string,std::string>& /* otherArgs */, 
+        int64_t /* timestamp */, 
+        std::unordered_map<std::string,std::string>& /* sinceArgs */, 
+        size_t& /* window */
+    ) const {
+        return false; 
+    }
+
+    // Resolution in seconds of the candles requested with otherArgs (the key of their series in a store, 
+    // see MarketDataStore); 0 if unknown (the default) 
+    virtual int64_t candlestickResolution(const std::unordered_map<std::string,std::string>& /* otherArgs */) const {
+        return 0; 
+    }
+
+    // Latest market data as fixed-layout records (see ticker.h); fetchTickers fills out[i] for tickers[i]. 
+    // The defaults convert the maps of fetchMarketTicker(s) 
+    virtual Ticker fetchTicker(const std::string& ticker) {return Ticker::fromMap(fetchMarketTicker(ticker));}
+    virtual void fetchTickerAsync(const std::string& ticker, std::function<void(Ticker)> callback) {
+        fetchMarketTickerAsync(ticker, [callback = std::move(callback)](DataMap marketData) {
+            callback(Ticker::fromMap(marketData)); 
+        }); 
+    }
+    virtual bool fetchTickers(const std::vector<PairId>& tickers, std::vector<Ticker>& out) {
+        auto marketData = fetchMarketTickers(tickers); 
+        out.assign(tickers.size(), Ticker{}); 
+        for (size_t i = 0; i < tickers.size(); ++i) {
+            auto it = marketData.find(tickers[i]); 
+            if (it != marketData.end()) out[i] = Ticker::fromMap(it->second); 
+        }
+        return !marketData.empty(); 
+    }
+
+    // Metadata of all currencies as records (see currency_info.h); the default converts fetchCurrencyData 
+    virtual std::vector<CurrencyInfo> fetchCurrencies() {
+        std::vector<CurrencyInfo> currencies; 
+        for (const auto& currency: fetchCurrencyData()) currencies.push_back(CurrencyInfo::fromMap(currency)); 
+        return currencies; 
+    }
+
     virtual std::vector<std::string> fetchAllTickers() = 0; // gets all ticker names (all pairs)
     
     // Given a crypto name and a fiat (or other conversion currency), it creates a pair name
@@ -39,5 +161,13 @@ public:
     // Given a pair name, it checks if it is a valid pair for the exchange
     virtual bool validatePair(const std::string& pair) const = 0; 
 
+    // Integer id of a pair in the shared symbol table (INVALID_PAIR_ID if the pair is not valid) 
+    virtual PairId pairId(const std::string& pair) const {
+        return validatePair(pair) ? SymbolTable::shared().intern(pair) : INVALID_PAIR_ID; 
+    }
+
+    // Service queried (e.g. its base url; empty if unknown): same source, same data for the same request 
+    virtual std::string getSource() const {return "";}
+
     virtual ~Api() {}
 }; 
\ No newline at end of file
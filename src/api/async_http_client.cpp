@@ -0,0 +1,477 @@
+#include "async_http_client.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/*
+ * State of a request, from its submission to the invocation of its callback.
+ */
+struct AsyncHttpClient::Transfer {
+    enum class Phase {Queued, Connecting, Writing, Reading};
+
+    uint64_t id = 0;
+    Url url;
+    std::string hostKey;
+    std::string request;
+    size_t written = 0;
+    Deadline deadline;
+    Callback callback;
+    HttpResponseParser::BodySink sink;
+
+    Phase phase = Phase::Queued;
+    std::unique_ptr<Connection> connection;
+    bool reused = false;   // the connection was already used by a previous request
+    bool retried = false;  // the request was already sent again after a stale connection
+    uint64_t ticket = 0;   // place in the queue of the pool while the transfer waits for a connection
+    uint32_t events = 0;   // epoll events the socket is registered for (0 if not registered)
+
+    HttpResponse response;
+    std::unique_ptr<HttpResponseParser> parser;
+};
+
+AsyncHttpClient::AsyncHttpClient(ConnectionPool& pool): pool_(pool) {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd_ < 0 || wakeFd_ < 0) throw std::runtime_error("cannot create the event loop");
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = 0;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &event);
+    loop_ = std::thread([this]() {run();});
+    resolver_ = std::thread([this]() {resolveHosts();});
+}
+
+AsyncHttpClient::~AsyncHttpClient() {
+    shutdown();
+    ::close(wakeFd_);
+    ::close(epollFd_);
+}
+
+AsyncHttpClient& AsyncHttpClient::shared() {
+    static AsyncHttpClient* client = []() {
+        auto* shared = new AsyncHttpClient();
+        std::atexit([]() {AsyncHttpClient::shared().shutdown();});
+        return shared;
+    }();
+    return *client;
+}
+
+void AsyncHttpClient::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    wake();
+    if (loop_.joinable()) loop_.join();
+    resolve_.notify_all();
+    if (resolver_.joinable()) resolver_.join();
+}
+
+uint64_t AsyncHttpClient::get(const std::string& url, const std::vector<std::string>& headers, const Deadline& deadline, Callback callback,
+                              HttpResponseParser::BodySink sink) {
+    auto transfer = std::make_unique<Transfer>();
+    if (!Url::parse(url, transfer->url)) {
+        transfer->response.error = "invalid url: " + url;
+        callback(std::move(transfer->response));
+        return 0;
+    }
+    transfer->hostKey = transfer->url.hostKey();
+    transfer->request = HttpClient::formatGet(transfer->url, headers);
+    transfer->deadline = deadline;
+    transfer->callback = std::move(callback);
+    transfer->sink = std::move(sink);
+    uint64_t id;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopped_) {
+            lock.unlock();
+            transfer->response.error = "client stopped";
+            transfer->callback(std::move(transfer->response));
+            return 0;
+        }
+        id = transfer->id = nextId_++;
+        submitted_.push_back(std::move(transfer));
+        stats_.maxInFlight = std::max<uint64_t>(stats_.maxInFlight, ++inFlight_);
+    }
+    wake();
+    return id;
+}
+
+void AsyncHttpClient::cancel(uint64_t id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_.push_back(id);
+    }
+    wake();
+}
+
+void AsyncHttpClient::schedule(Clock::time_point when, std::function<void()> task) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopped_) {
+            lock.unlock();
+            task();
+            return;
+        }
+        scheduled_.emplace_back(when, std::move(task));
+    }
+    wake();
+}
+
+void AsyncHttpClient::wakeHost(const std::string& hostKey) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        woken_.push_back(hostKey);
+    }
+    wake();
+}
+
+void AsyncHttpClient::wake() {
+    uint64_t one = 1;
+    (void)::write(wakeFd_, &one, sizeof(one));
+}
+
+AsyncHttpClient::Stats AsyncHttpClient::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+size_t AsyncHttpClient::inFlight() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return inFlight_;
+}
+
+/************************
+*      Event loop       *
+*************************/
+
+void AsyncHttpClient::run() {
+    std::vector<epoll_event> events(256);
+    std::vector<std::unique_ptr<Transfer>> submitted;
+    std::vector<uint64_t> cancelled;
+    std::vector<std::pair<Clock::time_point, std::function<void()>>> scheduled;
+    std::vector<Resolution> resolutions;
+    std::vector<std::string> woken;
+    bool stopping = false;
+
+    while (!stopping) {
+        // The loop wakes up at the nearest deadline or task, and at least once per second
+        int timeoutMs = 1000;
+        auto next = Clock::time_point::max();
+        if (!timers_.empty()) next = timers_.top().first;
+        if (!tasks_.empty()) next = std::min(next, tasks_.begin()->first);
+        if (next != Clock::time_point::max()) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count() + 1;
+            timeoutMs = static_cast<int>(std::clamp<long long>(left, 0, timeoutMs));
+        }
+        int n = epoll_wait(epollFd_, events.data(), static_cast<int>(events.size()), timeoutMs);
+        if (n < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < n; ++i) {
+            uint64_t id = events[i].data.u64;
+            if (id == 0) {
+                uint64_t count;
+                (void)::read(wakeFd_, &count, sizeof(count));
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    submitted.swap(submitted_);
+                    cancelled.swap(cancelled_);
+                    scheduled.swap(scheduled_);
+                    resolutions.swap(resolved_);
+                    woken.swap(woken_);
+                    stopping = stopping_;
+                }
+                for (auto& resolution: resolutions) resolved(resolution);
+                resolutions.clear();
+                for (const auto& hostKey: woken) dispatch(hostKey);
+                woken.clear();
+                for (auto& transfer: submitted) start(std::move(transfer));
+                submitted.clear();
+                for (auto id: cancelled) {
+                    auto it = transfers_.find(id);
+                    if (it == transfers_.end()) continue; // already completed
+                    auto& transfer = *it->second;
+                    std::string hostKey = transfer.hostKey;
+                    if (transfer.connection) releaseConnection(transfer, false);
+                    finish(transfer, "cancelled");
+                    dispatch(hostKey);
+                }
+                cancelled.clear();
+                for (auto& task: scheduled) tasks_.emplace(task.first, std::move(task.second));
+                scheduled.clear();
+                continue;
+            }
+            // The transfer may have been completed by a previous event of the same batch
+            auto it = transfers_.find(id);
+            if (it != transfers_.end()) advance(*it->second);
+        }
+        expireTimers();
+        runTasks();
+    }
+
+    // Outstanding and not yet started requests fail, then the tasks are run (e.g. the retries, which
+    // fail in turn): the requests and tasks submitted from now on are handled by the calling thread
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        submitted.swap(submitted_);
+        scheduled.swap(scheduled_);
+        stopped_ = true;
+    }
+    for (auto& transfer: submitted) transfers_.emplace(transfer->id, std::move(transfer));
+    while (!transfers_.empty()) {
+        auto& transfer = *transfers_.begin()->second;
+        if (transfer.connection) releaseConnection(transfer, false);
+        finish(transfer, "client stopped");
+    }
+    hosts_.clear();
+    for (auto& task: scheduled) tasks_.emplace(task.first, std::move(task.second));
+    while (!tasks_.empty()) {
+        auto task = std::move(tasks_.begin()->second);
+        tasks_.erase(tasks_.begin());
+        task();
+    }
+}
+
+void AsyncHttpClient::start(std::unique_ptr<Transfer> transfer) {
+    auto& t = *transfer;
+    transfers_.emplace(t.id, std::move(transfer));
+    if (!t.deadline.unlimited) timers_.emplace(t.deadline.at, t.id);
+    hosts_[t.hostKey].queued.push_back(t.id);
+    dispatch(t.hostKey);
+}
+
+// A transfer started may complete at once and dispatch its host again: instead of recursing, the outer call
+// walks the queue once more
+void AsyncHttpClient::dispatch(const std::string& hostKey) {
+    auto& host = hosts_[hostKey];
+    if (host.dispatching) {
+        host.redispatch = true;
+        return;
+    }
+    host.dispatching = true;
+    do {
+        host.redispatch = false;
+        dispatchQueued(host, hostKey);
+    } while (host.redispatch);
+    host.dispatching = false;
+}
+
+void AsyncHttpClient::dispatchQueued(Host& host, const std::string& hostKey) {
+    // The transfers expired or cancelled while queued are dropped
+    host.queued.erase(std::remove_if(host.queued.begin(), host.queued.end(), [this](uint64_t id) {
+        return transfers_.find(id) == transfers_.end();
+    }), host.queued.end());
+    if (host.queued.empty()) return;
+
+    // The addresses are resolved by the resolver thread; stale addresses are used while they are resolved again
+    auto now = Clock::now();
+    if (now >= host.staleAt && !host.resolving) {
+        host.resolving = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            toResolve_.push_back(Resolution{hostKey, transfers_.at(host.queued.front())->url, {}, {}});
+        }
+        resolve_.notify_one();
+    }
+    if (host.addresses.empty()) return; // the transfers wait for the addresses
+
+    // The transfers get the connections in the order of the queue of the pool (where a transfer sent again
+    // after a stale connection, or the requests of other threads, may come first). The queue is walked on a
+    // copy, as the transfers started leave it.
+    const std::vector<uint64_t> queued(host.queued.begin(), host.queued.end());
+    for (const auto id: queued) {
+        auto it = transfers_.find(id);
+        if (it == transfers_.end() || it->second->phase != Transfer::Phase::Queued) continue;
+        auto& transfer = *it->second;
+        auto checkout = pool_.tryCheckout(hostKey, transfer.ticket, [this, hostKey]() {wakeHost(hostKey);}, transfer.connection);
+        if (checkout == ConnectionPool::Checkout::Wait) continue;
+        host.queued.erase(std::find(host.queued.begin(), host.queued.end(), id));
+
+        transfer.reused = checkout == ConnectionPool::Checkout::Idle;
+        if (!transfer.reused) {
+            std::string error;
+            transfer.connection = Connection::openNonBlocking(transfer.url, host.addresses, error);
+            if (!transfer.connection) {
+                pool_.release(hostKey);
+                finish(transfer, error);
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.connections;
+        }
+        transfer.phase = transfer.reused ? Transfer::Phase::Writing : Transfer::Phase::Connecting;
+        transfer.parser = std::make_unique<HttpResponseParser>(transfer.response, transfer.sink);
+        transfer.parser->setInflater(&transfer.connection->inflater());
+        advance(transfer);
+    }
+}
+
+void AsyncHttpClient::resolveHosts() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        resolve_.wait(lock, [this]() {return stopping_ || !toResolve_.empty();});
+        if (stopping_) return;
+        auto resolution = std::move(toResolve_.front());
+        toResolve_.pop_front();
+        lock.unlock();
+        Connection::resolve(resolution.url, resolution.addresses, resolution.error);
+        lock.lock();
+        resolved_.push_back(std::move(resolution));
+        wake();
+    }
+}
+
+// The transfers waiting for the addresses are dispatched, or fail if the host cannot be resolved (and has no
+// previous addresses)
+void AsyncHttpClient::resolved(Resolution& resolution) {
+    auto& host = hosts_[resolution.hostKey];
+    host.resolving = false;
+    if (resolution.error.empty()) {
+        host.addresses = std::move(resolution.addresses);
+        host.staleAt = Clock::now() + RESOLVE_TTL;
+    } else if (host.addresses.empty()) {
+        auto queued = std::move(host.queued);
+        host.queued.clear();
+        for (auto id: queued) {
+            auto it = transfers_.find(id);
+            if (it != transfers_.end()) finish(*it->second, resolution.error);
+        }
+    }
+    dispatch(resolution.hostKey);
+}
+
+void AsyncHttpClient::advance(Transfer& transfer) {
+    using IoStatus = Connection::IoStatus;
+    auto& connection = *transfer.connection;
+
+    if (transfer.phase == Transfer::Phase::Connecting) {
+        std::string error;
+        auto status = connection.continueOpen(error);
+        if (status == IoStatus::Error || status == IoStatus::Closed) return connectionFailed(transfer, error);
+        if (status != IoStatus::Ok) return watch(transfer, status);
+        transfer.phase = Transfer::Phase::Writing;
+    }
+
+    if (transfer.phase == Transfer::Phase::Writing) {
+        while (transfer.written < transfer.request.size()) {
+            size_t n = 0;
+            auto status = connection.write(transfer.request.data() + transfer.written, transfer.request.size() - transfer.written, n);
+            if (status == IoStatus::Ok) transfer.written += n;
+            else if (status == IoStatus::Error || status == IoStatus::Closed) return connectionFailed(transfer, "write error");
+            else return watch(transfer, status);
+        }
+        transfer.phase = Transfer::Phase::Reading;
+    }
+
+    char chunk[16384];
+    auto& parser = *transfer.parser;
+    while (!parser.done() && !parser.failed()) {
+        size_t n = 0;
+        auto status = connection.read(chunk, sizeof(chunk), n);
+        if (status == IoStatus::Ok) {
+            size_t consumed = parser.feed(chunk, n);
+            if (consumed < n) connection.pending.append(chunk + consumed, n - consumed);
+        } else if (status == IoStatus::Closed) {
+            parser.finish();
+        } else if (status == IoStatus::Error) {
+            return connectionFailed(transfer, "read error");
+        } else {
+            return watch(transfer, status);
+        }
+    }
+    if (parser.failed()) return connectionFailed(transfer, transfer.response.error);
+
+    bool keepAlive = parser.keepAlive();
+    std::string hostKey = transfer.hostKey;
+    releaseConnection(transfer, keepAlive);
+    finish(transfer, "");
+    dispatch(hostKey);
+}
+
+void AsyncHttpClient::watch(Transfer& transfer, Connection::IoStatus want) {
+    uint32_t events = want == Connection::IoStatus::WantWrite ? EPOLLOUT : EPOLLIN;
+    if (transfer.events == events) return;
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = transfer.id;
+    epoll_ctl(epollFd_, transfer.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, transfer.connection->fd(), &event);
+    transfer.events = events;
+}
+
+void AsyncHttpClient::unwatch(Transfer& transfer) {
+    if (transfer.events == 0) return;
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, transfer.connection->fd(), nullptr);
+    transfer.events = 0;
+}
+
+// Gives the connection of the transfer back to the pool (as an idle connection) or closes it
+void AsyncHttpClient::releaseConnection(Transfer& transfer, bool keepAlive) {
+    unwatch(transfer);
+    pool_.checkin(std::move(transfer.connection), keepAlive);
+}
+
+// A reused connection may have been closed by the server in the meantime: in that case
+// the request is sent again, on another connection
+void AsyncHttpClient::connectionFailed(Transfer& transfer, const std::string& error) {
+    std::string hostKey = transfer.hostKey;
+    // A host which cannot be reached any more may have moved: its addresses are resolved again
+    if (transfer.phase == Transfer::Phase::Connecting) hosts_[hostKey].staleAt = Clock::time_point{};
+    releaseConnection(transfer, false);
+    if (transfer.reused && !transfer.retried && transfer.response.status == 0 && !transfer.deadline.expired()) {
+        transfer.retried = true;
+        transfer.written = 0;
+        transfer.response = HttpResponse{};
+        transfer.phase = Transfer::Phase::Queued;
+        hosts_[transfer.hostKey].queued.push_front(transfer.id);
+    } else {
+        finish(transfer, error.empty() ? "connection error" : error);
+    }
+    dispatch(hostKey);
+}
+
+// Removes the transfer and invokes its callback (the connection must have been released)
+void AsyncHttpClient::finish(Transfer& transfer, const std::string& error) {
+    auto node = transfers_.extract(transfer.id);
+    auto owned = std::move(node.mapped());
+    if (owned->ticket != 0) pool_.abandon(owned->hostKey, owned->ticket);
+    if (!error.empty()) owned->response.error = error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --inFlight_;
+        if (error.empty()) ++stats_.completed;
+        else {
+            ++stats_.failed;
+            if (error == "timeout") ++stats_.timeouts;
+        }
+    }
+    owned->callback(std::move(owned->response));
+}
+
+void AsyncHttpClient::expireTimers() {
+    auto now = Clock::now();
+    while (!timers_.empty() && timers_.top().first <= now) {
+        uint64_t id = timers_.top().second;
+        timers_.pop();
+        auto it = transfers_.find(id);
+        if (it == transfers_.end()) continue; // already completed
+        auto& transfer = *it->second;
+        std::string hostKey = transfer.hostKey;
+        if (transfer.connection) releaseConnection(transfer, false);
+        finish(transfer, "timeout");
+        dispatch(hostKey); // the queued transfers of the host are removed by dispatch
+    }
+}
+
+void AsyncHttpClient::runTasks() {
+    auto now = Clock::now();
+    while (!tasks_.empty() && tasks_.begin()->first <= now) {
+        auto task = std::move(tasks_.begin()->second);
+        tasks_.erase(tasks_.begin());
+        task();
+    }
+}
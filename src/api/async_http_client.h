@@ -0,0 +1,144 @@
+#pragma once
+
+#include "connection_pool.h"
+#include "http_client.h"
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Asynchronous HTTP/1.1 client driven by an epoll event loop. The requests submitted by any
+ * thread are multiplexed on non-blocking sockets by a single event loop thread, so the number of
+ * threads does not depend on the number of outstanding requests. The connections are taken from, and
+ * given back to, a ConnectionPool (the one shared by the process by default): they are kept alive and
+ * reused by both the blocking and the asynchronous requests, and the requests exceeding the connection
+ * limit of a host wait in the queue of the pool, in the order of their arrival. The addresses of the hosts are
+ * resolved by a helper thread and cached, so that the event loop never blocks on DNS. Each request
+ * is bound to a deadline, and its callback is invoked exactly once with the response or with the reason of
+ * the failure. Callbacks run on the event loop thread: they must be short and must not block.
+ */
+class AsyncHttpClient {
+
+public:
+    using Callback = std::function<void(HttpResponse)>;
+
+    struct Stats {
+        uint64_t completed = 0;    // requests answered by the server
+        uint64_t failed = 0;       // requests failed (timeouts included)
+        uint64_t timeouts = 0;     // requests failed because of their deadline
+        uint64_t connections = 0;  // connections opened
+        uint64_t maxInFlight = 0;  // max number of requests submitted and not completed at the same time
+    };
+
+    explicit AsyncHttpClient(ConnectionPool& pool = ConnectionPool::shared());
+    AsyncHttpClient(const AsyncHttpClient&) = delete;
+    AsyncHttpClient& operator=(const AsyncHttpClient&) = delete;
+
+    // Shuts the client down
+    ~AsyncHttpClient();
+
+    // The client shared by the whole process (its event loop thread is started on first use). It is never
+    // destroyed, so that it outlives the objects using it: it is shut down by an exit handler.
+    static AsyncHttpClient& shared();
+
+    // Stops the event loop: the requests still outstanding fail with the error "client stopped", then the
+    // tasks still scheduled are run. The requests submitted afterwards fail, and the tasks run, on the calling
+    // thread. The later calls do nothing.
+    void shutdown();
+
+    // Submits a GET request; headers are full header lines, e.g. "User-Agent: Mozilla/5.0".
+    // The callback is invoked on the calling thread if the url is not valid. If a sink is given, the
+    // body is passed to it (on the event loop thread) while it is received, instead of being stored
+    // in the response. Returns the id of the request (0 if the url is not valid).
+    uint64_t get(const std::string& url, const std::vector<std::string>& headers, const Deadline& deadline, Callback callback,
+                 HttpResponseParser::BodySink sink = nullptr);
+
+    // Abandons a request: if it is not completed yet, its connection is closed and its callback is invoked
+    // with the error "cancelled". Unknown and completed requests are ignored.
+    void cancel(uint64_t id);
+
+    // Runs the task on the event loop thread once the time is reached (like the callbacks, it must not block)
+    void schedule(Clock::time_point when, std::function<void()> task);
+
+    Stats stats() const;
+
+    // Number of requests submitted and not completed yet
+    size_t inFlight() const;
+
+private:
+    struct Transfer;
+
+    struct Host {
+        std::deque<uint64_t> queued;      // transfers waiting for a connection
+        std::vector<Connection::Address> addresses;
+        Clock::time_point staleAt{};      // the addresses are resolved again from then on (at once if never resolved)
+        bool resolving = false;
+        bool dispatching = false;         // dispatch is running for the host
+        bool redispatch = false;          // dispatch was called again meanwhile
+    };
+
+    struct Resolution {
+        std::string hostKey;
+        Url url;
+        std::vector<Connection::Address> addresses;
+        std::string error; // empty if the host was resolved
+    };
+
+    static constexpr std::chrono::seconds RESOLVE_TTL{300};
+
+    using Timer = std::pair<Clock::time_point, uint64_t>; // deadline and id of a transfer
+
+    ConnectionPool& pool_;
+    int epollFd_ = -1;
+    int wakeFd_ = -1; // eventfd signalling the submission of new requests
+
+    mutable std::mutex mutex_; // guards the members below, shared with the submitting threads
+    std::vector<std::unique_ptr<Transfer>> submitted_;
+    std::vector<uint64_t> cancelled_;
+    std::vector<std::pair<Clock::time_point, std::function<void()>>> scheduled_;
+    std::vector<Resolution> resolved_;   // resolutions done, for the event loop
+    std::vector<std::string> woken_;     // hosts whose first request waiting in the pool may be served
+    std::deque<Resolution> toResolve_;   // hosts waiting for the resolver thread
+    std::condition_variable resolve_;
+    uint64_t nextId_ = 1; // 0 identifies the eventfd in the epoll events
+    size_t inFlight_ = 0;
+    bool stopping_ = false;
+    bool stopped_ = false; // the event loop has exited
+    Stats stats_;
+
+    // State owned by the event loop thread
+    std::unordered_map<uint64_t, std::unique_ptr<Transfer>> transfers_;
+    std::unordered_map<std::string, Host> hosts_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;
+    std::multimap<Clock::time_point, std::function<void()>> tasks_;
+
+    std::thread loop_;
+    std::thread resolver_;
+
+    void run();
+    void resolveHosts(); // body of the resolver thread
+    void resolved(Resolution& resolution);
+    void start(std::unique_ptr<Transfer> transfer);
+    void dispatch(const std::string& hostKey); // assigns the connections of the pool to the queued transfers of the host
+    void dispatchQueued(Host& host, const std::string& hostKey);
+    void wakeHost(const std::string& hostKey); // dispatches the host on the event loop (called by the pool)
+    void advance(Transfer& transfer);          // moves the transfer forward until it would block
+    void watch(Transfer& transfer, Connection::IoStatus want);
+    void unwatch(Transfer& transfer);
+    void releaseConnection(Transfer& transfer, bool keepAlive);
+    void connectionFailed(Transfer& transfer, const std::string& error);
+    void finish(Transfer& transfer, const std::string& error);
+    void expireTimers();
+    void runTasks();
+    void wake();
+};
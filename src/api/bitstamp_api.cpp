@@ -1,83 +1,588 @@
 #include "bitstamp_api.h"
 #include "api.h"
+#include "../json_reader/json_object_stream.h"
+#include "../json_reader/json_schema.h"
 #include <cctype>
+#include <charconv>
+#include <memory>
+#include <mutex>
 
 std::string BitstampApi::fetchCurrencyDataString() const {
+    if (!admit(RequestScheduler::EndpointClass::Catalog)) return ""; 
     return httpRequestsHandler.request(CURRENCIES_URL); 
 }
 
 std::string BitstampApi::fetchAllPairsString() const {
+    if (!admit(RequestScheduler::EndpointClass::Catalog)) return ""; 
     return httpRequestsHandler.request(PAIR_URL); 
 } 
 
 std::string BitstampApi::fetchMarketTickerString(const std::string& ticker) const {
+    if (!admit(RequestScheduler::EndpointClass::Ticker)) return ""; 
     return httpRequestsHandler.request(PAIR_URL + ticker);
 } 
 
 
 std::string BitstampApi::fetchHourlyTickerString(const std::string& ticker) const {
+    if (!admit(RequestScheduler::EndpointClass::Ticker)) return ""; 
     return httpRequestsHandler.request(HOURLY_URL + ticker); 
 } 
 
 std::string BitstampApi::fetchCandlestickDataString(const std::string& ticker, const std::unordered_map<std::string,std::string>& otherArgs) const {
-    std::stringstream ss; 
+    if (!admit(RequestScheduler::EndpointClass::Ohlc)) return ""; 
+    return httpRequestsHandler.request(candlestickUrl(ticker, otherArgs));
+} 
+
+// The url is written into a single string, sized beforehand 
+std::string BitstampApi::candlestickUrl(const std::string& ticker, const std::unordered_map<std::string,std::string>& otherArgs) const {
+    size_t size = OHLC_URL.size() + ticker.size() + 2; 
+    for (const auto& args: otherArgs) size += args.first.size() + args.second.size() + 2; 
+    std::string url; 
+    url.reserve(size); 
+    url.append(OHLC_URL).append(ticker).append("/?"); 
     size_t count = 0; 
     for (const auto& args: otherArgs) {
-        ss << args.first << '=' << args.second; 
-        if (++count != otherArgs.size()) ss << "&"; 
+        url.append(args.first).append(1, '=').append(args.second); 
+        if (++count != otherArgs.size()) url += '&'; 
     }
-    return httpRequestsHandler.request(OHLC_URL + ticker + "/?" + ss.str());
-} 
+    return url; 
+}
+
+// The ohlc endpoint returns the limit candles from start on (at most the candles up to now); a request 
+// already bounded by start or end is a fixed period, and it is not restricted 
+bool BitstampApi::sinceCandlestickArgs(
+    const std::unordered_map<std::string,std::string>& otherArgs, 
+    int64_t timestamp, 
+    std::unordered_map<std::string,std::string>& sinceArgs, 
+    size_t& window
+) const {
+    if (otherArgs.count("start") > 0 || otherArgs.count("end") > 0) return false; 
+    window = 0; 
+    auto limit = otherArgs.find("limit"); 
+    if (limit != otherArgs.end()) {
+        unsigned long value = 0; 
+        auto result = std::from_chars(limit->second.data(), limit->second.data() + limit->second.size(), value); 
+        if (result.ec == std::errc() && result.ptr == limit->second.data() + limit->second.size()) window = value; 
+    }
+    sinceArgs = otherArgs; 
+    sinceArgs["start"] = std::to_string(timestamp); 
+    return true; 
+}
+
+// The resolution is the step argument of the request 
+int64_t BitstampApi::candlestickResolution(const std::unordered_map<std::string,std::string>& otherArgs) const {
+    auto step = otherArgs.find("step"); 
+    if (step == otherArgs.end()) return 0; 
+    int64_t value = 0; 
+    auto result = std::from_chars(step->second.data(), step->second.data() + step->second.size(), value); 
+    return result.ec == std::errc() && result.ptr == step->second.data() + step->second.size() && value > 0 ? value : 0; 
+}
 
 std::string BitstampApi::fetchEurUsdConversionRateString() {
+    if (!admit(RequestScheduler::EndpointClass::Ticker)) return ""; 
     return httpRequestsHandler.request(EUR_USD_URL);
 } 
 
+namespace {
+
+/*
+ * Objects parsed from a json response while it is received (see JsonStreamParser). It is used 
+ * both on the calling thread and, for the asynchronous requests, on the event loop thread. 
+ */
+struct JsonCollector {
+    explicit JsonCollector(JsonStreamParser::Mode mode): 
+        parser(mode, [this](jMap&& object) {objects.push_back(std::move(object));}) {}
+
+    DataMapVec objects; 
+    JsonStreamParser parser; 
+
+    HttpResponseParser::BodySink sink() {return [this](const char* data, size_t size) {parser.feed(data, size);};}
+
+    // Gets the parsed objects, or nothing if the request or the parsing failed 
+    DataMapVec records(bool ok) {return ok && parser.finish() ? std::move(objects) : DataMapVec{};}
+    DataMap object(bool ok) {return ok && parser.finish() && !objects.empty() ? std::move(objects.front()) : DataMap{};}
+}; 
+
+/*
+ * Candles parsed from a json response while it is received: each candle object is appended to the columns
+ * of the series as soon as its closing brace is parsed, so that the response is never held as a whole. 
+ * The series may be lent by the caller, to reuse its buffers. 
+ */
+struct SeriesCollector {
+    SeriesCollector(CandleSeries&& lent, CandleSeries::Mask mask): 
+        series(std::move(lent)), parser(JsonStreamParser::Mode::Records, [this](jMap&& candle) {series.append(candle);}) {
+        series.clear(); 
+        series.columns = mask | CandleSeries::bit(CandleSeries::Timestamp); 
+    }
+
+    CandleSeries series; 
+    JsonStreamParser parser; 
+
+    HttpResponseParser::BodySink sink() {return [this](const char* data, size_t size) {parser.feed(data, size);};}
+
+    // Gets the series, emptied if the request or the parsing failed 
+    CandleSeries take(bool ok) {
+        if (!ok || !parser.finish()) series.clear(); 
+        return std::move(series); 
+    }
+}; 
+
+/*
+ * Parsers of the attempts of a hedged request (see HedgingHttpClient): each attempt streams its body 
+ * into its own collector (a JsonCollector or a SeriesCollector, made by create), and the result of the 
+ * winning attempt is kept. 
+ */
+template<typename Collector>
+struct AttemptCollectors {
+    using Create = std::function<std::shared_ptr<Collector>(size_t attempt)>; 
+
+    explicit AttemptCollectors(Create create): create(std::move(create)) {}
+
+    Create create; 
+    std::mutex mutex; 
+    std::vector<std::shared_ptr<Collector>> attempts; 
+
+    // The sinks keep their collectors alive until the attempts are completed or cancelled 
+    static HedgingHttpClient::SinkFactory sinks(const std::shared_ptr<AttemptCollectors>& collectors) {
+        return [collectors](size_t attempt) -> HttpResponseParser::BodySink {
+            auto collector = collectors->create(attempt); 
+            {
+                std::lock_guard<std::mutex> lock(collectors->mutex); 
+                if (collectors->attempts.size() <= attempt) collectors->attempts.resize(attempt + 1); 
+                collectors->attempts[attempt] = collector; 
+            }
+            return [collector](const char* data, size_t size) {collector->parser.feed(data, size);}; 
+        }; 
+    }
+
+    Collector& winner(size_t attempt) {
+        std::lock_guard<std::mutex> lock(mutex); 
+        return *attempts.at(attempt); 
+    }
+
+    // Collector of an attempt, if it was sent 
+    std::shared_ptr<Collector> attempt(size_t attempt) {
+        std::lock_guard<std::mutex> lock(mutex); 
+        return attempt < attempts.size() ? attempts[attempt] : nullptr; 
+    }
+}; 
+
+/*
+ * Tickers decoded from a json response while it is received: the text of each ticker object is cut from 
+ * the stream (see JsonObjectStream) and decoded by the parser of the ticker schema, so that neither the 
+ * response is held as a whole nor its objects are converted into maps. add folds each record into the 
+ * result, with the "pair" member of its object and, if keepOthers is set, the members the record does 
+ * not hold. 
+ */
+template<typename Result>
+struct TickerCollector {
+    using Add = std::function<void(Result& result, const Ticker& record, std::string_view pair, DataMap& others)>; 
+
+    TickerCollector(JsonStreamParser::Mode mode, bool keepOthers, Add add, Result initial): 
+        keepOthers(keepOthers), add(std::move(add)), result(std::move(initial)), 
+        parser(mode, [this](std::string_view object) {return decode(object);}) {}
+
+    bool keepOthers; 
+    Add add; 
+    Result result; 
+    Ticker record; 
+    DataMap others; 
+    JsonObjectStream parser; 
+
+    bool decode(std::string_view object) {
+        JsonTokenizer tokenizer(object); 
+        std::string_view pair; 
+        others.clear(); 
+        if (tokenizer.next().type != JsonTokenizer::TokenType::BeginObject) return false; 
+        if (!record.read(tokenizer, &pair, keepOthers ? &others : nullptr)) return false; 
+        add(result, record, pair, others); 
+        return true; 
+    }
+
+    // Gets the result, or nothing if the request or the parsing failed 
+    Result take(bool ok) {return ok && parser.finish() ? std::move(result) : Result{};}
+}; 
+
+template<typename Result>
+using TickerCollectors = AttemptCollectors<TickerCollector<Result>>; 
+
+template<typename Result>
+std::shared_ptr<TickerCollectors<Result>> tickerCollectors(
+    JsonStreamParser::Mode mode, bool keepOthers, typename TickerCollector<Result>::Add add, Result initial = Result{}
+) {
+    return std::make_shared<TickerCollectors<Result>>([mode, keepOthers, add = std::move(add), initial = std::move(initial)](size_t) {
+        return std::make_shared<TickerCollector<Result>>(mode, keepOthers, add, initial); 
+    }); 
+}
+
+std::shared_ptr<AttemptCollectors<JsonCollector>> jsonCollectors(JsonStreamParser::Mode mode) {
+    return std::make_shared<AttemptCollectors<JsonCollector>>([mode](size_t) {return std::make_shared<JsonCollector>(mode);}); 
+}
+
+// The first attempt decodes into the lent series, the hedges and the retries into series of their own 
+std::shared_ptr<AttemptCollectors<SeriesCollector>> seriesCollectors(CandleSeries&& lent, CandleSeries::Mask mask) {
+    auto series = std::make_shared<CandleSeries>(std::move(lent)); 
+    return std::make_shared<AttemptCollectors<SeriesCollector>>([series, mask](size_t attempt) {
+        return std::make_shared<SeriesCollector>(attempt == 0 ? std::move(*series) : CandleSeries{}, mask); 
+    }); 
+}
+
+// Requests the url through the hedging client, and gets the result parsed by the winning attempt 
+template<typename Collector, typename Result>
+Result fetchHedged(
+    const std::string& url, const std::shared_ptr<AttemptCollectors<Collector>>& collectors, RequestScheduler::EndpointClass endpoint, 
+    RequestScheduler::Lane lane, const std::vector<std::string>& headers, int maxConnectionTime, Result (Collector::*parsed)(bool)
+) {
+    size_t attempt; 
+    auto response = HedgingHttpClient::shared().request(endpoint, lane, url, headers, maxConnectionTime, AttemptCollectors<Collector>::sinks(collectors), attempt); 
+    if (!response.ok()) return Result{}; 
+    return (collectors->winner(attempt).*parsed)(true); 
+}
+
+// Url of a resource under a base url, allocated once 
+std::string joinUrl(const std::string& base, const std::string& path) {
+    std::string url; 
+    url.reserve(base.size() + path.size()); 
+    return url.append(base).append(path); 
+}
+
+// Schema of the objects of the all-tickers payload, when only their pair is needed (the catalog) 
+struct PairSchema {
+    using Record = std::string; 
+    static constexpr std::array<std::string_view, 1> KEYS = {"pair"}; 
+
+    static bool set(Record& pair, size_t, const JsonTokenizer::Token& value) {
+        return value.type == JsonTokenizer::TokenType::String && JsonReader::storeValue(value, pair); 
+    }
+}; 
+
+// Ticker (e.g. "btcusd") of a pair name of the api (e.g. "BTC/USD"), written into the buffer; empty if 
+// the pair does not fit 
+std::string_view pairTicker(std::string_view pair, char (&buffer)[32]) {
+    if (pair.size() > sizeof(buffer)) return {}; 
+    size_t size = 0; 
+    for (const auto c: pair) {
+        if (c != '/') buffer[size++] = static_cast<char>(std::tolower(static_cast<unsigned char>(c))); 
+    }
+    return std::string_view(buffer, size); 
+}
+
+// Market data of a ticker record, as decoded by the generic reader: the null fields are "null", and the members 
+// the record does not hold (e.g. a field with a non-numeric value) are kept as they were received 
+DataMap tickerData(const Ticker& record, DataMap&& others) {
+    DataMap marketData(std::move(others)); 
+    for (unsigned f = 0; f < Ticker::FIELDS; ++f) {
+        const auto field = static_cast<Ticker::Field>(f); 
+        if (record.has(field) || record.isNull(field)) marketData[Ticker::name(field)] = record.text(field); 
+    }
+    return marketData; 
+}
+
+// Collectors of a single ticker payload, decoded into a record, or into its market data 
+std::shared_ptr<TickerCollectors<Ticker>> recordCollectors() {
+    return tickerCollectors<Ticker>(JsonStreamParser::Mode::Object, false, 
+        [](Ticker& result, const Ticker& record, std::string_view, DataMap&) {result = record;}); 
+}
+
+std::shared_ptr<TickerCollectors<DataMap>> dataCollectors() {
+    return tickerCollectors<DataMap>(JsonStreamParser::Mode::Object, true, 
+        [](DataMap& result, const Ticker& record, std::string_view, DataMap& others) {result = tickerData(record, std::move(others));}); 
+}
+
+} // namespace
+
+// The urls the native client cannot handle (https without OpenSSL) are requested through the fallback of the 
+// HttpRequest object, without hedging 
+DataMapVec BitstampApi::fetchRecords(const std::string& url, RequestScheduler::EndpointClass endpoint) const {
+    if (HttpClient::supports(url)) {
+        return fetchHedged(url, jsonCollectors(JsonStreamParser::Mode::Records), endpoint, lane_, headers_, 
+                           maxConnectionTime_, &JsonCollector::records); 
+    }
+    if (!admit(endpoint)) return DataMapVec{}; 
+    JsonCollector collector(JsonStreamParser::Mode::Records); 
+    return collector.records(httpRequestsHandler.request(url, collector.sink())); 
+}
+
+DataMap BitstampApi::fetchObject(const std::string& url, RequestScheduler::EndpointClass endpoint) const {
+    if (HttpClient::supports(url)) {
+        return fetchHedged(url, jsonCollectors(JsonStreamParser::Mode::Object), endpoint, lane_, headers_, 
+                           maxConnectionTime_, &JsonCollector::object); 
+    }
+    if (!admit(endpoint)) return DataMap{}; 
+    JsonCollector collector(JsonStreamParser::Mode::Object); 
+    return collector.object(httpRequestsHandler.request(url, collector.sink())); 
+}
+
+bool BitstampApi::fetchStreamed(
+    const std::string& url, RequestScheduler::EndpointClass endpoint, const HedgingHttpClient::SinkFactory& sinks, size_t& attempt
+) const {
+    if (HttpClient::supports(url)) {
+        return HedgingHttpClient::shared().request(endpoint, lane_, url, headers_, maxConnectionTime_, sinks, attempt).ok(); 
+    }
+    attempt = 0; 
+    if (!admit(endpoint)) return false; 
+    return httpRequestsHandler.request(url, sinks(0)); 
+}
+
+bool BitstampApi::fetchBody(const std::string& url, RequestScheduler::EndpointClass endpoint, std::string& body) const {
+    if (HttpClient::supports(url)) {
+        size_t attempt; 
+        auto response = HedgingHttpClient::shared().request(endpoint, lane_, url, headers_, 
+                                                            maxConnectionTime_, nullptr, attempt); 
+        if (!response.ok()) return false; 
+        body = std::move(response.body); 
+        return true; 
+    }
+    if (!admit(endpoint)) return false; 
+    body = httpRequestsHandler.request(url); 
+    return !body.empty(); 
+}
+
 DataMapVec BitstampApi::fetchCurrencyData() {
-    multiJsonReader.setFromString(this->fetchCurrencyDataString()); 
-    return multiJsonReader.get(); 
+    DataMapVec currencyData; 
+    for (const auto& currency: fetchCurrencies()) currencyData.push_back(currency.toMap()); 
+    return currencyData; 
+}
+
+// The currencies are decoded from the whole response by the parser of their schema 
+std::vector<CurrencyInfo> BitstampApi::fetchCurrencies() {
+    std::vector<CurrencyInfo> currencies; 
+    std::string body; 
+    if (fetchBody(CURRENCIES_URL, RequestScheduler::EndpointClass::Catalog, body)) CurrencyInfo::parseList(body, currencies); 
+    return currencies; 
 }
 
 DataMapVec BitstampApi::fetchAllPairs() {
-    multiJsonReader.setFromString(this->fetchAllPairsString()); 
-    return multiJsonReader.get(); 
+    return fetchRecords(PAIR_URL, RequestScheduler::EndpointClass::Catalog); 
 }
 
 DataMap BitstampApi::fetchMarketTicker(const std::string& ticker) {
-    jReader.setFromString(this->fetchMarketTickerString(ticker)); 
-    return jReader.get(); 
+    return fetchTickerData(joinUrl(PAIR_URL, ticker)); 
 } 
 
 DataMap BitstampApi::fetchHourlyTicker(const std::string& ticker) {
-    jReader.setFromString(this->fetchHourlyTickerString(ticker)); 
-    return jReader.get(); 
+    return fetchTickerData(joinUrl(HOURLY_URL, ticker)); 
+}
+
+// The ticker payloads are decoded by the parser of their schema while received (see TickerCollector), then 
+// converted 
+DataMap BitstampApi::fetchTickerData(const std::string& url) const {
+    auto collectors = dataCollectors(); 
+    size_t attempt; 
+    const bool ok = fetchStreamed(url, RequestScheduler::EndpointClass::Ticker, TickerCollectors<DataMap>::sinks(collectors), attempt); 
+    return ok ? collectors->winner(attempt).take(true) : DataMap{}; 
+}
+
+// A single request to the ticker endpoint (without a pair) returns the market data of all pairs; 
+// the pairs which were not requested are discarded while the response is decoded 
+std::unordered_map<PairId, DataMap> BitstampApi::fetchMarketTickers(const std::vector<PairId>& tickers) {
+    using MarketData = std::unordered_map<PairId, DataMap>; 
+    std::vector<bool> requested; 
+    for (const auto id: tickers) {
+        if (id == INVALID_PAIR_ID) continue; 
+        if (id >= requested.size()) requested.resize(id + 1, false); 
+        requested[id] = true; 
+    }
+
+    auto collectors = tickerCollectors<MarketData>(JsonStreamParser::Mode::Records, true, 
+        [catalog = catalog, requested = std::move(requested)](MarketData& marketData, const Ticker& record, std::string_view pair, DataMap& others) {
+            char ticker[32]; 
+            PairId id = catalog->id(pairTicker(pair, ticker)); 
+            if (id >= requested.size() || !requested[id]) return; 
+            others.erase("pair"); // not part of the single ticker response 
+            marketData[id] = tickerData(record, std::move(others)); 
+        }); 
+    size_t attempt; 
+    const bool ok = fetchStreamed(PAIR_URL, RequestScheduler::EndpointClass::Ticker, TickerCollectors<MarketData>::sinks(collectors), attempt); 
+    return ok ? collectors->winner(attempt).take(true) : MarketData{}; // nothing from a malformed response 
+}
+
+// The ticker is decoded while received, straight into the fields of the record 
+Ticker BitstampApi::fetchTicker(const std::string& ticker) {
+    auto collectors = recordCollectors(); 
+    size_t attempt; 
+    const bool ok = fetchStreamed(joinUrl(PAIR_URL, ticker), RequestScheduler::EndpointClass::Ticker, TickerCollectors<Ticker>::sinks(collectors), attempt); 
+    return ok ? collectors->winner(attempt).take(true) : Ticker{}; 
+}
+
+void BitstampApi::fetchTickerAsync(const std::string& ticker, std::function<void(Ticker)> callback) {
+    auto url = joinUrl(PAIR_URL, ticker); 
+    if (!HttpClient::supports(url)) return callback(fetchTicker(ticker)); 
+    auto collectors = recordCollectors(); 
+    HedgingHttpClient::shared().get(RequestScheduler::EndpointClass::Ticker, lane_, url, headers_, 
+        maxConnectionTime_, TickerCollectors<Ticker>::sinks(collectors), 
+        [collectors, callback = std::move(callback)](HttpResponse response, size_t attempt) {
+            callback(response.ok() ? collectors->winner(attempt).take(true) : Ticker{}); 
+        }); 
+}
+
+// The records of all pairs are decoded from the response of the ticker endpoint (without a pair) one after 
+// the other, while it is received; a record is copied into the output when its pair was requested, found with 
+// one lookup in the slots of the requested pairs (indexed by PairId, as in fetchMarketTickers). A pair listed 
+// several times is copied into its other slots once the response is decoded. 
+bool BitstampApi::fetchTickers(const std::vector<PairId>& tickers, std::vector<Ticker>& out) {
+    constexpr size_t NO_SLOT = static_cast<size_t>(-1); 
+    std::vector<size_t> slots; // first slot of the output of each requested pair 
+    for (size_t i = 0; i < tickers.size(); ++i) {
+        const PairId id = tickers[i]; 
+        if (id == INVALID_PAIR_ID) continue; 
+        if (id >= slots.size()) slots.resize(id + 1, NO_SLOT); 
+        if (slots[id] == NO_SLOT) slots[id] = i; 
+    }
+
+    auto collectors = tickerCollectors<std::vector<Ticker>>(JsonStreamParser::Mode::Records, false, 
+        [catalog = catalog, slots](std::vector<Ticker>& records, const Ticker& record, std::string_view pair, DataMap&) {
+            char ticker[32]; 
+            PairId id = catalog->id(pairTicker(pair, ticker)); 
+            if (id < slots.size() && slots[id] != NO_SLOT) records[slots[id]] = record; 
+        }, std::vector<Ticker>(tickers.size())); 
+    size_t attempt; 
+    bool ok = fetchStreamed(PAIR_URL, RequestScheduler::EndpointClass::Ticker, TickerCollectors<std::vector<Ticker>>::sinks(collectors), attempt); 
+    if (ok) {
+        auto& collector = collectors->winner(attempt); 
+        ok = collector.parser.finish(); 
+        if (ok) out = std::move(collector.result); 
+    }
+    if (!ok) {
+        out.assign(tickers.size(), Ticker{}); // failed request or malformed response 
+        return false; 
+    }
+    for (size_t i = 0; i < tickers.size(); ++i) {
+        if (tickers[i] != INVALID_PAIR_ID && slots[tickers[i]] != i) out[i] = out[slots[tickers[i]]]; 
+    }
+    return true; 
 }
 
 DataMapVec BitstampApi::fetchCandlestickData(const std::string& ticker, const std::unordered_map<std::string,std::string>& otherArgs) {
-    multiJsonReader.setFromString(this->fetchCandlestickDataString(ticker, otherArgs)); 
-    return multiJsonReader.get(); 
+    return fetchRecords(candlestickUrl(ticker, otherArgs), RequestScheduler::EndpointClass::Ohlc); 
+}
+
+// The urls the native client cannot handle (https without OpenSSL) are requested synchronously. The others are 
+// submitted to the hedging client, which sends them to the event loop once the scheduler admits them 
+void BitstampApi::fetchMarketTickerAsync(const std::string& ticker, std::function<void(DataMap)> callback) {
+    auto url = joinUrl(PAIR_URL, ticker); 
+    if (!HttpClient::supports(url)) return Api::fetchMarketTickerAsync(ticker, std::move(callback)); 
+    auto collectors = dataCollectors(); 
+    HedgingHttpClient::shared().get(RequestScheduler::EndpointClass::Ticker, lane_, url, headers_, 
+        maxConnectionTime_, TickerCollectors<DataMap>::sinks(collectors), 
+        [collectors, callback = std::move(callback)](HttpResponse response, size_t attempt) {
+            callback(response.ok() ? collectors->winner(attempt).take(true) : DataMap{}); 
+        }); 
+}
+
+void BitstampApi::fetchCandlestickDataAsync(
+    const std::string& ticker, 
+    const std::unordered_map<std::string,std::string>& otherArgs, 
+    std::function<void(DataMapVec)> callback
+) {
+    auto url = candlestickUrl(ticker, otherArgs); 
+    if (!HttpClient::supports(url)) return Api::fetchCandlestickDataAsync(ticker, otherArgs, std::move(callback)); 
+    auto collectors = jsonCollectors(JsonStreamParser::Mode::Records); 
+    HedgingHttpClient::shared().get(RequestScheduler::EndpointClass::Ohlc, lane_, url, headers_, 
+        maxConnectionTime_, AttemptCollectors<JsonCollector>::sinks(collectors), 
+        [collectors, callback = std::move(callback)](HttpResponse response, size_t attempt) {
+            callback(response.ok() ? collectors->winner(attempt).records(true) : DataMapVec{}); 
+        }); 
+}
+
+// The candles are decoded while the response is received, each attempt into its own series (see 
+// SeriesCollector): only the columns of the mask are converted 
+CandleSeries BitstampApi::fetchCandleSeries(
+    const std::string& ticker, 
+    const std::unordered_map<std::string,std::string>& otherArgs, 
+    CandleSeries::Mask columns
+) {
+    auto url = candlestickUrl(ticker, otherArgs); 
+    if (HttpClient::supports(url)) {
+        return fetchHedged(url, seriesCollectors(CandleSeries{}, columns), RequestScheduler::EndpointClass::Ohlc, lane_, headers_, 
+                           maxConnectionTime_, &SeriesCollector::take); 
+    }
+    if (!admit(RequestScheduler::EndpointClass::Ohlc)) return CandleSeries{}; 
+    SeriesCollector collector(CandleSeries{}, columns); 
+    return collector.take(httpRequestsHandler.request(url, collector.sink())); 
+}
+
+void BitstampApi::fetchCandleSeriesAsync(
+    const std::string& ticker, 
+    const std::unordered_map<std::string,std::string>& otherArgs, 
+    std::function<void(CandleSeries)> callback, 
+    CandleSeries::Mask columns
+) {
+    fetchCandleSeriesIntoAsync(ticker, otherArgs, CandleSeries{}, std::move(callback), columns); 
+}
+
+// The series travels with the request, and is moved from the collector of the first attempt to the callback 
+// of the caller: the columns are neither copied nor allocated again (unless another attempt wins) 
+void BitstampApi::fetchCandleSeriesIntoAsync(
+    const std::string& ticker, 
+    const std::unordered_map<std::string,std::string>& otherArgs, 
+    CandleSeries series, 
+    std::function<void(CandleSeries)> callback, 
+    CandleSeries::Mask columns
+) {
+    auto url = candlestickUrl(ticker, otherArgs); 
+    if (!HttpClient::supports(url)) return callback(fetchCandleSeries(ticker, otherArgs, columns)); 
+    auto collectors = seriesCollectors(std::move(series), columns); 
+    HedgingHttpClient::shared().get(RequestScheduler::EndpointClass::Ohlc, lane_, url, headers_, 
+        maxConnectionTime_, AttemptCollectors<SeriesCollector>::sinks(collectors), 
+        [collectors, callback = std::move(callback)](HttpResponse response, size_t attempt) {
+            if (response.ok()) return callback(collectors->winner(attempt).take(true)); 
+            // The lent series is handed back empty, with its buffers 
+            auto first = collectors->attempt(0); 
+            callback(first ? first->take(false) : CandleSeries{}); 
+        }); 
 }
 
 DataMap BitstampApi::fetchEurUsdConversionRate() {
-    jReader.setFromString(this->fetchEurUsdConversionRateString()); 
-    return jReader.get(); 
+    return fetchObject(EUR_USD_URL, RequestScheduler::EndpointClass::Ticker); 
 }
 
-void BitstampApi::retrieveAllTickers() {
-    allTickers.clear(); 
-    for (auto& pair: this->fetchAllPairs()) {
-        auto ticker = pair["pair"]; 
-        std::string newTicker; 
-        for (const auto c: ticker) {
-            if (c != '/') newTicker += std::tolower(c);
-        }
-        allTickers.push_back(newTicker); 
+std::string BitstampApi::pairToTicker(const std::string& pair) {
+    std::string ticker; 
+    for (const auto c: pair) {
+        if (c != '/') ticker += std::tolower(c);
     }
+    return ticker; 
+}
+
+std::vector<std::string> BitstampApi::pairsToTickers(const DataMapVec& pairs) {
+    std::vector<std::string> tickers; 
+    tickers.reserve(pairs.size()); 
+    for (const auto& pair: pairs) {
+        auto it = pair.find("pair"); 
+        if (it != pair.end()) tickers.push_back(pairToTicker(it->second)); 
+    }
+    return tickers; 
+}
+
+TickerCatalog::Loader BitstampApi::catalogLoader() const {
+    auto url = PAIR_URL; 
+    auto maxConnectionTime = httpRequestsHandler.getMaxConnectionTime(); 
+    return [url, maxConnectionTime]() {
+        HttpRequest request(maxConnectionTime); 
+        const auto endpoint = RequestScheduler::EndpointClass::Catalog; 
+        if (!RequestScheduler::shared().acquire(endpoint, RequestScheduler::Lane::Live)) return std::vector<std::string>{}; 
+        const std::string body = request.request(url); 
+        // Only the pairs of the objects are decoded: the market data are skipped 
+        std::vector<std::string> tickers; 
+        bool ok = JsonSchemaReader<PairSchema>::readArray(body, [&tickers](const std::string& pair) {
+            if (!pair.empty()) tickers.push_back(pairToTicker(pair)); 
+        }); 
+        return ok ? tickers : std::vector<std::string>{}; 
+    }; 
+}
+
+void BitstampApi::attachCatalog() {
+    catalog = &TickerCatalog::forSource(BASE_URL); 
+    catalog->ensureLoaded(catalogLoader()); 
+}
+
+void BitstampApi::retrieveAllTickers() {
+    catalog->refresh(catalogLoader()); 
 }
 
 std::vector<std::string> BitstampApi::fetchAllTickers() {
-    if (allTickers.empty()) this->retrieveAllTickers(); 
-    return allTickers; 
+    return catalog->tickers(catalogLoader()); 
 } 
 
 std::string BitstampApi::makePair(const std::string& cryptoSymbol, const std::string& fiatSymbol) const {
@@ -92,8 +597,9 @@ std::string BitstampApi::makePair(const std::string& cryptoSymbol, const std::st
 }
 
 bool BitstampApi::validatePair(const std::string& pair) const {
-    if (!allTickers.empty() && std::find(allTickers.begin(), allTickers.end(), pair) != allTickers.end()) {
-        return true; 
-    }
-    return false; 
+    return catalog->contains(pair); 
+}
+
+PairId BitstampApi::pairId(const std::string& pair) const {
+    return catalog->id(pair); 
 }
\ No newline at end of file
@@ -2,18 +2,31 @@
 
 #include "api.h"
 #include "web_requests.h"
+#include "async_http_client.h"
+#include "hedging_http_client.h"
+#include "request_scheduler.h"
+#include "ticker_catalog.h"
 #include <sstream> 
 #include <vector> 
 #include <algorithm> 
 #include "../json_reader/json_reader.h"
 #include "../json_reader/multi_json_reader.h"
+#include "../json_reader/json_stream_parser.h"
 
 using DataMap = std::unordered_map<std::string, std::string>; 
 using DataMapVec = std::vector<std::unordered_map<std::string, std::string>>; 
 
 /*
  * Implementation of the Api interface using the Bitstamp exchange RESTful service. 
- * When initialized, it retrieves the list of all tickers available in the exchange. 
+ * When initialized, it attaches to the catalog of all tickers available in the exchange, which 
+ * is shared by all the BitstampApi objects of the process (see ticker_catalog.h): the catalog is 
+ * downloaded by the first object only, or read from the local cache file. 
+ * The asynchronous requests are served by the event loop of the shared AsyncHttpClient, and their 
+ * responses are parsed on that thread: the callbacks do not touch the state of the object. 
+ * Every request is admitted by the shared RequestScheduler first, in the priority lane of the object 
+ * (live by default), so that the requests of all the objects stay within the rate limits of Bitstamp. 
+ * The requests parsed into DataMap objects go through the shared HedgingHttpClient, which hedges the 
+ * slow ones and retries the ones failed because of transport errors. 
  */
 
 class BitstampApi : public Api {
@@ -21,11 +34,17 @@ class BitstampApi : public Api {
 public: 
 
     // Constructors
-    BitstampApi(){retrieveAllTickers();} 
-    BitstampApi(std::string n): n_(n){retrieveAllTickers();}
+    BitstampApi(){attachCatalog();} 
+    BitstampApi(std::string n): n_(n){attachCatalog();}
     BitstampApi(int maxConnectionTime): maxConnectionTime_(maxConnectionTime) {
         httpRequestsHandler.setMaxConnectionTime(maxConnectionTime_);
-        retrieveAllTickers();
+        attachCatalog();
+    }
+    // The base url can point to a different server exposing the Bitstamp Api (e.g. a local stand-in server) 
+    BitstampApi(int maxConnectionTime, const std::string& baseUrl): maxConnectionTime_(maxConnectionTime) {
+        httpRequestsHandler.setMaxConnectionTime(maxConnectionTime_);
+        setBaseUrl(baseUrl); 
+        attachCatalog();
     }
 
     // void debug() override {std::cout << "Api: " << n_ << std::endl;} 
@@ -37,6 +56,10 @@ public:
         httpRequestsHandler.setMaxConnectionTime(maxConnectionTime_); 
     }
 
+    // Priority lane of the requests of the object (e.g. backfill for the bulk downloads of historical data) 
+    RequestScheduler::Lane getLane() const {return lane_;}
+    void setLane(RequestScheduler::Lane lane) {lane_ = lane;}
+
     /*
      * Helper functions - They recover the output of the Api web requests as strings.
      * Their output will be passed to the functions overriding the Api interface, which
@@ -52,33 +75,116 @@ public:
     /*
      * Functions overriding the Api interface. 
      */
+    using Api::fetchCandleSeries; // the overloads without the mask 
+    using Api::fetchCandleSeriesAsync; 
+    using Api::fetchCandleSeriesIntoAsync; 
     DataMapVec fetchCurrencyData() override;
     DataMapVec fetchAllPairs() override; 
     DataMap fetchMarketTicker(const std::string& ticker) override; 
     DataMap fetchHourlyTicker(const std::string& ticker) override; 
+    std::unordered_map<PairId, DataMap> fetchMarketTickers(const std::vector<PairId>& tickers) override; 
     DataMapVec fetchCandlestickData(const std::string& ticker, const std::unordered_map<std::string,std::string>& otherArgs) override;
+    void fetchMarketTickerAsync(const std::string& ticker, std::function<void(DataMap)> callback) override; 
+    void fetchCandlestickDataAsync(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        std::function<void(DataMapVec)> callback
+    ) override; 
+    CandleSeries fetchCandleSeries(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        CandleSeries::Mask columns
+    ) override; 
+    void fetchCandleSeriesAsync(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        std::function<void(CandleSeries)> callback, 
+        CandleSeries::Mask columns
+    ) override; 
+    void fetchCandleSeriesIntoAsync(
+        const std::string& ticker, 
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        CandleSeries series, 
+        std::function<void(CandleSeries)> callback, 
+        CandleSeries::Mask columns
+    ) override; 
+    bool sinceCandlestickArgs(
+        const std::unordered_map<std::string,std::string>& otherArgs, 
+        int64_t timestamp, 
+        std::unordered_map<std::string,std::string>& sinceArgs, 
+        size_t& window
+    ) const override; 
+    int64_t candlestickResolution(const std::unordered_map<std::string,std::string>& otherArgs) const override; 
+    Ticker fetchTicker(const std::string& ticker) override; 
+    void fetchTickerAsync(const std::string& ticker, std::function<void(Ticker)> callback) override; 
+    bool fetchTickers(const std::vector<PairId>& tickers, std::vector<Ticker>& out) override; 
+    std::vector<CurrencyInfo> fetchCurrencies() override; 
     DataMap fetchEurUsdConversionRate(); 
     std::vector<std::string> fetchAllTickers() override; 
     std::string makePair(const std::string& cryptoSymbol, const std::string& fiatSymbol) const override;
     bool validatePair(const std::string& pair) const override; 
+    PairId pairId(const std::string& pair) const override; 
+    std::string getSource() const override {return BASE_URL;} 
 
-
-    // Helper function for fechAllTickers()
+    // Downloads the list of all tickers again, and updates the shared catalog 
     void retrieveAllTickers(); 
 
+    // Converts the pair names of the Api (e.g. "BTC/USD") into tickers (e.g. "btcusd") 
+    static std::string pairToTicker(const std::string& pair); 
+    static std::vector<std::string> pairsToTickers(const DataMapVec& pairs); 
+
 private:
     HttpRequest httpRequestsHandler{};
-    JsonReader jReader{};
-    MultiJsonReader multiJsonReader{};  
+    std::vector<std::string> headers_{httpRequestsHandler.getUserAgentHeader()}; // headers of the requests, built once 
     int maxConnectionTime_ = httpRequestsHandler.getMaxConnectionTime(); 
-    std::vector<std::string> allTickers; 
+    TickerCatalog* catalog = nullptr; 
     std::string n_; 
+    RequestScheduler::Lane lane_ = RequestScheduler::Lane::Live; 
+
+    // Waits until a request to the endpoint class is admitted by the scheduler; false if it was cancelled 
+    bool admit(RequestScheduler::EndpointClass endpoint) const {return RequestScheduler::shared().acquire(endpoint, lane_);}
+
+    // Request the url and parse the response while it is received, as a list of objects or as a single object 
+    DataMapVec fetchRecords(const std::string& url, RequestScheduler::EndpointClass endpoint) const; 
+    DataMap fetchObject(const std::string& url, RequestScheduler::EndpointClass endpoint) const; 
+
+    // Request the url and stream the response into the sink made for each attempt (see HedgingHttpClient); 
+    // returns false if the request failed, or else the index of the attempt whose response was received 
+    bool fetchStreamed(const std::string& url, RequestScheduler::EndpointClass endpoint, 
+                       const HedgingHttpClient::SinkFactory& sinks, size_t& attempt) const; 
+
+    // Request the url and get the whole body of the response (the currencies, requested once and parsed 
+    // as a whole by the parser of their schema); returns false if the request failed 
+    bool fetchBody(const std::string& url, RequestScheduler::EndpointClass endpoint, std::string& body) const; 
+
+    // Request a ticker payload (ticker, hourly ticker) and get its market data 
+    DataMap fetchTickerData(const std::string& url) const; 
+
+    // Url of the candlestick data of a ticker 
+    std::string candlestickUrl(const std::string& ticker, const std::unordered_map<std::string,std::string>& otherArgs) const; 
+
+    // Attaches the object to the ticker catalog of its base url, loading the catalog if needed 
+    void attachCatalog(); 
+
+    // Function downloading the ticker list for the catalog; it does not depend on the lifetime of the object 
+    TickerCatalog::Loader catalogLoader() const; 
 
     // Api URLs: 
-    const std::string BASE_URL = "https://www.bitstamp.net/api/v2/"; 
-    const std::string CURRENCIES_URL = BASE_URL + "currencies/"; 
-    const std::string PAIR_URL = BASE_URL + "ticker/"; // note: without a ticker symbol after it, it retrieves all tickers
-    const std::string HOURLY_URL = BASE_URL + "ticker_hour/"; 
-    const std::string OHLC_URL = BASE_URL + "ohlc/"; 
-    const std::string EUR_USD_URL = BASE_URL + "eur_usd/"; 
+    std::string BASE_URL = "https://www.bitstamp.net/api/v2/"; 
+    std::string CURRENCIES_URL = BASE_URL + "currencies/"; 
+    std::string PAIR_URL = BASE_URL + "ticker/"; // note: without a ticker symbol after it, it retrieves all tickers
+    std::string HOURLY_URL = BASE_URL + "ticker_hour/"; 
+    std::string OHLC_URL = BASE_URL + "ohlc/"; 
+    std::string EUR_USD_URL = BASE_URL + "eur_usd/"; 
+
+    // Sets the base url of the Api, from which all the other urls are derived 
+    void setBaseUrl(const std::string& baseUrl) {
+        BASE_URL = baseUrl; 
+        if (BASE_URL.back() != '/') BASE_URL += '/'; 
+        CURRENCIES_URL = BASE_URL + "currencies/"; 
+        PAIR_URL = BASE_URL + "ticker/"; 
+        HOURLY_URL = BASE_URL + "ticker_hour/"; 
+        OHLC_URL = BASE_URL + "ohlc/"; 
+        EUR_USD_URL = BASE_URL + "eur_usd/"; 
+    }
 };
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "bitstamp_stream_api.h"
+#include "../json_reader/json_reader.h"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+
+namespace {
+
+const auto RECEIVE_SLICE = std::chrono::milliseconds(100); // the thread checks for new subscriptions and stop requests at least this often
+
+Deadline after(Clock::duration duration) {
+    Deadline deadline;
+    deadline.unlimited = false;
+    deadline.at = Clock::now() + duration;
+    return deadline;
+}
+
+// Parses a json object in place (the messages are complete); nested values are kept as json text
+DataMap parseObject(const std::string& json) {
+    DataMap object;
+    JsonTokenizer tokenizer(json);
+    if (tokenizer.next().type != JsonTokenizer::TokenType::BeginObject || !JsonReader::readObject(tokenizer, object)) return {};
+    return object;
+}
+
+// First price of a side of the order book, e.g. [["57841", "0.1"], ...] -> 57841
+std::string bestPrice(const std::string& side) {
+    size_t begin = side.find('"');
+    if (begin == std::string::npos) return "";
+    size_t end = side.find('"', begin + 1);
+    return end == std::string::npos ? "" : side.substr(begin + 1, end - begin - 1);
+}
+
+} // namespace
+
+BitstampStreamApi::BitstampStreamApi(const std::string& url, const std::string& restBaseUrl, int heartbeatSeconds):
+    url_(url), heartbeat_(std::max(heartbeatSeconds, 1)), rest_(10, restBaseUrl) {
+    thread_ = std::thread([this]() {run();});
+}
+
+BitstampStreamApi::~BitstampStreamApi() {
+    stopping_.store(true);
+    if (thread_.joinable()) thread_.join();
+}
+
+void BitstampStreamApi::subscribeMarketData(const std::vector<PairId>& tickers, MarketDataHandler handler) {
+    auto subscription = std::make_shared<Subscription>();
+    subscription->handler = std::move(handler);
+    std::vector<PairId> seeds;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto id: tickers) {
+            if (id == INVALID_PAIR_ID) continue;
+            subscription->tickers.insert(id);
+            bool known = std::any_of(subscriptions_.begin(), subscriptions_.end(), [id](const auto& s) {return s->tickers.count(id) > 0;});
+            if (known) continue;
+            const auto& ticker = SymbolTable::shared().name(id);
+            channels_.push_back(tradesChannel(ticker));
+            channels_.push_back(orderBookChannel(ticker));
+            seeds.push_back(id);
+        }
+        subscriptions_.push_back(subscription);
+    }
+
+    // The fields not carried by the stream (e.g. high, low, volume) come from the RESTful Api
+    for (const auto id: seeds) {
+        rest_.fetchMarketTickerAsync(SymbolTable::shared().name(id), [this, id](DataMap marketData) {
+            if (!marketData.empty()) update(id, marketData, true);
+        });
+    }
+}
+
+BitstampStreamApi::Stats BitstampStreamApi::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BitstampStreamApi::run() {
+    std::mt19937 random{std::random_device{}()};
+    auto backoff = std::chrono::milliseconds(500);
+    const auto maxBackoff = std::chrono::milliseconds(30000);
+
+    while (!stopping_.load()) {
+        std::string error;
+        auto socket = WebSocket::connect(url_, {"User-Agent: Mozilla/5.0"}, after(std::chrono::seconds(10)), error);
+        if (socket) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++stats_.connections;
+                subscribedChannels_ = 0;
+            }
+            connected_.store(true);
+            auto opened = Clock::now();
+            serve(*socket);
+            connected_.store(false);
+            socket->close(after(std::chrono::seconds(1)));
+            // A connection which lasted long enough resets the backoff
+            if (Clock::now() - opened > std::chrono::seconds(60)) backoff = std::chrono::milliseconds(500);
+        }
+        if (stopping_.load()) break;
+
+        // Jittered backoff: a uniform wait between half and the whole backoff, doubled at every failure
+        std::uniform_int_distribution<long long> wait(backoff.count() / 2, backoff.count());
+        auto until = Clock::now() + std::chrono::milliseconds(wait(random));
+        while (!stopping_.load() && Clock::now() < until) std::this_thread::sleep_for(RECEIVE_SLICE);
+        backoff = std::min(backoff * 2, maxBackoff);
+    }
+}
+
+void BitstampStreamApi::serve(WebSocket& socket) {
+    bool heartbeatSent = false;
+    std::string message;
+    while (!stopping_.load()) {
+        if (!subscribePending(socket)) return;
+
+        auto status = socket.receive(message, after(RECEIVE_SLICE));
+        if (status == WebSocket::ReceiveStatus::Closed || status == WebSocket::ReceiveStatus::Error) return;
+        if (status == WebSocket::ReceiveStatus::Message) {
+            heartbeatSent = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ++stats_.messages;
+            }
+            if (!handleMessage(message)) return;
+            continue;
+        }
+
+        // Silent connection: a heartbeat is sent, and the connection is given up if it is not answered
+        auto silence = Clock::now() - socket.lastReceived();
+        if (silence > 2 * heartbeat_) return;
+        if (silence > heartbeat_ && !heartbeatSent) {
+            if (!socket.sendText("{\"event\":\"bts:heartbeat\"}", after(std::chrono::seconds(1)))) return;
+            heartbeatSent = true;
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++stats_.heartbeats;
+        }
+    }
+}
+
+bool BitstampStreamApi::subscribePending(WebSocket& socket) {
+    std::vector<std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending.assign(channels_.begin() + subscribedChannels_, channels_.end());
+        subscribedChannels_ = channels_.size();
+    }
+    for (const auto& channel: pending) {
+        std::string request = "{\"event\":\"bts:subscribe\",\"data\":{\"channel\":\"" + channel + "\"}}";
+        if (!socket.sendText(request, after(std::chrono::seconds(5)))) return false;
+    }
+    return true;
+}
+
+bool BitstampStreamApi::handleMessage(const std::string& message) {
+    auto envelope = parseObject(message);
+    const auto& event = envelope["event"];
+    if (event == "bts:request_reconnect") return false;
+    if (event != "trade" && event != "data") return true; // subscription acknowledgements, heartbeats, errors
+
+    const auto& channel = envelope["channel"];
+    bool trade = channel.compare(0, 12, "live_trades_") == 0;
+    bool orderBook = channel.compare(0, 11, "order_book_") == 0;
+    if (!trade && !orderBook) return true;
+    PairId id = rest_.pairId(channel.substr(trade ? 12 : 11));
+    if (id == INVALID_PAIR_ID) return true;
+
+    auto data = parseObject(envelope["data"]);
+    DataMap fields;
+    fields["timestamp"] = data["timestamp"];
+    fields["microtimestamp"] = data["microtimestamp"];
+    if (trade) {
+        fields["last"] = data["price_str"].empty() ? data["price"] : data["price_str"];
+        fields["side"] = data["type"];
+    } else {
+        fields["bid"] = bestPrice(data["bids"]);
+        fields["ask"] = bestPrice(data["asks"]);
+    }
+    update(id, fields);
+    return true;
+}
+
+void BitstampStreamApi::update(PairId id, const DataMap& fields, bool onlyMissing) {
+    DataMap marketData;
+    std::vector<std::shared_ptr<Subscription>> subscriptions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& current = marketData_[id];
+        for (const auto& field: fields) {
+            if (field.second.empty()) continue;
+            if (onlyMissing && current.count(field.first) > 0) continue;
+            current[field.first] = field.second;
+        }
+        // The last trade can extend the range of the day
+        auto last = current.find("last");
+        if (!onlyMissing && fields.count("last") > 0 && last != current.end()) {
+            double price = std::strtod(last->second.c_str(), nullptr);
+            auto high = current.find("high");
+            auto low = current.find("low");
+            if (high != current.end() && price > std::strtod(high->second.c_str(), nullptr)) high->second = last->second;
+            if (low != current.end() && price < std::strtod(low->second.c_str(), nullptr)) low->second = last->second;
+        }
+        marketData = current;
+        for (const auto& subscription: subscriptions_) {
+            if (subscription->tickers.count(id) > 0) subscriptions.push_back(subscription);
+        }
+        ++stats_.updates;
+    }
+    for (const auto& subscription: subscriptions) subscription->handler(id, marketData);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "stream_api.h"
+#include "bitstamp_api.h"
+#include "websocket.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * Implementation of the StreamApi interface using the Bitstamp WebSocket Api (v2). A single
+ * connection carries the channels of all the subscribed tickers: the live trades (which update the
+ * last price) and the top of the order book (which updates bid and ask). The other fields of the
+ * market data are seeded with a RESTful request when a ticker is subscribed. The connection is
+ * owned by a thread of the object: when no message is received for a heartbeat interval, a
+ * bts:heartbeat is sent, and when the server stops answering, closes the connection or asks for a
+ * reconnection (bts:request_reconnect), the connection is opened again after a jittered backoff
+ * and all the channels are subscribed again.
+ */
+class BitstampStreamApi : public StreamApi {
+
+public:
+    struct Stats {
+        uint64_t connections = 0;   // connections established (the first one included)
+        uint64_t messages = 0;      // messages received
+        uint64_t updates = 0;       // market data updates pushed to the handlers
+        uint64_t heartbeats = 0;    // heartbeats sent
+    };
+
+    // The urls can point to a different server exposing the Bitstamp Api (e.g. a local stand-in server)
+    explicit BitstampStreamApi(
+        const std::string& url = "wss://ws.bitstamp.net",
+        const std::string& restBaseUrl = "https://www.bitstamp.net/api/v2/",
+        int heartbeatSeconds = 10
+    );
+    BitstampStreamApi(const BitstampStreamApi&) = delete;
+    BitstampStreamApi& operator=(const BitstampStreamApi&) = delete;
+
+    // Closes the connection and stops the thread of the object
+    ~BitstampStreamApi();
+
+    std::string makePair(const std::string& cryptoSymbol, const std::string& fiatSymbol) const override {
+        return rest_.makePair(cryptoSymbol, fiatSymbol);
+    }
+    PairId pairId(const std::string& pair) const override {return rest_.pairId(pair);}
+    void subscribeMarketData(const std::vector<PairId>& tickers, MarketDataHandler handler) override;
+    bool connected() const override {return connected_.load();}
+
+    Stats stats() const;
+
+    // Channel names of the Bitstamp WebSocket Api
+    static std::string tradesChannel(const std::string& ticker) {return "live_trades_" + ticker;}
+    static std::string orderBookChannel(const std::string& ticker) {return "order_book_" + ticker;}
+
+private:
+    struct Subscription {
+        std::unordered_set<PairId> tickers;
+        MarketDataHandler handler;
+    };
+
+    const std::string url_;
+    const std::chrono::seconds heartbeat_;
+    BitstampApi rest_;
+
+    mutable std::mutex mutex_; // guards the members below
+    std::vector<std::shared_ptr<Subscription>> subscriptions_;
+    std::vector<std::string> channels_;       // channels of all the subscriptions
+    size_t subscribedChannels_ = 0;           // channels already subscribed on the current connection
+    std::unordered_map<PairId, DataMap> marketData_;
+    Stats stats_;
+
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+
+    void run();
+
+    // Reads the messages of the connection until it fails or the object is stopped
+    void serve(WebSocket& socket);
+
+    // Subscribes the channels which are not subscribed on the connection yet
+    bool subscribePending(WebSocket& socket);
+
+    // Handles a message; returns false if the server asked for a reconnection
+    bool handleMessage(const std::string& message);
+
+    // Merges the fields into the market data of the ticker, and pushes the result to its handlers
+    void update(PairId id, const DataMap& fields, bool onlyMissing = false);
+};
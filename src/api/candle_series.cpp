@@ -0,0 +1,325 @@
+#include "candle_series.h"
+#include "../json_reader/json_schema.h"
+#include "../utils/arena.h"
+#include "../utils/decimal.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <limits>
+
+namespace {
+
+// A candle, as the text of its values in column order
+struct CandleRow {
+    std::string_view values[CandleSeries::COLUMNS];
+};
+
+// Schema of the candles of the ohlc payload: the columns, in their order
+struct CandleSchema {
+    using Record = CandleRow;
+    static constexpr std::array<std::string_view, CandleSeries::COLUMNS> KEYS = {"timestamp", "open", "high", "low", "close", "volume"};
+
+    static bool set(Record& row, size_t key, const JsonTokenizer::Token& value) {
+        using TokenType = JsonTokenizer::TokenType;
+        if (value.type != TokenType::String && value.type != TokenType::Literal) return false;
+        row.values[key] = value.text;
+        return true;
+    }
+};
+
+using CandleReader = JsonSchemaReader<CandleSchema>;
+constexpr const auto& COLUMN_NAMES = CandleSchema::KEYS;
+
+// Pads the text written from start with spaces up to the column width (longer texts are not cut), as
+// std::setw does
+void padFrom(std::string& out, size_t start, size_t width) {
+    if (out.size() - start < width) out.append(width - (out.size() - start), ' ');
+}
+
+} // namespace
+
+void CandleSeries::reserve(size_t n) {
+    timestamp.reserve(n);
+    for (size_t c = Open; c < COLUMNS; ++c) {
+        if (has(static_cast<Column>(c))) values(static_cast<Column>(c)).reserve(n);
+    }
+}
+
+void CandleSeries::clear() {
+    timestamp.clear();
+    open.clear();
+    high.clear();
+    low.clear();
+    close.clear();
+    volume.clear();
+    std::fill(scale, scale + COLUMNS, 0);
+    std::fill(decimals, decimals + COLUMNS, 0);
+    columns = ALL;
+}
+
+int64_t CandleSeries::step() const {
+    int64_t step = 0;
+    for (size_t i = 1; i < size(); ++i) {
+        const int64_t gap = timestamp[i] - timestamp[i - 1];
+        if (gap > 0 && (step == 0 || gap < step)) step = gap;
+    }
+    return step;
+}
+
+void CandleSeries::select(Mask mask) {
+    mask |= bit(Timestamp);
+    for (size_t c = Open; c < COLUMNS; ++c) {
+        const auto column = static_cast<Column>(c);
+        if ((mask & bit(column)) != 0) continue;
+        std::vector<int64_t>().swap(values(column));
+        scale[c] = 0;
+        decimals[c] = 0;
+    }
+    columns &= mask;
+}
+
+CandleSeries::Mask CandleSeries::mask(const std::vector<std::string>& fields) {
+    if (fields.empty()) return ALL;
+    Mask mask = bit(Timestamp);
+    Column column;
+    for (const auto& field: fields) {
+        if (find(field, column)) mask |= bit(column);
+    }
+    return mask;
+}
+
+void CandleSeries::append(const std::string_view (&values)[COLUMNS]) {
+    int64_t time = 0;
+    std::from_chars(values[Timestamp].data(), values[Timestamp].data() + values[Timestamp].size(), time);
+    timestamp.push_back(time);
+
+    for (size_t c = Open; c < COLUMNS; ++c) {
+        const auto column = static_cast<Column>(c);
+        if (!has(column)) continue;
+        const auto text = values[c];
+        int64_t units = MISSING;
+        if (!Decimal::parse(text, scale[c], units)) {
+            // The column is rescaled to the decimals of the value, if it can be
+            const unsigned written = Decimal::decimals(text);
+            if (written <= scale[c] || written > Decimal::MAX_SCALE || !rescale(column, written) || !Decimal::parse(text, scale[c], units)) {
+                units = MISSING;
+            }
+        }
+        if (units != MISSING) decimals[c] = std::max<unsigned char>(decimals[c], std::min(Decimal::decimals(text), Decimal::MAX_SCALE));
+        this->values(column).push_back(units);
+    }
+}
+
+const std::vector<int64_t>& CandleSeries::values(Column column) const {
+    switch (column) {
+        case Open: return open;
+        case High: return high;
+        case Low: return low;
+        case Close: return close;
+        default: return volume;
+    }
+}
+
+std::vector<int64_t>& CandleSeries::values(Column column) {
+    return const_cast<std::vector<int64_t>&>(static_cast<const CandleSeries*>(this)->values(column));
+}
+
+double CandleSeries::value(Column column, size_t i) const {
+    if (!has(column)) return std::numeric_limits<double>::quiet_NaN();
+    const int64_t units = values(column)[i];
+    return units == MISSING ? std::numeric_limits<double>::quiet_NaN() : Decimal::toDouble(units, scale[column]);
+}
+
+bool CandleSeries::rescale(Column column, unsigned newScale) {
+    if (column == Timestamp || column >= COLUMNS || !has(column) || newScale > Decimal::MAX_SCALE) return false;
+    if (newScale == scale[column]) return true;
+    auto& units = values(column);
+    // The values are checked first, so that the column is left unchanged if one of them cannot be converted
+    int64_t converted;
+    for (const auto value: units) {
+        if (value != MISSING && !Decimal::rescale(value, scale[column], newScale, converted)) return false;
+    }
+    for (auto& value: units) {
+        if (value != MISSING) Decimal::rescale(value, scale[column], newScale, value);
+    }
+    scale[column] = static_cast<unsigned char>(newScale);
+    return true;
+}
+
+std::string CandleSeries::text(Column column, size_t i) const {
+    std::string out;
+    appendText(column, i, out);
+    return out;
+}
+
+void CandleSeries::appendText(Column column, size_t i, std::string& out) const {
+    if (column == Timestamp) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), timestamp[i]);
+        out.append(buffer, result.ptr - buffer);
+        return;
+    }
+    if (!has(column)) return;
+    const int64_t units = values(column)[i];
+    if (units != MISSING) Decimal::append(units, scale[column], decimals[column], out);
+}
+
+const char* CandleSeries::name(Column column) {
+    return column < COLUMNS ? COLUMN_NAMES[column].data() : "";
+}
+
+bool CandleSeries::find(std::string_view name, Column& column) {
+    const int index = CandleReader::KEYS.find(name);
+    if (index < 0) return false;
+    column = static_cast<Column>(index);
+    return true;
+}
+
+// The candles are read by the parser specialized for their schema, and their values are converted in
+// place: nothing is allocated per candle (the columns are reserved beforehand). The values of the columns
+// out of the mask are neither converted nor stored
+bool CandleSeries::parse(std::string_view json, Mask mask) {
+    clear();
+    columns = mask | bit(Timestamp);
+    Arena::Scope scratch; // the index only lives for this parse
+    StructuralIndex index(scratch.resource());
+    const bool indexed = index.build(json);
+    JsonTokenizer tokenizer = indexed ? JsonTokenizer(json, index) : JsonTokenizer(json);
+
+    // Every candle opens a brace: their number bounds the number of candles
+    if (indexed) {
+        size_t braces = 0;
+        for (const auto position: index) braces += json[position] == '{';
+        reserve(braces);
+    }
+
+    if (CandleReader::readArray(tokenizer, [this](const CandleRow& row) {append(row.values);})) return true;
+    clear();
+    return false;
+}
+
+// The candles are checked and their values converted first, so that the series is left as it was if they cannot be merged
+bool CandleSeries::merge(const CandleSeries& newer, size_t window) {
+    if (newer.empty() || empty() || newer.columns != columns) return false;
+    const size_t first = static_cast<size_t>(std::lower_bound(timestamp.begin(), timestamp.end(), newer.timestamp.front()) - timestamp.begin());
+    if (first == size()) return false;
+    for (size_t i = 0; i < newer.size(); ++i) {
+        // The candles held are matched one by one; the others must be in increasing order (i > 0 past the end)
+        if (first + i < size() ? timestamp[first + i] != newer.timestamp[i] : newer.timestamp[i] <= newer.timestamp[i - 1]) return false;
+    }
+
+    // The columns are brought to the larger of the two scales; a rescaled column keeps its values
+    int64_t converted;
+    for (size_t c = Open; c < COLUMNS; ++c) {
+        const auto column = static_cast<Column>(c);
+        if (!has(column)) continue;
+        if (newer.scale[c] > scale[c] && !rescale(column, newer.scale[c])) return false;
+        for (const auto value: newer.values(column)) {
+            if (value != MISSING && !Decimal::rescale(value, newer.scale[c], scale[c], converted)) return false;
+        }
+    }
+
+    if (window == 0) window = size();
+    timestamp.resize(std::max(size(), first + newer.size()));
+    std::copy(newer.timestamp.begin(), newer.timestamp.end(), timestamp.begin() + first);
+    for (size_t c = Open; c < COLUMNS; ++c) {
+        const auto column = static_cast<Column>(c);
+        if (!has(column)) continue;
+        auto& units = values(column);
+        units.resize(size());
+        for (size_t i = 0; i < newer.size(); ++i) {
+            const int64_t value = newer.values(column)[i];
+            if (value == MISSING || !Decimal::rescale(value, newer.scale[c], scale[c], units[first + i])) units[first + i] = MISSING;
+        }
+        decimals[c] = std::max(decimals[c], newer.decimals[c]);
+    }
+
+    if (size() > window) {
+        const auto dropped = static_cast<std::ptrdiff_t>(size() - window);
+        timestamp.erase(timestamp.begin(), timestamp.begin() + dropped);
+        for (size_t c = Open; c < COLUMNS; ++c) {
+            auto& units = values(static_cast<Column>(c));
+            if (!units.empty()) units.erase(units.begin(), units.begin() + dropped);
+        }
+    }
+    return true;
+}
+
+CandleSeries CandleSeries::fromRecords(const std::vector<std::unordered_map<std::string, std::string>>& records) {
+    CandleSeries series;
+    series.reserve(records.size());
+    for (const auto& record: records) series.append(record);
+    return series;
+}
+
+void CandleSeries::append(const std::unordered_map<std::string, std::string>& record) {
+    std::string_view values[COLUMNS];
+    for (size_t c = 0; c < COLUMNS; ++c) {
+        auto it = record.find(std::string(COLUMN_NAMES[c]));
+        if (it != record.end()) values[c] = it->second;
+    }
+    append(values);
+}
+
+std::string CandleSeries::format(
+    const std::string& headerPrefix,
+    const std::vector<std::string>& fields,
+    bool convertTimestamp,
+    bool toCsv
+) const {
+    std::string out;
+    appendFormat(out, headerPrefix, fields, convertTimestamp, toCsv);
+    return out;
+}
+
+// The values are written straight into the output, and padded in place: nothing is allocated but the
+// output (the list of the columns shown is scratch memory of the thread)
+void CandleSeries::appendFormat(
+    std::string& out,
+    const std::string& headerPrefix,
+    const std::vector<std::string>& fields,
+    bool convertTimestamp,
+    bool toCsv
+) const {
+    Arena::Scope scratch;
+    std::pmr::vector<Column> shown(scratch.resource());
+    for (const auto& field: fields) {
+        Column column;
+        if (find(field, column) && has(column)) shown.push_back(column);
+    }
+    if (fields.empty()) {
+        for (size_t c = 0; c < COLUMNS; ++c) {
+            if (has(static_cast<Column>(c))) shown.push_back(static_cast<Column>(c));
+        }
+    }
+    const size_t count = shown.size();
+
+    const size_t colWidth = 15 + headerPrefix.size();
+    for (size_t c = 0; c < count; ++c) {
+        const size_t start = out.size();
+        out += headerPrefix;
+        out += name(shown[c]);
+        if (toCsv) {
+            if (c + 1 < count) out += ',';
+        } else {
+            padFrom(out, start, colWidth);
+        }
+    }
+    out += '\n';
+    if (!toCsv) out.append(count * colWidth, '-') += '\n';
+
+    for (size_t i = 0; i < size(); ++i) {
+        for (size_t c = 0; c < count; ++c) {
+            const size_t start = out.size();
+            if (shown[c] == Timestamp && convertTimestamp) Utils::appendTimestamp(static_cast<int>(timestamp[i]), out);
+            else appendText(shown[c], i, out);
+            if (toCsv) {
+                if (c + 1 < count) out += ',';
+            } else {
+                padFrom(out, start, colWidth);
+            }
+        }
+        out += '\n';
+    }
+    if (!toCsv) out.append(count * colWidth, '-') += '\n';
+}
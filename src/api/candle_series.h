@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Candlestick data stored by columns (structure of arrays): the i-th candle is made of the i-th element
+ * of each column. A series of n candles takes one allocation per column, instead of a hash map and a
+ * dozen strings per candle, and a pass over a column (e.g. the close prices) reads contiguous memory.
+ * Prices and volumes are stored exactly, as fixed-point integers (see decimal.h) with a scale per column
+ * (MISSING if a value is missing). A column is rescaled when a value has more decimals than its scale;
+ * it also keeps the largest number of decimals of its values as received, so that they are formatted
+ * back as they were received (the exchanges send the values of a pair with a fixed number of decimals,
+ * e.g. "0.07330").
+ */
+struct CandleSeries {
+
+    enum Column : size_t {Timestamp, Open, High, Low, Close, Volume, COLUMNS};
+
+    // Set of columns, one bit per column
+    using Mask = unsigned char;
+    static constexpr Mask ALL = (1u << COLUMNS) - 1;
+    static constexpr Mask bit(Column column) {return static_cast<Mask>(1u << column);}
+
+    static constexpr int64_t MISSING = std::numeric_limits<int64_t>::min();
+
+    std::vector<int64_t> timestamp;
+    std::vector<int64_t> open;
+    std::vector<int64_t> high;
+    std::vector<int64_t> low;
+    std::vector<int64_t> close;
+    std::vector<int64_t> volume;
+    unsigned char scale[COLUMNS] = {};      // the values of a column are units of 10^-scale (0 for timestamp)
+    unsigned char decimals[COLUMNS] = {};   // decimals of the values of each column, as received
+    Mask columns = ALL;                     // columns holding values (the others are left empty; timestamp is always kept)
+
+    size_t size() const {return timestamp.size();}
+    bool empty() const {return timestamp.empty();}
+    bool has(Column column) const {return (columns & bit(column)) != 0;}
+    void reserve(size_t n);
+    void clear();
+
+    // Interval between two candles (e.g. 3600 for hourly candles): the smallest gap between consecutive
+    // timestamps, 0 if the series holds less than two candles
+    int64_t step() const;
+
+    // Keeps only the columns of the mask (and the timestamps): the values of the other columns are released
+    void select(Mask mask);
+
+    // Columns named by the fields (all of them if fields is empty), plus the timestamps
+    static Mask mask(const std::vector<std::string>& fields);
+
+    // Appends a candle given the text of its values, in column order (empty or invalid values are missing);
+    // the values of the columns which are not kept are ignored
+    void append(const std::string_view (&values)[COLUMNS]);
+
+    // Appends a candle given as an object of the api (names of the columns to the text of their values, e.g.
+    // an object of JsonStreamParser); the keys which are not columns are ignored
+    void append(const std::unordered_map<std::string, std::string>& record);
+
+    // Price or volume column (Open to Volume)
+    const std::vector<int64_t>& values(Column column) const;
+    std::vector<int64_t>& values(Column column);
+
+    // Value of a price or volume as a double (NaN if missing), for the computations which need not be exact
+    double value(Column column, size_t i) const;
+
+    // Converts the values of a price or volume column into units of 10^-scale; returns false (and leaves
+    // the column unchanged) if a value does not fit, or if nonzero digits would be dropped
+    bool rescale(Column column, unsigned scale);
+
+    // Text of a value, formatted with the decimals of its column (empty if the value or its column is missing)
+    std::string text(Column column, size_t i) const;
+    void appendText(Column column, size_t i, std::string& out) const;
+
+    // Name of a column (e.g. "close"), and column with a given name; returns false if the name is unknown
+    static const char* name(Column column);
+    static bool find(std::string_view name, Column& column);
+
+    // Decodes a json response holding the candles as objects (e.g. {"data": {"ohlc": [{...}, ...]}}): the
+    // first array of objects found is read, wherever it is nested, and the keys which are not columns are
+    // skipped. The values are converted straight from the input, without building an object per candle;
+    // only the columns of the mask are decoded (projection pushdown), the others are skipped as tokens.
+    // Returns false (and leaves the series empty) if the input is malformed.
+    bool parse(std::string_view json, Mask mask = ALL);
+
+    // Merges the candles of a more recent series (e.g. the candles from the newest one held on, fetched by an
+    // incremental request): a candle with the timestamp of a candle held replaces it in place (e.g. the candle
+    // which was still open), the newer ones are appended, and the oldest candles are dropped so that at most
+    // window candles are kept (0: as many as before the merge). Returns false, and leaves the values of the
+    // series unchanged, if the candles do not start at one of the candles held and follow them in order, if
+    // their columns differ, or if a value does not fit the scale of its column.
+    bool merge(const CandleSeries& newer, size_t window = 0);
+
+    // Converts the candles of an Api which only returns them as maps of strings
+    static CandleSeries fromRecords(const std::vector<std::unordered_map<std::string, std::string>>& records);
+
+    /* Formats the candles, either in tabular format (toCsv=false) or in csv format (toCsv=true), with the
+     * same layout as Utils::formatMapVector. The fields argument selects the columns (all the columns held
+     * if empty; the fields naming columns which are not held are not shown),
+     * the headerPrefix argument adds a prefix to their names; the timestamps are converted into datetime
+     * format if convertTimestamp is set. appendFormat writes the same text at the end of out, so that a
+     * polling loop can reuse the same string for all its refreshes.
+     */
+    std::string format(
+        const std::string& headerPrefix = "",
+        const std::vector<std::string>& fields = {},
+        bool convertTimestamp = true,
+        bool toCsv = true
+    ) const;
+    void appendFormat(
+        std::string& out,
+        const std::string& headerPrefix = "",
+        const std::vector<std::string>& fields = {},
+        bool convertTimestamp = true,
+        bool toCsv = true
+    ) const;
+};
@@ -0,0 +1,235 @@
+#include "coalescing_api.h"
+#include "single_flight.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Requests in flight of the whole process, one registry per type of result
+template<typename T>
+SingleFlight<T>& inFlight() {
+    static SingleFlight<T> registry;
+    return registry;
+}
+
+std::atomic<uint64_t> totalRequests{0};
+std::atomic<uint64_t> totalDeduplicated{0};
+std::atomic<uint64_t> anonymousScopes{0};
+
+}
+
+CoalescingApi::CoalescingApi(std::unique_ptr<Api> api): api_(std::move(api)) {
+    scope_ = api_->getSource();
+    // Unknown source: the requests are only shared by the callers of this object
+    if (scope_.empty()) scope_ = "#" + std::to_string(++anonymousScopes);
+}
+
+DataMapVec CoalescingApi::fetchCurrencyData() {
+    bool deduplicated;
+    auto data = inFlight<DataMapVec>().run(key("currencies"), [this]() {return api_->fetchCurrencyData();}, deduplicated);
+    count(deduplicated);
+    return data;
+}
+
+DataMapVec CoalescingApi::fetchAllPairs() {
+    bool deduplicated;
+    auto data = inFlight<DataMapVec>().run(key("pairs"), [this]() {return api_->fetchAllPairs();}, deduplicated);
+    count(deduplicated);
+    return data;
+}
+
+DataMap CoalescingApi::fetchMarketTicker(const std::string& ticker) {
+    bool deduplicated;
+    auto data = inFlight<DataMap>().run(key("ticker", ticker), [this, &ticker]() {return api_->fetchMarketTicker(ticker);}, deduplicated);
+    count(deduplicated);
+    return data;
+}
+
+DataMap CoalescingApi::fetchHourlyTicker(const std::string& ticker) {
+    bool deduplicated;
+    auto data = inFlight<DataMap>().run(key("ticker_hour", ticker), [this, &ticker]() {return api_->fetchHourlyTicker(ticker);}, deduplicated);
+    count(deduplicated);
+    return data;
+}
+
+std::unordered_map<PairId, DataMap> CoalescingApi::fetchMarketTickers(const std::vector<PairId>& tickers) {
+    std::vector<PairId> ids(tickers);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    std::string args;
+    for (const auto id: ids) args += std::to_string(id) + ',';
+
+    bool deduplicated;
+    auto data = inFlight<std::unordered_map<PairId, DataMap>>().run(
+        key("tickers", args), [this, &tickers]() {return api_->fetchMarketTickers(tickers);}, deduplicated
+    );
+    count(deduplicated);
+    return data;
+}
+
+DataMapVec CoalescingApi::fetchCandlestickData(const std::string& ticker, const std::unordered_map<std::string,std::string>& otherArgs) {
+    bool deduplicated;
+    auto data = inFlight<DataMapVec>().run(
+        key("ohlc", ticker + '?' + canonicalArgs(otherArgs)),
+        [this, &ticker, &otherArgs]() {return api_->fetchCandlestickData(ticker, otherArgs);},
+        deduplicated
+    );
+    count(deduplicated);
+    return data;
+}
+
+void CoalescingApi::fetchMarketTickerAsync(const std::string& ticker, std::function<void(DataMap)> callback) {
+    Api* api = api_.get();
+    bool deduplicated;
+    inFlight<DataMap>().runAsync(
+        key("ticker", ticker),
+        [api, &ticker](std::function<void(DataMap)> done) {api->fetchMarketTickerAsync(ticker, std::move(done));},
+        std::move(callback),
+        deduplicated
+    );
+    count(deduplicated);
+}
+
+void CoalescingApi::fetchCandlestickDataAsync(
+    const std::string& ticker,
+    const std::unordered_map<std::string,std::string>& otherArgs,
+    std::function<void(DataMapVec)> callback
+) {
+    Api* api = api_.get();
+    bool deduplicated;
+    inFlight<DataMapVec>().runAsync(
+        key("ohlc", ticker + '?' + canonicalArgs(otherArgs)),
+        [api, &ticker, &otherArgs](std::function<void(DataMapVec)> done) {
+            api->fetchCandlestickDataAsync(ticker, otherArgs, std::move(done));
+        },
+        std::move(callback),
+        deduplicated
+    );
+    count(deduplicated);
+}
+
+// The requests of different columns are not coalesced: their series differ
+CandleSeries CoalescingApi::fetchCandleSeries(
+    const std::string& ticker,
+    const std::unordered_map<std::string,std::string>& otherArgs,
+    CandleSeries::Mask columns
+) {
+    bool deduplicated;
+    auto data = inFlight<CandleSeries>().run(
+        key("ohlc_series", ticker + '?' + canonicalArgs(otherArgs) + '#' + std::to_string(columns)),
+        [this, &ticker, &otherArgs, columns]() {return api_->fetchCandleSeries(ticker, otherArgs, columns);},
+        deduplicated
+    );
+    count(deduplicated);
+    return data;
+}
+
+void CoalescingApi::fetchCandleSeriesAsync(
+    const std::string& ticker,
+    const std::unordered_map<std::string,std::string>& otherArgs,
+    std::function<void(CandleSeries)> callback,
+    CandleSeries::Mask columns
+) {
+    Api* api = api_.get();
+    bool deduplicated;
+    inFlight<CandleSeries>().runAsync(
+        key("ohlc_series", ticker + '?' + canonicalArgs(otherArgs) + '#' + std::to_string(columns)),
+        [api, &ticker, &otherArgs, columns](std::function<void(CandleSeries)> done) {
+            api->fetchCandleSeriesAsync(ticker, otherArgs, std::move(done), columns);
+        },
+        std::move(callback),
+        deduplicated
+    );
+    count(deduplicated);
+}
+
+Ticker CoalescingApi::fetchTicker(const std::string& ticker) {
+    bool deduplicated;
+    auto data = inFlight<Ticker>().run(key("ticker_record", ticker), [this, &ticker]() {return api_->fetchTicker(ticker);}, deduplicated);
+    count(deduplicated);
+    return data;
+}
+
+void CoalescingApi::fetchTickerAsync(const std::string& ticker, std::function<void(Ticker)> callback) {
+    Api* api = api_.get();
+    bool deduplicated;
+    inFlight<Ticker>().runAsync(
+        key("ticker_record", ticker),
+        [api, &ticker](std::function<void(Ticker)> done) {api->fetchTickerAsync(ticker, std::move(done));},
+        std::move(callback),
+        deduplicated
+    );
+    count(deduplicated);
+}
+
+// The records are returned by position: unlike fetchMarketTickers, the key keeps the order of the ids.
+// A failed request yields no records.
+bool CoalescingApi::fetchTickers(const std::vector<PairId>& tickers, std::vector<Ticker>& out) {
+    std::string args;
+    for (const auto id: tickers) args += std::to_string(id) + ',';
+
+    bool deduplicated;
+    out = inFlight<std::vector<Ticker>>().run(
+        key("ticker_records", args),
+        [this, &tickers]() {
+            std::vector<Ticker> records;
+            return api_->fetchTickers(tickers, records) ? records : std::vector<Ticker>{};
+        },
+        deduplicated
+    );
+    count(deduplicated);
+    if (out.size() == tickers.size()) return true;
+    out.assign(tickers.size(), Ticker{});
+    return false;
+}
+
+std::vector<CurrencyInfo> CoalescingApi::fetchCurrencies() {
+    bool deduplicated;
+    auto data = inFlight<std::vector<CurrencyInfo>>().run(key("currency_records"), [this]() {return api_->fetchCurrencies();}, deduplicated);
+    count(deduplicated);
+    return data;
+}
+
+std::vector<std::string> CoalescingApi::fetchAllTickers() {
+    bool deduplicated;
+    auto data = inFlight<std::vector<std::string>>().run(key("all_tickers"), [this]() {return api_->fetchAllTickers();}, deduplicated);
+    count(deduplicated);
+    return data;
+}
+
+CoalescingApi::Stats CoalescingApi::stats() const {
+    return Stats{requests_.load(), deduplicated_.load()};
+}
+
+CoalescingApi::Stats CoalescingApi::totalStats() {
+    return Stats{totalRequests.load(), totalDeduplicated.load()};
+}
+
+std::string CoalescingApi::canonicalArgs(const std::unordered_map<std::string,std::string>& args) {
+    std::vector<std::pair<std::string, std::string>> sorted(args.begin(), args.end());
+    std::sort(sorted.begin(), sorted.end());
+    std::string canonical;
+    for (const auto& [name, value]: sorted) {
+        if (!canonical.empty()) canonical += '&';
+        canonical += name + '=' + value;
+    }
+    return canonical;
+}
+
+std::string CoalescingApi::key(const std::string& endpoint, const std::string& args) const {
+    return scope_ + '\n' + endpoint + '\n' + args;
+}
+
+void CoalescingApi::count(bool deduplicated) {
+    ++requests_;
+    ++totalRequests;
+    if (deduplicated) {
+        ++deduplicated_;
+        ++totalDeduplicated;
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const CoalescingApi::Stats& stats) {
+    os << "request coalescing << requests: " << stats.requests << " << deduplicated: " << stats.deduplicated;
+    return os;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "api.h"
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+
+/*
+ * Api decorator coalescing identical requests (single-flight): when a request is issued while an
+ * identical one is in flight (same source, same endpoint and same arguments, whatever their
+ * order), the caller waits for the result of the first request instead of issuing its own, and
+ * receives its own copy of it. The requests in flight are shared by all the CoalescingApi objects
+ * of the process, so consumers holding different decorators over the same source are coalesced
+ * too; if the source of the wrapped Api is unknown, only the requests of the same decorator are.
+ * Only the data requests are coalesced; the other calls, and the requests decoding into a lent
+ * series, are forwarded to the wrapped Api.
+ */
+class CoalescingApi : public Api {
+
+public:
+    struct Stats {
+        uint64_t requests = 0;      // data requests received
+        uint64_t deduplicated = 0;  // requests served by an identical request in flight
+    };
+
+    explicit CoalescingApi(std::unique_ptr<Api> api);
+
+    int getMaxConnectionTime() const override {return api_->getMaxConnectionTime();}
+    void setMaxConnectionTime(int maxConnectionTime) override {api_->setMaxConnectionTime(maxConnectionTime);}
+
+    using Api::fetchCandleSeries; // the overloads without the mask
+    using Api::fetchCandleSeriesAsync;
+    using Api::fetchCandleSeriesIntoAsync;
+
+    DataMapVec fetchCurrencyData() override;
+    DataMapVec fetchAllPairs() override;
+    DataMap fetchMarketTicker(const std::string& ticker) override;
+    DataMap fetchHourlyTicker(const std::string& ticker) override;
+    std::unordered_map<PairId, DataMap> fetchMarketTickers(const std::vector<PairId>& tickers) override;
+    DataMapVec fetchCandlestickData(const std::string& ticker, const std::unordered_map<std::string,std::string>& otherArgs) override;
+    void fetchMarketTickerAsync(const std::string& ticker, std::function<void(DataMap)> callback) override;
+    void fetchCandlestickDataAsync(
+        const std::string& ticker,
+        const std::unordered_map<std::string,std::string>& otherArgs,
+        std::function<void(DataMapVec)> callback
+    ) override;
+    CandleSeries fetchCandleSeries(
+        const std::string& ticker,
+        const std::unordered_map<std::string,std::string>& otherArgs,
+        CandleSeries::Mask columns
+    ) override;
+    void fetchCandleSeriesAsync(
+        const std::string& ticker,
+        const std::unordered_map<std::string,std::string>& otherArgs,
+        std::function<void(CandleSeries)> callback,
+        CandleSeries::Mask columns
+    ) override;
+    void fetchCandleSeriesIntoAsync(
+        const std::string& ticker,
+        const std::unordered_map<std::string,std::string>& otherArgs,
+        CandleSeries series,
+        std::function<void(CandleSeries)> callback,
+        CandleSeries::Mask columns
+    ) override {
+        api_->fetchCandleSeriesIntoAsync(ticker, otherArgs, std::move(series), std::move(callback), columns);
+    }
+    Ticker fetchTicker(const std::string& ticker) override;
+    void fetchTickerAsync(const std::string& ticker, std::function<void(Ticker)> callback) override;
+    bool fetchTickers(const std::vector<PairId>& tickers, std::vector<Ticker>& out) override;
+    std::vector<CurrencyInfo> fetchCurrencies() override;
+    std::vector<std::string> fetchAllTickers() override;
+
+    std::string makePair(const std::string& cryptoSymbol, const std::string& fiatSymbol) const override {
+        return api_->makePair(cryptoSymbol, fiatSymbol);
+    }
+    bool validatePair(const std::string& pair) const override {return api_->validatePair(pair);}
+    PairId pairId(const std::string& pair) const override {return api_->pairId(pair);}
+    std::string getSource() const override {return api_->getSource();}
+    bool sinceCandlestickArgs(
+        const std::unordered_map<std::string,std::string>& otherArgs,
+        int64_t timestamp,
+        std::unordered_map<std::string,std::string>& sinceArgs,
+        size_t& window
+    ) const override {
+        return api_->sinceCandlestickArgs(otherArgs, timestamp, sinceArgs, window);
+    }
+    int64_t candlestickResolution(const std::unordered_map<std::string,std::string>& otherArgs) const override {
+        return api_->candlestickResolution(otherArgs);
+    }
+
+    // The wrapped Api
+    Api& inner() const {return *api_;}
+
+    // Requests received by this object, and requests received by all the objects of the process
+    Stats stats() const;
+    static Stats totalStats();
+
+    // Canonical form of the request arguments: sorted by name, encoded as in a query string
+    static std::string canonicalArgs(const std::unordered_map<std::string,std::string>& args);
+
+private:
+    std::unique_ptr<Api> api_;
+    std::string scope_; // prefix of the keys of the requests, identifying the source
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> deduplicated_{0};
+
+    std::string key(const std::string& endpoint, const std::string& args = "") const;
+    void count(bool deduplicated);
+};
+
+std::ostream& operator<<(std::ostream& os, const CoalescingApi::Stats& stats);
@@ -0,0 +1,236 @@
+#include "connection_pool.h"
+#include <algorithm>
+
+ConnectionPool& ConnectionPool::shared() {
+    static ConnectionPool* pool = new ConnectionPool(); // never destroyed: used by the threads still running at exit
+    return *pool;
+}
+
+size_t ConnectionPool::getMaxConnectionsPerHost() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return maxConnectionsPerHost_;
+}
+
+void ConnectionPool::setMaxConnectionsPerHost(size_t maxConnectionsPerHost) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    maxConnectionsPerHost_ = std::max<size_t>(1, maxConnectionsPerHost);
+    for (auto& host: hosts_) notify(*host.second);
+}
+
+int ConnectionPool::getIdleTimeout() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idleTimeout_;
+}
+
+void ConnectionPool::setIdleTimeout(int idleTimeoutSeconds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    idleTimeout_ = std::max(0, idleTimeoutSeconds);
+}
+
+void ConnectionPool::evictExpired(Host& host) {
+    auto limit = Clock::now() - std::chrono::seconds(idleTimeout_);
+    // The least recently used connections are at the front
+    while (!host.idle.empty() && host.idle.front().since <= limit) {
+        host.idle.pop_front();
+        --host.open;
+        ++stats_.evictions;
+    }
+}
+
+ConnectionPool::Host& ConnectionPool::host(const std::string& hostKey) {
+    auto& host = hosts_[hostKey];
+    if (!host) host.reset(new Host());
+    return *host;
+}
+
+void ConnectionPool::notify(Host& host) {
+    host.available.notify_all();
+    if (host.waiting.empty()) return;
+    auto waiter = host.waiters.find(host.waiting.front());
+    if (waiter != host.waiters.end()) waiter->second.wakeup();
+}
+
+std::unique_ptr<Connection> ConnectionPool::takeIdle(Host& host) {
+    // Idle connections are reused starting from the most recent one
+    while (!host.idle.empty()) {
+        auto connection = std::move(host.idle.back().connection);
+        host.idle.pop_back();
+        if (connection->isReusable()) return connection;
+        // The server closed the connection in the meantime
+        --host.open;
+        ++stats_.evictions;
+    }
+    return nullptr;
+}
+
+void ConnectionPool::recordWait(Clock::time_point since) {
+    auto waitUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - since).count());
+    stats_.totalWaitUs += waitUs;
+    stats_.maxWaitUs = std::max(stats_.maxWaitUs, waitUs);
+}
+
+std::unique_ptr<Connection> ConnectionPool::checkout(const Url& url, const Deadline& deadline, bool& reused, std::string& error) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Host& host = this->host(url.hostKey());
+
+    auto start = Clock::now();
+    uint64_t ticket = nextTicket_++;
+    host.waiting.push_back(ticket);
+    bool waited = false;
+
+    // Leaves the waiting queue, and records the time spent in it (mutex_ must be held)
+    auto leaveQueue = [this, &host, &start, &waited]() {
+        host.waiting.pop_front();
+        notify(host);
+        if (waited) recordWait(start);
+    };
+
+    while (true) {
+        evictExpired(host);
+        bool first = host.waiting.front() == ticket;
+
+        if (first) {
+            auto connection = takeIdle(host);
+            if (connection) {
+                leaveQueue();
+                ++stats_.hits;
+                reused = true;
+                return connection;
+            }
+        }
+
+        if (first && host.open < maxConnectionsPerHost_) {
+            ++host.open;
+            leaveQueue();
+            ++stats_.misses;
+            lock.unlock();
+
+            // The slot is reserved: the connection is opened without holding the lock
+            reused = false;
+            auto connection = Connection::open(url, deadline, error);
+            if (!connection) {
+                lock.lock();
+                --host.open;
+                notify(host);
+            }
+            return connection;
+        }
+
+        if (!waited) {
+            waited = true;
+            ++stats_.waits;
+        }
+        bool timedOut = false;
+        if (deadline.unlimited) host.available.wait(lock);
+        else timedOut = host.available.wait_until(lock, deadline.at) == std::cv_status::timeout;
+
+        if (timedOut) {
+            host.waiting.erase(std::find(host.waiting.begin(), host.waiting.end(), ticket));
+            notify(host);
+            error = "timeout while waiting for a connection";
+            return nullptr;
+        }
+    }
+}
+
+void ConnectionPool::checkin(std::unique_ptr<Connection> connection, bool keepAlive) {
+    if (!connection) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& host = *hosts_.at(connection->hostKey());
+    if (keepAlive && idleTimeout_ > 0) {
+        host.idle.push_back(IdleConnection{std::move(connection), Clock::now()});
+    } else {
+        --host.open;
+    }
+    notify(host);
+}
+
+// The request is served only once it is the first of the queue of the host, like the threads of checkout
+ConnectionPool::Checkout ConnectionPool::tryCheckout(const std::string& hostKey, uint64_t& ticket, std::function<void()> wakeup,
+                                                     std::unique_ptr<Connection>& connection) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Host& host = this->host(hostKey);
+    evictExpired(host);
+    if (ticket == 0 && host.waiting.empty()) {
+        connection = takeIdle(host);
+        if (connection) {
+            ++stats_.hits;
+            return Checkout::Idle;
+        }
+        if (host.open < maxConnectionsPerHost_) {
+            ++host.open;
+            ++stats_.misses;
+            return Checkout::Open;
+        }
+    }
+    if (ticket == 0) {
+        ticket = nextTicket_++;
+        host.waiting.push_back(ticket);
+        host.waiters[ticket] = Waiter{std::move(wakeup), Clock::now()};
+        ++stats_.waits;
+        return Checkout::Wait;
+    }
+    if (host.waiting.empty() || host.waiting.front() != ticket) return Checkout::Wait;
+
+    connection = takeIdle(host);
+    const bool opened = connection == nullptr && host.open < maxConnectionsPerHost_;
+    if (connection == nullptr && !opened) return Checkout::Wait;
+    if (opened) {
+        ++host.open;
+        ++stats_.misses;
+    } else {
+        ++stats_.hits;
+    }
+    recordWait(host.waiters[ticket].since);
+    host.waiters.erase(ticket);
+    host.waiting.pop_front();
+    ticket = 0;
+    notify(host);
+    return opened ? Checkout::Open : Checkout::Idle;
+}
+
+void ConnectionPool::release(const std::string& hostKey) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& host = *hosts_.at(hostKey);
+    --host.open;
+    notify(host);
+}
+
+void ConnectionPool::abandon(const std::string& hostKey, uint64_t ticket) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = hosts_.find(hostKey);
+    if (it == hosts_.end() || it->second->waiters.erase(ticket) == 0) return;
+    auto& host = *it->second;
+    host.waiting.erase(std::find(host.waiting.begin(), host.waiting.end(), ticket));
+    notify(host);
+}
+
+void ConnectionPool::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& host: hosts_) {
+        host.second->open -= host.second->idle.size();
+        host.second->idle.clear();
+        notify(*host.second);
+    }
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+size_t ConnectionPool::idleConnections(const std::string& hostKey) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = hosts_.find(hostKey);
+    return it == hosts_.end() ? 0 : it->second->idle.size();
+}
+
+std::ostream& operator<<(std::ostream& os, const ConnectionPool::Stats& stats) {
+    auto checkouts = stats.hits + stats.misses;
+    os << "connection pool << hits: " << stats.hits << " << misses: " << stats.misses
+       << " << waits: " << stats.waits << " << evictions: " << stats.evictions
+       << " << avg wait (us): " << (stats.waits == 0 ? 0 : stats.totalWaitUs / stats.waits)
+       << " << max wait (us): " << stats.maxWaitUs
+       << " << hit rate: " << (checkouts == 0 ? 0.0 : static_cast<double>(stats.hits) / checkouts);
+    return os;
+}
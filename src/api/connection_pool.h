@@ -0,0 +1,120 @@
+#pragma once
+
+#include "http_client.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/*
+ * Process-wide pool of keep-alive connections, keyed by host. All the HttpClient objects
+ * (hence all the Api implementations) share the same pool by default, so that the number of
+ * open sockets depends on the number of concurrent requests rather than on the number of
+ * Api objects. At most maxConnectionsPerHost connections (idle or in use) are open towards
+ * the same host: when the limit is reached, the requesting threads wait for a connection in
+ * first-come, first-served order. Connections idle for longer than the idle timeout are closed.
+ * The event loop of the AsyncHttpClient takes its connections from the same pool, without blocking
+ * (tryCheckout): its requests wait in the same queues as the threads, and are counted in the same stats.
+ */
+class ConnectionPool {
+
+public:
+    struct Stats {
+        uint64_t hits = 0;          // checkouts served with an idle connection
+        uint64_t misses = 0;        // checkouts that opened a new connection
+        uint64_t waits = 0;         // checkouts that had to wait for a connection
+        uint64_t evictions = 0;     // idle connections closed by the pool
+        uint64_t totalWaitUs = 0;   // total time spent waiting for a connection (microseconds)
+        uint64_t maxWaitUs = 0;     // longest wait for a connection (microseconds)
+    };
+
+    ConnectionPool() {}
+    ConnectionPool(size_t maxConnectionsPerHost, int idleTimeoutSeconds):
+        maxConnectionsPerHost_(maxConnectionsPerHost), idleTimeout_(idleTimeoutSeconds) {}
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // The pool shared by the whole process (never destroyed)
+    static ConnectionPool& shared();
+
+    size_t getMaxConnectionsPerHost() const;
+    void setMaxConnectionsPerHost(size_t maxConnectionsPerHost);
+    int getIdleTimeout() const;
+    void setIdleTimeout(int idleTimeoutSeconds);
+
+    // Gets a connection to the host of the url, either an idle one (reused = true) or a new one.
+    // Returns nullptr (and sets error) if no connection could be obtained before the deadline.
+    std::unique_ptr<Connection> checkout(const Url& url, const Deadline& deadline, bool& reused, std::string& error);
+
+    // Gives a connection back to the pool; if keepAlive is false the connection is closed.
+    // Every connection obtained through checkout or tryCheckout must be given back.
+    void checkin(std::unique_ptr<Connection> connection, bool keepAlive);
+
+    // Non-blocking checkout, for the event loops. ticket identifies the request in the queue of the host: 0
+    // for a new request, then the ticket it received while it waits. Returns Idle with an idle connection,
+    // Open if a connection may be opened (the caller opens it, and gives it back through checkin, or through
+    // release if it could not be opened), or Wait if the request is queued behind others: wakeup is then
+    // invoked, by the thread changing the state of the pool, once it may be served (it must not block nor
+    // call the pool). A request which stops waiting must leave the queue through abandon.
+    enum class Checkout {Idle, Open, Wait};
+    Checkout tryCheckout(const std::string& hostKey, uint64_t& ticket, std::function<void()> wakeup, std::unique_ptr<Connection>& connection);
+    void release(const std::string& hostKey);
+    void abandon(const std::string& hostKey, uint64_t ticket);
+
+    // Closes all the idle connections
+    void clear();
+
+    Stats stats() const;
+    size_t idleConnections(const std::string& hostKey) const;
+
+private:
+    struct IdleConnection {
+        std::unique_ptr<Connection> connection;
+        Clock::time_point since;
+    };
+
+    // Request of an event loop waiting for a connection
+    struct Waiter {
+        std::function<void()> wakeup;
+        Clock::time_point since;
+    };
+
+    struct Host {
+        std::deque<IdleConnection> idle; // most recently used at the back
+        size_t open = 0;                 // idle + checked out connections
+        std::deque<uint64_t> waiting;    // tickets of the threads and requests waiting for a connection
+        std::unordered_map<uint64_t, Waiter> waiters; // the requests of the event loops among them
+        std::condition_variable available;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<Host>> hosts_;
+    size_t maxConnectionsPerHost_ = 8;
+    int idleTimeout_ = 60; // seconds
+    uint64_t nextTicket_ = 1; // 0 is not a ticket (see tryCheckout)
+    Stats stats_;
+
+    // Closes the connections that have been idle for too long (mutex_ must be held)
+    void evictExpired(Host& host);
+
+    // Host of a key, created on first use (mutex_ must be held)
+    Host& host(const std::string& hostKey);
+
+    // Wakes up the threads waiting for a connection of the host, and the request of an event loop if it is
+    // the first one in the queue (mutex_ must be held)
+    void notify(Host& host);
+
+    // Takes the most recent idle connection still open, if any (mutex_ must be held)
+    std::unique_ptr<Connection> takeIdle(Host& host);
+
+    // Records a wait for a connection which ended now (mutex_ must be held)
+    void recordWait(Clock::time_point since);
+};
+
+std::ostream& operator<<(std::ostream& os, const ConnectionPool::Stats& stats);
@@ -0,0 +1,62 @@
+#include "currency_info.h"
+#include "../json_reader/json_schema.h"
+#include <charconv>
+
+namespace {
+
+enum Key : size_t {Currency, Name, Type, Decimals};
+
+// Schema of the currency payload; the other members of the objects go to CurrencyInfo::others
+struct CurrencySchema {
+    using Record = CurrencyInfo;
+    static constexpr std::array<std::string_view, 4> KEYS = {"currency", "name", "type", "decimals"};
+
+    // The decimals are a number or a string holding a number; the texts are non-empty strings (the other
+    // values are kept in others, as received)
+    static bool set(Record& record, size_t key, const JsonTokenizer::Token& value) {
+        using TokenType = JsonTokenizer::TokenType;
+        if (key == Decimals) {
+            if (value.type != TokenType::Literal && value.type != TokenType::String) return false;
+            int decimals = -1;
+            const char* const end = value.text.data() + value.text.size();
+            auto result = std::from_chars(value.text.data(), end, decimals);
+            if (result.ec != std::errc() || result.ptr != end || decimals < 0) return false;
+            record.decimals = decimals;
+            return true;
+        }
+        if (value.type != TokenType::String || value.text.empty()) return false;
+        std::string& text = key == Currency ? record.currency : key == Name ? record.name : record.type;
+        return JsonReader::storeValue(value, text);
+    }
+};
+
+using CurrencyReader = JsonSchemaReader<CurrencySchema>;
+
+} // namespace
+
+bool CurrencyInfo::parseList(std::string_view json, std::vector<CurrencyInfo>& out) {
+    out.clear();
+    if (CurrencyReader::readArray(json, [&out](CurrencyInfo& currency) {out.push_back(std::move(currency));})) return true;
+    out.clear();
+    return false;
+}
+
+CurrencyInfo CurrencyInfo::fromMap(const std::unordered_map<std::string, std::string>& currency) {
+    CurrencyInfo info;
+    for (const auto& [key, value]: currency) {
+        const int index = CurrencyReader::KEYS.find(key);
+        // The values of the map are unescaped already: they are handed over as plain strings
+        const JsonTokenizer::Token token{index == Decimals ? JsonTokenizer::TokenType::Literal : JsonTokenizer::TokenType::String, value, false};
+        if (index < 0 || !CurrencySchema::set(info, static_cast<size_t>(index), token)) info.others[key] = value;
+    }
+    return info;
+}
+
+std::unordered_map<std::string, std::string> CurrencyInfo::toMap() const {
+    auto currency = others;
+    if (!this->currency.empty()) currency["currency"] = this->currency;
+    if (!name.empty()) currency["name"] = name;
+    if (!type.empty()) currency["type"] = type;
+    if (decimals >= 0) currency["decimals"] = std::to_string(decimals);
+    return currency;
+}
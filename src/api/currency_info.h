@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Metadata of a currency of an exchange (an element of the currency payload), e.g. its symbol and its
+ * number of decimals. The members which are not fields of the record (e.g. "logo", or the networks of a
+ * crypto currency) are kept as strings, so that the record converts back into the map of the generic
+ * reader.
+ */
+struct CurrencyInfo {
+    std::string currency;   // symbol, e.g. "BTC"
+    std::string name;       // e.g. "Bitcoin"
+    std::string type;       // e.g. "crypto" or "fiat"
+    int decimals = -1;      // -1 if unknown
+    std::unordered_map<std::string, std::string> others;
+
+    // Decodes the currency payload (an array of currency objects, wherever it is nested) with the parser
+    // specialized for its schema (see json_schema.h); returns false (and leaves out empty) if the input is
+    // malformed
+    static bool parseList(std::string_view json, std::vector<CurrencyInfo>& out);
+
+    // Conversions from and to the maps of the generic reader
+    static CurrencyInfo fromMap(const std::unordered_map<std::string, std::string>& currency);
+    std::unordered_map<std::string, std::string> toMap() const;
+};
@@ -0,0 +1,52 @@
+#include "currency_scales.h"
+#include "../utils/decimal.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+namespace {
+
+std::string lowerCase(const std::string& symbol) {
+    std::string lower(symbol);
+    for (auto& c: lower) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return lower;
+}
+
+} // namespace
+
+CurrencyScales::CurrencyScales(const std::vector<CurrencyInfo>& currencies) {
+    for (const auto& currency: currencies) {
+        if (currency.currency.empty() || currency.decimals < 0) continue;
+        const auto decimals = static_cast<unsigned>(currency.decimals);
+        if (decimals > Decimal::MAX_SCALE) continue;
+        decimals_[lowerCase(currency.currency)] = decimals;
+    }
+}
+
+std::shared_ptr<const CurrencyScales> CurrencyScales::forApi(Api& api) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const CurrencyScales>> scales;
+
+    // The metadata are requested under the lock, so that concurrent first calls request them only once
+    const auto source = api.getSource();
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!source.empty()) {
+        auto it = scales.find(source);
+        if (it != scales.end()) return it->second;
+    }
+    auto loaded = std::make_shared<const CurrencyScales>(api.fetchCurrencies());
+    if (!source.empty()) scales[source] = loaded;
+    return loaded;
+}
+
+int CurrencyScales::decimals(const std::string& currency) const {
+    auto it = decimals_.find(lowerCase(currency));
+    return it == decimals_.end() ? -1 : static_cast<int>(it->second);
+}
+
+CurrencyScales::PairScale CurrencyScales::pair(const std::string& base, const std::string& counter) const {
+    PairScale scale;
+    scale.amount = static_cast<unsigned>(std::max(decimals(base), 0));
+    scale.price = std::max(scale.amount, static_cast<unsigned>(std::max(decimals(counter), 0)));
+    return scale;
+}
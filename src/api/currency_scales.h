@@ -0,0 +1,44 @@
+#pragma once
+
+#include "api.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Number of decimals of the currencies of an exchange, taken from its currency metadata (see
+ * Api::fetchCurrencies), from which the fixed-point scales of the prices and amounts of a pair are
+ * derived (see decimal.h). The metadata are requested once per source, and shared by all the objects
+ * of the process. Without metadata (e.g. if the request failed) all the scales are 0: the fixed-point
+ * values are still exact, as their scale grows with the decimals received (see candle_series.h).
+ */
+class CurrencyScales {
+
+public:
+    // Scales of the prices and of the amounts (e.g. the volumes) of a pair
+    struct PairScale {
+        unsigned price = 0;
+        unsigned amount = 0;
+    };
+
+    CurrencyScales() {}
+    explicit CurrencyScales(const std::vector<CurrencyInfo>& currencies);
+
+    // Scales of the currencies of the source of the Api (loaded on first use)
+    static std::shared_ptr<const CurrencyScales> forApi(Api& api);
+
+    bool empty() const {return decimals_.empty();}
+
+    // Decimals of a currency (the symbol is case insensitive), or -1 if the currency is unknown
+    int decimals(const std::string& currency) const;
+
+    // The amounts are in the base currency (e.g. BTC in BTC/USD), the prices in the counter currency:
+    // the prices can have more decimals than the counter currency (e.g. DOGE/USD prices have 5 decimals,
+    // USD has 2), so they take the decimals of the finer of the two currencies. Unknown currencies
+    // count as 0 decimals.
+    PairScale pair(const std::string& base, const std::string& counter) const;
+
+private:
+    std::unordered_map<std::string, unsigned> decimals_; // keyed by lower case symbol
+};
@@ -0,0 +1,288 @@
+#include "hedging_http_client.h"
+#include <condition_variable>
+#include <random>
+#include <utility>
+
+/*
+ * State of a request, shared by its attempts.
+ */
+struct HedgingHttpClient::Flight {
+    struct Attempt {
+        uint64_t id = 0;  // id in the AsyncHttpClient (0 until sent)
+        Clock::time_point sent;
+        bool hedge = false;
+        bool outstanding = true;
+    };
+
+    Endpoint endpoint;
+    Lane lane;
+    std::string url;
+    std::vector<std::string> headers;
+    int maxTimeSeconds = -1;
+    SinkFactory sinks;
+    Callback callback;
+    Policy policy;
+    Clock::time_point submitted = Clock::now();
+
+    std::mutex mutex; // guards the members below
+    std::vector<Attempt> attempts;
+    Deadline deadline; // set when the first attempt is admitted
+    size_t outstanding = 0;
+    size_t hedges = 0;
+    size_t retries = 0;
+    bool done = false;
+};
+
+HedgingHttpClient::HedgingHttpClient(AsyncHttpClient& client, RequestScheduler& scheduler): client_(client), scheduler_(scheduler) {
+    // The catalog is large and rarely requested: it is only retried
+    state(Endpoint::Catalog).policy.hedge = false;
+}
+
+// Never destroyed, like the client and the scheduler: their exit handlers complete the outstanding requests
+// through it
+HedgingHttpClient& HedgingHttpClient::shared() {
+    static HedgingHttpClient* client = new HedgingHttpClient(AsyncHttpClient::shared(), RequestScheduler::shared());
+    return *client;
+}
+
+void HedgingHttpClient::setPolicy(Endpoint endpoint, const Policy& policy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    state(endpoint).policy = policy;
+}
+
+HedgingHttpClient::Policy HedgingHttpClient::policy(Endpoint endpoint) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state(endpoint).policy;
+}
+
+void HedgingHttpClient::get(Endpoint endpoint, Lane lane, const std::string& url, const std::vector<std::string>& headers,
+                            int maxTimeSeconds, SinkFactory sinks, Callback callback) {
+    auto flight = std::make_shared<Flight>();
+    flight->endpoint = endpoint;
+    flight->lane = lane;
+    flight->url = url;
+    flight->headers = headers;
+    flight->maxTimeSeconds = maxTimeSeconds;
+    flight->sinks = std::move(sinks);
+    flight->callback = std::move(callback);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flight->policy = state(endpoint).policy;
+        ++state(endpoint).stats.requests;
+    }
+    launch(flight, false);
+}
+
+HttpResponse HedgingHttpClient::request(Endpoint endpoint, Lane lane, const std::string& url, const std::vector<std::string>& headers,
+                                        int maxTimeSeconds, SinkFactory sinks, size_t& attempt) {
+    std::mutex mutex;
+    std::condition_variable completed;
+    bool done = false;
+    HttpResponse result;
+    get(endpoint, lane, url, headers, maxTimeSeconds, std::move(sinks), [&](HttpResponse response, size_t winner) {
+        std::lock_guard<std::mutex> lock(mutex);
+        result = std::move(response);
+        attempt = winner;
+        done = true;
+        completed.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    completed.wait(lock, [&done]() {return done;});
+    return result;
+}
+
+void HedgingHttpClient::launch(const std::shared_ptr<Flight>& flight, bool hedge) {
+    scheduler_.submit(flight->endpoint, flight->lane, [this, flight, hedge](bool admitted) {
+        if (admitted) send(flight, hedge);
+        else cancelled(flight);
+    });
+}
+
+// An attempt was cancelled by the scheduler before being sent: the request fails unless another attempt is outstanding
+void HedgingHttpClient::cancelled(const std::shared_ptr<Flight>& flight) {
+    Callback callback;
+    size_t attempt;
+    {
+        std::lock_guard<std::mutex> lock(flight->mutex);
+        if (flight->done || flight->outstanding > 0) return;
+        flight->done = true;
+        attempt = flight->attempts.size();
+        callback = std::move(flight->callback);
+        flight->callback = nullptr;
+        flight->sinks = nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++state(flight->endpoint).stats.failures;
+    }
+    HttpResponse response;
+    response.error = "cancelled";
+    callback(std::move(response), attempt);
+}
+
+void HedgingHttpClient::send(const std::shared_ptr<Flight>& flight, bool hedge) {
+    size_t attempt;
+    HttpResponseParser::BodySink sink;
+    Deadline deadline;
+    {
+        std::lock_guard<std::mutex> lock(flight->mutex);
+        if (flight->done) return; // answered while the attempt was waiting for its admission
+        attempt = flight->attempts.size();
+        if (attempt == 0) flight->deadline = Deadline::in(flight->maxTimeSeconds);
+        deadline = flight->deadline;
+        flight->attempts.push_back(Flight::Attempt{0, Clock::now(), hedge, true});
+        ++flight->outstanding;
+        if (flight->sinks) sink = flight->sinks(attempt);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++state(flight->endpoint).stats.attempts;
+    }
+
+    uint64_t id = client_.get(flight->url, flight->headers, deadline, [this, flight, attempt](HttpResponse response) {
+        completed(flight, attempt, std::move(response));
+    }, std::move(sink));
+
+    bool hedgeLater;
+    {
+        std::lock_guard<std::mutex> lock(flight->mutex);
+        flight->attempts[attempt].id = id;
+        // The request may have been answered in the meantime by another attempt
+        if (flight->done && flight->attempts[attempt].outstanding) {
+            client_.cancel(id);
+            return;
+        }
+        hedgeLater = flight->policy.hedge && flight->hedges < flight->policy.maxHedges && !flight->done;
+    }
+    if (!hedgeLater) return;
+
+    client_.schedule(Clock::now() + hedgeDelay(flight->endpoint), [this, flight]() {
+        {
+            std::lock_guard<std::mutex> lock(flight->mutex);
+            if (flight->done || flight->hedges >= flight->policy.maxHedges || flight->outstanding == 0) return;
+            ++flight->hedges;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++state(flight->endpoint).stats.hedges;
+        }
+        launch(flight, true);
+    });
+}
+
+void HedgingHttpClient::completed(const std::shared_ptr<Flight>& flight, size_t attempt, HttpResponse response) {
+    auto now = Clock::now();
+    std::unique_lock<std::mutex> lock(flight->mutex);
+    auto& current = flight->attempts[attempt];
+    current.outstanding = false;
+    --flight->outstanding;
+    if (flight->done) return; // a cancelled loser, or an attempt completed after the winner
+
+    // Any response of the server wins (whatever its status); transport errors wait for the other attempts, or are retried
+    bool failed = !response.error.empty();
+    if (failed) {
+        if (flight->outstanding > 0) return;
+        if (flight->retries < flight->policy.maxRetries && !flight->deadline.expired()) {
+            auto delay = retryDelay(flight->policy, flight->retries);
+            if (flight->deadline.unlimited || now + delay < flight->deadline.at) {
+                ++flight->retries;
+                lock.unlock();
+                {
+                    std::lock_guard<std::mutex> stateLock(mutex_);
+                    ++state(flight->endpoint).stats.retries;
+                }
+                client_.schedule(now + delay, [this, flight]() {launch(flight, false);});
+                return;
+            }
+        }
+    }
+
+    // The request is answered (or failed for good): the other attempts are abandoned
+    flight->done = true;
+    std::vector<uint64_t> losers;
+    std::vector<Clock::duration> censored; // latencies of the abandoned attempts, at least as long as the time they waited
+    for (auto& other: flight->attempts) {
+        if (!other.outstanding) continue;
+        censored.push_back(now - other.sent);
+        // An attempt whose id is not known yet stays outstanding: send cancels it
+        if (other.id == 0) continue;
+        other.outstanding = false;
+        losers.push_back(other.id);
+    }
+    bool hedgeWon = current.hedge && !failed;
+    auto latency = now - current.sent;
+    auto callback = std::move(flight->callback);
+    flight->callback = nullptr;
+    flight->sinks = nullptr;
+    lock.unlock();
+
+    for (auto id: losers) client_.cancel(id);
+    if (!failed) recordAttempt(flight->endpoint, latency);
+    for (auto latency: censored) recordAttempt(flight->endpoint, latency);
+    {
+        std::lock_guard<std::mutex> stateLock(mutex_);
+        auto& endpoint = state(flight->endpoint);
+        endpoint.requests.record(now - flight->submitted);
+        if (hedgeWon) ++endpoint.stats.hedgeWins;
+        if (failed) ++endpoint.stats.failures;
+    }
+    callback(std::move(response), attempt);
+}
+
+Clock::duration HedgingHttpClient::hedgeDelay(Endpoint endpoint) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto& s = state(endpoint);
+    LatencyHistogram window(s.previous);
+    window.add(s.recent);
+    if (window.count() < MIN_SAMPLES) return s.policy.maxHedgeDelay;
+    auto threshold = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(window.percentileMs(s.policy.hedgePercentile)));
+    return std::clamp<Clock::duration>(threshold, s.policy.minHedgeDelay, s.policy.maxHedgeDelay);
+}
+
+// Full jitter: a uniform wait between 0 and the exponential backoff
+Clock::duration HedgingHttpClient::retryDelay(const Policy& policy, size_t retry) const {
+    thread_local std::mt19937_64 random{std::random_device{}()};
+    auto limit = std::min<Clock::duration>(policy.retryBackoff * (1LL << std::min<size_t>(retry, 20)), policy.maxRetryBackoff);
+    std::uniform_int_distribution<Clock::rep> wait(0, limit.count());
+    return Clock::duration(wait(random));
+}
+
+void HedgingHttpClient::recordAttempt(Endpoint endpoint, Clock::duration latency) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& s = state(endpoint);
+    s.attempts.record(latency);
+    s.recent.record(latency);
+    if (s.recent.count() >= WINDOW) {
+        s.previous = s.recent;
+        s.recent.reset();
+    }
+}
+
+HedgingHttpClient::Stats HedgingHttpClient::stats(Endpoint endpoint) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state(endpoint).stats;
+}
+
+LatencyHistogram HedgingHttpClient::attemptLatencies(Endpoint endpoint) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state(endpoint).attempts;
+}
+
+LatencyHistogram HedgingHttpClient::requestLatencies(Endpoint endpoint) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return state(endpoint).requests;
+}
+
+std::string HedgingHttpClient::report() const {
+    static const char* names[] = {"ticker", "ohlc", "catalog"};
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string report;
+    for (size_t i = 0; i < endpoints_.size(); ++i) {
+        const auto& s = endpoints_[i];
+        if (s.stats.requests == 0) continue;
+        report += std::string(names[i]) + ": requests " + s.requests.summary() + " | attempts " + s.attempts.summary() +
+                  " | hedges " + std::to_string(s.stats.hedges) + " (won " + std::to_string(s.stats.hedgeWins) + ")" +
+                  " retries " + std::to_string(s.stats.retries) + " failures " + std::to_string(s.stats.failures) + "\n";
+    }
+    return report;
+}
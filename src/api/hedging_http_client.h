@@ -0,0 +1,114 @@
+#pragma once
+
+#include "async_http_client.h"
+#include "latency_histogram.h"
+#include "request_scheduler.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Layer over the AsyncHttpClient cutting the tail latency of the requests. If a request has not
+ * completed when its latency reaches a high percentile of the recent latencies of its endpoint
+ * class, a duplicate (hedge) is sent, on another connection: the first response wins, and the
+ * other attempts are cancelled. The requests failing because of transport errors (e.g. refused or
+ * reset connections) are sent again after a random (jittered) backoff, a bounded number of times
+ * and only while the deadline allows it. Every attempt is admitted by the RequestScheduler, so
+ * that hedges and retries are counted in the rate budgets. The policy is set per endpoint class;
+ * the latencies of the attempts and of the whole requests are recorded in per-endpoint histograms.
+ */
+class HedgingHttpClient {
+
+public:
+    using Endpoint = RequestScheduler::EndpointClass;
+    using Lane = RequestScheduler::Lane;
+    using SinkFactory = std::function<HttpResponseParser::BodySink(size_t attempt)>; // a sink for each attempt
+    using Callback = std::function<void(HttpResponse, size_t attempt)>;           // response of the winning attempt
+
+    struct Policy {
+        bool hedge = true;
+        double hedgePercentile = 0.95;                       // attempts slower than this percentile are hedged
+        std::chrono::milliseconds minHedgeDelay{20};
+        std::chrono::milliseconds maxHedgeDelay{2000};       // also used until enough latencies are recorded
+        size_t maxHedges = 1;                                // duplicates sent for the same request
+        size_t maxRetries = 2;                               // attempts sent again after a transport error
+        std::chrono::milliseconds retryBackoff{100};         // the first retry waits up to this time, doubled at every retry
+        std::chrono::milliseconds maxRetryBackoff{2000};
+    };
+
+    struct Stats {
+        uint64_t requests = 0;   // requests submitted
+        uint64_t attempts = 0;   // attempts sent (requests, hedges and retries)
+        uint64_t hedges = 0;     // hedges sent
+        uint64_t hedgeWins = 0;  // requests answered by a hedge
+        uint64_t retries = 0;    // retries sent
+        uint64_t failures = 0;   // requests failed after all their attempts
+    };
+
+    HedgingHttpClient(AsyncHttpClient& client, RequestScheduler& scheduler);
+    HedgingHttpClient(const HedgingHttpClient&) = delete;
+    HedgingHttpClient& operator=(const HedgingHttpClient&) = delete;
+
+    // The client shared by the whole process, over the shared AsyncHttpClient and RequestScheduler (never destroyed)
+    static HedgingHttpClient& shared();
+
+    void setPolicy(Endpoint endpoint, const Policy& policy);
+    Policy policy(Endpoint endpoint) const;
+
+    // Submits a GET request: the callback is invoked exactly once, on the event loop thread, with the
+    // response of the first attempt answered by the server (or with the error of the last attempt).
+    // Each attempt streams its body into its own sink; the callback tells which attempt won. The request
+    // (hedges and retries included) must complete within maxTimeSeconds from the admission of its first
+    // attempt (no limit if negative).
+    void get(Endpoint endpoint, Lane lane, const std::string& url, const std::vector<std::string>& headers,
+             int maxTimeSeconds, SinkFactory sinks, Callback callback);
+
+    // Blocking version of get: returns the response and the winning attempt
+    HttpResponse request(Endpoint endpoint, Lane lane, const std::string& url, const std::vector<std::string>& headers,
+                         int maxTimeSeconds, SinkFactory sinks, size_t& attempt);
+
+    Stats stats(Endpoint endpoint) const;
+
+    // Latencies of the single attempts (from their admission) and of the whole requests (from their submission)
+    LatencyHistogram attemptLatencies(Endpoint endpoint) const;
+    LatencyHistogram requestLatencies(Endpoint endpoint) const;
+
+    // Latency histograms and counters of all the endpoint classes, one line each
+    std::string report() const;
+
+private:
+    struct Flight;
+
+    struct EndpointState {
+        Policy policy;
+        Stats stats;
+        LatencyHistogram attempts;
+        LatencyHistogram requests;
+        // The hedging threshold follows the recent latencies: the window is replaced every WINDOW attempts
+        LatencyHistogram recent;
+        LatencyHistogram previous;
+    };
+
+    static constexpr uint64_t WINDOW = 512;
+    static constexpr uint64_t MIN_SAMPLES = 20; // latencies needed before the threshold is adaptive
+
+    AsyncHttpClient& client_;
+    RequestScheduler& scheduler_;
+    mutable std::mutex mutex_; // guards the endpoint states
+    std::array<EndpointState, RequestScheduler::ENDPOINT_CLASSES> endpoints_;
+
+    void launch(const std::shared_ptr<Flight>& flight, bool hedge);
+    void send(const std::shared_ptr<Flight>& flight, bool hedge);
+    void completed(const std::shared_ptr<Flight>& flight, size_t attempt, HttpResponse response);
+    void cancelled(const std::shared_ptr<Flight>& flight);
+    Clock::duration hedgeDelay(Endpoint endpoint);
+    Clock::duration retryDelay(const Policy& policy, size_t retry) const;
+    void recordAttempt(Endpoint endpoint, Clock::duration latency);
+    EndpointState& state(Endpoint endpoint) {return endpoints_[static_cast<size_t>(endpoint)];}
+    const EndpointState& state(Endpoint endpoint) const {return endpoints_[static_cast<size_t>(endpoint)];}
+};
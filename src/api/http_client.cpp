@@ -0,0 +1,576 @@
+#include "http_client.h"
+#include "connection_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef CMDF_WITH_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+namespace {
+
+std::string toLower(std::string s) {
+    for (auto& c: s) c = std::tolower(static_cast<unsigned char>(c));
+    return s;
+}
+
+// Parses a whole header value or chunk size as an unsigned number in the base given; false if it holds
+// anything else (a sign, spaces, other characters) or does not fit
+bool parseSize(const std::string& text, size_t end, int base, size_t& out) {
+    const char* first = text.data();
+    const char* last = first + std::min(end, text.size());
+    if (first == last) return false;
+    auto result = std::from_chars(first, last, out, base);
+    return result.ec == std::errc() && result.ptr == last;
+}
+
+std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+#ifdef CMDF_WITH_OPENSSL
+// The TLS context is shared by all connections of the process
+SSL_CTX* tlsContext() {
+    static SSL_CTX* ctx = []() {
+        // A peer closing the connection while OpenSSL writes to the socket would otherwise kill the process
+        std::signal(SIGPIPE, SIG_IGN);
+        SSL_CTX* c = SSL_CTX_new(TLS_client_method());
+        if (c != nullptr) {
+            SSL_CTX_set_default_verify_paths(c);
+            SSL_CTX_set_verify(c, SSL_VERIFY_PEER, nullptr);
+            SSL_CTX_set_mode(c, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        }
+        return c;
+    }();
+    return ctx;
+}
+#endif
+
+} // namespace
+
+int Deadline::remainingMs() const {
+    if (unlimited) return -1;
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(at - Clock::now()).count();
+    return left > 0 ? static_cast<int>(left) : 0;
+}
+
+bool Url::parse(const std::string& url, Url& out) {
+    size_t schemeEnd = url.find("://");
+    if (schemeEnd == std::string::npos) return false;
+    out.scheme = toLower(url.substr(0, schemeEnd));
+    if (out.scheme != "http" && out.scheme != "https") return false;
+
+    size_t hostBegin = schemeEnd + 3;
+    size_t targetBegin = url.find_first_of("/?", hostBegin);
+    std::string authority = url.substr(hostBegin, targetBegin == std::string::npos ? std::string::npos : targetBegin - hostBegin);
+    out.target = targetBegin == std::string::npos ? "/" : url.substr(targetBegin);
+    if (out.target.front() == '?') out.target = "/" + out.target;
+
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+        out.host = authority.substr(0, colon);
+        out.port = authority.substr(colon + 1);
+    } else {
+        out.host = authority;
+        out.port = out.scheme == "https" ? "443" : "80";
+    }
+    if (out.host.size() > 1 && out.host.front() == '[' && out.host.back() == ']') {
+        out.host = out.host.substr(1, out.host.size() - 2);
+    }
+    return !out.host.empty() && !out.port.empty();
+}
+
+/************************
+*      Connection       *
+*************************/
+
+std::unique_ptr<Connection> Connection::open(const Url& url, const Deadline& deadline, std::string& error) {
+    auto connection = openNonBlocking(url, error);
+    if (!connection) return nullptr;
+    while (true) {
+        auto status = connection->continueOpen(error);
+        if (status == IoStatus::Ok) return connection;
+        if (status == IoStatus::Error || status == IoStatus::Closed) return nullptr;
+        if (!connection->wait(status, deadline)) {
+            error = "timeout";
+            return nullptr;
+        }
+    }
+}
+
+bool Connection::resolve(const Url& url, std::vector<Address>& addresses, std::string& error) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* resolved = nullptr;
+    int rc = getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &resolved);
+    if (rc != 0) {
+        error = "cannot resolve " + url.host + ": " + gai_strerror(rc);
+        return false;
+    }
+    addresses.clear();
+    for (addrinfo* a = resolved; a != nullptr; a = a->ai_next) {
+        addresses.push_back(Address{a->ai_family, a->ai_protocol, std::string(reinterpret_cast<const char*>(a->ai_addr), a->ai_addrlen)});
+    }
+    freeaddrinfo(resolved);
+    return true;
+}
+
+std::unique_ptr<Connection> Connection::openNonBlocking(const Url& url, std::string& error) {
+    std::vector<Address> addresses;
+    if (!resolve(url, addresses, error)) return nullptr;
+    return openNonBlocking(url, addresses, error);
+}
+
+std::unique_ptr<Connection> Connection::openNonBlocking(const Url& url, const std::vector<Address>& addresses, std::string& error) {
+    // The first address whose connection does not fail immediately is used
+    int fd = -1;
+    for (const auto& a: addresses) {
+        fd = socket(a.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, a.protocol);
+        if (fd < 0) continue;
+        const auto* address = reinterpret_cast<const sockaddr*>(a.sockaddr.data());
+        if (connect(fd, address, static_cast<socklen_t>(a.sockaddr.size())) == 0 || errno == EINPROGRESS) break;
+        ::close(fd);
+        fd = -1;
+    }
+
+    if (fd < 0) {
+        error = "cannot connect to " + url.host + ":" + url.port;
+        return nullptr;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return std::unique_ptr<Connection>(new Connection(fd, url.hostKey(), url.scheme == "https" ? url.host : ""));
+}
+
+Connection::IoStatus Connection::continueOpen(std::string& error) {
+    if (phase_ == Phase::Connecting) {
+        pollfd p{fd_, POLLOUT, 0};
+        if (poll(&p, 1, 0) == 0) return IoStatus::WantWrite;
+        int soError = 0;
+        socklen_t len = sizeof(soError);
+        if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &soError, &len) != 0 || soError != 0) {
+            error = std::string("cannot connect: ") + std::strerror(soError);
+            return IoStatus::Error;
+        }
+        phase_ = tlsHost_.empty() ? Phase::Open : Phase::Handshaking;
+    }
+    if (phase_ == Phase::Handshaking) {
+        auto status = handshake(error);
+        if (status != IoStatus::Ok) return status;
+        phase_ = Phase::Open;
+    }
+    return IoStatus::Ok;
+}
+
+Connection::Connection(int fd, std::string hostKey, std::string tlsHost):
+    fd_(fd), hostKey_(std::move(hostKey)), tlsHost_(std::move(tlsHost)) {}
+
+Inflater& Connection::inflater() {
+    if (!inflater_) inflater_ = std::make_unique<Inflater>();
+    return *inflater_;
+}
+
+Connection::~Connection() {
+#ifdef CMDF_WITH_OPENSSL
+    if (ssl_ != nullptr) {
+        SSL_shutdown(ssl_);
+        SSL_free(ssl_);
+    }
+#endif
+    if (fd_ >= 0) ::close(fd_);
+}
+
+// Performs a step of the TLS handshake
+Connection::IoStatus Connection::handshake(std::string& error) {
+#ifdef CMDF_WITH_OPENSSL
+    if (ssl_ == nullptr) {
+        SSL_CTX* ctx = tlsContext();
+        if (ctx == nullptr || (ssl_ = SSL_new(ctx)) == nullptr) {
+            error = "cannot create the TLS session";
+            return IoStatus::Error;
+        }
+        SSL_set_fd(ssl_, fd_);
+        SSL_set_tlsext_host_name(ssl_, tlsHost_.c_str());
+        SSL_set1_host(ssl_, tlsHost_.c_str());
+    }
+
+    int rc = SSL_connect(ssl_);
+    if (rc == 1) return IoStatus::Ok;
+    int sslError = SSL_get_error(ssl_, rc);
+    if (sslError == SSL_ERROR_WANT_READ) return IoStatus::WantRead;
+    if (sslError == SSL_ERROR_WANT_WRITE) return IoStatus::WantWrite;
+    char reason[256];
+    ERR_error_string_n(ERR_get_error(), reason, sizeof(reason));
+    error = std::string("TLS handshake failed: ") + reason;
+    return IoStatus::Error;
+#else
+    error = "https is not supported (built without OpenSSL)";
+    return IoStatus::Error;
+#endif
+}
+
+Connection::IoStatus Connection::read(char* buffer, size_t size, size_t& bytesRead) {
+    bytesRead = 0;
+#ifdef CMDF_WITH_OPENSSL
+    if (ssl_ != nullptr) {
+        int rc = SSL_read(ssl_, buffer, static_cast<int>(size));
+        if (rc > 0) {
+            bytesRead = static_cast<size_t>(rc);
+            return IoStatus::Ok;
+        }
+        switch (SSL_get_error(ssl_, rc)) {
+            case SSL_ERROR_WANT_READ: return IoStatus::WantRead;
+            case SSL_ERROR_WANT_WRITE: return IoStatus::WantWrite;
+            case SSL_ERROR_ZERO_RETURN: return IoStatus::Closed;
+            default: return IoStatus::Error;
+        }
+    }
+#endif
+    ssize_t rc = ::recv(fd_, buffer, size, 0);
+    if (rc > 0) {
+        bytesRead = static_cast<size_t>(rc);
+        return IoStatus::Ok;
+    }
+    if (rc == 0) return IoStatus::Closed;
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return IoStatus::WantRead;
+    return IoStatus::Error;
+}
+
+Connection::IoStatus Connection::write(const char* buffer, size_t size, size_t& bytesWritten) {
+    bytesWritten = 0;
+#ifdef CMDF_WITH_OPENSSL
+    if (ssl_ != nullptr) {
+        int rc = SSL_write(ssl_, buffer, static_cast<int>(size));
+        if (rc > 0) {
+            bytesWritten = static_cast<size_t>(rc);
+            return IoStatus::Ok;
+        }
+        switch (SSL_get_error(ssl_, rc)) {
+            case SSL_ERROR_WANT_READ: return IoStatus::WantRead;
+            case SSL_ERROR_WANT_WRITE: return IoStatus::WantWrite;
+            case SSL_ERROR_ZERO_RETURN: return IoStatus::Closed;
+            default: return IoStatus::Error;
+        }
+    }
+#endif
+    ssize_t rc = ::send(fd_, buffer, size, MSG_NOSIGNAL);
+    if (rc >= 0) {
+        bytesWritten = static_cast<size_t>(rc);
+        return IoStatus::Ok;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return IoStatus::WantWrite;
+    return errno == EPIPE || errno == ECONNRESET ? IoStatus::Closed : IoStatus::Error;
+}
+
+bool Connection::wait(IoStatus want, const Deadline& deadline) const {
+    pollfd p{fd_, static_cast<short>(want == IoStatus::WantWrite ? POLLOUT : POLLIN), 0};
+    while (true) {
+        int rc = poll(&p, 1, deadline.remainingMs());
+        if (rc > 0) return true;
+        if (rc == 0) return false;
+        if (errno != EINTR) return false;
+    }
+}
+
+bool Connection::writeAll(const std::string& data, const Deadline& deadline) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        size_t n = 0;
+        auto status = write(data.data() + offset, data.size() - offset, n);
+        if (status == IoStatus::Ok) {
+            offset += n;
+            continue;
+        }
+        if (status == IoStatus::Closed || status == IoStatus::Error) return false;
+        if (!wait(status, deadline)) return false;
+    }
+    return true;
+}
+
+bool Connection::readSome(char* buffer, size_t size, size_t& bytesRead, const Deadline& deadline) {
+    while (true) {
+        auto status = read(buffer, size, bytesRead);
+        if (status == IoStatus::Ok) return true;
+        if (status == IoStatus::Closed || status == IoStatus::Error) return false;
+        if (!wait(status, deadline)) return false;
+    }
+}
+
+bool Connection::isReusable() const {
+    if (!pending.empty()) return false;
+    pollfd p{fd_, POLLIN, 0};
+    if (poll(&p, 1, 0) == 0) return true; // nothing to read: the peer did not close the connection
+    if (p.revents & (POLLERR | POLLHUP | POLLNVAL)) return false;
+#ifdef CMDF_WITH_OPENSSL
+    if (ssl_ != nullptr) {
+        // Post-handshake messages (e.g. session tickets) make the socket readable without any application data
+        char probe;
+        int rc = SSL_peek(ssl_, &probe, 1);
+        return rc <= 0 && SSL_get_error(ssl_, rc) == SSL_ERROR_WANT_READ;
+    }
+#endif
+    return false;
+}
+
+/************************
+*      HttpClient       *
+*************************/
+
+bool HttpClient::supports(const std::string& url) {
+    Url parsed;
+    if (!Url::parse(url, parsed)) return false;
+#ifdef CMDF_WITH_OPENSSL
+    return true;
+#else
+    return parsed.scheme == "http";
+#endif
+}
+
+HttpClient::HttpClient(): pool_(&ConnectionPool::shared()) {}
+
+std::string HttpClient::formatGet(const Url& url, const std::vector<std::string>& headers) {
+    std::string request = "GET " + url.target + " HTTP/1.1\r\nHost: " + url.host;
+    if (url.port != (url.scheme == "https" ? "443" : "80")) request += ":" + url.port;
+    request += "\r\n";
+    for (const auto& h: headers) request += h + "\r\n";
+    request += "Accept: */*\r\n";
+    if (Inflater::supported()) request += "Accept-Encoding: gzip, deflate\r\n";
+    request += "Connection: keep-alive\r\n\r\n";
+    return request;
+}
+
+HttpResponse HttpClient::get(const std::string& url, const std::vector<std::string>& headers, const Deadline& deadline,
+                             const HttpResponseParser::BodySink& sink) {
+    HttpResponse response;
+    Url parsed;
+    if (!Url::parse(url, parsed)) {
+        response.error = "invalid url: " + url;
+        return response;
+    }
+
+    std::string request = formatGet(parsed, headers);
+
+    // A reused connection may have been closed by the server in the meantime:
+    // in that case the request is sent again on a new connection
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool reused = false;
+        std::string error;
+        auto connection = pool_->checkout(parsed, deadline, reused, error);
+        if (!connection) {
+            response.error = error;
+            return response;
+        }
+
+        response = HttpResponse{};
+        bool keepAlive = false;
+        bool receivedAny = false;
+        if (connection->writeAll(request, deadline)) {
+            if (readResponse(*connection, response, keepAlive, deadline, sink)) {
+                pool_->checkin(std::move(connection), keepAlive);
+                return response;
+            }
+            receivedAny = response.status != 0;
+        } else {
+            response.error = deadline.expired() ? "timeout" : "write error";
+        }
+        pool_->checkin(std::move(connection), false);
+        if (!reused || receivedAny || deadline.expired()) return response;
+    }
+    return response;
+}
+
+bool HttpClient::readResponse(Connection& connection, HttpResponse& response, bool& keepAlive, const Deadline& deadline,
+                              const HttpResponseParser::BodySink& sink) {
+    HttpResponseParser parser(response, sink);
+    parser.setInflater(&connection.inflater());
+    std::string& pending = connection.pending;
+
+    // Bytes received together with the previous response come first
+    if (!pending.empty()) pending.erase(0, parser.feed(pending.data(), pending.size()));
+
+    char chunk[16384];
+    while (!parser.done() && !parser.failed()) {
+        size_t n = 0;
+        auto status = connection.read(chunk, sizeof(chunk), n);
+        if (status == Connection::IoStatus::Ok) {
+            size_t consumed = parser.feed(chunk, n);
+            if (consumed < n) pending.append(chunk + consumed, n - consumed);
+        } else if (status == Connection::IoStatus::Closed) {
+            parser.finish();
+        } else if (status == Connection::IoStatus::Error) {
+            response.error = "read error";
+            return false;
+        } else if (!connection.wait(status, deadline)) {
+            response.error = "timeout";
+            return false;
+        }
+    }
+    keepAlive = parser.keepAlive();
+    return parser.done();
+}
+
+/************************
+*  HttpResponseParser   *
+*************************/
+
+void HttpResponseParser::emit(const char* data, size_t size) {
+    response_.bodyBytes += size;
+    if (!decoding_) return deliver(data, size);
+    if (!inflater_->decode(data, size, [this](const char* decoded, size_t n) {deliver(decoded, n);})) {
+        fail("corrupted " + response_.headers["content-encoding"] + " body");
+    }
+}
+
+void HttpResponseParser::deliver(const char* data, size_t size) {
+    if (sink_) sink_(data, size);
+    else response_.body.append(data, size);
+}
+
+void HttpResponseParser::fail(const std::string& error) {
+    state_ = State::Error;
+    keepAlive_ = false;
+    if (response_.error.empty()) response_.error = error;
+}
+
+size_t HttpResponseParser::feed(const char* data, size_t size) {
+    size_t pos = 0;
+    while (pos < size && state_ != State::Done && state_ != State::Error) {
+        switch (state_) {
+            case State::Body:
+            case State::ChunkData:
+            case State::UntilClose: {
+                size_t take = state_ == State::UntilClose ? size - pos : std::min(remaining_, size - pos);
+                emit(data + pos, take);
+                pos += take;
+                if (state_ == State::Error || state_ == State::UntilClose) break;
+                remaining_ -= take;
+                if (remaining_ == 0 && state_ == State::Body) complete();
+                else if (remaining_ == 0) state_ = State::ChunkEnd;
+                break;
+            }
+            default: {
+                // Line-based states: the line is accumulated until CRLF
+                const char* end = static_cast<const char*>(std::memchr(data + pos, '\n', size - pos));
+                size_t take = end == nullptr ? size - pos : end - (data + pos) + 1;
+                line_.append(data + pos, take);
+                pos += take;
+                if (end == nullptr) {
+                    if (line_.size() > 65536) fail("malformed response");
+                    break;
+                }
+                line_.pop_back();
+                if (!line_.empty() && line_.back() == '\r') line_.pop_back();
+                onLine();
+                line_.clear();
+            }
+        }
+    }
+    return pos;
+}
+
+void HttpResponseParser::onLine() {
+    switch (state_) {
+        case State::StatusLine:
+            if (line_.compare(0, 5, "HTTP/") != 0 || line_.size() < 12) return fail("malformed response");
+            http11_ = line_.compare(0, 8, "HTTP/1.1") == 0;
+            response_.status = std::atoi(line_.c_str() + 9);
+            response_.headers.clear();
+            state_ = State::Headers;
+            return;
+        case State::Headers: {
+            if (line_.empty()) return onHeadersEnd();
+            size_t colon = line_.find(':');
+            if (colon != std::string::npos) response_.headers[toLower(line_.substr(0, colon))] = trim(line_.substr(colon + 1));
+            return;
+        }
+        case State::ChunkSize: {
+            // The size may be followed by extensions (";name=value"), with whitespace before them
+            size_t end = std::min(line_.find(';'), line_.size());
+            while (end > 0 && (line_[end - 1] == ' ' || line_[end - 1] == '\t')) --end;
+            if (!parseSize(line_, end, 16, remaining_)) return fail("invalid chunk size");
+            state_ = remaining_ == 0 ? State::Trailers : State::ChunkData;
+            return;
+        }
+        case State::ChunkEnd:
+            state_ = State::ChunkSize;
+            return;
+        case State::Trailers:
+            if (line_.empty()) complete();
+            return;
+        default:
+            return;
+    }
+}
+
+void HttpResponseParser::onHeadersEnd() {
+    // Interim 1xx responses are skipped
+    if (response_.status >= 100 && response_.status < 200) {
+        state_ = State::StatusLine;
+        return;
+    }
+
+    auto header = [this](const std::string& name) {
+        auto it = response_.headers.find(name);
+        return it == response_.headers.end() ? std::string() : toLower(it->second);
+    };
+    auto connectionHeader = header("connection");
+    keepAlive_ = http11_ ? connectionHeader.find("close") == std::string::npos
+                         : connectionHeader.find("keep-alive") != std::string::npos;
+
+    // Compressed bodies are decoded while they are received
+    auto encoding = header("content-encoding");
+    decoding_ = false;
+    if (!encoding.empty() && encoding != "identity") {
+        bool gzip = encoding == "gzip" || encoding == "x-gzip";
+        if ((!gzip && encoding != "deflate") || inflater_ == nullptr ||
+            !inflater_->begin(gzip ? Inflater::Encoding::Gzip : Inflater::Encoding::Deflate)) {
+            return fail("unsupported content encoding: " + encoding);
+        }
+        decoding_ = true;
+    }
+
+    if (response_.status == 204 || response_.status == 304) {
+        state_ = State::Done;
+    } else if (header("transfer-encoding").find("chunked") != std::string::npos) {
+        state_ = State::ChunkSize;
+    } else if (!header("content-length").empty()) {
+        if (!parseSize(header("content-length"), std::string::npos, 10, remaining_)) return fail("invalid content length");
+        // The length announced is not trusted for the allocation: the body grows past 1 MB as it is received
+        if (!sink_ && !decoding_) response_.body.reserve(std::min<size_t>(remaining_, 1 << 20));
+        if (remaining_ == 0) complete();
+        else state_ = State::Body;
+    } else {
+        // No framing information: the body ends when the server closes the connection
+        keepAlive_ = false;
+        state_ = State::UntilClose;
+    }
+}
+
+void HttpResponseParser::complete() {
+    // A compressed body must end with the end of its compressed stream (an empty body is left as it is)
+    if (decoding_ && response_.bodyBytes > 0 && !inflater_->finished()) return fail("truncated " + response_.headers["content-encoding"] + " body");
+    state_ = State::Done;
+}
+
+void HttpResponseParser::finish() {
+    if (state_ == State::UntilClose) complete();
+    else if (state_ != State::Done) fail("connection closed by peer");
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "inflater.h"
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ssl_st; // OpenSSL session (SSL), only used when built with OpenSSL
+class ConnectionPool;
+
+using Clock = std::chrono::steady_clock;
+
+/*
+ * Point in time after which a request is abandoned. A default constructed deadline never expires
+ * (it corresponds to a max connection time of -1).
+ */
+struct Deadline {
+    bool unlimited = true;
+    Clock::time_point at{};
+
+    static Deadline in(int seconds) {
+        Deadline d;
+        if (seconds < 0) return d;
+        d.unlimited = false;
+        d.at = Clock::now() + std::chrono::seconds(seconds);
+        return d;
+    }
+
+    bool expired() const {return !unlimited && Clock::now() >= at;}
+
+    // Milliseconds left before the deadline (-1 if unlimited), as expected by poll()
+    int remainingMs() const;
+};
+
+/*
+ * Components of an http(s) url. The target is the path plus the query string.
+ */
+struct Url {
+    std::string scheme;
+    std::string host;
+    std::string port;
+    std::string target;
+
+    // Returns false if the url is not a valid http or https url
+    static bool parse(const std::string& url, Url& out);
+
+    // Identifies the remote end point, e.g. "https://www.bitstamp.net:443"
+    std::string hostKey() const {return scheme + "://" + host + ":" + port;}
+};
+
+/*
+ * Result of an http request. When the request fails before a response is received,
+ * status is 0 and error contains the reason of the failure.
+ */
+struct HttpResponse {
+    int status = 0;
+    std::unordered_map<std::string, std::string> headers; // header names are lower case
+    std::string body;
+    std::string error;
+    size_t bodyBytes = 0; // size of the body as received, before decoding its content encoding
+
+    bool ok() const {return status != 0 && error.empty();}
+};
+
+/*
+ * Incremental (push) parser of an HTTP/1.1 response. Bytes are fed as they are received from
+ * the socket; the body is passed to the sink (or appended to the response body if there is no
+ * sink) as soon as it is decoded, from both the transfer encoding (chunked) and the content
+ * encoding (gzip, deflate). Used by both the blocking and the asynchronous clients.
+ */
+class HttpResponseParser {
+
+public:
+    using BodySink = std::function<void(const char*, size_t)>;
+
+    explicit HttpResponseParser(HttpResponse& response, BodySink sink = nullptr):
+        response_(response), sink_(std::move(sink)) {}
+
+    // Consumes the bytes up to the end of the response; returns the number of consumed bytes
+    size_t feed(const char* data, size_t size);
+
+    // Decoder of the compressed bodies; without it, compressed bodies are rejected
+    void setInflater(Inflater* inflater) {inflater_ = inflater;}
+
+    // Notifies that the peer closed the connection: this ends the bodies delimited by the
+    // closing of the connection, and is an error otherwise
+    void finish();
+
+    bool done() const {return state_ == State::Done;}
+    bool failed() const {return state_ == State::Error;}
+
+    // True if the connection can carry another request once the response is complete
+    bool keepAlive() const {return keepAlive_;}
+
+private:
+    enum class State {StatusLine, Headers, Body, ChunkSize, ChunkData, ChunkEnd, Trailers, UntilClose, Done, Error};
+
+    HttpResponse& response_;
+    BodySink sink_;
+    Inflater* inflater_ = nullptr;
+    bool decoding_ = false;
+    State state_ = State::StatusLine;
+    std::string line_;
+    size_t remaining_ = 0;
+    bool keepAlive_ = false;
+    bool http11_ = false;
+
+    void emit(const char* data, size_t size);    // passes a part of the body, as received
+    void deliver(const char* data, size_t size); // passes a part of the decoded body
+    void fail(const std::string& error);
+    void onLine(); // processes a complete line of the response head (or of the chunked framing)
+    void onHeadersEnd();
+    void complete(); // ends the response once its body has been received
+};
+
+/*
+ * A connected socket to a remote host, optionally wrapped in a TLS session.
+ * The socket is non-blocking: the wait method blocks until the socket is ready
+ * or the deadline expires.
+ */
+class Connection {
+
+public:
+    enum class IoStatus {Ok, WantRead, WantWrite, Closed, Error};
+
+    // Address of a host, as resolved by getaddrinfo (sockaddr holds the bytes of the socket address)
+    struct Address {
+        int family = 0;
+        int protocol = 0;
+        std::string sockaddr;
+    };
+
+    // Opens a new connection to the host of the url; returns nullptr (and sets error) on failure
+    static std::unique_ptr<Connection> open(const Url& url, const Deadline& deadline, std::string& error);
+
+    // Resolves the host of the url (blocking); returns false (and sets error) if it cannot be resolved
+    static bool resolve(const Url& url, std::vector<Address>& addresses, std::string& error);
+
+    // Starts opening a connection to one of the addresses of the host without blocking: continueOpen must
+    // be called (when the socket is ready for the returned IoStatus) until it returns Ok. Returns nullptr on
+    // immediate failure. The second version resolves the host first, on the calling thread.
+    static std::unique_ptr<Connection> openNonBlocking(const Url& url, const std::vector<Address>& addresses, std::string& error);
+    static std::unique_ptr<Connection> openNonBlocking(const Url& url, std::string& error);
+    IoStatus continueOpen(std::string& error);
+
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+    ~Connection();
+
+    // Non-blocking read and write; the number of transferred bytes is stored in the last argument
+    IoStatus read(char* buffer, size_t size, size_t& bytesRead);
+    IoStatus write(const char* buffer, size_t size, size_t& bytesWritten);
+
+    // Blocking helpers built on top of read/write; they return false on error,
+    // on closed connection or when the deadline expires
+    bool writeAll(const std::string& data, const Deadline& deadline);
+    bool readSome(char* buffer, size_t size, size_t& bytesRead, const Deadline& deadline);
+
+    // Waits until the socket can be read (or written); returns false on timeout
+    bool wait(IoStatus want, const Deadline& deadline) const;
+
+    // Returns false if the peer closed the connection while it was idle
+    bool isReusable() const;
+
+    int fd() const {return fd_;}
+    const std::string& hostKey() const {return hostKey_;}
+
+    // Bytes already received from the socket, but not yet consumed by a response parser
+    std::string pending;
+
+    // Decoder of the compressed bodies, reused by all the responses of the connection
+    Inflater& inflater();
+
+private:
+    enum class Phase {Connecting, Handshaking, Open};
+
+    Connection(int fd, std::string hostKey, std::string tlsHost);
+
+    int fd_ = -1;
+    std::string hostKey_;
+    std::string tlsHost_; // empty for plain http connections
+    Phase phase_ = Phase::Connecting;
+    ssl_st* ssl_ = nullptr;
+    std::unique_ptr<Inflater> inflater_;
+
+    IoStatus handshake(std::string& error);
+};
+
+/*
+ * Minimal HTTP/1.1 client. Connections are kept alive in a ConnectionPool (by default, the
+ * pool shared by the whole process) and reused for subsequent requests to the same host;
+ * responses can be delimited by Content-Length, by chunked transfer encoding, or by the
+ * closing of the connection. Each request is bound to a deadline.
+ * The class is thread-safe: concurrent requests use different connections.
+ */
+class HttpClient {
+
+public:
+    HttpClient();
+    explicit HttpClient(ConnectionPool& pool): pool_(&pool) {}
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    // Performs a GET request; headers are full header lines, e.g. "User-Agent: Mozilla/5.0".
+    // If a sink is given, the body is passed to it while it is received, instead of being stored in the response
+    HttpResponse get(const std::string& url, const std::vector<std::string>& headers, const Deadline& deadline,
+                     const HttpResponseParser::BodySink& sink = nullptr);
+
+    // Returns true if the scheme of the url can be handled by the client
+    static bool supports(const std::string& url);
+
+    // Formats the head of a keep-alive GET request
+    static std::string formatGet(const Url& url, const std::vector<std::string>& headers);
+
+    ConnectionPool& pool() const {return *pool_;}
+
+private:
+    ConnectionPool* pool_;
+
+    // Reads the response to a request sent on the connection. keepAlive is set to
+    // false if the connection cannot be used for further requests
+    static bool readResponse(Connection& connection, HttpResponse& response, bool& keepAlive, const Deadline& deadline,
+                             const HttpResponseParser::BodySink& sink);
+};
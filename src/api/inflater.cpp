@@ -0,0 +1,84 @@
+#include "inflater.h"
+
+#ifdef CMDF_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+bool Inflater::supported() {
+#ifdef CMDF_WITH_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef CMDF_WITH_ZLIB
+
+Inflater::~Inflater() {
+    if (stream_ != nullptr) {
+        inflateEnd(stream_);
+        delete stream_;
+    }
+}
+
+bool Inflater::begin(Encoding encoding) {
+    // 15 + 32: zlib or gzip header, detected automatically
+    int windowBits = 15 + 32;
+    if (stream_ == nullptr) {
+        stream_ = new z_stream_s{};
+        if (inflateInit2(stream_, windowBits) != Z_OK) {
+            delete stream_;
+            stream_ = nullptr;
+            return false;
+        }
+    } else if (inflateReset2(stream_, windowBits) != Z_OK) {
+        return false;
+    }
+    encoding_ = encoding;
+    raw_ = false;
+    finished_ = false;
+    return true;
+}
+
+bool Inflater::decode(const char* data, size_t size, const Sink& sink) {
+    if (stream_ == nullptr) return false;
+    char out[16384];
+    stream_->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream_->avail_in = static_cast<uInt>(size);
+
+    while (stream_->avail_in > 0 && !finished_) {
+        stream_->next_out = reinterpret_cast<Bytef*>(out);
+        stream_->avail_out = sizeof(out);
+        int rc = inflate(stream_, Z_NO_FLUSH);
+
+        // A deflate body without the zlib header is detected on its first bytes
+        if (rc == Z_DATA_ERROR && encoding_ == Encoding::Deflate && !raw_ && stream_->total_out == 0 && stream_->total_in <= size) {
+            if (inflateReset2(stream_, -15) != Z_OK) return false;
+            raw_ = true;
+            stream_->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            stream_->avail_in = static_cast<uInt>(size);
+            continue;
+        }
+        if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) return false;
+
+        size_t produced = sizeof(out) - stream_->avail_out;
+        if (produced > 0) sink(out, produced);
+        if (rc == Z_STREAM_END) finished_ = true;
+        else if (rc == Z_BUF_ERROR && produced == 0) break;
+    }
+    return true;
+}
+
+#else
+
+Inflater::~Inflater() {}
+
+bool Inflater::begin(Encoding) {
+    return false;
+}
+
+bool Inflater::decode(const char*, size_t, const Sink&) {
+    return false;
+}
+
+#endif
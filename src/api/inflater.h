@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+struct z_stream_s; // zlib stream, only used when built with zlib
+
+/*
+ * Streaming decoder of the gzip and deflate content encodings, based on zlib. The zlib stream
+ * (and its 32 KB window) is allocated on first use and only reset for the following bodies, so
+ * that a connection can decode all its responses with the same Inflater. When the program is
+ * built without zlib, no encoding is supported, and the clients do not ask for compressed bodies.
+ */
+class Inflater {
+
+public:
+    enum class Encoding {Gzip, Deflate};
+    using Sink = std::function<void(const char*, size_t)>;
+
+    Inflater() {}
+    Inflater(const Inflater&) = delete;
+    Inflater& operator=(const Inflater&) = delete;
+    ~Inflater();
+
+    // Returns true if the program is built with zlib
+    static bool supported();
+
+    // Prepares the decoder for a new body; returns false if the encoding is not supported
+    bool begin(Encoding encoding);
+
+    // Decodes the next part of the body, passing the decoded bytes to the sink;
+    // returns false if the body is corrupted
+    bool decode(const char* data, size_t size, const Sink& sink);
+
+    // True once the end of the compressed stream has been decoded
+    bool finished() const {return finished_;}
+
+private:
+    z_stream_s* stream_ = nullptr;
+    Encoding encoding_ = Encoding::Gzip;
+    bool raw_ = false; // deflate body without the zlib header, as sent by some servers
+    bool finished_ = false;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/*
+ * Histogram of latencies, with logarithmic buckets (8 per power of two, i.e. a relative error
+ * below 12.5%) from 1 microsecond to several hours. Values can be recorded by several threads at
+ * the same time without locking; reading the percentiles while values are recorded gives an
+ * approximate (but consistent enough) picture.
+ */
+class LatencyHistogram {
+
+public:
+    static constexpr size_t BUCKETS = 16 + 32 * 8;
+
+    LatencyHistogram() {}
+    LatencyHistogram(const LatencyHistogram& other) {add(other);}
+    LatencyHistogram& operator=(const LatencyHistogram& other) {
+        if (this != &other) {
+            reset();
+            add(other);
+        }
+        return *this;
+    }
+
+    void record(std::chrono::steady_clock::duration latency) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        uint64_t value = us > 0 ? static_cast<uint64_t>(us) : 0;
+        buckets_[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+    }
+
+    // Adds the values of another histogram
+    void add(const LatencyHistogram& other) {
+        for (size_t i = 0; i < BUCKETS; ++i) buckets_[i].fetch_add(other.buckets_[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        count_.fetch_add(other.count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        uint64_t max = other.max_.load(std::memory_order_relaxed);
+        if (max > max_.load(std::memory_order_relaxed)) max_.store(max, std::memory_order_relaxed);
+    }
+
+    void reset() {
+        for (auto& bucket: buckets_) bucket.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const {return count_.load(std::memory_order_relaxed);}
+
+    // Latency (in milliseconds) below which the fraction q of the values lies (upper bound of its bucket)
+    double percentileMs(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(std::clamp(q, 0.0, 1.0) * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) return std::min(upperBound(i), max_.load(std::memory_order_relaxed)) / 1000.0;
+        }
+        return maxMs();
+    }
+
+    double maxMs() const {return max_.load(std::memory_order_relaxed) / 1000.0;}
+
+    // One line summary, e.g. "n=120 p50=12.1 p90=20.3 p99=85.0 max=90.2 ms"
+    std::string summary() const {
+        char line[128];
+        std::snprintf(line, sizeof(line), "n=%llu p50=%.1f p90=%.1f p99=%.1f max=%.1f ms", static_cast<unsigned long long>(count()),
+                      percentileMs(0.5), percentileMs(0.9), percentileMs(0.99), maxMs());
+        return line;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_{0};
+
+    // Values below 16 us have a bucket each; then 8 buckets per power of two
+    static size_t bucket(uint64_t us) {
+        if (us < 16) return static_cast<size_t>(us);
+        size_t exponent = 63 - static_cast<size_t>(__builtin_clzll(us));
+        size_t index = 16 + (exponent - 4) * 8 + static_cast<size_t>((us >> (exponent - 3)) & 7);
+        return std::min(index, BUCKETS - 1);
+    }
+
+    static uint64_t upperBound(size_t index) {
+        if (index < 16) return index;
+        size_t exponent = (index - 16) / 8 + 4;
+        uint64_t sub = (index - 16) % 8;
+        return ((8 + sub + 1) << (exponent - 3)) - 1;
+    }
+};
@@ -0,0 +1,210 @@
+#include "request_scheduler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+void RequestScheduler::Bucket::refill(Clock::time_point now) {
+    if (budget.ratePerSecond > 0 && now > updated) {
+        tokens = std::min(budget.burst, tokens + budget.ratePerSecond * std::chrono::duration<double>(now - updated).count());
+    }
+    updated = now;
+}
+
+RequestScheduler::Clock::time_point RequestScheduler::Bucket::readyAt() const {
+    if (ready()) return updated;
+    return updated + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((1 - tokens) / budget.ratePerSecond));
+}
+
+void RequestScheduler::Bucket::reset(const Budget& newBudget) {
+    budget = newBudget;
+    if (budget.burst < 1) budget.burst = 1;
+    tokens = std::min(tokens, budget.burst);
+}
+
+RequestScheduler::RequestScheduler() {
+    // 8000 requests every 10 minutes: about 13 per second, of which at most 8 for candlesticks
+    global_.reset(Budget{13, 4});
+    global_.tokens = global_.budget.burst;
+    buckets_[static_cast<size_t>(EndpointClass::Ticker)].reset(Budget{0, 1});
+    buckets_[static_cast<size_t>(EndpointClass::Ohlc)].reset(Budget{8, 2});
+    buckets_[static_cast<size_t>(EndpointClass::Catalog)].reset(Budget{1, 1});
+    dispatcher_ = std::thread(&RequestScheduler::run, this);
+}
+
+RequestScheduler::~RequestScheduler() {
+    shutdown();
+}
+
+void RequestScheduler::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (dispatcher_.joinable()) dispatcher_.join();
+
+    // The grants may submit other requests, which are cancelled on the spot
+    std::vector<Grant> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& lane: queues_) {
+            for (auto& queue: lane) {
+                for (auto& request: queue) cancelled.push_back(std::move(request.grant));
+                queue.clear();
+            }
+        }
+    }
+    for (auto& grant: cancelled) grant(false);
+}
+
+RequestScheduler& RequestScheduler::shared() {
+    static RequestScheduler* scheduler = []() {
+        auto* shared = new RequestScheduler();
+        std::atexit([]() {RequestScheduler::shared().shutdown();});
+        return shared;
+    }();
+    return *scheduler;
+}
+
+void RequestScheduler::setBudget(EndpointClass endpoint, const Budget& budget) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& bucket = buckets_[static_cast<size_t>(endpoint)];
+        bucket.refill(Clock::now());
+        bucket.reset(budget);
+    }
+    wake_.notify_all();
+}
+
+void RequestScheduler::setGlobalBudget(const Budget& budget) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        global_.refill(Clock::now());
+        global_.reset(budget);
+    }
+    wake_.notify_all();
+}
+
+RequestScheduler::Budget RequestScheduler::budget(EndpointClass endpoint) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buckets_[static_cast<size_t>(endpoint)].budget;
+}
+
+RequestScheduler::Budget RequestScheduler::globalBudget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return global_.budget;
+}
+
+void RequestScheduler::submit(EndpointClass endpoint, Lane lane, Grant grant) {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (stopping_) {
+            lock.unlock();
+            grant(false);
+            return;
+        }
+        auto l = static_cast<size_t>(lane);
+        queues_[l][static_cast<size_t>(endpoint)].push_back(Request{std::move(grant), Clock::now()});
+        laneTotals_[l].maxQueued = std::max(laneTotals_[l].maxQueued, queued(l));
+    }
+    wake_.notify_all();
+}
+
+bool RequestScheduler::acquire(EndpointClass endpoint, Lane lane) {
+    std::mutex mutex;
+    std::condition_variable granted;
+    bool done = false;
+    bool result = false;
+    submit(endpoint, lane, [&](bool admitted) {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        result = admitted;
+        granted.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    granted.wait(lock, [&done]() {return done;});
+    return result;
+}
+
+RequestScheduler::Stats RequestScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    for (size_t l = 0; l < LANES; ++l) {
+        const auto& totals = laneTotals_[l];
+        auto& lane = stats.lanes[l];
+        lane.queued = queued(l);
+        lane.maxQueued = totals.maxQueued;
+        lane.admitted = totals.admitted;
+        lane.meanDelayMs = totals.admitted > 0 ? totals.totalDelayMs / totals.admitted : 0;
+        lane.maxDelayMs = totals.maxDelayMs;
+    }
+    stats.admitted = admitted_;
+    return stats;
+}
+
+size_t RequestScheduler::queued(size_t lane) const {
+    size_t n = 0;
+    for (const auto& queue: queues_[lane]) n += queue.size();
+    return n;
+}
+
+void RequestScheduler::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        auto now = Clock::now();
+        global_.refill(now);
+        for (auto& bucket: buckets_) bucket.refill(now);
+
+        // The oldest admissible request of the first lane having one; otherwise, the next time a token is available
+        size_t lane = LANES, endpoint = ENDPOINT_CLASSES;
+        auto wakeAt = Clock::time_point::max();
+        for (size_t l = 0; l < LANES && lane == LANES; ++l) {
+            for (size_t e = 0; e < ENDPOINT_CLASSES; ++e) {
+                const auto& queue = queues_[l][e];
+                if (queue.empty()) continue;
+                if (buckets_[e].ready() && global_.ready()) {
+                    if (endpoint == ENDPOINT_CLASSES || queue.front().submitted < queues_[l][endpoint].front().submitted) endpoint = e;
+                } else {
+                    wakeAt = std::min(wakeAt, std::max(buckets_[e].readyAt(), global_.readyAt()));
+                }
+            }
+            if (endpoint != ENDPOINT_CLASSES) lane = l;
+        }
+
+        if (stopping_) return; // the requests still queued are cancelled by shutdown
+        if (lane == LANES) {
+            if (wakeAt == Clock::time_point::max()) wake_.wait(lock);
+            else wake_.wait_until(lock, wakeAt);
+            continue;
+        }
+
+        auto request = std::move(queues_[lane][endpoint].front());
+        queues_[lane][endpoint].pop_front();
+        buckets_[endpoint].take();
+        global_.take();
+        double delayMs = std::chrono::duration<double, std::milli>(now - request.submitted).count();
+        auto& totals = laneTotals_[lane];
+        ++totals.admitted;
+        totals.totalDelayMs += delayMs;
+        totals.maxDelayMs = std::max(totals.maxDelayMs, delayMs);
+        ++admitted_[endpoint];
+
+        lock.unlock();
+        request.grant(true);
+        lock.lock();
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const RequestScheduler::Stats& stats) {
+    static const char* lanes[] = {"live", "backfill"};
+    os << "request scheduler << admitted: ticker " << stats.admitted[0] << ", ohlc " << stats.admitted[1]
+       << ", catalog " << stats.admitted[2];
+    for (size_t l = 0; l < RequestScheduler::LANES; ++l) {
+        const auto& lane = stats.lanes[l];
+        os << " << " << lanes[l] << " lane: max queued " << lane.maxQueued << ", avg delay (ms) " << lane.meanDelayMs
+           << ", max delay (ms) " << lane.maxDelayMs;
+    }
+    return os;
+}
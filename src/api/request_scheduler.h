@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+/*
+ * Admission control of the requests sent to an exchange. Every request waits in the queue of its
+ * priority lane until the token buckets of its endpoint class and of the whole exchange both hold
+ * a token; a single dispatcher thread admits the requests in priority order (the live lane before
+ * the backfill lane, the oldest request first within a lane). The tokens are refilled continuously
+ * and the bursts are small, so that requests submitted together (e.g. all the coins refreshed at
+ * the same time) are spread over the interval instead of reaching the exchange in a single burst.
+ * Budgets can be changed at any time; a non-positive rate means no limit. Once the scheduler is shut
+ * down, the requests still queued and the ones submitted afterwards are cancelled instead of admitted.
+ */
+class RequestScheduler {
+
+public:
+    using Clock = std::chrono::steady_clock;
+    using Grant = std::function<void(bool admitted)>; // admitted is false if the request was cancelled
+
+    enum class EndpointClass {Ticker, Ohlc, Catalog};
+    enum class Lane {Live, Backfill};
+    static constexpr size_t ENDPOINT_CLASSES = 3;
+    static constexpr size_t LANES = 2;
+
+    struct Budget {
+        double ratePerSecond = 0;  // sustained rate; <= 0: unlimited
+        double burst = 1;          // max number of requests admitted at once
+    };
+
+    struct LaneStats {
+        size_t queued = 0;        // requests waiting for admission
+        size_t maxQueued = 0;     // max queue depth observed
+        uint64_t admitted = 0;    // requests admitted
+        double meanDelayMs = 0;   // mean admission delay (time spent in the queue)
+        double maxDelayMs = 0;    // max admission delay
+    };
+
+    struct Stats {
+        std::array<LaneStats, LANES> lanes;
+        std::array<uint64_t, ENDPOINT_CLASSES> admitted{}; // requests admitted per endpoint class
+    };
+
+    // The default budgets stay within the public limits of Bitstamp (8000 requests every 10 minutes)
+    RequestScheduler();
+    RequestScheduler(const RequestScheduler&) = delete;
+    RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+    // Shuts the scheduler down
+    ~RequestScheduler();
+
+    // The scheduler shared by the whole process (its dispatcher thread is started on first use). It is never
+    // destroyed, so that it outlives the objects using it: it is shut down by an exit handler.
+    static RequestScheduler& shared();
+
+    void setBudget(EndpointClass endpoint, const Budget& budget);
+    void setGlobalBudget(const Budget& budget); // shared by all endpoint classes
+    Budget budget(EndpointClass endpoint) const;
+    Budget globalBudget() const;
+
+    // Queues a request; grant is invoked on the dispatcher thread once the request is admitted, and
+    // must only start the request (e.g. submit it to the AsyncHttpClient) without blocking. After the
+    // shutdown, grant is invoked on the calling thread with admitted false.
+    void submit(EndpointClass endpoint, Lane lane, Grant grant);
+
+    // Blocks the calling thread until a request is admitted; returns false if it was cancelled
+    bool acquire(EndpointClass endpoint, Lane lane);
+
+    // Stops the dispatcher, and cancels the requests still queued (their grants are invoked with admitted
+    // false before it returns); the later calls do nothing
+    void shutdown();
+
+    Stats stats() const;
+
+private:
+    struct Bucket {
+        Budget budget;
+        double tokens = 1;
+        Clock::time_point updated = Clock::now();
+
+        void refill(Clock::time_point now);
+        bool ready() const {return budget.ratePerSecond <= 0 || tokens >= 1;}
+        Clock::time_point readyAt() const; // time at which the next token is available
+        void take() {if (budget.ratePerSecond > 0) tokens -= 1;}
+        void reset(const Budget& newBudget);
+    };
+
+    struct Request {
+        Grant grant;
+        Clock::time_point submitted;
+    };
+
+    struct LaneTotals {
+        size_t maxQueued = 0;
+        uint64_t admitted = 0;
+        double totalDelayMs = 0;
+        double maxDelayMs = 0;
+    };
+
+    mutable std::mutex mutex_; // guards the members below
+    std::condition_variable wake_;
+    std::array<Bucket, ENDPOINT_CLASSES> buckets_;
+    Bucket global_;
+    std::array<std::array<std::deque<Request>, ENDPOINT_CLASSES>, LANES> queues_;
+    std::array<LaneTotals, LANES> laneTotals_;
+    std::array<uint64_t, ENDPOINT_CLASSES> admitted_{};
+    bool stopping_ = false;
+
+    std::thread dispatcher_;
+
+    void run();
+    size_t queued(size_t lane) const;
+};
+
+std::ostream& operator<<(std::ostream& os, const RequestScheduler::Stats& stats);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Registry of the calls in flight, keyed by a string identifying their result. The first caller
+ * of a key (the leader) performs the call; the callers arriving with the same key while the call
+ * is in flight do not perform it again, but receive a copy of the leader's result (or its
+ * exception). Calls can be synchronous (run) or asynchronous (runAsync), and both kinds of caller
+ * can share the same call. The key is released as soon as the result is available: later callers
+ * perform a new call.
+ */
+template<typename T>
+class SingleFlight {
+
+public:
+    using Callback = std::function<void(T)>;
+
+    SingleFlight() {}
+    SingleFlight(const SingleFlight&) = delete;
+    SingleFlight& operator=(const SingleFlight&) = delete;
+
+    // Returns the result of fn, or of the call with the same key in flight (deduplicated = true)
+    T run(const std::string& key, const std::function<T()>& fn, bool& deduplicated) {
+        auto call = join(key, deduplicated);
+        if (deduplicated) {
+            std::unique_lock<std::mutex> lock(call->mutex);
+            call->completed.wait(lock, [&call]() {return call->done;});
+            if (call->error) std::rethrow_exception(call->error);
+            return *call->result;
+        }
+
+        T result;
+        try {
+            result = fn();
+        } catch (...) {
+            publish(key, call, nullptr, std::current_exception());
+            throw;
+        }
+        publish(key, call, &result, nullptr);
+        return result;
+    }
+
+    // Starts the call with start, unless the call with the same key is in flight (deduplicated = true);
+    // the callback receives the result. start must invoke the callback it is given exactly once.
+    // Followers joining a synchronous call that throws receive an empty result.
+    void runAsync(const std::string& key, const std::function<void(Callback)>& start, Callback callback, bool& deduplicated) {
+        auto call = join(key, deduplicated);
+        if (deduplicated) {
+            std::unique_lock<std::mutex> lock(call->mutex);
+            if (!call->done) {
+                call->callbacks.push_back(std::move(callback));
+                return;
+            }
+            // The result was published after join: a copy is still available
+            lock.unlock();
+            callback(call->result ? *call->result : T{});
+            return;
+        }
+
+        start([this, key, call, callback = std::move(callback)](T result) {
+            publish(key, call, &result, nullptr);
+            callback(std::move(result));
+        });
+    }
+
+    // Number of calls in flight
+    size_t inFlight() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return calls_.size();
+    }
+
+private:
+    struct Call {
+        std::mutex mutex;
+        std::condition_variable completed;
+        size_t followers = 0;                // guarded by the registry mutex
+        bool done = false;
+        std::vector<Callback> callbacks;     // asynchronous followers waiting for the result
+        std::shared_ptr<const T> result;
+        std::exception_ptr error;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Call>> calls_;
+
+    // Gets the call in flight with the key, or registers a new one (led by the caller)
+    std::shared_ptr<Call> join(const std::string& key, bool& deduplicated) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& call = calls_[key];
+        deduplicated = call != nullptr;
+        if (!call) call = std::make_shared<Call>();
+        else ++call->followers;
+        return call;
+    }
+
+    // Releases the key, and passes the result (or the error) to the callers waiting for it
+    void publish(const std::string& key, const std::shared_ptr<Call>& call, const T* result, std::exception_ptr error) {
+        size_t followers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            calls_.erase(key);
+            followers = call->followers;
+        }
+        std::vector<Callback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(call->mutex);
+            // The result is copied only if somebody else is waiting for it
+            if (result != nullptr && followers > 0) call->result = std::make_shared<const T>(*result);
+            call->error = error;
+            call->done = true;
+            callbacks.swap(call->callbacks);
+        }
+        call->completed.notify_all();
+        // Asynchronous followers of a failed call receive an empty result
+        for (auto& callback: callbacks) callback(call->result ? *call->result : T{});
+    }
+};
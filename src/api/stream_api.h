@@ -0,0 +1,36 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "api.h"
+
+/*
+ *  Interface of the streaming counterpart of the Api class. Instead of polling the exchange, the
+ *  concrete implementations keep a connection open and push the market data of the subscribed
+ *  tickers to the consumers as soon as the exchange publishes an update. The market data have the
+ *  same format as the ones returned by Api::fetchMarketTicker (the fields which are not part of the
+ *  stream may be missing, or refreshed less often).
+ */
+class StreamApi {
+
+public:
+    // Receives the latest market data of a ticker every time they change
+    using MarketDataHandler = std::function<void(PairId, const DataMap&)>;
+
+    // Given a crypto name and a fiat (or other conversion currency), it creates a pair name
+    // according to the exchange's taxonomy
+    virtual std::string makePair(const std::string& cryptoSymbol, const std::string& fiatSymbol) const = 0;
+
+    // Given a pair name, it returns its id in the shared symbol table (INVALID_PAIR_ID if the pair is not valid)
+    virtual PairId pairId(const std::string& pair) const = 0;
+
+    // Subscribes to the market data of the tickers: the handler is invoked on a thread owned by the
+    // StreamApi, and must not block. Subscriptions are kept when the connection is re-established
+    virtual void subscribeMarketData(const std::vector<PairId>& tickers, MarketDataHandler handler) = 0;
+
+    // True while the connection to the exchange is open
+    virtual bool connected() const = 0;
+
+    virtual ~StreamApi() {}
+};
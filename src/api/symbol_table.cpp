@@ -0,0 +1,70 @@
+#include "symbol_table.h"
+#include <mutex>
+
+SymbolTable& SymbolTable::shared() {
+    static SymbolTable* table = new SymbolTable(); // never destroyed: used by the threads still running at exit
+    return *table;
+}
+
+// FNV-1a
+uint64_t SymbolTable::hash(std::string_view name) {
+    uint64_t h = 1469598103934665603ULL;
+    for (const auto c: name) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Returns the slot containing the name, or the empty slot where it would be inserted
+size_t SymbolTable::slotOf(std::string_view name, uint64_t h) const {
+    size_t mask = slots_.size() - 1;
+    size_t slot = h & mask;
+    while (slots_[slot] != INVALID_PAIR_ID) {
+        PairId id = slots_[slot];
+        if (hashes_[id] == h && names_[id] == name) return slot;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Doubles the number of slots, keeping the load factor below 1/2
+void SymbolTable::grow() {
+    slots_.assign(slots_.size() * 2, INVALID_PAIR_ID);
+    size_t mask = slots_.size() - 1;
+    for (PairId id = 0; id < names_.size(); ++id) {
+        size_t slot = hashes_[id] & mask;
+        while (slots_[slot] != INVALID_PAIR_ID) slot = (slot + 1) & mask;
+        slots_[slot] = id;
+    }
+}
+
+PairId SymbolTable::intern(std::string_view name) {
+    uint64_t h = hash(name);
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    size_t slot = slotOf(name, h);
+    if (slots_[slot] != INVALID_PAIR_ID) return slots_[slot];
+
+    PairId id = static_cast<PairId>(names_.size());
+    names_.emplace_back(name);
+    hashes_.push_back(h);
+    slots_[slot] = id;
+    if (names_.size() * 2 > slots_.size()) grow();
+    return id;
+}
+
+PairId SymbolTable::find(std::string_view name) const {
+    uint64_t h = hash(name);
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return slots_[slotOf(name, h)];
+}
+
+std::string SymbolTable::name(PairId id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return id < names_.size() ? names_[id] : std::string();
+}
+
+size_t SymbolTable::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return names_.size();
+}
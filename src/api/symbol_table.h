@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Dense integer identifier of an exchange pair (e.g. "btcusd")
+using PairId = uint32_t;
+constexpr PairId INVALID_PAIR_ID = UINT32_MAX;
+
+/*
+ * Table of interned pair names. Each name receives a dense integer id (0, 1, 2, ...) the first
+ * time it is interned, and keeps it for the lifetime of the process; ids can therefore be used
+ * as keys (or vector indices) in place of the names. Lookups use an open-addressing hash table
+ * and do not allocate. The table shared by the process is filled when the ticker catalogs are loaded.
+ */
+class SymbolTable {
+
+public:
+    SymbolTable() {slots_.assign(64, INVALID_PAIR_ID);}
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    // The table shared by the whole process (never destroyed)
+    static SymbolTable& shared();
+
+    // Returns the id of the name, assigning a new id if the name was not interned yet
+    PairId intern(std::string_view name);
+
+    // Returns the id of the name, or INVALID_PAIR_ID if the name was never interned
+    PairId find(std::string_view name) const;
+
+    // Returns the name corresponding to an id
+    std::string name(PairId id) const;
+
+    // Number of interned names (ids range from 0 to size() - 1)
+    size_t size() const;
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::vector<std::string> names_;
+    std::vector<uint64_t> hashes_;
+    std::vector<PairId> slots_; // open addressing with linear probing; the size is a power of 2
+
+    static uint64_t hash(std::string_view name);
+    size_t slotOf(std::string_view name, uint64_t h) const; // mutex_ must be held
+    void grow(); // mutex_ must be held
+};
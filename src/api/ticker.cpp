@@ -0,0 +1,167 @@
+#include "ticker.h"
+#include "../json_reader/json_schema.h"
+#include "../utils/decimal.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Target of the decoding of a ticker object: the record, and the "pair" member of the objects of the
+// all-tickers payload
+struct TickerTarget {
+    Ticker* ticker = nullptr;
+    std::string_view* pair = nullptr;
+};
+
+// Schema of the ticker payloads (ticker, hourly ticker, all tickers): the fields of the record, in their
+// order, then the pair
+struct TickerSchema {
+    using Record = TickerTarget;
+    static constexpr std::array<std::string_view, Ticker::FIELDS + 1> KEYS = {
+        "timestamp", "open", "high", "low", "last", "volume", "vwap", "bid", "ask", "side", "open_24", "percent_change_24",
+        "pair"
+    };
+
+    // Null values are held as null fields, the other non-numeric values are not held by the record; an escaped
+    // pair is not used
+    static bool set(Record& target, size_t key, const JsonTokenizer::Token& value) {
+        using TokenType = JsonTokenizer::TokenType;
+        if (value.type != TokenType::String && value.type != TokenType::Literal) return false;
+        if (key < Ticker::FIELDS && value.type == TokenType::Literal && value.text == "null") {
+            target.ticker->setNull(static_cast<Ticker::Field>(key));
+            return true;
+        }
+        if (key < Ticker::FIELDS) return target.ticker->set(static_cast<Ticker::Field>(key), value.text);
+        if (target.pair == nullptr || value.escaped) return false;
+        *target.pair = value.text;
+        return true;
+    }
+};
+
+using TickerReader = JsonSchemaReader<TickerSchema>;
+constexpr const auto& FIELD_NAMES = TickerSchema::KEYS;
+
+// Text of the null fields, as the generic reader stores a null value
+constexpr std::string_view NULL_TEXT = "null";
+
+} // namespace
+
+bool Ticker::set(Field field, std::string_view text) {
+    if (field >= FIELDS) return false;
+    present &= static_cast<Mask>(~bit(field));
+    nulls &= static_cast<Mask>(~bit(field));
+    const unsigned written = std::min(Decimal::decimals(text), Decimal::MAX_SCALE);
+    if (!Decimal::parse(text, written, units[field])) return false;
+    decimals[field] = static_cast<unsigned char>(written);
+    present |= bit(field);
+    return true;
+}
+
+double Ticker::value(Field field) const {
+    return has(field) ? Decimal::toDouble(units[field], decimals[field]) : std::numeric_limits<double>::quiet_NaN();
+}
+
+std::string Ticker::text(Field field) const {
+    std::string out;
+    appendText(field, out);
+    return out;
+}
+
+void Ticker::appendText(Field field, std::string& out) const {
+    if (has(field)) Decimal::append(units[field], decimals[field], decimals[field], out);
+    else if (isNull(field)) out += NULL_TEXT;
+}
+
+const char* Ticker::name(Field field) {
+    return field < FIELDS ? FIELD_NAMES[field].data() : "";
+}
+
+bool Ticker::find(std::string_view name, Field& field) {
+    const int index = TickerReader::KEYS.find(name);
+    if (index < 0 || index >= static_cast<int>(FIELDS)) return false;
+    field = static_cast<Field>(index);
+    return true;
+}
+
+Ticker::Projection Ticker::project(const std::vector<std::string>& names) {
+    Projection projection;
+    if (names.empty()) return projection;
+    projection.mask = 0;
+    for (const auto& name: names) {
+        Field field;
+        const bool known = find(name, field);
+        if (known) projection.mask |= bit(field);
+        projection.order.push_back(known ? static_cast<int>(field) : -1);
+    }
+    return projection;
+}
+
+// Same separators as Utils::mapToMessage: with a list of fields, a separator follows every field found
+// but the last one of the list, even when the fields after it are missing. Without a list, the fields are
+// printed in the order of their declaration, rather than in the unspecified order of the keys of a map
+void Ticker::appendMessage(const std::string& label, const Projection& projection, std::string& out) const {
+    out += label;
+    out += " << ";
+    if (projection.order.empty()) {
+        bool first = true;
+        for (unsigned f = 0; f < FIELDS; ++f) {
+            const auto field = static_cast<Field>(f);
+            if (!has(field) && !isNull(field)) continue;
+            if (!first) out += " << ";
+            first = false;
+            out += FIELD_NAMES[field];
+            out += ": ";
+            appendText(field, out);
+        }
+        return;
+    }
+    const size_t n = projection.order.size();
+    for (size_t i = 0; i < n; ++i) {
+        const int field = projection.order[i];
+        if (field < 0 || (!has(static_cast<Field>(field)) && !isNull(static_cast<Field>(field)))) continue;
+        out += FIELD_NAMES[field];
+        out += ": ";
+        appendText(static_cast<Field>(field), out);
+        if (i < n - 1) out += " << ";
+    }
+}
+
+std::string Ticker::message(const std::string& label, const Projection& projection) const {
+    std::string out;
+    appendMessage(label, projection, out);
+    return out;
+}
+
+bool Ticker::parse(std::string_view json, std::unordered_map<std::string, std::string>* others) {
+    JsonTokenizer tokenizer(json);
+    if (tokenizer.next().type == JsonTokenizer::TokenType::BeginObject && read(tokenizer, nullptr, others)) return true;
+    clear();
+    return false;
+}
+
+// The keys are dispatched by the perfect hash of the schema, and the values converted straight from the input
+bool Ticker::read(JsonTokenizer& tokenizer, std::string_view* pair, std::unordered_map<std::string, std::string>* others) {
+    clear();
+    TickerTarget target{this, pair};
+    return TickerReader::readObject(tokenizer, target, others);
+}
+
+Ticker Ticker::fromMap(const std::unordered_map<std::string, std::string>& marketData) {
+    Ticker ticker;
+    for (unsigned f = 0; f < FIELDS; ++f) {
+        auto it = marketData.find(std::string(FIELD_NAMES[f]));
+        if (it == marketData.end()) continue;
+        if (it->second == NULL_TEXT) ticker.setNull(static_cast<Field>(f));
+        else ticker.set(static_cast<Field>(f), it->second);
+    }
+    return ticker;
+}
+
+std::unordered_map<std::string, std::string> Ticker::toMap(Mask mask) const {
+    std::unordered_map<std::string, std::string> marketData;
+    for (unsigned f = 0; f < FIELDS; ++f) {
+        const auto field = static_cast<Field>(f);
+        if ((has(field) || isNull(field)) && (mask & bit(field)) != 0) marketData[std::string(FIELD_NAMES[f])] = text(field);
+    }
+    return marketData;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class JsonTokenizer;
+
+/*
+ * Latest market data of a pair as a fixed-layout record: one fixed-point value per field of the ticker
+ * schema (see decimal.h), with the decimals it was received with, and bitmasks telling which fields are
+ * present, and which were received as null (e.g. "open_24": null), so that they are still printed. The record fits in two cache lines and owns no memory, so decoding, copying and formatting it
+ * allocate nothing. The fields which are not part of the schema (e.g. "pair") are not kept.
+ */
+struct alignas(64) Ticker {
+
+    enum Field : unsigned {Timestamp, Open, High, Low, Last, Volume, Vwap, Bid, Ask, Side, Open24, PercentChange24, FIELDS};
+
+    using Mask = uint16_t;
+    static constexpr Mask ALL = (1u << FIELDS) - 1;
+
+    int64_t units[FIELDS] = {};           // value of each field, in units of 10^-decimals
+    unsigned char decimals[FIELDS] = {};  // decimals of each field, as received
+    Mask present = 0;                     // bit f is set if field f is present
+    Mask nulls = 0;                       // bit f is set if field f was received as null (it is not present then)
+
+    static constexpr Mask bit(Field field) {return static_cast<Mask>(1u << field);}
+    bool has(Field field) const {return (present & bit(field)) != 0;}
+    bool isNull(Field field) const {return (nulls & bit(field)) != 0;}
+    bool empty() const {return present == 0;}
+    void clear() {present = nulls = 0;}
+
+    // Keeps only the fields of the mask
+    void select(Mask mask) {
+        present &= mask;
+        nulls &= mask;
+    }
+
+    // Sets a field from its text; returns false (and leaves the field missing) if it is not a decimal number
+    bool set(Field field, std::string_view text);
+
+    // Marks a field as received as null: it has no value, but is printed (as "null", the text of the maps)
+    void setNull(Field field) {
+        present &= static_cast<Mask>(~bit(field));
+        nulls |= bit(field);
+    }
+
+    // Value of a field as a double (NaN if missing), for the computations which need not be exact
+    double value(Field field) const;
+
+    // Text of a field, formatted as it was received ("null" if it was received as null, empty if it is missing)
+    std::string text(Field field) const;
+    void appendText(Field field, std::string& out) const;
+
+    // Name of a field (e.g. "open_24"), and field with a given name; returns false if the name is unknown
+    static const char* name(Field field);
+    static bool find(std::string_view name, Field& field);
+
+    // Fields selected by name, resolved once: the mask of the known names, and the order in which the
+    // names were given (-1 for the unknown ones), which is the order of the fields in the messages.
+    // No names selects all the fields.
+    struct Projection {
+        Mask mask = ALL;
+        std::vector<int> order;
+    };
+    static Projection project(const std::vector<std::string>& names);
+
+    // Appends the message of the market data of the record, e.g. "BTC/USD << bid: 57841 << ask: 57850", as
+    // Utils::mapToMessage prints them; the fields are printed in the order of Field (timestamp, open, ...,
+    // percent_change_24), unless the projection gives an order
+    void appendMessage(const std::string& label, const Projection& projection, std::string& out) const;
+    std::string message(const std::string& label, const Projection& projection) const;
+    std::string message(const std::string& label) const {return message(label, Projection());}
+
+    // Decodes a ticker object (e.g. the response of the ticker or hourly ticker endpoint), with the parser
+    // specialized for the ticker schema (see json_schema.h); returns false (and leaves the record empty)
+    // if the input is malformed. The fields received as null are kept as such (see setNull); the members the
+    // record does not hold (other keys, non-numeric values) are stored into others, if given, as JsonReader
+    // stores them.
+    bool parse(std::string_view json, std::unordered_map<std::string, std::string>* others = nullptr);
+
+    // Reads the members of an object whose opening brace was just returned by the tokenizer; the text
+    // of its "pair" member, if any, is stored into pair. Returns false if the object is not valid json.
+    bool read(JsonTokenizer& tokenizer, std::string_view* pair = nullptr, std::unordered_map<std::string, std::string>* others = nullptr);
+
+    // Conversions from and to the market data maps (the fields of the mask only), where the null fields are "null"
+    static Ticker fromMap(const std::unordered_map<std::string, std::string>& marketData);
+    std::unordered_map<std::string, std::string> toMap(Mask mask = ALL) const;
+};
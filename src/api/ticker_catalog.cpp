@@ -0,0 +1,194 @@
+#include "ticker_catalog.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <unordered_map>
+
+namespace {
+
+std::mutex registryMutex;
+std::string cacheDirectory = "./.cache/";
+
+} // namespace
+
+// The registry is never destroyed, so that a download still running at exit never outlives its catalog
+std::unordered_map<std::string, std::unique_ptr<TickerCatalog>>& TickerCatalog::registry() {
+    static auto* catalogs = []() {
+        auto* registry = new std::unordered_map<std::string, std::unique_ptr<TickerCatalog>>();
+        std::atexit(TickerCatalog::shutdown);
+        return registry;
+    }();
+    return *catalogs;
+}
+
+TickerCatalog& TickerCatalog::forSource(const std::string& source) {
+    auto& catalogs = registry();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto& catalog = catalogs[source];
+    if (!catalog) catalog.reset(new TickerCatalog(source));
+    return *catalog;
+}
+
+void TickerCatalog::shutdown() {
+    std::vector<TickerCatalog*> catalogs;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& entry: registry()) catalogs.push_back(entry.second.get());
+    }
+    for (auto* catalog: catalogs) {
+        std::thread refreshThread;
+        {
+            std::lock_guard<std::mutex> lock(catalog->mutex_);
+            catalog->stopped_ = true;
+            refreshThread = std::move(catalog->refreshThread_);
+        }
+        if (refreshThread.joinable()) refreshThread.join();
+    }
+}
+
+void TickerCatalog::setCacheDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    cacheDirectory = directory;
+    if (!cacheDirectory.empty() && cacheDirectory.back() != '/') cacheDirectory += '/';
+}
+
+std::string TickerCatalog::getCacheDirectory() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return cacheDirectory;
+}
+
+TickerCatalog::TickerCatalog(const std::string& source) {
+    // The name of the cache file is derived from the source, e.g. "tickers_https___www_bitstamp_net_api_v2_.txt"
+    std::string name;
+    for (const auto c: source) name += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    cacheFile_ = cacheDirectory + "tickers_" + name + ".txt";
+}
+
+TickerCatalog::~TickerCatalog() {
+    if (refreshThread_.joinable()) refreshThread_.join();
+}
+
+void TickerCatalog::setTimeToLive(std::chrono::seconds timeToLive) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    timeToLive_ = timeToLive;
+}
+
+std::vector<std::string> TickerCatalog::tickers(const Loader& loader) {
+    ensureLoaded(loader);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tickers_;
+}
+
+PairId TickerCatalog::id(std::string_view ticker) const {
+    PairId pairId = SymbolTable::shared().find(ticker);
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pairId < members_.size() && members_[pairId] ? pairId : INVALID_PAIR_ID;
+}
+
+void TickerCatalog::refresh(const Loader& loader) {
+    std::lock_guard<std::mutex> loadLock(loadMutex_);
+    auto downloaded = loader();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.networkLoads;
+        if (downloaded.empty()) return; // keep the previous list (a failed first load is retried on the next call)
+        loaded_ = true;
+    }
+    setTickers(std::move(downloaded), std::chrono::system_clock::now());
+    writeCache();
+}
+
+TickerCatalog::Stats TickerCatalog::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void TickerCatalog::ensureLoaded(const Loader& loader) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (loaded_) {
+            if (std::chrono::system_clock::now() - updatedAt_ > timeToLive_) refreshInBackground(loader);
+            return;
+        }
+    }
+    std::unique_lock<std::mutex> loadLock(loadMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (loaded_) return; // loaded by another thread in the meantime
+    }
+    if (readCache()) {
+        loadLock.unlock();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (std::chrono::system_clock::now() - updatedAt_ > timeToLive_) refreshInBackground(loader);
+        return;
+    }
+    loadLock.unlock();
+    refresh(loader);
+}
+
+// mutex_ must be held
+void TickerCatalog::refreshInBackground(const Loader& loader) {
+    if (stopped_ || refreshing_.exchange(true)) return;
+    if (refreshThread_.joinable()) refreshThread_.join();
+    refreshThread_ = std::thread([this, loader]() {
+        refresh(loader);
+        refreshing_.store(false);
+    });
+}
+
+void TickerCatalog::setTickers(std::vector<std::string> tickers, std::chrono::system_clock::time_point updatedAt) {
+    std::vector<bool> members;
+    for (const auto& ticker: tickers) {
+        PairId pairId = SymbolTable::shared().intern(ticker);
+        if (pairId >= members.size()) members.resize(pairId + 1, false);
+        members[pairId] = true;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    tickers_ = std::move(tickers);
+    members_ = std::move(members);
+    updatedAt_ = updatedAt;
+}
+
+// The cache file contains the time of the download (seconds since epoch) on the
+// first line, followed by one ticker per line
+bool TickerCatalog::readCache() {
+    std::fstream inFile(cacheFile_, std::ios::in);
+    if (!inFile) return false;
+
+    long long seconds = 0;
+    if (!(inFile >> seconds)) return false;
+    std::vector<std::string> tickers;
+    std::string line;
+    while (std::getline(inFile, line)) {
+        if (!line.empty()) tickers.push_back(line);
+    }
+    if (tickers.empty()) return false;
+
+    setTickers(std::move(tickers), std::chrono::system_clock::time_point(std::chrono::seconds(seconds)));
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.cacheLoads;
+    loaded_ = true;
+    return true;
+}
+
+void TickerCatalog::writeCache() const {
+    std::string directory = cacheFile_.substr(0, cacheFile_.rfind('/') + 1);
+    if (!directory.empty()) ::mkdir(directory.c_str(), 0755);
+
+    // Written to a temporary file first, so that concurrent runs never read a partial list
+    std::string tmpFile = cacheFile_ + ".tmp";
+    {
+        std::fstream outFile(tmpFile, std::ios::out | std::ios::trunc);
+        if (!outFile) {
+            std::cerr << "Cannot write the ticker cache file \"" << cacheFile_ << "\"." << std::endl;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        outFile << std::chrono::duration_cast<std::chrono::seconds>(updatedAt_.time_since_epoch()).count() << '\n';
+        for (const auto& ticker: tickers_) outFile << ticker << '\n';
+    }
+    std::rename(tmpFile.c_str(), cacheFile_.c_str());
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "symbol_table.h"
+
+/*
+ * Process-wide catalog of the tickers (pair names) offered by an exchange. There is one catalog
+ * per source (e.g. per Api base url), shared by all the Api objects of the process: the list is
+ * downloaded at most once, and it is persisted to a cache file so that the next runs of the
+ * program can start without downloading it. When the list is older than its time to live, it is
+ * still served, while a fresh copy is downloaded in the background. The tickers of the catalog
+ * are interned in the shared SymbolTable, so that each of them is identified by a PairId.
+ * The catalogs are never destroyed: their background downloads are stopped by shutdown, at exit.
+ */
+class TickerCatalog {
+
+public:
+    // Downloads the list of tickers from the exchange; an empty result means that the download failed
+    using Loader = std::function<std::vector<std::string>()>;
+
+    struct Stats {
+        size_t networkLoads = 0; // downloads of the list (successful or not)
+        size_t cacheLoads = 0;   // loads of the list from the cache file
+    };
+
+    // Returns the catalog of the given source (created on first use)
+    static TickerCatalog& forSource(const std::string& source);
+
+    // Waits for the background downloads of all the catalogs, and starts no other one. It is called by an
+    // exit handler registered with the first catalog, and can be called earlier.
+    static void shutdown();
+
+    // Directory of the cache files (default: "./.cache/") and time to live of the list (default: one day)
+    static void setCacheDirectory(const std::string& directory);
+    static std::string getCacheDirectory();
+    void setTimeToLive(std::chrono::seconds timeToLive);
+
+    TickerCatalog(const TickerCatalog&) = delete;
+    TickerCatalog& operator=(const TickerCatalog&) = delete;
+    ~TickerCatalog();
+
+    // Gets all the tickers. The first call loads them from the cache file or, if there is no
+    // cache file, with the loader; later calls only use the loader to refresh a stale list
+    std::vector<std::string> tickers(const Loader& loader);
+
+    // Loads the catalog like tickers() does, without copying the list
+    void ensureLoaded(const Loader& loader);
+
+    // Returns true if the ticker belongs to the catalog (the catalog must have been loaded)
+    bool contains(std::string_view ticker) const {return id(ticker) != INVALID_PAIR_ID;}
+
+    // Returns the id of the ticker, or INVALID_PAIR_ID if the ticker does not belong to the catalog
+    PairId id(std::string_view ticker) const;
+
+    // Downloads the list with the loader, on the calling thread
+    void refresh(const Loader& loader);
+
+    Stats stats() const;
+    const std::string& cacheFile() const {return cacheFile_;}
+
+private:
+    explicit TickerCatalog(const std::string& source);
+
+    static std::unordered_map<std::string, std::unique_ptr<TickerCatalog>>& registry();
+
+    mutable std::mutex mutex_;
+    std::vector<std::string> tickers_;
+    std::vector<bool> members_; // indexed by PairId: true if the pair belongs to the catalog
+    std::chrono::system_clock::time_point updatedAt_{};
+    std::chrono::seconds timeToLive_{24 * 3600};
+    bool loaded_ = false;
+    bool stopped_ = false; // no background download is started any more
+    std::string cacheFile_;
+    Stats stats_;
+
+    std::mutex loadMutex_; // serializes the loads, so that concurrent first calls download the list only once
+    std::atomic<bool> refreshing_{false};
+    std::thread refreshThread_;
+
+    void refreshInBackground(const Loader& loader);
+    void setTickers(std::vector<std::string> tickers, std::chrono::system_clock::time_point updatedAt);
+    bool readCache();
+    void writeCache() const;
+};
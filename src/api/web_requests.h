@@ -1,11 +1,18 @@
+#pragma once
+
 #include <string> 
 #include <sstream>
 #include <iostream>
 #include <cstdio>
+#include <memory>
+#include "http_client.h"
 
 /*
- * The class makes use of `curl` to perform web requests. The 'request' method performs the actual web requests,
+ * The class performs web requests. The 'request' method performs the actual web requests,
  * given an url as input. The 'setMaxConnectionTime' method sets the max waiting time for a request.
+ * Requests are served by an in-process HTTP/1.1 client which keeps the connections alive between
+ * requests; `curl` is only used as a fallback for the urls the client cannot handle (https urls
+ * when the program is built without OpenSSL). 
  */
 
 class HttpRequest {
@@ -19,7 +26,7 @@ public:
         this->buildCommand();
     } 
 
-    std::string getUserAgentHeader() const {return userAgentHeader;} 
+    const std::string& getUserAgentHeader() const {return userAgentHeader;} 
     int getMaxConnectionTime() const {return maxConnectionTime;} 
 
     void setUserAgentHeader(std::string newAgentHeader) {userAgentHeader = newAgentHeader; this->buildCommand();}
@@ -33,21 +40,32 @@ public:
         return cmd; 
     }
 
-    // Performs the web request 
+    // Performs the web request; returns an empty string if the request fails 
     std::string request(const std::string& url) const {
-        return exec((cmd + "\"" + url + "\"").c_str()); 
+        if (!HttpClient::supports(url)) return exec((cmd + "\"" + url + "\"").c_str()); 
+        auto response = client->get(url, {userAgentHeader}, Deadline::in(maxConnectionTime)); 
+        if (!response.ok()) return ""; 
+        return std::move(response.body); 
+    } 
+
+    // Performs the web request, passing the response body to the sink while it is received, so that 
+    // the body is never held in memory as a whole; returns false if the request fails 
+    bool request(const std::string& url, const HttpResponseParser::BodySink& sink) const {
+        if (!HttpClient::supports(url)) return exec((cmd + "\"" + url + "\"").c_str(), sink); 
+        return client->get(url, {userAgentHeader}, Deadline::in(maxConnectionTime), sink).ok(); 
     } 
 
 
 private:
     std::string cmd; 
+    std::shared_ptr<HttpClient> client = std::make_shared<HttpClient>(); 
     std::string userAgentHeader = "User-Agent: Mozilla/5.0"; 
     int maxConnectionTime = 100; // max connection time 
 
     // Creates the base curl command for the web request (without url) 
     void buildCommand() {
         if (cmd.size() != 0) cmd.clear(); 
-        cmd = "curl -s -H \"" + userAgentHeader + "\" "; 
+        cmd = "curl -s --compressed -H \"" + userAgentHeader + "\" "; 
         if (maxConnectionTime != -1) {
             cmd += "--max-time " + std::to_string(maxConnectionTime) + " "; 
         }
@@ -68,4 +86,14 @@ private:
         return result;
     }
 
+    // Executes a terminal command, passing its output to the sink 
+    static bool exec(const char* cmd_, const HttpResponseParser::BodySink& sink) {
+        char buffer[16384];
+        FILE* pipe = popen(cmd_, "r");
+        if (!pipe) return false; 
+        size_t n; 
+        while ((n = fread(buffer, 1, sizeof(buffer), pipe)) > 0) sink(buffer, n); 
+        return pclose(pipe) == 0; 
+    }
+
 };
\ No newline at end of file
@@ -0,0 +1,293 @@
+#include "websocket.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <random>
+
+namespace {
+
+// SHA-1 (FIPS 180-4), only used to verify the opening handshake
+std::array<uint8_t, 20> sha1(const std::string& message) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    auto rotl = [](uint32_t x, int n) {return (x << n) | (x >> (32 - n));};
+
+    std::string data = message;
+    uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+    data += static_cast<char>(0x80);
+    while (data.size() % 64 != 56) data += '\0';
+    for (int i = 7; i >= 0; --i) data += static_cast<char>((bits >> (i * 8)) & 0xFF);
+
+    for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const auto* p = reinterpret_cast<const uint8_t*>(data.data() + chunk + i * 4);
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {f = (b & c) | (~b & d); k = 0x5A827999;}
+            else if (i < 40) {f = b ^ c ^ d; k = 0x6ED9EBA1;}
+            else if (i < 60) {f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC;}
+            else {f = b ^ c ^ d; k = 0xCA62C1D6;}
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    std::array<uint8_t, 20> digest;
+    for (int i = 0; i < 5; ++i) {
+        for (int j = 0; j < 4; ++j) digest[i * 4 + j] = static_cast<uint8_t>(h[i] >> (24 - j * 8));
+    }
+    return digest;
+}
+
+std::string base64(const uint8_t* data, size_t size) {
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < size) n |= uint32_t(data[i + 1]) << 8;
+        if (i + 2 < size) n |= uint32_t(data[i + 2]);
+        out += alphabet[(n >> 18) & 63];
+        out += alphabet[(n >> 12) & 63];
+        out += i + 1 < size ? alphabet[(n >> 6) & 63] : '=';
+        out += i + 2 < size ? alphabet[n & 63] : '=';
+    }
+    return out;
+}
+
+std::mt19937& randomEngine() {
+    thread_local std::mt19937 engine{std::random_device{}()};
+    return engine;
+}
+
+std::string toLower(std::string s) {
+    for (auto& c: s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+std::string trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t");
+    size_t end = s.find_last_not_of(" \t\r");
+    return begin == std::string::npos ? "" : s.substr(begin, end - begin + 1);
+}
+
+} // namespace
+
+std::string WebSocket::acceptKey(const std::string& key) {
+    auto digest = sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+    return base64(digest.data(), digest.size());
+}
+
+std::unique_ptr<WebSocket> WebSocket::connect(const std::string& url, const std::vector<std::string>& headers,
+                                              const Deadline& deadline, std::string& error) {
+    // ws and wss are carried by the same connections as http and https
+    size_t schemeEnd = url.find("://");
+    std::string scheme = schemeEnd == std::string::npos ? "" : toLower(url.substr(0, schemeEnd));
+    Url target;
+    if ((scheme != "ws" && scheme != "wss") || !Url::parse((scheme == "wss" ? "https" : "http") + url.substr(schemeEnd), target)) {
+        error = "invalid websocket url: " + url;
+        return nullptr;
+    }
+    auto connection = Connection::open(target, deadline, error);
+    if (!connection) return nullptr;
+
+    uint8_t nonce[16];
+    for (auto& byte: nonce) byte = static_cast<uint8_t>(randomEngine()());
+    std::string key = base64(nonce, sizeof(nonce));
+    bool defaultPort = target.port == (scheme == "wss" ? "443" : "80");
+    std::string request = "GET " + target.target + " HTTP/1.1\r\n"
+                          "Host: " + target.host + (defaultPort ? "" : ":" + target.port) + "\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Connection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: " + key + "\r\n"
+                          "Sec-WebSocket-Version: 13\r\n";
+    for (const auto& header: headers) request += header + "\r\n";
+    request += "\r\n";
+    if (!connection->writeAll(request, deadline)) {
+        error = "cannot send the websocket handshake";
+        return nullptr;
+    }
+
+    // The response ends with an empty line; the bytes after it are already websocket frames
+    std::string received;
+    size_t headersEnd;
+    while ((headersEnd = received.find("\r\n\r\n")) == std::string::npos) {
+        char chunk[4096];
+        size_t n = 0;
+        if (received.size() > 65536 || !connection->readSome(chunk, sizeof(chunk), n, deadline)) {
+            error = deadline.expired() ? "timeout" : "websocket handshake failed";
+            return nullptr;
+        }
+        received.append(chunk, n);
+    }
+
+    std::string status = received.substr(0, received.find("\r\n"));
+    if (status.compare(0, 5, "HTTP/") != 0 || status.find(" 101") == std::string::npos) {
+        error = "websocket upgrade refused: " + status;
+        return nullptr;
+    }
+    std::string accept, upgrade;
+    size_t line = received.find("\r\n") + 2;
+    while (line < headersEnd) {
+        size_t end = received.find("\r\n", line);
+        size_t colon = received.find(':', line);
+        if (colon != std::string::npos && colon < end) {
+            std::string name = toLower(received.substr(line, colon - line));
+            std::string value = trim(received.substr(colon + 1, end - colon - 1));
+            if (name == "sec-websocket-accept") accept = value;
+            else if (name == "upgrade") upgrade = toLower(value);
+        }
+        line = end + 2;
+    }
+    if (upgrade != "websocket" || accept != acceptKey(key)) {
+        error = "invalid websocket handshake response";
+        return nullptr;
+    }
+
+    std::unique_ptr<WebSocket> socket(new WebSocket(std::move(connection)));
+    socket->buffer_ = received.substr(headersEnd + 4);
+    return socket;
+}
+
+bool WebSocket::sendText(const std::string& message, const Deadline& deadline) {
+    return sendFrame(Text, message.data(), message.size(), deadline);
+}
+
+bool WebSocket::sendPing(const std::string& payload, const Deadline& deadline) {
+    return sendFrame(Ping, payload.data(), std::min<size_t>(payload.size(), 125), deadline);
+}
+
+void WebSocket::close(const Deadline& deadline) {
+    if (closed_) return;
+    const char normalClosure[2] = {static_cast<char>(1000 >> 8), static_cast<char>(1000 & 0xFF)};
+    sendFrame(Close, normalClosure, sizeof(normalClosure), deadline);
+    closed_ = true;
+}
+
+bool WebSocket::sendFrame(Opcode opcode, const char* payload, size_t size, const Deadline& deadline) {
+    if (closed_) return false;
+    std::string frame;
+    frame.reserve(size + 14);
+    frame += static_cast<char>(0x80 | opcode); // final fragment
+    if (size < 126) {
+        frame += static_cast<char>(0x80 | size);
+    } else if (size <= 0xFFFF) {
+        frame += static_cast<char>(0x80 | 126);
+        frame += static_cast<char>(size >> 8);
+        frame += static_cast<char>(size & 0xFF);
+    } else {
+        frame += static_cast<char>(0x80 | 127);
+        for (int i = 7; i >= 0; --i) frame += static_cast<char>((static_cast<uint64_t>(size) >> (i * 8)) & 0xFF);
+    }
+    // The frames of the client are masked with a random key
+    uint32_t key = randomEngine()();
+    char mask[4] = {static_cast<char>(key >> 24), static_cast<char>(key >> 16), static_cast<char>(key >> 8), static_cast<char>(key)};
+    frame.append(mask, 4);
+    for (size_t i = 0; i < size; ++i) frame += static_cast<char>(payload[i] ^ mask[i % 4]);
+    return connection_->writeAll(frame, deadline);
+}
+
+WebSocket::ReceiveStatus WebSocket::receive(std::string& message, const Deadline& deadline) {
+    while (true) {
+        uint8_t opcode;
+        bool final, error = false;
+        std::string payload;
+        while (nextFrame(opcode, final, payload, error)) {
+            lastReceived_ = Clock::now();
+            switch (opcode) {
+                case Ping:
+                    sendFrame(Pong, payload.data(), payload.size(), deadline);
+                    break;
+                case Pong:
+                    break;
+                case Close:
+                    // The closing handshake is completed by echoing the status code
+                    if (!closed_) sendFrame(Close, payload.data(), std::min<size_t>(payload.size(), 2), deadline);
+                    closed_ = true;
+                    return ReceiveStatus::Closed;
+                case Text:
+                case Binary:
+                    if (fragmented_) return ReceiveStatus::Error;
+                    if (final) {
+                        message = std::move(payload);
+                        return ReceiveStatus::Message;
+                    }
+                    fragments_ = std::move(payload);
+                    fragmented_ = true;
+                    break;
+                case Continuation:
+                    if (!fragmented_ || fragments_.size() + payload.size() > MAX_MESSAGE_SIZE) return ReceiveStatus::Error;
+                    fragments_ += payload;
+                    if (final) {
+                        message = std::move(fragments_);
+                        fragments_.clear();
+                        fragmented_ = false;
+                        return ReceiveStatus::Message;
+                    }
+                    break;
+                default:
+                    return ReceiveStatus::Error;
+            }
+        }
+        if (error) return ReceiveStatus::Error;
+
+        char chunk[16384];
+        size_t n = 0;
+        auto status = connection_->read(chunk, sizeof(chunk), n);
+        if (status == Connection::IoStatus::Ok) {
+            buffer_.erase(0, parsed_);
+            parsed_ = 0;
+            buffer_.append(chunk, n);
+            continue;
+        }
+        if (status == Connection::IoStatus::Closed) return ReceiveStatus::Closed;
+        if (status == Connection::IoStatus::Error) return ReceiveStatus::Error;
+        if (!connection_->wait(status, deadline)) return ReceiveStatus::Timeout;
+    }
+}
+
+bool WebSocket::nextFrame(uint8_t& opcode, bool& final, std::string& payload, bool& error) {
+    size_t available = buffer_.size() - parsed_;
+    if (available < 2) return false;
+    const auto* bytes = reinterpret_cast<const uint8_t*>(buffer_.data() + parsed_);
+    final = (bytes[0] & 0x80) != 0;
+    opcode = bytes[0] & 0x0F;
+    bool masked = (bytes[1] & 0x80) != 0;
+    uint64_t length = bytes[1] & 0x7F;
+    size_t header = 2;
+    if (length == 126) {
+        if (available < 4) return false;
+        length = (uint64_t(bytes[2]) << 8) | bytes[3];
+        header = 4;
+    } else if (length == 127) {
+        if (available < 10) return false;
+        length = 0;
+        for (int i = 0; i < 8; ++i) length = (length << 8) | bytes[2 + i];
+        header = 10;
+    }
+    // No extension is negotiated: the reserved bits must be 0; control frames are short and not fragmented
+    bool control = (opcode & 0x08) != 0;
+    if ((bytes[0] & 0x70) != 0 || length > MAX_MESSAGE_SIZE || (control && (length > 125 || !final))) {
+        error = true;
+        return false;
+    }
+    size_t maskOffset = header;
+    if (masked) header += 4;
+    if (available < header + length) return false;
+
+    payload.assign(buffer_, parsed_ + header, static_cast<size_t>(length));
+    if (masked) {
+        for (size_t i = 0; i < payload.size(); ++i) payload[i] = static_cast<char>(payload[i] ^ bytes[maskOffset + i % 4]);
+    }
+    parsed_ += header + static_cast<size_t>(length);
+    return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "http_client.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Client end of a WebSocket connection (RFC 6455), over a Connection (plain or TLS). The opening
+ * handshake is an HTTP/1.1 upgrade request, whose Sec-WebSocket-Accept answer is verified. Frames
+ * sent by the client are masked; the fragments of the received messages are joined, the pings are
+ * answered with pongs, and a close frame is answered before reporting the closing. Extensions
+ * (e.g. compression) are not negotiated. The object is not thread-safe: it is meant to be used by
+ * a single thread, which alternates between sending and receiving.
+ */
+class WebSocket {
+
+public:
+    enum class ReceiveStatus {Message, Timeout, Closed, Error};
+
+    // Opens the connection and performs the opening handshake; the url scheme is ws or wss.
+    // Returns nullptr (and sets error) on failure.
+    static std::unique_ptr<WebSocket> connect(const std::string& url, const std::vector<std::string>& headers,
+                                              const Deadline& deadline, std::string& error);
+
+    WebSocket(const WebSocket&) = delete;
+    WebSocket& operator=(const WebSocket&) = delete;
+
+    // Sends a text message (or a ping); returns false if the connection failed
+    bool sendText(const std::string& message, const Deadline& deadline);
+    bool sendPing(const std::string& payload, const Deadline& deadline);
+
+    // Starts the closing handshake (status code 1000: normal closure)
+    void close(const Deadline& deadline);
+
+    // Waits for the next text or binary message (control frames are handled internally). Returns Timeout
+    // if no complete message is received before the deadline: the message can still be received later.
+    ReceiveStatus receive(std::string& message, const Deadline& deadline);
+
+    // Time of the last frame (of any kind) received from the server
+    Clock::time_point lastReceived() const {return lastReceived_;}
+
+    // Largest accepted message; longer messages fail the connection
+    static constexpr size_t MAX_MESSAGE_SIZE = 16 << 20;
+
+    // Value of Sec-WebSocket-Accept expected for a Sec-WebSocket-Key (base64 of the SHA-1 of the key and the RFC GUID)
+    static std::string acceptKey(const std::string& key);
+
+private:
+    enum Opcode : uint8_t {Continuation = 0x0, Text = 0x1, Binary = 0x2, Close = 0x8, Ping = 0x9, Pong = 0xA};
+
+    explicit WebSocket(std::unique_ptr<Connection> connection): connection_(std::move(connection)) {}
+
+    std::unique_ptr<Connection> connection_;
+    std::string buffer_;     // bytes received; the first parsed_ bytes are already parsed into frames
+    size_t parsed_ = 0;
+    std::string fragments_;  // payload of the message being received, when fragmented
+    bool fragmented_ = false;
+    bool closed_ = false;
+    Clock::time_point lastReceived_ = Clock::now();
+
+    bool sendFrame(Opcode opcode, const char* payload, size_t size, const Deadline& deadline);
+
+    // Parses the next complete frame from the buffer; returns false if it is not complete yet,
+    // sets error if the frame is invalid
+    bool nextFrame(uint8_t& opcode, bool& final, std::string& payload, bool& error);
+};
@@ -0,0 +1,59 @@
+/*
+ * File: candlestickArchiveConverter.cpp
+ * Description: This program converts candlestick data between the csv files written by candlestickDataDownloader 
+ *              and the binary archives (one per crypto asset and resolution) read through a memory mapping. 
+ *              A csv file is appended to the archive (which is created if it does not exist yet); 
+ *              an archive is written to a csv file. 
+ * Author: Davide Vidotto
+ * Date: 2026-10-17
+ */
+
+#include "storage/candle_archive.h"
+#include "storage/candle_csv.h"
+#include <iostream>
+#include <string> 
+
+/*
+ *  The main function reads 2 arguments: 
+ *      - the first one is the path of the file to convert: a csv file (with the ".csv" extension) or an archive 
+ *      - the second one is the path of the converted file (the archive to append to, or the csv file to write) 
+*/
+int main (int argc, char** argv) {
+
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <input file> <output file>" << std::endl; 
+        return 1; 
+    }
+    std::string input = argv[1]; 
+    std::string output = argv[2]; 
+
+    // Csv to archive: the pair is the prefix of the csv columns 
+    if (input.size() > 4 && input.compare(input.size() - 4, 4, ".csv") == 0) {
+        CandleSeries candles; 
+        std::string pair; 
+        if (!CandleCsv::read(input, candles, &pair)) {
+            std::cerr << "Could not read the candles from " << input << std::endl; 
+            return 1; 
+        }
+        size_t added = 0; 
+        if (!CandleArchive::append(output, pair, candles, &added)) {
+            std::cerr << "Could not append the candles to " << output << std::endl; 
+            return 1; 
+        }
+        std::cout << output << " written to disk (" << added << " new candles)." << std::endl; 
+        return 0; 
+    }
+
+    // Archive to csv 
+    CandleArchive archive; 
+    if (!archive.open(input)) {
+        std::cerr << input << " is not a valid archive." << std::endl; 
+        return 1; 
+    }
+    if (!CandleCsv::write(output, archive)) {
+        std::cerr << "Could not write the candles to " << output << std::endl; 
+        return 1; 
+    }
+    std::cout << output << " written to disk (" << archive.size() << " candles)." << std::endl; 
+    return 0; 
+}
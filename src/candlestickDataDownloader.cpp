@@ -13,6 +13,7 @@ make
 
 #include "api/api.h"
 #include "api/bitstamp_api.h"
+#include "api/coalescing_api.h"
 #include "crypto_market_data/market_data_fetcher.h"
 #include "json_reader/json_reader.h"
 #include "utils/utils.h"
@@ -24,13 +25,15 @@ make
 #include <unordered_map>
 
 /*
- *  The main function can read 0 to 5 optional arguments: 
+ *  The main function can read 0 to 6 optional arguments: 
  *      - the first one is the path of the file containing the coin names for wich we want to fetch the market data
  *      - the second one is the optional path where the csv files can be stored; 
  *        specify "" or '' if you don't want to save the data into csv files
  *      - the third one is the optional fiat currency name against which the crypto is valuated, defalts to "USD"
  *      - the fourth one is the wait time which specifies the number of seconds to wait for the next data refresh 
  *      - the fifth one is the path of the file containing the options for the candlestick api request (Api/exchange-dependent) 
+ *      - the sixth one is the output format, "csv" (default) or "archive": in the latter case the candles are appended 
+ *        to one binary archive per crypto asset and resolution (see candlestickArchiveConverter to convert them back to csv) 
 */
 int main (int argc, char** argv) {
 
@@ -57,13 +60,19 @@ int main (int argc, char** argv) {
 
     try {
         std::string ohlcFilename = argc > 5 ? argv[5] : "./config/ohlc_params.json"; 
-        ohlcParams = JsonReader(ohlcFilename, true).get(); 
+        ohlcParams = JsonReader(ohlcFilename, true).take(); 
     }
     catch (const std::exception& e) {
         std::cerr << "Could not read the OHLC parameters from " << argv[4] << std::endl; 
         return 1; 
     }
 
+    bool toArchive = argc > 6 && std::string(argv[6]) == "archive"; 
+    if (argc > 6 && !toArchive && std::string(argv[6]) != "csv") {
+        std::cerr << "Invalid output format (please specify csv or archive)." << std::endl; 
+        return 1; 
+    }
+
     // Import crypto names from file
     std::vector<std::string> cryptoNames;
     try {
@@ -74,16 +83,21 @@ int main (int argc, char** argv) {
         return 1; 
     }
 
-    // Create Api request handlers -- in this case, from Bitstamp Api service
+    // Create Api request handlers -- in this case, from Bitstamp Api service. 
+    // Historical downloads use the backfill lane, so that they never delay the live requests; identical 
+    // requests of different handlers (e.g. a coin listed twice) are sent once 
     std::vector<std::unique_ptr<Api>> apiRequesters; 
     for (size_t i=0; i < cryptoNames.size(); ++i) {
-        apiRequesters.push_back(std::make_unique<BitstampApi>(wait_time)); 
+        auto apiRequester = std::make_unique<BitstampApi>(wait_time); 
+        apiRequester->setLane(RequestScheduler::Lane::Backfill); 
+        apiRequesters.push_back(std::make_unique<CoalescingApi>(std::move(apiRequester))); 
     }
 
     // Create the market data fetcher object and download the data
     std::cout << "Downloading the data. Please wait...\n" << std::endl; 
 
     MarketDataFetcher marketDataFetcher; 
-    marketDataFetcher.downloadMultiCoinCandlestickData(cryptoNames, apiRequesters, ohlcParams, "timestamp", outputFilesPath, {}, fiatName); 
+    marketDataFetcher.downloadMultiCoinCandlestickData(cryptoNames, apiRequesters, ohlcParams, "timestamp", outputFilesPath, {}, fiatName, toArchive); 
+    MarketDataFetcher::printRequestStats(); 
     return 0; 
 }
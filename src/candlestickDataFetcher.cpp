@@ -10,6 +10,7 @@
 
 #include "api/api.h"
 #include "api/bitstamp_api.h"
+#include "api/coalescing_api.h"
 #include "crypto_market_data/market_data_fetcher.h"
 #include "json_reader/json_reader.h"
 #include "utils/utils.h"
@@ -54,7 +55,7 @@ int main (int argc, char** argv) {
 
     try {
         std::string ohlcFilename = argc > 5 ? argv[5] : "./config/ohlc_params.json"; 
-        ohlcParams = JsonReader(ohlcFilename, true).get(); 
+        ohlcParams = JsonReader(ohlcFilename, true).take(); 
     }
     catch (const std::exception& e) {
         std::cerr << "Could not read the OHLC parameters from " << argv[4] << std::endl; 
@@ -71,15 +72,17 @@ int main (int argc, char** argv) {
         return 1; 
     }
 
-    // Create Api request handlers -- in this case, from Bitstamp Api service
+    // Create Api request handlers -- in this case, from Bitstamp Api service. 
+    // Identical requests of different handlers (e.g. a coin listed twice) are sent once 
     std::vector<std::unique_ptr<Api>> apiRequesters; 
     for (size_t i=0; i < cryptoNames.size(); ++i) {
-        apiRequesters.push_back(std::make_unique<BitstampApi>(wait_time)); 
+        apiRequesters.push_back(std::make_unique<CoalescingApi>(std::make_unique<BitstampApi>(wait_time))); 
     }
 
     // Create the market data fetcher object and fetch the data
     MarketDataFetcher marketDataFetcher; 
     marketDataFetcher.fetchMultiCoinCandlestickData(cryptoNames, apiRequesters, ohlcParams, "timestamp", {}, fiatName, csvFormat); 
+    MarketDataFetcher::printRequestStats(); 
 
     return 0; 
 }
\ No newline at end of file
@@ -2,41 +2,91 @@
 #include <unordered_map>
 
 void CryptoDataUpdater::updateMarketData() {
-    lastMarketData = apiRequester_->fetchMarketTicker(pair_); 
+    lastTicker = apiRequester_->fetchTicker(pair_); 
+}
+
+void CryptoDataUpdater::updateMarketData(const Ticker& ticker) {
+    lastTicker = ticker; 
 }
 
 std::string CryptoDataUpdater::fetchMarketData(const std::string& field) {
-    if (lastMarketData.empty()) updateMarketData(); 
-    return lastMarketData[field];
+    const auto& ticker = fetchTicker(); 
+    Ticker::Field f; 
+    return Ticker::find(field, f) ? ticker.text(f) : "";
 }
 
+// The fields are selected by the mask of their names 
 MarketData CryptoDataUpdater::fetchMarketData(const std::vector<std::string>& fields) {
-    if (lastMarketData.empty()) updateMarketData(); 
-    if (fields.size() == 0) return lastMarketData;
-    MarketData filteredMarketData; 
-    for (const auto& m: lastMarketData) {
-        if (std::find(fields.begin(), fields.end(), m.first) != fields.end()) 
-            filteredMarketData[m.first] = m.second;
+    return fetchTicker().toMap(Ticker::project(fields).mask); 
+}
+
+const Ticker& CryptoDataUpdater::fetchTicker() {
+    if (lastTicker.empty()) updateMarketData(); 
+    return lastTicker; 
+}
+
+CurrencyScales::PairScale CryptoDataUpdater::getPairScale() const {
+    if (!pairScaleLoaded_) {
+        pairScale_ = CurrencyScales::forApi(*apiRequester_)->pair(name_, fiat_); 
+        pairScaleLoaded_ = true; 
     }
-    return filteredMarketData; 
+    return pairScale_; 
+}
+
+void CryptoDataUpdater::applyScale(CandleSeries& series, CurrencyScales::PairScale scale) {
+    for (const auto column: {CandleSeries::Open, CandleSeries::High, CandleSeries::Low, CandleSeries::Close}) {
+        if (series.scale[column] < scale.price) series.rescale(column, scale.price); 
+    }
+    if (series.scale[CandleSeries::Volume] < scale.amount) series.rescale(CandleSeries::Volume, scale.amount); 
+}
+
+CandleSeries CryptoDataUpdater::fetchCandlestickData(const std::unordered_map<std::string,std::string>& args, CandleSeries::Mask columns) {
+    auto series = apiRequester_->fetchCandleSeries(pair_, args, columns); 
+    applyScale(series, getPairScale()); 
+    return series; 
 }
 
-std::vector<MarketData> CryptoDataUpdater::fetchCandlestickData(
+void CryptoDataUpdater::requestMarketData(std::function<void(Ticker)> callback) const {
+    apiRequester_->fetchTickerAsync(pair_, std::move(callback)); 
+}
+
+void CryptoDataUpdater::requestCandlestickData(
+    const std::unordered_map<std::string,std::string>& args, 
+    std::function<void(CandleSeries)> callback, 
+    CandleSeries::Mask columns
+) const {
+    requestCandlestickData(args, CandleSeries{}, std::move(callback), columns); 
+}
+
+void CryptoDataUpdater::requestCandlestickData(
     const std::unordered_map<std::string,std::string>& args, 
-    std::vector<std::string> fields
+    CandleSeries series, 
+    std::function<void(CandleSeries)> callback, 
+    CandleSeries::Mask columns
+) const {
+    apiRequester_->fetchCandleSeriesIntoAsync(pair_, args, std::move(series), [scale = getPairScale(), callback = std::move(callback)](CandleSeries series) {
+        applyScale(series, scale); 
+        callback(std::move(series)); 
+    }, columns); 
+}
+
+void CryptoDataUpdater::requestCandlestickUpdate(
+    const std::unordered_map<std::string,std::string>& args, 
+    CandleSeries series, 
+    std::function<void(CandleSeries)> callback, 
+    CandleSeries::Mask columns
 ) {
-    auto candlestickData = apiRequester_->fetchCandlestickData(pair_, args);
-    std::vector<MarketData> retData(candlestickData.size());   
-    for (size_t i = 0; i < candlestickData.size(); ++i) {
-        if (fields.size() == 0) retData.at(i) = candlestickData.at(i); 
-        else {
-            MarketData filteredMarketData; 
-            for (const auto& m: candlestickData.at(i)) {
-                if (std::find(fields.begin(), fields.end(), m.first) != fields.end()) 
-                    filteredMarketData[m.first] = m.second; 
-            }
-            retData.at(i) = filteredMarketData;  
-        } 
+    sinceRequest_ = !candles_.empty() && apiRequester_->sinceCandlestickArgs(args, candles_.timestamp.back(), sinceArgs_, candlesWindow_); 
+    requestCandlestickData(sinceRequest_ ? sinceArgs_ : args, std::move(series), std::move(callback), columns); 
+}
+
+bool CryptoDataUpdater::updateCandlestickData(CandleSeries& candles) {
+    if (candles.empty()) return false; 
+    if (!sinceRequest_) {
+        std::swap(candles_, candles); 
+        return true; 
     }
-    return retData; 
-}
\ No newline at end of file
+    if (candles_.merge(candles, candlesWindow_)) return true; 
+    candles_.clear(); 
+    return false; 
+}
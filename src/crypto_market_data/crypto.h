@@ -1,7 +1,9 @@
 #pragma  once 
 
 #include "../api/api.h"
+#include "../api/currency_scales.h"
 #include <algorithm>
+#include <functional>
 #include <unordered_map>
 #include "../json_reader/json_reader.h"
 #include "../json_reader/multi_json_reader.h"
@@ -27,7 +29,8 @@ public:
         name_(name), apiRequester_(&apiRequester), maxConnectionTime_(maxConnectionTime) {
             apiRequester_->setMaxConnectionTime(maxConnectionTime_); 
             pair_ = apiRequester_->makePair(name_, fiat_);  
-            if (!apiRequester_->validatePair(pair_)) {
+            pairId_ = apiRequester_->pairId(pair_); 
+            if (pairId_ == INVALID_PAIR_ID) {
                 throw std::invalid_argument("Invalid input: " + pair_ + " not among the API tickers."); 
             }
     }
@@ -36,7 +39,8 @@ public:
         name_(name), apiRequester_(&apiRequester), maxConnectionTime_(apiRequester.getMaxConnectionTime()) {
             apiRequester_->setMaxConnectionTime(maxConnectionTime_); 
             pair_ = apiRequester_->makePair(name_, fiat_);  
-            if (!apiRequester_->validatePair(pair_)) {
+            pairId_ = apiRequester_->pairId(pair_); 
+            if (pairId_ == INVALID_PAIR_ID) {
                 throw std::invalid_argument("Invalid input: " + pair_ + " not among the API tickers."); 
             }
     }
@@ -45,7 +49,8 @@ public:
         name_(name), fiat_(fiat), apiRequester_(&apiRequester), maxConnectionTime_(maxConnectionTime) {
             apiRequester_->setMaxConnectionTime(maxConnectionTime_); 
             pair_ = apiRequester_->makePair(name_, fiat_); 
-            if (!apiRequester_->validatePair(pair_)) {
+            pairId_ = apiRequester_->pairId(pair_); 
+            if (pairId_ == INVALID_PAIR_ID) {
                 throw std::invalid_argument("Invalid input: " + pair_ + " not among the API tickers."); 
             }
     } 
@@ -54,7 +59,8 @@ public:
         name_(name), fiat_(fiat), apiRequester_(&apiRequester), maxConnectionTime_(apiRequester.getMaxConnectionTime()) {
             apiRequester_->setMaxConnectionTime(maxConnectionTime_); 
             pair_ = apiRequester_->makePair(name_, fiat_); 
-            if (!apiRequester_->validatePair(pair_)) {
+            pairId_ = apiRequester_->pairId(pair_); 
+            if (pairId_ == INVALID_PAIR_ID) {
                 throw std::invalid_argument("Invalid input: " + pair_ + " not among the API tickers."); 
             }
     } 
@@ -76,27 +82,79 @@ public:
     // Api request handler getter
     Api* getApiRequester() const {return apiRequester_;}
 
-    void updateMarketData(); // updates the lastMarketData object
+    // Pair name, according to the exchange's taxonomy, and its integer id 
+    const std::string& getPair() const {return pair_;}
+    PairId getPairId() const {return pairId_;}
+
+    void updateMarketData(); // updates the lastTicker object
+    void updateMarketData(const Ticker& ticker); // updates the lastTicker object with data fetched elsewhere (e.g. in bulk)
     std::string fetchMarketData(const std::string& field); // fetches a specific field of the latest market data
     
-    // updates and gets the lastMarketData object (returns a map) 
+    // updates and gets the lastTicker object (as a map) 
     // The optional fields parameter specifies which market data components to returns 
     MarketData fetchMarketData(const std::vector<std::string>& fields = {});
 
-    // Gets the candlestick data
-    // The args parameter specifies the parameters for tha Api web request 
-    // The fields parameter specifies which components of the candlestick to return 
-    std::vector<MarketData> fetchCandlestickData(
+    // updates and gets the lastTicker object, without copying it (see ticker.h) 
+    const Ticker& fetchTicker(); 
+
+    // Fixed-point scales of the prices and amounts of the pair (see currency_scales.h) 
+    CurrencyScales::PairScale getPairScale() const; 
+
+    // Gets the candlestick data as columns, at the scales of the pair (see candle_series.h) 
+    // The args parameter specifies the parameters for tha Api web request, columns the components to decode 
+    CandleSeries fetchCandlestickData(const std::unordered_map<std::string,std::string>& args, CandleSeries::Mask columns = CandleSeries::ALL);
+
+    // Asynchronous requests: the callback receives the data (empty on failure) on a thread of the Api; 
+    // the object is not modified (see updateMarketData) 
+    void requestMarketData(std::function<void(Ticker)> callback) const; 
+    void requestCandlestickData(
+        const std::unordered_map<std::string,std::string>& args, 
+        std::function<void(CandleSeries)> callback, 
+        CandleSeries::Mask columns = CandleSeries::ALL
+    ) const; 
+
+    // Same, decoding into a lent series whose buffers are reused (see Api::fetchCandleSeriesIntoAsync) 
+    void requestCandlestickData(
         const std::unordered_map<std::string,std::string>& args, 
-        std::vector<std::string> fields = {}
-    );
+        CandleSeries series, 
+        std::function<void(CandleSeries)> callback, 
+        CandleSeries::Mask columns = CandleSeries::ALL
+    ) const; 
+
+    // Requests only the candles from the newest one held on (see Api::sinceCandlestickArgs), or the whole 
+    // window if none is held; the result must be handed to updateCandlestickData 
+    void requestCandlestickUpdate(
+        const std::unordered_map<std::string,std::string>& args, 
+        CandleSeries series, 
+        std::function<void(CandleSeries)> callback, 
+        CandleSeries::Mask columns = CandleSeries::ALL
+    ); 
+
+    // Merges the candles received into the candles held (see CandleSeries::merge); candles is left with a 
+    // series to lend to the next request. Returns false on failure (the next request fetches the whole window) 
+    bool updateCandlestickData(CandleSeries& candles); 
+
+    // Candles held by the object (empty before the first update) 
+    const CandleSeries& getCandlestickData() const {return candles_;}
 
 private:
     std::string name_; 
     std::string fiat_ = "USD"; 
     std::string pair_; 
+    PairId pairId_ = INVALID_PAIR_ID; 
 
     Api* apiRequester_; 
     int maxConnectionTime_;
-    MarketData lastMarketData;  
+    Ticker lastTicker;  
+    mutable CurrencyScales::PairScale pairScale_; 
+    mutable bool pairScaleLoaded_ = false; 
+
+    // Incremental candlestick data 
+    CandleSeries candles_; 
+    size_t candlesWindow_ = 0; // number of candles kept (0: as many as the whole window received) 
+    bool sinceRequest_ = false; // whether the request in flight only asks for the latest candles 
+    std::unordered_map<std::string,std::string> sinceArgs_; 
+
+    // Brings the prices and volumes of the series to the given scales, where they fit exactly 
+    static void applyScale(CandleSeries& series, CurrencyScales::PairScale scale); 
 }; 
\ No newline at end of file
@@ -1,49 +1,144 @@
 #include "market_data_fetcher.h"
+#include "../api/coalescing_api.h"
+#include "../api/connection_pool.h"
+#include "../api/hedging_http_client.h"
+#include "../api/request_scheduler.h"
+#include "../storage/candle_archive.h"
+#include <limits>
 #include <memory>
 #include <stdexcept>
 #include <utility>
 
 std::atomic<bool> MarketDataFetcher::terminateFlag{false};
 std::atomic<bool> MarketDataFetcher::terminateInnerLoopFlag{false};
-std::atomic<bool> MarketDataFetcher::terminateOuterLoopFlag{false};
 
-// For a specific crypto asset, it fetches the real time (most recent) market data
-void MarketDataFetcher::fetchCoinMarketData(
-    const std::string& name, 
-    const std::unique_ptr<Api>& apiRequester, 
-    const std::string& timestampField,
-    const std::vector<std::string>& fields,
-    const std::string& fiat
+namespace {
+
+using Clock = std::chrono::steady_clock; 
+
+// Max time spent waiting before the termination flags are checked again 
+constexpr auto WAIT_SLICE = std::chrono::milliseconds(200); 
+
+/*
+ * Results of asynchronous requests, pushed by the threads of the Api request handlers and 
+ * taken by the calling thread. Each result is tagged with the index of its crypto asset. 
+ * The queue is shared with the callbacks of the requests, so that the results arriving after 
+ * the caller returned are simply discarded. 
+ */
+template<typename T>
+class CompletionQueue {
+public:
+    void push(size_t index, T result) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_); 
+            results_.emplace_back(index, std::move(result)); 
+        }
+        ready_.notify_one(); 
+    }
+
+    // Waits for results until the given time (at most WAIT_SLICE), and takes all the available ones 
+    std::vector<std::pair<size_t, T>> pop(Clock::time_point until) {
+        std::vector<std::pair<size_t, T>> results; 
+        pop(until, results); 
+        return results; 
+    }
+
+    // Same, but the results are swapped into a vector of the caller: the queue and the caller keep 
+    // reusing the same two buffers, so that taking the results allocates nothing once they are large enough 
+    void pop(Clock::time_point until, std::vector<std::pair<size_t, T>>& results) {
+        results.clear(); 
+        std::unique_lock<std::mutex> lock(mutex_); 
+        ready_.wait_until(lock, std::min(until, Clock::now() + WAIT_SLICE), [this]() {return !results_.empty();}); 
+        results.swap(results_); 
+    }
+
+private:
+    std::mutex mutex_; 
+    std::condition_variable ready_; 
+    std::vector<std::pair<size_t, T>> results_; 
+}; 
+
+// Sleeps until the given time, unless the flag is set in the meantime 
+void sleepUntil(Clock::time_point until, const std::atomic<bool>& flag) {
+    while (!flag.load() && Clock::now() < until) std::this_thread::sleep_for(std::min<Clock::duration>(WAIT_SLICE, until - Clock::now())); 
+}
+
+// Value of lastTimestamp before the first update, and when the timestamp field is missing 
+constexpr int64_t MISSING_TIMESTAMP = std::numeric_limits<int64_t>::min(); 
+
+// Field of the timestamps of the market data; Ticker::FIELDS if the name is not a field of the records, in which 
+// case every update is printed 
+Ticker::Field timestampOf(const std::string& timestampField) {
+    Ticker::Field timestamp; 
+    return Ticker::find(timestampField, timestamp) ? timestamp : Ticker::FIELDS; 
+}
+
+// Prints the market data of a crypto asset if their timestamp differs from the last one printed 
+void printIfChanged(
+    const Ticker& ticker, Ticker::Field timestamp, const std::string& label, const Ticker::Projection& projection, 
+    int64_t& lastTimestamp, std::string& message, std::mutex& coutMutex
 ) {
-    try {
-        CryptoDataUpdater crypto(name, fiat, *apiRequester); 
-        std::unordered_map<std::string, std::string> marketData;  
-        std::string lastTimestamp{""}; 
-    
-        while (!terminateFlag.load()) {
-            crypto.updateMarketData(); 
-            marketData = crypto.fetchMarketData(); 
-            if (lastTimestamp != marketData[timestampField]) {
-                lastTimestamp = marketData[timestampField]; 
-                {
-                    std::lock_guard<std::mutex> lock(coutMutex); 
-                    std::cout << Utils::mapToMessage(name + "/" + fiat, marketData, fields).str() << std::endl; 
-                    std::cout << std::string(50, '-') << std::endl; 
-                }
-            }
-            std::this_thread::sleep_for(std::chrono::seconds(WAIT_TIME)); 
-        } 
-    } 
-    catch(std::invalid_argument) {
-        std::cout << name << " : invalid coin name." << std::endl; 
-        return; 
+    if (timestamp < Ticker::FIELDS) {
+        const int64_t time = ticker.has(timestamp) ? ticker.units[timestamp] : MISSING_TIMESTAMP; 
+        if (time == lastTimestamp) return; 
+        lastTimestamp = time; 
     }
+    message.clear(); 
+    ticker.appendMessage(label, projection, message); 
+    static const std::string separator(50, '-'); 
+    std::lock_guard<std::mutex> lock(coutMutex); 
+    std::cout << message << std::endl; 
+    std::cout << separator << std::endl; 
+}
+
+// Issues the candlestick data request of a crypto asset, whose data are decoded into the given buffer and pushed 
+// to the queue; in incremental mode, only the candles which may have changed are requested 
+void requestCandles(
+    CryptoDataUpdater& crypto, const std::unordered_map<std::string, std::string>& args, CandleSeries buffer, 
+    const std::shared_ptr<CompletionQueue<CandleSeries>>& completions, size_t k, CandleSeries::Mask columns, bool incremental
+) {
+    auto callback = [completions, k](CandleSeries candlestickData) {
+        completions->push(k, std::move(candlestickData)); 
+    }; 
+    if (incremental) crypto.requestCandlestickUpdate(args, std::move(buffer), std::move(callback), columns); 
+    else crypto.requestCandlestickData(args, std::move(buffer), std::move(callback), columns); 
+}
+
+// Candles of a crypto asset once its request completed: in incremental mode, the candles received are merged into 
+// the candles held by the crypto asset. Returns nullptr if they could not be merged: the whole window must be 
+// requested again (the candles received are then left as a buffer) 
+const CandleSeries* receivedCandles(CryptoDataUpdater& crypto, CandleSeries& candles, bool incremental) {
+    if (!incremental) return &candles; 
+    if (crypto.updateCandlestickData(candles)) return &crypto.getCandlestickData(); 
+    return candles.empty() ? &candles : nullptr; // a failed request is shown as in the other mode 
+}
 
-    std::cout << name << ": thread terminated." << std::endl; 
+// Stores the market data received for a crypto asset, and reads the latest ones back from the store into view: 
+// the market data printed are the ones of the store (or the ones of the crypto asset, if the store could not keep them) 
+const Ticker& storeTicker(MarketDataStore& store, CryptoDataUpdater& crypto, const Ticker& ticker, Ticker& view) {
+    crypto.updateMarketData(ticker); 
+    store.append(crypto.getPairId(), ticker); 
+    return store.latest(crypto.getPairId(), view) ? view : crypto.fetchTicker(); 
 }
 
-// It calls asynchronously the fetchCoinMarketData method, 
-// to handle multiple crypto-assets requests simultaneosly. 
+// Resolution of the candles requested for a crypto asset with the ohlc arguments (see Api::candlestickResolution) 
+int64_t candleResolution(const CryptoDataUpdater& crypto, const std::unordered_map<std::string, std::string>& ohlcArgs) {
+    return crypto.getApiRequester()->candlestickResolution(ohlcArgs); 
+}
+
+// Stores the candles received for a pair at the resolution they were requested at, and reads the latest ones (as many 
+// as received) back from the store into view: the candles printed or exported are the ones of the store. Returns the 
+// candles received if the store could not keep them (e.g. with a null budget, or an unknown resolution) 
+const CandleSeries& storeCandles(MarketDataStore& store, PairId id, int64_t resolution, const CandleSeries& candles, CandleSeries& view) {
+    if (candles.empty() || !store.append(id, resolution, candles)) return candles; 
+    return store.latest(id, resolution, candles.size(), view) ? view : candles; 
+}
+
+} // namespace
+
+// Issues a market data request for each crypto asset every WAIT_TIME seconds (skipping the assets whose 
+// previous request is still outstanding), and prints the data of the crypto assets whose timestamp changed. 
+// All the requests are outstanding at the same time, while the results are handled on the calling thread. 
 void MarketDataFetcher::fetchMultiCoinMarketData(
     const std::vector<std::string>& cryptoNames,
     const std::vector<std::unique_ptr<Api>>& apiRequesters,
@@ -54,170 +149,266 @@ void MarketDataFetcher::fetchMultiCoinMarketData(
     if (cryptoNames.size() != apiRequesters.size())
         throw std::runtime_error("Number of cryptos and number of api request handlers must be equal.");
 
-    std::vector<std::thread> threads; 
+    std::vector<size_t> indices; 
+    auto cryptos = makeUpdaters(cryptoNames, apiRequesters, fiat, indices); 
+    std::vector<std::string> labels; 
+    for (const auto i: indices) labels.push_back(cryptoNames.at(i) + "/" + fiat); 
+
+    // The records are handled in place, and their messages are written into the same string: nothing is 
+    // allocated per update 
+    const Ticker::Field timestamp = timestampOf(timestampField); 
+    const auto projection = Ticker::project(fields); 
+    std::vector<int64_t> lastTimestamps(cryptos.size(), MISSING_TIMESTAMP); 
+    std::vector<bool> inFlight(cryptos.size(), false); 
+    auto completions = std::make_shared<CompletionQueue<Ticker>>(); 
+    std::vector<std::pair<size_t, Ticker>> results; 
+    Ticker view; 
+    std::string message; 
+    auto nextRefresh = Clock::now(); 
+
+    while (!terminateFlag.load() && !cryptos.empty()) {
+        if (Clock::now() >= nextRefresh) {
+            nextRefresh = Clock::now() + std::chrono::seconds(WAIT_TIME); 
+            for (size_t i = 0; i < cryptos.size(); ++i) {
+                if (inFlight.at(i)) continue; 
+                inFlight.at(i) = true; 
+                cryptos.at(i)->requestMarketData([completions, i](Ticker ticker) {
+                    completions->push(i, ticker); 
+                }); 
+            }
+        }
 
-    for (int i = 0; i < cryptoNames.size(); ++i) {
-        threads.emplace_back([this, &cryptoNames, i, &apiRequesters, &fiat, &timestampField, &fields]() {
-            fetchCoinMarketData(cryptoNames.at(i), apiRequesters.at(i), timestampField, fields, fiat
-        );}); 
+        completions->pop(nextRefresh, results); 
+        for (const auto& completion: results) {
+            size_t i = completion.first; 
+            inFlight.at(i) = false; 
+            if (completion.second.empty()) continue; // failed request: retried at the next refresh 
+            const auto& ticker = storeTicker(store_, *cryptos.at(i), completion.second, view); 
+            printIfChanged(ticker, timestamp, labels.at(i), projection, lastTimestamps.at(i), message, coutMutex); 
+        }
     }
-    for (auto& t: threads) t.join(); 
+
+    std::cout << "Polling terminated." << std::endl; 
 }
 
-// It fetches candlestick data for a specific crypto assets, and send it to the calling thread. 
-// It notifies the calling thread when the corresponding data are ready. 
-void MarketDataFetcher::fetchAndSendCoinCandlestickData (
-    const std::string& name, 
-    const int threadNumber, 
-    const std::unique_ptr<Api>& apiRequester, 
-    std::vector<bool>& threadsReady, 
-    std::unordered_map<std::string, std::vector<std::unordered_map<std::string, std::string>>>& data, 
-    const std::unordered_map<std::string, std::string>& ohlcArgs,
+// It fetches the market data of all the crypto assets in one go (on the calling thread), 
+// and prints the data of the crypto assets whose timestamp changed since the previous refresh. 
+void MarketDataFetcher::pollMultiCoinMarketData(
+    const std::vector<std::string>& cryptoNames,
+    const std::unique_ptr<Api>& apiRequester,
+    const std::string& timestampField,
     const std::vector<std::string>& fields, 
-    const std::string& fiat, 
-    bool notifyEnd
+    const std::string& fiat
 ) {
-    try {
-        CryptoDataUpdater crypto(name, fiat, *apiRequester); 
-    
-        while (!terminateInnerLoopFlag.load()) {
-            if (!threadsReady.at(threadNumber)) {
-                data[name] = crypto.fetchCandlestickData(ohlcArgs, fields); 
-
-                // std::lock_guard<std::mutex> l(mapMutex); 
-                threadsReady.at(threadNumber) = true; 
-                {
-                    std::lock_guard<std::mutex> dataReadyLock(dataReadyMutex);
-                    dataReady.notify_all(); 
-                }
-                std::this_thread::sleep_for(std::chrono::seconds(WAIT_TIME)); 
-            }
+    std::vector<std::unique_ptr<CryptoDataUpdater>> cryptos; 
+    std::vector<std::string> labels; 
+    std::vector<PairId> pairIds; 
+    for (const auto& name: cryptoNames) {
+        try {
+            cryptos.push_back(std::make_unique<CryptoDataUpdater>(name, fiat, *apiRequester)); 
+            labels.push_back(name + "/" + fiat); 
+            pairIds.push_back(cryptos.back()->getPairId()); 
         } 
-    } 
-    catch(std::invalid_argument) {
-        std::cout << name << " : invalid coin name." << std::endl; 
-        {
-            threadsReady.at(threadNumber) = true; 
-            std::lock_guard<std::mutex> dataReadyLock(dataReadyMutex);
-            dataReady.notify_all(); 
+        catch(const std::invalid_argument&) {
+            std::cout << name << " : invalid coin name." << std::endl; 
         }
-        // terminateInnerLoopFlag.store(true); 
-        // return; 
     }
 
-    std::cout << name << ": thread terminated." << std::endl; 
-    if (notifyEnd) {
-        std::lock_guard<std::mutex> dataReadyLock(dataReadyMutex);
-        dataReady.notify_all(); 
+    const Ticker::Field timestamp = timestampOf(timestampField); 
+    const auto projection = Ticker::project(fields); 
+    std::vector<int64_t> lastTimestamps(cryptos.size(), MISSING_TIMESTAMP); 
+    std::vector<Ticker> tickers; 
+    Ticker view; 
+    std::string message; 
+    while (!terminateFlag.load() && !cryptos.empty()) {
+        if (apiRequester->fetchTickers(pairIds, tickers)) {
+            for (size_t i = 0; i < cryptos.size(); ++i) {
+                if (tickers.at(i).empty()) continue; 
+                const auto& ticker = storeTicker(store_, *cryptos.at(i), tickers.at(i), view); 
+                printIfChanged(ticker, timestamp, labels.at(i), projection, lastTimestamps.at(i), message, coutMutex); 
+            }
+        }
+        sleepUntil(Clock::now() + std::chrono::seconds(WAIT_TIME), terminateFlag); 
     }
+
+    std::cout << "Polling terminated." << std::endl; 
 }
 
-// It fetches and prints to screen the candlestick data for a specific crypto asset. 
-// If csvFormat = false, it returns the data in tabular form. 
-void MarketDataFetcher::fetchAndPrintCoinCandlestickData (
-    const std::string& name, 
-    const std::unique_ptr<Api>& apiRequester, 
-    const std::unordered_map<std::string, std::string>& ohlcArgs,
+// Subscribes to the market data of all the crypto assets at once, and prints the updates pushed by the 
+// streaming Api. The updates are handed over to the calling thread: when several updates of the same crypto 
+// asset arrive while the previous ones are printed, only the latest one is printed. 
+void MarketDataFetcher::streamMultiCoinMarketData(
+    const std::vector<std::string>& cryptoNames,
+    StreamApi& streamApi,
     const std::vector<std::string>& fields, 
-    const std::string& timestampField, 
-    const std::string& fiat, 
-    bool csvFormat
+    const std::string& fiat
 ) {
-    try {
-        CryptoDataUpdater crypto(name, fiat, *apiRequester); 
-    
-        while (!terminateInnerLoopFlag.load()) {
-
-            auto data = crypto.fetchCandlestickData(ohlcArgs, fields); 
-
-            {
-                std::lock_guard<std::mutex> lock(coutMutex); 
-                std::cout << Utils::formatMapVector(data, name + '/' +  fiat + '-', timestampField, {}, csvFormat) << std::endl; 
-                std::cout << std::string(15 * fields.size(), '-') << std::endl; 
-            }
-            std::this_thread::sleep_for(std::chrono::seconds(WAIT_TIME)); 
-        } 
-    } 
-    catch(std::invalid_argument) {
-        std::cout << name << " : invalid coin name." << std::endl; 
-        terminateInnerLoopFlag.store(true); 
-        return; 
+    std::vector<std::string> labels; 
+    std::vector<PairId> pairIds; 
+    std::unordered_map<PairId, size_t> positions; 
+    for (const auto& name: cryptoNames) {
+        auto id = streamApi.pairId(streamApi.makePair(name, fiat)); 
+        if (id == INVALID_PAIR_ID) {
+            std::cout << name << " : invalid coin name." << std::endl; 
+            continue; 
+        }
+        if (positions.count(id) > 0) continue; 
+        positions[id] = pairIds.size(); 
+        labels.push_back(name + "/" + fiat); 
+        pairIds.push_back(id); 
+    }
+    if (pairIds.empty()) return; 
+
+    // The handler runs on the thread of the streaming Api and outlives this call: the queue is shared with it 
+    auto completions = std::make_shared<CompletionQueue<MarketData>>(); 
+    streamApi.subscribeMarketData(pairIds, [completions, positions](PairId id, const DataMap& marketData) {
+        auto it = positions.find(id); 
+        if (it != positions.end()) completions->push(it->second, marketData); 
+    }); 
+
+    // The updates are stored as Ticker records, but printed from the maps pushed by the streaming Api, which also hold 
+    // the fields out of the ticker schema (e.g. "microtimestamp"). The updates which do not change the printed fields 
+    // (e.g. an order book update not moving the top of the book) are skipped 
+    std::vector<std::string> lastMessages(pairIds.size()); 
+    std::vector<std::pair<size_t, MarketData>> updates; 
+    std::vector<const MarketData*> latest(pairIds.size(), nullptr); 
+    std::string message; 
+    while (!terminateFlag.load()) {
+        completions->pop(Clock::time_point::max(), updates); 
+        std::fill(latest.begin(), latest.end(), nullptr); 
+        for (const auto& update: updates) latest.at(update.first) = &update.second; 
+        for (size_t i = 0; i < latest.size(); ++i) {
+            if (latest.at(i) == nullptr) continue; 
+            store_.append(pairIds.at(i), Ticker::fromMap(*latest.at(i))); 
+            message.clear(); 
+            Utils::appendMessage(labels.at(i), *latest.at(i), fields, message); 
+            if (message == lastMessages.at(i)) continue; 
+            lastMessages.at(i) = message; 
+            std::lock_guard<std::mutex> lock(coutMutex); 
+            std::cout << message << std::endl; 
+            std::cout << std::string(50, '-') << std::endl; 
+        }
     }
 
-    std::cout << name << ": thread terminated." << std::endl; 
+    std::cout << "Streaming terminated." << std::endl; 
 }
 
-// It calls fetchAndSendCoinCandlestickData to fetch and gather candlestick data
-// about multiple crypto assets. Importantly, only a single candlestick field 
-// (besides the timestamp) is fetched (for example, the volume or close price). 
-// Such data are then printed to screen in tabular form. 
+// It fetches candlestick data about multiple crypto assets every WAIT_TIME seconds. Importantly, 
+// only a single candlestick field (besides the timestamp) is fetched (for example, the volume or 
+// close price). Once the data of all the crypto assets are received, they are printed to screen 
+// in tabular form. 
 void MarketDataFetcher::fetchMultiCoinSingleCandlestickField(
     const std::vector<std::string>& cryptoNames, 
     const std::vector<std::unique_ptr<Api>>& apiRequesters, 
     const std::unordered_map<std::string, std::string>& ohlcArgs,
     const std::string& timestampField, 
     const std::string& candlestickField, 
-    const std::string& fiat
+    const std::string& fiat, 
+    bool incremental
 ) {
 
     if (cryptoNames.size() != apiRequesters.size())
         throw std::runtime_error("Number of cryptos and number of api request handlers must be equal.");
 
-    std::vector<std::string> fields{timestampField, candlestickField}; 
-    std::unordered_map<std::string, std::vector<std::unordered_map<std::string, std::string>>> data; 
-    std::vector<bool> threadsReady(cryptoNames.size(), false); 
-    std::vector<std::thread> threads; 
-    
-    for (int i = 0; i < cryptoNames.size(); ++i) {
-        threads.emplace_back([this, cryptoNames, i, &threadsReady, &apiRequesters, &data, &ohlcArgs, &fiat, &fields]() {
-            fetchAndSendCoinCandlestickData(
-                cryptoNames.at(i), i, apiRequesters.at(i), threadsReady, 
-                data, ohlcArgs, fields, fiat, true);
-        }); 
+    CandleSeries::Column column; 
+    if (!CandleSeries::find(candlestickField, column))
+        throw std::invalid_argument("Invalid candlestick field: " + candlestickField); 
+
+    std::vector<size_t> indices; 
+    auto cryptos = makeUpdaters(cryptoNames, apiRequesters, fiat, indices); 
+    std::vector<std::string> names; 
+    PairDataMap data; 
+    for (size_t k = 0; k < cryptos.size(); ++k) {
+        names.push_back(cryptoNames.at(indices.at(k))); 
+        data[cryptos.at(k)->getPairId()]; 
     }
-
-    while (!terminateOuterLoopFlag.load()) {
-
-        std::unique_lock<std::mutex> lock(dataReadyMutex);
-        dataReady.wait(lock, [this, &threadsReady]() {
-            return std::all_of(threadsReady.begin(), threadsReady.end(), [](bool v) { return v; }) || terminateInnerLoopFlag; 
-        });
-
-        if (terminateInnerLoopFlag) break; 
+    auto completions = std::make_shared<CompletionQueue<CandleSeries>>(); 
+    std::vector<std::pair<size_t, CandleSeries>> results; 
+    const auto columns = CandleSeries::bit(column); // and the timestamps: the other columns are not decoded 
+
+    // The series printed at a refresh are the buffers into which the data of the next refresh are decoded: 
+    // once they are large enough, the series are only moved between the requests and the data map. 
+    // In incremental mode, the candles received are merged into the candles held by the crypto assets. The series 
+    // printed are read back from the store into the views (see storeCandles) 
+    std::vector<CandleSeries> buffers(cryptos.size()); 
+    std::vector<CandleSeries> views(cryptos.size()); 
+    std::vector<const CandleSeries*> shown(cryptos.size(), nullptr); 
+    std::string text; // value being converted 
+    std::string message; 
+
+    while (!terminateInnerLoopFlag.load() && !cryptos.empty()) {
+
+        for (size_t k = 0; k < cryptos.size(); ++k) {
+            requestCandles(*cryptos.at(k), ohlcArgs, std::move(buffers.at(k)), completions, k, columns, incremental); 
+        }
 
         // Only print to screen when all results are ready 
-        std::vector<std::string> timestampVector; 
-        std::vector<std::vector<std::string>> values(cryptoNames.size());
-
-        // Convert maps into vector of vectors
-        size_t i = 0; 
-        for (const auto& n: cryptoNames) {
-            auto valuesMap = data[n]; 
-            if (valuesMap.empty()) continue;
-            std::vector<std::string> tmp; // contains prices data of one specific coin
-            for (auto& v: valuesMap) {
-                tmp.push_back(v[candlestickField]); 
-                if (i == 0) timestampVector.push_back(Utils::timestampToString(std::stoi(v[timestampField]))); 
+        size_t pending = cryptos.size(); 
+        while (pending > 0 && !terminateInnerLoopFlag.load()) {
+            completions->pop(Clock::time_point::max(), results); 
+            for (auto& completion: results) {
+                const size_t k = completion.first; 
+                auto& candles = completion.second; 
+                shown.at(k) = receivedCandles(*cryptos.at(k), candles, incremental); 
+                if (shown.at(k) == &candles) {
+                    auto& held = data.at(cryptos.at(k)->getPairId()); 
+                    std::swap(held, candles); 
+                    shown.at(k) = &held; 
+                }
+                buffers.at(k) = std::move(candles); 
+                if (shown.at(k) == nullptr) {
+                    requestCandles(*cryptos.at(k), ohlcArgs, std::move(buffers.at(k)), completions, k, columns, incremental); 
+                    continue; 
+                }
+                shown.at(k) = &storeCandles(store_, cryptos.at(k)->getPairId(), candleResolution(*cryptos.at(k), ohlcArgs), *shown.at(k), views.at(k)); 
+                --pending; 
+            }
+        }
+        if (terminateInnerLoopFlag.load()) break; 
+
+        // The table of the refresh is scratch memory of the cycle: it is released at once at the end of the scope 
+        {
+            Arena::Scope scratch; 
+            std::pmr::vector<std::pmr::string> timestampVector(scratch.resource()); 
+            std::pmr::vector<std::pmr::vector<std::pmr::string>> values(cryptos.size(), scratch.resource());
+
+            // Convert the columns into vector of vectors
+            size_t i = 0; 
+            for (const auto* candles: shown) {
+                const auto& series = *candles; 
+                if (series.empty()) continue;
+                auto& tmp = values.at(i); // contains prices data of one specific coin
+                tmp.reserve(series.size()); 
+                if (i == 0) timestampVector.reserve(series.size()); 
+                for (size_t j = 0; j < series.size(); ++j) {
+                    text.clear(); 
+                    series.appendText(column, j, text); 
+                    tmp.emplace_back(std::string_view(text)); 
+                    if (i == 0) {
+                        text.clear(); 
+                        if (timestampField.empty()) series.appendText(CandleSeries::Timestamp, j, text); 
+                        else Utils::appendTimestamp(static_cast<int>(series.timestamp[j]), text); 
+                        timestampVector.emplace_back(std::string_view(text)); 
+                    }
+                }
+                ++i; 
             }
-            values.at(i) = tmp; 
-            ++i; 
+
+            message.clear(); 
+            Utils::appendMatrixMsg(names, timestampVector, values, message); 
         }
 
         // Print the data 
-        std::cout << Utils::matrixToMsg(cryptoNames, timestampVector, values).str() << std::endl; 
+        std::cout << message << std::endl; 
 
-        std::fill(threadsReady.begin(), threadsReady.end(), false); 
-        if (terminateInnerLoopFlag.load()) terminateOuterLoopFlag.store(true); 
+        sleepUntil(Clock::now() + std::chrono::seconds(WAIT_TIME), terminateInnerLoopFlag); 
     }
-
-    for (auto& t: threads) t.join(); 
-    return; 
 }
 
-// It calls fetchAndSendCoinCandlestickData to fetch candlestick data about
-// multiple crypto assets. Subsequently, it prints to screen the candlestick data 
-// and, on requests, it saves them into csv format if csvFilePath is specified. 
-// Data are downloaded once, after which all the threads are terminated. 
+// It fetches the candlestick data of multiple crypto assets once (all the requests are outstanding 
+// at the same time). Subsequently, it prints to screen the candlestick data and, on requests, 
+// it saves them into csv format if csvFilePath is specified (or appends them to the archives 
+// of the folder if toArchive is set). 
 void MarketDataFetcher::downloadMultiCoinCandlestickData(
     const std::vector<std::string>& cryptoNames, 
     const std::vector<std::unique_ptr<Api>>& apiRequesters, 
@@ -225,45 +416,59 @@ void MarketDataFetcher::downloadMultiCoinCandlestickData(
     const std::string& timestampField, 
     const std::string& csvFilePath, 
     const std::vector<std::string>& fields, 
-    const std::string& fiat
+    const std::string& fiat, 
+    bool toArchive
 ) {
 
     if (cryptoNames.size() != apiRequesters.size())
         throw std::runtime_error("Number of cryptos and number of api request handlers must be equal.");
 
-    std::unordered_map<std::string, std::vector<std::unordered_map<std::string, std::string>>> data; 
-    std::vector<bool> threadsReady(cryptoNames.size(), false); 
-    std::vector<std::thread> threads; 
-    
-    for (int i = 0; i < cryptoNames.size(); ++i) {
-        threads.emplace_back([this, cryptoNames, i, &threadsReady, &apiRequesters, &data, &ohlcArgs, &fiat, &fields]() {
-            fetchAndSendCoinCandlestickData(
-                cryptoNames.at(i), i, apiRequesters.at(i), threadsReady, 
-                data, ohlcArgs, fields, fiat, false);
-        }); 
-    }
+    std::vector<size_t> indices; 
+    auto cryptos = makeUpdaters(cryptoNames, apiRequesters, fiat, indices); 
+    auto completions = std::make_shared<CompletionQueue<CandleSeries>>(); 
+    const auto columns = CandleSeries::mask(fields); 
 
-    std::unique_lock<std::mutex> lock(dataReadyMutex);
-    dataReady.wait(lock, [&threadsReady]() {
-        return std::all_of(threadsReady.begin(), threadsReady.end(), [](bool v) { return v; }); 
-    });
-
-    terminateInnerLoopFlag.store(true);    
-    for (auto& t: threads) t.join(); 
+    for (size_t k = 0; k < cryptos.size(); ++k) {
+        cryptos.at(k)->requestCandlestickData(ohlcArgs, [completions, k](CandleSeries candlestickData) {
+            completions->push(k, std::move(candlestickData)); 
+        }, columns); 
+    }
+    // The candles are kept by the store once the call returns: they are printed and exported as read back from it 
+    std::vector<CandleSeries> views(cryptos.size()); 
+    size_t pending = cryptos.size(); 
+    while (pending > 0 && !terminateInnerLoopFlag.load()) {
+        for (auto& completion: completions->pop(Clock::time_point::max())) {
+            const size_t k = completion.first; 
+            auto& candles = completion.second; 
+            if (&storeCandles(store_, cryptos.at(k)->getPairId(), candleResolution(*cryptos.at(k), ohlcArgs), candles, views.at(k)) == &candles) views.at(k) = std::move(candles); 
+            --pending; 
+        }
+    }
 
     std::cout << std::endl; 
     
-    for (const auto& marketData: data) {
+    for (size_t k = 0; k < cryptos.size(); ++k) {
 
-        auto name = marketData.first; 
-        std::cout << Utils::formatMapVector(marketData.second, name + '/' + fiat + '_', timestampField, {}, false) << std::endl; 
+        const auto& candlestickData = views.at(k); 
+        if (candlestickData.empty()) continue; 
+        const auto& name = cryptoNames.at(indices.at(k)); 
+        std::cout << candlestickData.format(name + '/' + fiat + '_', fields, !timestampField.empty(), false) << std::endl; 
         std::cout << std::string(15 * fields.size(), '-') << std::endl; 
 
         if (csvFilePath != "") {
             auto fileName = csvFilePath; 
-            auto out = Utils::formatMapVector(marketData.second, name + '/' + fiat +  '_', timestampField, {}, true); 
             if (csvFilePath.back() != '/') fileName += '/'; 
-            fileName += name + '_' + fiat + '_' + Utils::timestampToString(std::stoi(marketData.second.back().at(timestampField))) + ".csv"; 
+            if (toArchive) {
+                fileName += name + '_' + fiat + '_' + std::to_string(candlestickData.step()) + ".cndl"; 
+                size_t added = 0; 
+                if (CandleArchive::append(fileName, name + '/' + fiat, candlestickData, &added)) 
+                    std::cout << fileName << " written to disk (" << added << " new candles).\n" << std::endl; 
+                else 
+                    std::cout << fileName << " could not be written (not an archive of the same resolution and scales).\n" << std::endl; 
+                continue; 
+            }
+            auto out = candlestickData.format(name + '/' + fiat +  '_', fields, !timestampField.empty(), true); 
+            fileName += name + '_' + fiat + '_' + Utils::timestampToString(static_cast<int>(candlestickData.timestamp.back())) + ".csv"; 
             if (Utils::writeStringToFile(out, fileName) == 1)  
                 std::cout << fileName << " written to disk.\n" << std::endl; 
         }
@@ -271,8 +476,31 @@ void MarketDataFetcher::downloadMultiCoinCandlestickData(
     return; 
 }
 
-// It calls fetchAndPrintCoinCandlestickData to print the candlestick data about multiple 
-// crypto assets.  
+// Creates the CryptoDataUpdater objects before any request is issued, so that the maps 
+// keyed by pair id can be filled in beforehand 
+std::vector<std::unique_ptr<CryptoDataUpdater>> MarketDataFetcher::makeUpdaters(
+    const std::vector<std::string>& cryptoNames, 
+    const std::vector<std::unique_ptr<Api>>& apiRequesters, 
+    const std::string& fiat, 
+    std::vector<size_t>& indices
+) {
+    std::vector<std::unique_ptr<CryptoDataUpdater>> cryptos; 
+    indices.clear(); 
+    for (size_t i = 0; i < cryptoNames.size(); ++i) {
+        try {
+            cryptos.push_back(std::make_unique<CryptoDataUpdater>(cryptoNames.at(i), fiat, *apiRequesters.at(i))); 
+            indices.push_back(i); 
+        } 
+        catch(const std::invalid_argument&) {
+            std::cout << cryptoNames.at(i) << " : invalid coin name." << std::endl; 
+        }
+    }
+    return cryptos; 
+}
+
+// Issues a candlestick data request for each crypto asset every WAIT_TIME seconds (skipping the assets 
+// whose previous request is still outstanding), and prints the data of each crypto asset as soon as 
+// they are received. 
 void MarketDataFetcher::fetchMultiCoinCandlestickData(
     const std::vector<std::string>& cryptoNames, 
     const std::vector<std::unique_ptr<Api>>& apiRequesters, 
@@ -280,19 +508,70 @@ void MarketDataFetcher::fetchMultiCoinCandlestickData(
     const std::string& timestampField, 
     const std::vector<std::string>& fields, 
     const std::string& fiat, 
-    bool csvFormat 
+    bool csvFormat, 
+    bool incremental 
 ) {
 
     if (cryptoNames.size() != apiRequesters.size())
         throw std::runtime_error("Number of cryptos and number of api request handlers must be equal.");
 
-    std::vector<std::thread> threads; 
-    
-    for (int i = 0; i < cryptoNames.size(); ++i) {
-        threads.emplace_back([this, cryptoNames, i, &apiRequesters, &ohlcArgs, &fiat, &fields, &timestampField, &csvFormat]() {
-            fetchAndPrintCoinCandlestickData(
-                cryptoNames.at(i), apiRequesters.at(i), ohlcArgs, fields, timestampField, fiat, csvFormat);
-        }); 
+    std::vector<size_t> indices; 
+    auto cryptos = makeUpdaters(cryptoNames, apiRequesters, fiat, indices); 
+    std::vector<std::string> headerPrefixes; 
+    for (const auto i: indices) headerPrefixes.push_back(cryptoNames.at(i) + '/' + fiat + '-'); 
+
+    std::vector<bool> inFlight(cryptos.size(), false); 
+    auto completions = std::make_shared<CompletionQueue<CandleSeries>>(); 
+    std::vector<std::pair<size_t, CandleSeries>> results; 
+    const auto columns = CandleSeries::mask(fields); 
+    auto nextRefresh = Clock::now(); 
+
+    // Once printed, a series is the buffer into which the next data of its crypto asset are decoded, 
+    // and the messages are all formatted into the same string. In incremental mode, the candles received 
+    // are merged into the candles held by the crypto assets. The series printed are read back from the store 
+    // into the views (see storeCandles) 
+    std::vector<CandleSeries> buffers(cryptos.size()); 
+    std::vector<CandleSeries> views(cryptos.size()); 
+    std::string message; 
+
+    while (!terminateInnerLoopFlag.load() && !cryptos.empty()) {
+        if (Clock::now() >= nextRefresh) {
+            nextRefresh = Clock::now() + std::chrono::seconds(WAIT_TIME); 
+            for (size_t k = 0; k < cryptos.size(); ++k) {
+                if (inFlight.at(k)) continue; 
+                inFlight.at(k) = true; 
+                requestCandles(*cryptos.at(k), ohlcArgs, std::move(buffers.at(k)), completions, k, columns, incremental); 
+            }
+        }
+
+        completions->pop(nextRefresh, results); 
+        for (auto& completion: results) {
+            size_t k = completion.first; 
+            const auto* candles = receivedCandles(*cryptos.at(k), completion.second, incremental); 
+            if (candles == nullptr) {
+                // The whole window is requested at once, and printed when received 
+                requestCandles(*cryptos.at(k), ohlcArgs, std::move(completion.second), completions, k, columns, incremental); 
+                continue; 
+            }
+            inFlight.at(k) = false; 
+            message.clear(); 
+            storeCandles(store_, cryptos.at(k)->getPairId(), candleResolution(*cryptos.at(k), ohlcArgs), *candles, views.at(k)).appendFormat(message, headerPrefixes.at(k), fields, !timestampField.empty(), csvFormat); 
+            {
+                std::lock_guard<std::mutex> lock(coutMutex); 
+                std::cout << message << std::endl; 
+                std::cout << std::string(15 * fields.size(), '-') << std::endl; 
+            }
+            buffers.at(k) = std::move(completion.second); 
+        }
     }
-    for (auto& t: threads) t.join(); 
-}
\ No newline at end of file
+
+    std::cout << "Polling terminated." << std::endl; 
+}
+
+void MarketDataFetcher::printRequestStats(std::ostream& os) {
+    os << "\nRequest statistics:\n"; 
+    os << RequestScheduler::shared().stats() << '\n'; 
+    os << ConnectionPool::shared().stats() << '\n'; 
+    os << CoalescingApi::totalStats() << '\n'; 
+    os << HedgingHttpClient::shared().report() << std::flush; 
+}
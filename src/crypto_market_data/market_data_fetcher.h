@@ -1,7 +1,9 @@
 #pragma once 
 
 #include "crypto.h"
+#include "market_data_store.h"
 #include "../api/api.h"
+#include "../api/stream_api.h"
 #include "../utils/utils.h"
 
 #include <cstddef>
@@ -13,17 +15,22 @@
 #include <mutex> 
 #include <condition_variable>
 #include <algorithm>
+#include <iostream>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
 #include <iomanip>
 #include <memory> 
 
+// Candlestick data of several crypto assets, keyed by pair id 
+using PairDataMap = std::unordered_map<PairId, CandleSeries>; 
+
 /*
  * The class offers user interface functionalities to fetch real-time crypto market data 
  * from a specific exchange Api handler. Most of the inputs, such as crypto names, etc, 
  * are passed to the class' methods, rather than the constructor. To handle multiple requests 
- * simultaneously, the class makes use of multithreading.  
+ * simultaneously, the requests are issued asynchronously and their results collected on the calling thread. 
+ * The data received are kept in the time series store of the object (see market_data_store.h). 
  */
 class MarketDataFetcher {
 public:
@@ -45,7 +52,13 @@ public:
         WAIT_TIME = newWaitTime; 
     }
 
-    // Fetches the latest market data for multiple crypto assets
+    // Time series of the data received, kept within the memory budget (in bytes) of the store 
+    MarketDataStore& getStore() {return store_;}
+    const MarketDataStore& getStore() const {return store_;}
+    void setMemoryBudget(size_t budget) {store_.setBudget(budget);}
+
+    // Fetches the latest market data for multiple crypto assets, printed when their timestamp field changes (every 
+    // update is printed if timestampField is not a field of the market data) 
     void fetchMultiCoinMarketData(
         const std::vector<std::string>& cryptoNames,
         const std::vector<std::unique_ptr<Api>>& apiRequesters,
@@ -54,20 +67,39 @@ public:
         const std::string& fiat = "usd"
     );
 
+    // Same, with one bulk request per refresh for all the crypto assets (if the Api supports it) 
+    void pollMultiCoinMarketData(
+        const std::vector<std::string>& cryptoNames,
+        const std::unique_ptr<Api>& apiRequester,
+        const std::string& timestampField,
+        const std::vector<std::string>& fields = {}, 
+        const std::string& fiat = "usd"
+    );
+
+    // Receives and prints the market data of multiple crypto assets pushed by a streaming Api 
+    void streamMultiCoinMarketData(
+        const std::vector<std::string>& cryptoNames,
+        StreamApi& streamApi,
+        const std::vector<std::string>& fields = {}, 
+        const std::string& fiat = "usd"
+    );
+
     // Fetches a specific field of the candlestick data for multiple crypto assets, 
-    // prints them to screen in tabular format, and refreshes them regularly
+    // prints them to screen in tabular format, and refreshes them regularly (incrementally if set) 
     void fetchMultiCoinSingleCandlestickField(
         const std::vector<std::string>& cryptoNames, 
         const std::vector<std::unique_ptr<Api>>& apiRequesters, 
         const std::unordered_map<std::string, std::string>& ohlcArgs,
         const std::string& timestampField, 
         const std::string& candlestickField, 
-        const std::string& fiat = "usd"
+        const std::string& fiat = "usd", 
+        bool incremental = true
     ); 
 
     // Downloads the candlestick data for multiple crypto assets
     // The downloaded data are printed to screen and, if the csvFilePath
     // argument is populated, it stores them to file in csv format
+    // (one file per crypto asset and download), or appends them to binary archives (see candle_archive.h) 
     void downloadMultiCoinCandlestickData(
         const std::vector<std::string>& cryptoNames, 
         const std::vector<std::unique_ptr<Api>>& apiRequesters, 
@@ -75,12 +107,13 @@ public:
         const std::string& timestampField, 
         const std::string& csvFilePath = "", 
         const std::vector<std::string>& fields = {}, 
-        const std::string& fiat = "usd"
+        const std::string& fiat = "usd", 
+        bool toArchive = false
     );
     
     // Fetches the candlestick data for multiple crypto assets, 
     // prints them to screen in tabular/csv format (depending onf the csvFormat parameter), 
-    // and refreshes them regularly
+    // and refreshes them regularly (incrementally, as fetchMultiCoinSingleCandlestickField) 
     void fetchMultiCoinCandlestickData(
         const std::vector<std::string>& cryptoNames, 
         const std::vector<std::unique_ptr<Api>>& apiRequesters, 
@@ -88,47 +121,25 @@ public:
         const std::string& timestampField = "timestamp", 
         const std::vector<std::string>& fields = {}, 
         const std::string& fiat = "usd", 
-        bool csvFormat = true
+        bool csvFormat = true, 
+        bool incremental = true
     ); 
 
-private:
-
-    // Fetches the latest market data for a single crypto asset
-    void fetchCoinMarketData(
-        const std::string& name, 
-        const std::unique_ptr<Api>& apiRequester, 
-        const std::string& timestampField,
-        const std::vector<std::string>& fields = {},
-        const std::string& fiat = "usd"
-    );
+    // Prints the statistics of the requests sent by the process: admissions, pooled connections, 
+    // coalesced requests and hedged requests (to be called once the methods above returned) 
+    static void printRequestStats(std::ostream& os = std::cout); 
 
-    // Fetches the latest market data for a single crypto on a separate thread, 
-    // and returns the result to the calling thread
-    void fetchAndSendCoinCandlestickData(
-        const std::string& name, 
-        const int threadNumber, 
-        const std::unique_ptr<Api>& apiRequester, 
-        std::vector<bool>& threadsReady, 
-        std::unordered_map<std::string, std::vector<std::unordered_map<std::string, std::string>>>& data, 
-        const std::unordered_map<std::string, std::string>& ohlcArgs,
-        const std::vector<std::string>& fields = {},
-        const std::string& fiat = "usd", 
-        bool notifyEnd = false
-    ); 
+private:
 
-    // Fetches the latest market data for a single crypto on a separate thread, 
-    // and prints the results to screen
-    void fetchAndPrintCoinCandlestickData (
-        const std::string& name, 
-        const std::unique_ptr<Api>& apiRequester, 
-        const std::unordered_map<std::string, std::string>& ohlcArgs,
-        const std::vector<std::string>& fields = {}, 
-        const std::string& timestampField = "timestamp", 
-        const std::string& fiat = "usd", 
-        bool csvFormat = true 
+    // Creates the updaters of the valid crypto assets; indices holds their positions in cryptoNames 
+    static std::vector<std::unique_ptr<CryptoDataUpdater>> makeUpdaters(
+        const std::vector<std::string>& cryptoNames, 
+        const std::vector<std::unique_ptr<Api>>& apiRequesters, 
+        const std::string& fiat, 
+        std::vector<size_t>& indices
     ); 
 
-    // Signal Handler for Ctrl+C - It will terminate threads
+    // Signal Handler for Ctrl+C - It will terminate the polling loops
     static void sigintHandler(int signal) {
         if (signal == SIGINT) {
             std::cout << " Ctrl+C detected. Terminating program, please wait...\n";
@@ -139,12 +150,10 @@ private:
 
     static std::atomic<bool> terminateFlag;
     static std::atomic<bool> terminateInnerLoopFlag;
-    static std::atomic<bool> terminateOuterLoopFlag;
 
-    std::condition_variable dataReady;
     std::mutex coutMutex; 
-    std::mutex mapMutex; 
-    std::mutex dataReadyMutex;
+
+    MarketDataStore store_; 
 
     size_t WAIT_TIME = 10; // waiting time in seconds 
 
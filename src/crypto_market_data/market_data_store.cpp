@@ -0,0 +1,434 @@
+#include "market_data_store.h"
+#include "../utils/decimal.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace {
+
+constexpr auto RELAXED = std::memory_order_relaxed;
+
+// Smallest power of two not less than n (and not less than minimum)
+size_t roundUp(size_t n, size_t minimum) {
+    size_t capacity = minimum;
+    while (capacity < n) capacity *= 2;
+    return capacity;
+}
+
+// Number of positions held by a ring with the given head
+uint64_t held(uint64_t head, size_t capacity) {
+    return std::min<uint64_t>(head, capacity);
+}
+
+} // namespace
+
+CandleRing::CandleRing(size_t capacity, int64_t resolution):
+    capacity_(roundUp(capacity, LINE)), resolution_(resolution),
+    lines_(std::make_unique<Line[]>(CandleSeries::COLUMNS * capacity_ / LINE)) {}
+
+size_t CandleRing::size() const {
+    return static_cast<size_t>(held(head_.load(RELAXED), capacity_));
+}
+
+size_t CandleRing::bytes(size_t capacity) {
+    return sizeof(CandleRing) + CandleSeries::COLUMNS * roundUp(capacity, LINE) * sizeof(int64_t);
+}
+
+uint64_t CandleRing::lowerBound(uint64_t first, uint64_t last, int64_t time) const {
+    while (first < last) {
+        const uint64_t middle = first + (last - first) / 2;
+        if (timestampAt(middle) < time) first = middle + 1;
+        else last = middle;
+    }
+    return first;
+}
+
+// The series is matched against the candles held in one pass: its candles are in timestamp order, so the
+// position of each one is found from the position of the previous one
+size_t CandleRing::append(const CandleSeries& series) {
+    if (series.empty()) return 0;
+    std::lock_guard<std::mutex> lock(writer_);
+    const uint64_t head = head_.load(RELAXED);
+    uint64_t first = head - held(head, capacity_);
+    const CandleSeries::Mask before = columns_.load(RELAXED);
+    const CandleSeries::Mask columns = before | series.columns;
+
+    // The scales of the ring once the series is stored: the values are checked before anything is written
+    unsigned char scale[CandleSeries::COLUMNS] = {};
+    int64_t converted;
+    for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        const unsigned char current = scale_[c].load(RELAXED);
+        scale[c] = std::max(current, series.has(column) ? series.scale[c] : current);
+        if (scale[c] > current && (before & CandleSeries::bit(column)) != 0) {
+            for (uint64_t p = first; p < head; ++p) {
+                const int64_t value = at(c, p).load(RELAXED);
+                if (value != CandleSeries::MISSING && !Decimal::rescale(value, current, scale[c], converted)) return 0;
+            }
+        }
+        if (!series.has(column)) continue;
+        for (const auto value: series.values(column)) {
+            if (value != CandleSeries::MISSING && !Decimal::rescale(value, series.scale[c], scale[c], converted)) return 0;
+        }
+    }
+
+    lock_.beginWrite();
+    for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        if ((columns & CandleSeries::bit(column)) == 0) continue;
+        const unsigned char current = scale_[c].load(RELAXED);
+        const bool added = (before & CandleSeries::bit(column)) == 0;
+        if (added || scale[c] > current) {
+            // A column which was not held has no values yet; the others are rescaled
+            for (uint64_t p = first; p < head; ++p) {
+                auto& slot = at(c, p);
+                const int64_t value = slot.load(RELAXED);
+                if (added) slot.store(CandleSeries::MISSING, RELAXED);
+                else if (value != CandleSeries::MISSING && Decimal::rescale(value, current, scale[c], converted)) slot.store(converted, RELAXED);
+            }
+        }
+        scale_[c].store(scale[c], RELAXED);
+        if (series.has(column)) decimals_[c].store(std::max(decimals_[c].load(RELAXED), series.decimals[c]), RELAXED);
+    }
+    columns_.store(columns, RELAXED);
+
+    uint64_t end = head;
+    uint64_t position = lowerBound(first, end, series.timestamp.front());
+    size_t stored = 0;
+    for (size_t i = 0; i < series.size(); ++i) {
+        const int64_t time = series.timestamp[i];
+        while (position < end && timestampAt(position) < time) ++position;
+        if (position == end) {
+            // A newer candle: it takes the slot of the oldest one if the ring is full
+            ++end;
+            if (end - first > capacity_) ++first;
+        } else if (timestampAt(position) != time) {
+            continue; // older than the candles held, or missing among them
+        }
+        at(CandleSeries::Timestamp, position).store(time, RELAXED);
+        for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) {
+            const auto column = static_cast<CandleSeries::Column>(c);
+            if ((columns & CandleSeries::bit(column)) == 0) continue;
+            int64_t value = series.has(column) ? series.values(column)[i] : CandleSeries::MISSING;
+            if (value != CandleSeries::MISSING) Decimal::rescale(value, series.scale[c], scale[c], value);
+            at(c, position).store(value, RELAXED);
+        }
+        ++position;
+        ++stored;
+    }
+    head_.store(end, RELAXED);
+    lock_.endWrite();
+    return stored;
+}
+
+void CandleRing::copy(uint64_t first, uint64_t last, CandleSeries& out) const {
+    out.clear();
+    if (last < first) last = first;
+    const size_t n = static_cast<size_t>(last - first);
+    const CandleSeries::Mask columns = columns_.load(RELAXED);
+    out.columns = columns;
+    out.timestamp.resize(n);
+    for (size_t i = 0; i < n; ++i) out.timestamp[i] = timestampAt(first + i);
+    for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        if ((columns & CandleSeries::bit(column)) == 0) continue;
+        auto& values = out.values(column);
+        values.resize(n);
+        for (size_t i = 0; i < n; ++i) values[i] = at(c, first + i).load(RELAXED);
+        out.scale[c] = scale_[c].load(RELAXED);
+        out.decimals[c] = decimals_[c].load(RELAXED);
+    }
+}
+
+bool CandleRing::latest(size_t n, CandleSeries& out) const {
+    lock_.read([&]() {
+        const uint64_t head = head_.load(RELAXED);
+        const uint64_t count = std::min<uint64_t>(held(head, capacity_), n == 0 ? capacity_ : n);
+        copy(head - count, head, out);
+    });
+    return !out.empty();
+}
+
+bool CandleRing::range(int64_t from, int64_t to, CandleSeries& out) const {
+    lock_.read([&]() {
+        const uint64_t head = head_.load(RELAXED);
+        const uint64_t first = head - held(head, capacity_);
+        const uint64_t last = to == std::numeric_limits<int64_t>::max() ? head : lowerBound(first, head, to + 1);
+        copy(lowerBound(first, head, from), last, out);
+    });
+    return !out.empty();
+}
+
+TickerRing::TickerRing(size_t capacity):
+    capacity_(roundUp(capacity, 1)),
+    slots_(std::make_unique<Slot[]>(capacity_)),
+    times_(std::make_unique<std::atomic<int64_t>[]>(capacity_)) {}
+
+size_t TickerRing::size() const {
+    return static_cast<size_t>(held(head_.load(RELAXED), capacity_));
+}
+
+size_t TickerRing::bytes(size_t capacity) {
+    return sizeof(TickerRing) + roundUp(capacity, 1) * (sizeof(Slot) + sizeof(int64_t));
+}
+
+int64_t TickerRing::time(const Ticker& ticker) {
+    return ticker.has(Ticker::Timestamp) ? ticker.units[Ticker::Timestamp] : std::numeric_limits<int64_t>::min();
+}
+
+void TickerRing::store(uint64_t position, const Ticker& ticker) {
+    static_assert(std::is_trivially_copyable<Ticker>::value, "Ticker records are copied as words");
+    const size_t slot = static_cast<size_t>(position) & (capacity_ - 1);
+    uint64_t words[WORDS];
+    std::memcpy(words, &ticker, sizeof(Ticker));
+    for (size_t w = 0; w < WORDS; ++w) slots_[slot].words[w].store(words[w], RELAXED);
+    times_[slot].store(time(ticker), RELAXED);
+}
+
+void TickerRing::load(uint64_t position, Ticker& out) const {
+    const size_t slot = static_cast<size_t>(position) & (capacity_ - 1);
+    uint64_t words[WORDS];
+    for (size_t w = 0; w < WORDS; ++w) words[w] = slots_[slot].words[w].load(RELAXED);
+    std::memcpy(&out, words, sizeof(Ticker));
+}
+
+bool TickerRing::append(const Ticker& ticker) {
+    std::lock_guard<std::mutex> lock(writer_);
+    const uint64_t head = head_.load(RELAXED);
+    uint64_t position = head;
+    if (head > 0) {
+        const int64_t last = times_[static_cast<size_t>(head - 1) & (capacity_ - 1)].load(RELAXED);
+        if (time(ticker) < last) return false;
+        if (time(ticker) == last) position = head - 1;
+    }
+    lock_.beginWrite();
+    store(position, ticker);
+    if (position == head) head_.store(head + 1, RELAXED);
+    lock_.endWrite();
+    return true;
+}
+
+void TickerRing::copy(uint64_t first, uint64_t last, std::vector<Ticker>& out) const {
+    if (last < first) last = first;
+    out.resize(static_cast<size_t>(last - first));
+    for (size_t i = 0; i < out.size(); ++i) load(first + i, out[i]);
+}
+
+bool TickerRing::latest(Ticker& out) const {
+    bool found = false;
+    lock_.read([&]() {
+        const uint64_t head = head_.load(RELAXED);
+        found = head > 0;
+        if (found) load(head - 1, out);
+    });
+    if (!found) out.clear();
+    return found;
+}
+
+bool TickerRing::latest(size_t n, std::vector<Ticker>& out) const {
+    lock_.read([&]() {
+        const uint64_t head = head_.load(RELAXED);
+        const uint64_t count = std::min<uint64_t>(held(head, capacity_), n == 0 ? capacity_ : n);
+        copy(head - count, head, out);
+    });
+    return !out.empty();
+}
+
+bool TickerRing::range(int64_t from, int64_t to, std::vector<Ticker>& out) const {
+    lock_.read([&]() {
+        const uint64_t head = head_.load(RELAXED);
+        uint64_t first = head - held(head, capacity_);
+        while (first < head && times_[static_cast<size_t>(first) & (capacity_ - 1)].load(RELAXED) < from) ++first;
+        uint64_t last = first;
+        while (last < head && times_[static_cast<size_t>(last) & (capacity_ - 1)].load(RELAXED) <= to) ++last;
+        copy(first, last, out);
+    });
+    return !out.empty();
+}
+
+size_t MarketDataStore::getBudget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_;
+}
+
+void MarketDataStore::setBudget(size_t budget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget;
+    makeRoom(0);
+}
+
+bool MarketDataStore::makeRoom(size_t bytes) {
+    while (bytes_ + bytes > budget_) {
+        auto victim = entries_.end();
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (victim == entries_.end() || it->second.lastUse < victim->second.lastUse) victim = it;
+        }
+        if (victim == entries_.end()) return false;
+        bytes_ -= victim->second.bytes;
+        historyBytes_ -= victim->second.historyBytes;
+        entries_.erase(victim);
+        ++evictions_;
+    }
+    return true;
+}
+
+const MarketDataStore::Entry* MarketDataStore::find(uint64_t key) const {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) return nullptr;
+    it->second.lastUse = ++clock_;
+    return &it->second;
+}
+
+std::shared_ptr<MarketDataStore::History> MarketDataStore::history(uint64_t key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto* entry = find(key);
+    return entry != nullptr ? entry->history : nullptr;
+}
+
+template<typename Append>
+void MarketDataStore::record(uint64_t key, Append&& append) {
+    auto history = this->history(key);
+    if (history == nullptr) return;
+    std::lock_guard<std::mutex> historyLock(history->mutex);
+    append(*history);
+    size_t bytes = history->candles.bytes() + history->tickers.bytes();
+    while (bytes > historyLimit_ && (history->candles.dropOldest() || history->tickers.dropOldest())) {
+        bytes = history->candles.bytes() + history->tickers.bytes();
+    }
+
+    // The history grows by a block at a time (and shrinks by its oldest ones); it is accounted unless its ring
+    // was evicted meanwhile. The history is still locked, so that its sizes are accounted in order (the store
+    // is never locked before a history)
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it == entries_.end() || it->second.history != history || bytes == it->second.historyBytes) return;
+    it->second.bytes = it->second.bytes - it->second.historyBytes + bytes;
+    bytes_ = bytes_ - it->second.historyBytes + bytes;
+    historyBytes_ = historyBytes_ - it->second.historyBytes + bytes;
+    it->second.historyBytes = bytes;
+    makeRoom(0);
+}
+
+std::shared_ptr<CandleRing> MarketDataStore::candles(PairId id, int64_t resolution, size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t k = key(id, resolution);
+    if (const auto* entry = find(k)) return entry->candles;
+    capacity = std::max(capacity, candleCapacity_);
+    const size_t bytes = CandleRing::bytes(capacity);
+    if (bytes > budget_ || !makeRoom(bytes)) return nullptr;
+    Entry entry;
+    entry.candles = std::make_shared<CandleRing>(capacity, resolution);
+    entry.history = std::make_shared<History>();
+    entry.bytes = bytes;
+    entry.lastUse = ++clock_;
+    bytes_ += bytes;
+    return entries_.emplace(k, std::move(entry)).first->second.candles;
+}
+
+std::shared_ptr<TickerRing> MarketDataStore::tickers(PairId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const uint64_t k = key(id, -1);
+    if (const auto* entry = find(k)) return entry->tickers;
+    const size_t bytes = TickerRing::bytes(tickerCapacity_);
+    if (bytes > budget_ || !makeRoom(bytes)) return nullptr;
+    Entry entry;
+    entry.tickers = std::make_shared<TickerRing>(tickerCapacity_);
+    entry.history = std::make_shared<History>();
+    entry.bytes = bytes;
+    entry.lastUse = ++clock_;
+    bytes_ += bytes;
+    return entries_.emplace(k, std::move(entry)).first->second.tickers;
+}
+
+std::shared_ptr<const CandleRing> MarketDataStore::findCandles(PairId id, int64_t resolution) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto* entry = find(key(id, resolution));
+    return entry != nullptr ? entry->candles : nullptr;
+}
+
+std::shared_ptr<const TickerRing> MarketDataStore::findTickers(PairId id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto* entry = find(key(id, -1));
+    return entry != nullptr ? entry->tickers : nullptr;
+}
+
+bool MarketDataStore::append(PairId id, int64_t resolution, const CandleSeries& series) {
+    if (series.empty() || resolution <= 0) return false;
+    auto ring = candles(id, resolution, series.size());
+    if (ring == nullptr || ring->append(series) == 0) return false;
+    record(key(id, resolution), [&](History& history) {history.candles.append(series);});
+    return true;
+}
+
+bool MarketDataStore::append(PairId id, const Ticker& ticker) {
+    auto ring = tickers(id);
+    if (ring == nullptr || !ring->append(ticker)) return false;
+    record(key(id, -1), [&](History& history) {history.tickers.append(ticker);});
+    return true;
+}
+
+bool MarketDataStore::latest(PairId id, int64_t resolution, size_t n, CandleSeries& out) const {
+    auto ring = findCandles(id, resolution);
+    if (ring == nullptr) {
+        out.clear();
+        return false;
+    }
+    return ring->latest(n, out);
+}
+
+bool MarketDataStore::range(PairId id, int64_t resolution, int64_t from, int64_t to, CandleSeries& out) const {
+    auto ring = findCandles(id, resolution);
+    if (ring == nullptr) {
+        out.clear();
+        return false;
+    }
+    // The ring answers if it holds all the candles stored, or a candle within the step before from
+    const bool held = ring->range(from, to, out);
+    if (ring->size() < ring->capacity() || (held && out.timestamp.front() - resolution < from)) return held;
+    auto history = this->history(key(id, resolution));
+    if (history == nullptr) return held;
+    CandleSeries older;
+    {
+        std::lock_guard<std::mutex> lock(history->mutex);
+        if (!history->candles.read(from, to, older)) return held;
+    }
+    // The candles still in the ring replace their copies in the history
+    if (held && !older.merge(out, std::numeric_limits<size_t>::max())) return held;
+    std::swap(out, older);
+    return true;
+}
+
+bool MarketDataStore::latest(PairId id, Ticker& out) const {
+    auto ring = findTickers(id);
+    if (ring == nullptr) {
+        out.clear();
+        return false;
+    }
+    return ring->latest(out);
+}
+
+bool MarketDataStore::range(PairId id, int64_t from, int64_t to, std::vector<Ticker>& out) const {
+    auto ring = findTickers(id);
+    if (ring == nullptr) {
+        out.clear();
+        return false;
+    }
+    // The history holds the same records as the ring (they follow the same policy), and the older ones
+    if (ring->size() < ring->capacity()) return ring->range(from, to, out);
+    auto history = this->history(key(id, -1));
+    if (history == nullptr) return ring->range(from, to, out);
+    std::lock_guard<std::mutex> lock(history->mutex);
+    return history->tickers.read(from, to, out);
+}
+
+MarketDataStore::Stats MarketDataStore::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.budget = budget_;
+    stats.bytes = bytes_;
+    stats.historyBytes = historyBytes_;
+    stats.rings = entries_.size();
+    stats.evictions = evictions_;
+    return stats;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "../api/candle_series.h"
+#include "../api/symbol_table.h"
+#include "../api/ticker.h"
+#include "../storage/compressed_series.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Sequence lock of a ring buffer: the writer makes the sequence odd while it writes, and a reader retries
+ * the copy it made if the sequence was odd or changed meanwhile. Readers never block the writer nor each
+ * other, and a copy only ever sees the state of the buffer between two writes. The data it protects must
+ * be atomics accessed with relaxed ordering (plain loads and stores on x86), so that the copies racing
+ * with a write are well defined, merely discarded.
+ */
+class SeqLock {
+public:
+    void beginWrite() {
+        sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    void endWrite() {
+        sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Runs read until it ran without a concurrent write
+    template<typename Read>
+    void read(Read&& read) const {
+        for (unsigned attempt = 1;; ++attempt) {
+            const uint64_t before = sequence_.load(std::memory_order_acquire);
+            if ((before & 1) == 0) {
+                read();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence_.load(std::memory_order_relaxed) == before) return;
+            }
+            if (attempt % 64 == 0) std::this_thread::yield();
+        }
+    }
+
+private:
+    std::atomic<uint64_t> sequence_{0};
+};
+
+/*
+ * Ring buffer of the candles of a pair at a given resolution, stored by columns as CandleSeries: each
+ * column is a power-of-two array of cache lines, indexed by the position of the candle modulo the
+ * capacity. Appending a candle is O(1) and overwrites the oldest one once the ring is full; a candle with
+ * the timestamp of a candle held replaces it in place (e.g. the candle which was still open). There is one
+ * writer at a time (appends are serialized); the readers copy the candles out without any lock (see SeqLock).
+ */
+class CandleRing {
+public:
+    // The capacity is rounded up to a power of two (at least one cache line per column)
+    CandleRing(size_t capacity, int64_t resolution);
+    CandleRing(const CandleRing&) = delete;
+    CandleRing& operator=(const CandleRing&) = delete;
+
+    size_t capacity() const {return capacity_;}
+    int64_t resolution() const {return resolution_;}
+    size_t size() const;
+
+    // Memory taken by a ring of the given capacity
+    static size_t bytes(size_t capacity);
+
+    // Stores the candles of a series, in timestamp order: the ones newer than the newest candle held are
+    // appended, the ones with the timestamp of a candle held replace it, and the others are skipped.
+    // The columns are brought to the larger of the two scales. Returns the number of candles stored (0 if a
+    // value does not fit the scale of its column: the ring is then left unchanged).
+    size_t append(const CandleSeries& series);
+
+    // Copies the latest n candles (all of them if n is 0), or the candles whose timestamp is within
+    // [from, to], into out, whose buffers are reused; returns false if no candle was copied
+    bool latest(size_t n, CandleSeries& out) const;
+    bool range(int64_t from, int64_t to, CandleSeries& out) const;
+
+private:
+    struct alignas(64) Line {
+        std::atomic<int64_t> values[8];
+    };
+    static constexpr size_t LINE = 8;
+
+    const size_t capacity_;
+    const int64_t resolution_;
+    std::unique_ptr<Line[]> lines_; // the columns, one after the other (capacity_ / LINE lines each)
+    std::atomic<uint64_t> head_{0}; // number of candles appended since the creation of the ring
+    std::atomic<unsigned char> scale_[CandleSeries::COLUMNS] = {};
+    std::atomic<unsigned char> decimals_[CandleSeries::COLUMNS] = {};
+    std::atomic<CandleSeries::Mask> columns_{CandleSeries::bit(CandleSeries::Timestamp)};
+    SeqLock lock_;
+    std::mutex writer_;
+
+    std::atomic<int64_t>& at(size_t column, uint64_t position) const {
+        const size_t slot = static_cast<size_t>(position) & (capacity_ - 1);
+        return lines_[(column * capacity_ + slot) / LINE].values[slot % LINE];
+    }
+    int64_t timestampAt(uint64_t position) const {return at(CandleSeries::Timestamp, position).load(std::memory_order_relaxed);}
+
+    // First position in [first, last) whose timestamp is not less than time
+    uint64_t lowerBound(uint64_t first, uint64_t last, int64_t time) const;
+
+    // Copies the candles of the positions [first, last) into out
+    void copy(uint64_t first, uint64_t last, CandleSeries& out) const;
+};
+
+/*
+ * Ring buffer of the market data of a pair, as Ticker records (which are fixed-layout, so each slot is
+ * copied as a few words). Same policy as CandleRing: a record newer than the newest one held is appended,
+ * a record with the same timestamp replaces it, and an older one is skipped.
+ */
+class TickerRing {
+public:
+    TickerRing(size_t capacity);
+    TickerRing(const TickerRing&) = delete;
+    TickerRing& operator=(const TickerRing&) = delete;
+
+    size_t capacity() const {return capacity_;}
+    size_t size() const;
+    static size_t bytes(size_t capacity);
+
+    // Returns false if the record was skipped
+    bool append(const Ticker& ticker);
+
+    // Copies the latest record; the latest n records (all of them if n is 0) or the records whose timestamp
+    // is within [from, to], oldest first. Return false if no record was copied.
+    bool latest(Ticker& out) const;
+    bool latest(size_t n, std::vector<Ticker>& out) const;
+    bool range(int64_t from, int64_t to, std::vector<Ticker>& out) const;
+
+private:
+    static constexpr size_t WORDS = sizeof(Ticker) / sizeof(uint64_t);
+    static_assert(sizeof(Ticker) % sizeof(uint64_t) == 0, "Ticker records are copied as words");
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> words[WORDS];
+    };
+
+    const size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<std::atomic<int64_t>[]> times_; // timestamp of each slot, searched by the range queries
+    std::atomic<uint64_t> head_{0};
+    SeqLock lock_;
+    std::mutex writer_;
+
+    static int64_t time(const Ticker& ticker);
+    void store(uint64_t position, const Ticker& ticker);
+    void load(uint64_t position, Ticker& out) const;
+    void copy(uint64_t first, uint64_t last, std::vector<Ticker>& out) const;
+};
+
+/*
+ * In-memory time series of the market data received: one CandleRing per pair and resolution, and one
+ * TickerRing per pair, created on first use. The store keeps the data between the polls, so that they can
+ * be printed, exported or queried again without any request to the exchange.
+ * Behind each ring, the store keeps a compressed history of all the data appended through it (see
+ * compressed_series.h, about a quarter of the size of a ring slot): the ranges the ring no longer holds
+ * are decoded from the history, so that a long history takes little more memory than a window.
+ * The rings and their histories are accounted against a memory budget: when a new ring (or a history
+ * growing by a block) would not fit, the least recently used rings are evicted along with their histories
+ * (a ring is used when it is written or read through the store). A history is bounded on its own as well:
+ * beyond its limit, its oldest blocks are dropped, so that a single pair polled for long does not evict
+ * the rings of the others. The rings are handed out as shared
+ * pointers, so that a reader holding one keeps reading it without any lock, even after its eviction.
+ * The lookups of the store take a mutex for the duration of a hash table access.
+ */
+class MarketDataStore {
+public:
+    static constexpr size_t DEFAULT_BUDGET = 256u << 20;
+    static constexpr size_t DEFAULT_CANDLES = 4096;  // candles per ring, at least
+    static constexpr size_t DEFAULT_TICKERS = 1024;  // records per ring
+    static constexpr size_t DEFAULT_HISTORY = 16u << 20; // bytes of history per ring, at most
+
+    explicit MarketDataStore(
+        size_t budget = DEFAULT_BUDGET, size_t candles = DEFAULT_CANDLES, size_t tickers = DEFAULT_TICKERS, size_t history = DEFAULT_HISTORY
+    ): budget_(budget), candleCapacity_(candles), tickerCapacity_(tickers), historyLimit_(history) {}
+    MarketDataStore(const MarketDataStore&) = delete;
+    MarketDataStore& operator=(const MarketDataStore&) = delete;
+
+    // Memory budget in bytes: lowering it evicts the least recently used rings until they fit
+    size_t getBudget() const;
+    void setBudget(size_t budget);
+
+    // Ring of the candles of a pair at a resolution (in seconds, see CandleSeries::step), created if needed
+    // with room for at least capacity candles; nullptr if it does not fit the budget even alone
+    std::shared_ptr<CandleRing> candles(PairId id, int64_t resolution, size_t capacity = 0);
+    std::shared_ptr<TickerRing> tickers(PairId id);
+
+    // Existing rings (nullptr if there is none)
+    std::shared_ptr<const CandleRing> findCandles(PairId id, int64_t resolution) const;
+    std::shared_ptr<const TickerRing> findTickers(PairId id) const;
+
+    // Stores the candles of a series into the ring of the resolution they were requested at (the ring is
+    // sized for the series), and into its history; returns false if nothing was stored. The resolution is
+    // given rather than taken from the timestamps, which do not tell it for a single candle or a series with
+    // gaps.
+    bool append(PairId id, int64_t resolution, const CandleSeries& series);
+    bool append(PairId id, const Ticker& ticker);
+
+    // Latest candles and market data of a pair (see CandleRing::latest); false if the store has none.
+    // The ranges start in the history when the ring no longer holds their first candles or records (the
+    // candles still in the ring are the ones of the ring, which may have been replaced since).
+    bool latest(PairId id, int64_t resolution, size_t n, CandleSeries& out) const;
+    bool range(PairId id, int64_t resolution, int64_t from, int64_t to, CandleSeries& out) const;
+    bool latest(PairId id, Ticker& out) const;
+    bool range(PairId id, int64_t from, int64_t to, std::vector<Ticker>& out) const;
+
+    struct Stats {
+        size_t budget = 0;
+        size_t bytes = 0;       // memory taken by the rings held and their histories
+        size_t historyBytes = 0;
+        size_t rings = 0;
+        size_t evictions = 0;
+    };
+    Stats stats() const;
+
+private:
+    // Compressed history of a ring (one of the two series is used), written under its own mutex
+    struct History {
+        mutable std::mutex mutex;
+        CompressedCandles candles;
+        CompressedTickers tickers;
+    };
+
+    struct Entry {
+        std::shared_ptr<CandleRing> candles;
+        std::shared_ptr<TickerRing> tickers;
+        std::shared_ptr<History> history;
+        size_t bytes = 0;        // ring and history
+        size_t historyBytes = 0;
+        mutable uint64_t lastUse = 0;
+    };
+
+    // Candle rings are keyed by pair and resolution, ticker rings by pair (with a resolution of -1)
+    static uint64_t key(PairId id, int64_t resolution) {
+        return (static_cast<uint64_t>(id) << 32) | static_cast<uint32_t>(resolution);
+    }
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, Entry> entries_;
+    size_t budget_;
+    const size_t candleCapacity_;
+    const size_t tickerCapacity_;
+    const size_t historyLimit_;
+    size_t bytes_ = 0;
+    size_t historyBytes_ = 0;
+    size_t evictions_ = 0;
+    mutable uint64_t clock_ = 0;
+
+    // Entry of a key, marked as used (nullptr if there is none)
+    const Entry* find(uint64_t key) const;
+
+    // History of an existing ring (nullptr if there is none)
+    std::shared_ptr<History> history(uint64_t key) const;
+
+    // Runs append on the history of a ring, drops its oldest blocks beyond the limit of a history, then
+    // accounts for the memory the history takes
+    template<typename Append>
+    void record(uint64_t key, Append&& append);
+
+    // Evicts the least recently used rings until bytes more fit the budget; returns false if they cannot fit
+    bool makeRoom(size_t bytes);
+};
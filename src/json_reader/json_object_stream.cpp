@@ -0,0 +1,58 @@
+#include "json_object_stream.h"
+
+void JsonObjectStream::reset() {
+    stack_.clear();
+    object_.clear();
+    inObject_ = inString_ = escape_ = done_ = failed_ = false;
+    objects_ = 0;
+}
+
+void JsonObjectStream::feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size && !failed_; ++i) process(data[i]);
+}
+
+bool JsonObjectStream::finish() {
+    if (!done_) fail();
+    return !failed_;
+}
+
+// The objects are found at the depth of the elements of the top-level array (Records) or at the top
+// level (Object); the characters outside of them are only checked for the nesting of the brackets
+void JsonObjectStream::process(char c) {
+    if (inObject_) object_ += c;
+    if (inString_) {
+        if (escape_) escape_ = false;
+        else if (c == '\\') escape_ = true;
+        else if (c == '"') inString_ = false;
+        return;
+    }
+
+    const size_t objectDepth = mode_ == Mode::Records ? 2 : 1;
+    switch (c) {
+        case ' ': case '\t': case '\r': case '\n':
+            return;
+        case '{': case '[':
+            if (stack_.empty() && (done_ || c != (mode_ == Mode::Records ? '[' : '{'))) return fail();
+            stack_ += c;
+            if (stack_.size() == objectDepth && c == '{') {
+                inObject_ = true;
+                object_.assign(1, c);
+            }
+            return;
+        case '}': case ']':
+            if (stack_.empty() || stack_.back() != (c == '}' ? '{' : '[')) return fail();
+            stack_.pop_back();
+            if (inObject_ && stack_.size() + 1 == objectDepth) {
+                inObject_ = false;
+                ++objects_;
+                if (!handler_(object_)) return fail();
+            }
+            if (stack_.empty()) done_ = true;
+            return;
+        case '"':
+            inString_ = true;
+            [[fallthrough]];
+        default:
+            if (stack_.empty()) return fail(); // scalars are only accepted inside arrays and objects
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "json_stream_parser.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/*
+ * Incremental json splitter. As with JsonStreamParser, the input is fed in chunks of any size and each
+ * object (an element of the top-level array in Records mode, the top-level object in Object mode) is
+ * passed to the handler as soon as its closing brace is received, but as its json text rather than as a
+ * map, for the parsers of a known schema (see json_schema.h). Only the text of the current object is
+ * kept. Its members are not validated here but by the handler, which returns false if it rejects the
+ * object.
+ */
+class JsonObjectStream {
+
+public:
+    using Mode = JsonStreamParser::Mode;
+    using Handler = std::function<bool(std::string_view object)>;
+
+    JsonObjectStream(Mode mode, Handler handler): mode_(mode), handler_(std::move(handler)) {}
+
+    // Parses the next chunk of the input
+    void feed(const char* data, size_t size);
+    void feed(const std::string& data) {feed(data.data(), data.size());}
+
+    // Notifies the end of the input; returns false if the input was not a complete json document, or if
+    // the handler rejected an object
+    bool finish();
+
+    bool failed() const {return failed_;}
+
+    // Number of objects passed to the handler
+    size_t objects() const {return objects_;}
+
+    // Prepares the splitter for a new input
+    void reset();
+
+private:
+    Mode mode_;
+    Handler handler_;
+
+    std::string stack_;        // open arrays and objects
+    std::string object_;       // text of the current object
+    bool inObject_ = false;
+    bool inString_ = false;
+    bool escape_ = false;
+    bool done_ = false;        // the top-level value was closed
+    bool failed_ = false;
+    size_t objects_ = 0;
+
+    void process(char c);
+    void fail() {failed_ = true;}
+};
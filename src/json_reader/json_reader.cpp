@@ -3,56 +3,60 @@
 
 // It reads a json object (passed as a string) as an input, and it stores it into a 
 // unordered map object, where both the key and the value are stored
-// as std::string's. 
-void JsonReader::setFromString(const std::string& inputString) {
+// as std::string's. If the input is not valid json, the members read before the error are kept. 
+void JsonReader::setFromString(const std::string& inputString, const JsonProjection& keys) {
 
     if (inputString.size() == 0) return; 
 
     this->jsonObject.clear(); 
-    std::stringstream ss{inputString}; 
-    std::string key{}; 
-    std::string value{}; 
-    bool doValue = false;
-    bool isList = false;  
-    char currentChar; 
-
-    char skip = ss.peek(); 
-    if (skip == '{' || skip == '"') ss.ignore(); 
-    skip = ss.peek(); 
-    if (skip == '"') ss.ignore(); 
-
-    while (ss.get(currentChar)) {
-        if (currentChar == '"' || currentChar == ' ') {
-            continue;
-        }
+    JsonTokenizer tokenizer(inputString); 
+    if (tokenizer.next().type != JsonTokenizer::TokenType::BeginObject) return; 
+    readObject(tokenizer, this->jsonObject, keys); 
+}
 
-        if (currentChar == ':') {
-            doValue = true;
-            continue;
-        }
+// Keys and values are copied out of the input once; only the strings containing escape 
+// sequences need to be decoded. The members out of the projection are only tokenized: their 
+// values are skipped as a whole, whatever their size 
+bool JsonReader::readObject(JsonTokenizer& tokenizer, jMap& object, const JsonProjection& keys) {
+    using TokenType = JsonTokenizer::TokenType; 
+    std::string key; 
+    while (true) {
+        auto token = tokenizer.next(); 
+        if (token.type == TokenType::EndObject) return true; 
+        if (token.type != TokenType::Key) return false; 
+        if (token.escaped) JsonTokenizer::unescape(token.text, key); 
 
-        if (currentChar == '[' && !isList) isList = true; 
-        if (currentChar == ']' && isList) isList = false;
-        
-        if (currentChar != '}' && (currentChar != ',' || (currentChar == ',' && isList))) {
-            if (!doValue) key += currentChar; 
-            else value += currentChar;
+        if (!keys.contains(token.escaped ? std::string_view(key) : token.text)) {
+            if (tokenizer.nextValue().type == TokenType::Error) return false; 
             continue; 
         }
+        if (!token.escaped) key.assign(token.text.data(), token.text.size()); 
 
-        if (currentChar == ',' || currentChar == '}') {
-            this->operator[](key) = value; 
-            key.clear(); 
-            value.clear(); 
-            doValue = false; 
-            ss.ignore(); 
-        }
+        auto value = tokenizer.nextValue(); 
+        if (!storeValue(value, object[key])) return false; 
+    }
+}
+
+bool JsonReader::storeValue(const JsonTokenizer::Token& value, std::string& out) {
+    using TokenType = JsonTokenizer::TokenType; 
+    switch (value.type) {
+        case TokenType::String: 
+            if (value.escaped) JsonTokenizer::unescape(value.text, out); 
+            else out.assign(value.text.data(), value.text.size()); 
+            return true; 
+        case TokenType::Literal: 
+        case TokenType::BeginObject: 
+        case TokenType::BeginArray: 
+            out.assign(value.text.data(), value.text.size()); 
+            return true; 
+        default: 
+            return false; 
     }
 }
 
 // It creates an unordered map from a json file. It makes use
 // of the setFromString method. 
-void JsonReader::setFromFile(const std::string& inputFileName) {
+void JsonReader::setFromFile(const std::string& inputFileName, const JsonProjection& keys) {
 
     std::fstream inputFile(inputFileName, std::ios::in); 
 
@@ -64,7 +68,7 @@ void JsonReader::setFromFile(const std::string& inputFileName) {
     std::stringstream stringFileStream; 
     std::string jsonLine;  
     while (std::getline(inputFile, jsonLine)) stringFileStream << jsonLine; 
-    setFromString(stringFileStream.str()); 
+    setFromString(stringFileStream.str(), keys); 
     inputFile.close(); 
 }
 
@@ -1,20 +1,46 @@
 #pragma once
 
 #include <string> 
+#include <string_view>
 #include <unordered_map>
 #include <fstream> 
 #include <sstream>
 #include <iostream> 
 #include <vector> 
 #include <algorithm>
+#include <utility>
 #include "../utils/utils.cpp" 
+#include "json_tokenizer.h"
 
 using jMap = std::unordered_map<std::string,std::string>; 
 
+/*
+ * Keys to read from json objects (projection pushdown): the members with other keys are skipped by 
+ * the tokenizer, and neither their key nor their value is copied. An empty projection reads all the 
+ * keys. The keys are few, so they are looked up linearly. 
+ */
+class JsonProjection {
+
+public:
+    JsonProjection() {}
+    JsonProjection(std::vector<std::string> keys): keys_(std::move(keys)) {}
+
+    bool all() const {return keys_.empty();}
+    size_t size() const {return keys_.size();}
+    bool contains(std::string_view key) const {
+        return all() || std::find(keys_.begin(), keys_.end(), key) != keys_.end(); 
+    }
+
+private:
+    std::vector<std::string> keys_; 
+}; 
+
 /*
  * The class aims at converting a sequence of characters contained in a json object
  * (either as a string, or as an input file), parsing them, and converting them into 
- * an std::unordered_map<std::string,std::string> 
+ * an std::unordered_map<std::string,std::string>. The input is read in a single pass by 
+ * JsonTokenizer: string values are unquoted and unescaped, while nested arrays and objects 
+ * are kept as json text. 
  */
 
 class JsonReader {
@@ -26,14 +52,27 @@ public:
         if (!isFile) this->setFromString(inputString);
         else this->setFromFile(inputString); 
     }
+    JsonReader(const std::string& inputString, const JsonProjection& keys, bool isFile=false) {
+        if (!isFile) this->setFromString(inputString, keys);
+        else this->setFromFile(inputString, keys); 
+    }
 
     // These methods parse the json object characters from a string or file, 
-    // and convert them into std::unordered_map objects.
-    void setFromString(const std::string&); 
-    void setFromFile(const std::string&); 
+    // and convert them into std::unordered_map objects (only the keys of the projection, if given). 
+    void setFromString(const std::string&, const JsonProjection& keys = {}); 
+    void setFromFile(const std::string&, const JsonProjection& keys = {}); 
 
-    // Gets the parsed json objects
-    auto get() const -> jMap {return jsonObject;}
+    // Gets the parsed json object, without copying it 
+    auto get() const -> const jMap& {return jsonObject;}
+
+    // Moves the parsed json object out of the reader, which is left empty: the consumer owns it without 
+    // copying it. A map given back with release (e.g. once its consumer is done with it) is reused by the 
+    // next parse, which keeps its buckets 
+    jMap take() {return std::move(jsonObject);}
+    void release(jMap&& object) {
+        jsonObject = std::move(object); 
+        jsonObject.clear(); 
+    }
 
     std::string& operator[](std::string key) {
         return jsonObject[key]; 
@@ -53,6 +92,14 @@ public:
 
     friend std::ostream& operator<<(std::ostream& os, const JsonReader& obj); 
 
+    // Reads the members of an object whose opening brace was just returned by the tokenizer, 
+    // and adds the ones of the projection to the map; returns false if the object is not valid json 
+    static bool readObject(JsonTokenizer& tokenizer, jMap& object, const JsonProjection& keys = {}); 
+
+    // Stores a value returned by JsonTokenizer::nextValue as the maps do (strings unquoted and unescaped, 
+    // literals, arrays and objects as json text); returns false if the token is not a value 
+    static bool storeValue(const JsonTokenizer::Token& value, std::string& out); 
+
 
 private:
     jMap jsonObject; 
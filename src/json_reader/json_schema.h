@@ -0,0 +1,178 @@
+#pragma once
+
+#include "json_reader.h"
+#include "../utils/arena.h"
+#include "json_tokenizer.h"
+#include "structural_index.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Perfect hash of a fixed set of keys, built at compile time: every key has its own slot, so a key is
+ * looked up with one hash and one comparison. The hash samples a few characters of the key (its length,
+ * first, middle and last characters) when they tell the keys apart, and reads the whole key otherwise.
+ * The seed of the hash is searched for at compile time; perfect() is false if none was found.
+ */
+template<size_t N>
+class JsonKeys {
+
+public:
+    constexpr explicit JsonKeys(const std::array<std::string_view, N>& keys): keys_(keys) {
+        for (const bool sampled: {true, false}) {
+            for (uint32_t seed = 1; seed < 4096; ++seed) {
+                if (fill(sampled, seed)) {
+                    sampled_ = sampled;
+                    seed_ = seed;
+                    return;
+                }
+            }
+        }
+    }
+
+    constexpr bool perfect() const {return seed_ != 0;}
+    constexpr size_t size() const {return N;}
+    constexpr std::string_view operator[](size_t i) const {return keys_[i];}
+
+    // Index of the key in the set, or -1 if it is not one of the keys
+    constexpr int find(std::string_view key) const {
+        const int index = slots_[hash(key, sampled_, seed_) & (SLOTS - 1)];
+        return index >= 0 && keys_[index] == key ? index : -1;
+    }
+
+private:
+    static constexpr size_t SLOTS = [] {
+        size_t slots = 8;
+        while (slots < 2 * N) slots *= 2;
+        return slots;
+    }();
+
+    std::array<std::string_view, N> keys_{};
+    std::array<int, SLOTS> slots_{};
+    bool sampled_ = true;
+    uint32_t seed_ = 0;
+
+    static constexpr uint32_t mix(uint32_t h, unsigned char c) {return (h ^ c) * 16777619u;}
+
+    static constexpr uint32_t hash(std::string_view key, bool sampled, uint32_t seed) {
+        uint32_t h = mix(seed * 2654435761u, static_cast<unsigned char>(key.size()));
+        if (sampled) {
+            if (!key.empty()) {
+                h = mix(h, static_cast<unsigned char>(key[0]));
+                h = mix(h, static_cast<unsigned char>(key[key.size() / 2]));
+                h = mix(h, static_cast<unsigned char>(key[key.size() - 1]));
+            }
+        } else {
+            for (const char c: key) h = mix(h, static_cast<unsigned char>(c));
+        }
+        return h ^ (h >> 16);
+    }
+
+    constexpr bool fill(bool sampled, uint32_t seed) {
+        for (auto& slot: slots_) slot = -1;
+        for (size_t i = 0; i < N; ++i) {
+            auto& slot = slots_[hash(keys_[i], sampled, seed) & (SLOTS - 1)];
+            if (slot >= 0) return false;
+            slot = static_cast<int>(i);
+        }
+        return true;
+    }
+};
+
+/*
+ * Reader of the json objects of a known payload (e.g. a ticker, a candle, a currency), specialized at
+ * compile time by its schema. A schema declares the keys of the payload once, and how their values are
+ * stored into a typed record:
+ *
+ *     struct CandleSchema {
+ *         using Record = Candle;
+ *         static constexpr std::array<std::string_view, 2> KEYS = {"timestamp", "close"};
+ *         // Stores the value of KEYS[key]; returns false if the record cannot hold it
+ *         static bool set(Record& record, size_t key, const JsonTokenizer::Token& value);
+ *     };
+ *
+ * The keys are dispatched with the perfect hash of the schema (see JsonKeys), and the values are handed
+ * over as tokens (spans of the input), without building a map. The keys out of the schema, and the values
+ * the record cannot hold, are stored by the generic reader (see JsonReader::storeValue) into a map of the
+ * caller (by readArray, into the "others" map of the records which have one), or skipped.
+ */
+template<typename Schema>
+class JsonSchemaReader {
+
+    template<typename R, typename = void>
+    struct HasOthers : std::false_type {};
+    template<typename R>
+    struct HasOthers<R, std::void_t<decltype(std::declval<R&>().others)>> : std::is_same<decltype(std::declval<R&>().others), jMap> {};
+
+public:
+    using Record = typename Schema::Record;
+
+    static constexpr JsonKeys<Schema::KEYS.size()> KEYS{Schema::KEYS};
+    static_assert(KEYS.perfect(), "no perfect hash found for the keys of the schema");
+
+    // Reads the members of an object whose opening brace was just returned by the tokenizer into the
+    // record; returns false if the object is not valid json
+    static bool readObject(JsonTokenizer& tokenizer, Record& record, jMap* others = nullptr);
+
+    // Reads the objects of the first array of objects of the input, wherever it is nested (as
+    // MultiJsonReader does), into a new record each, and passes the records to onRecord(Record&), which
+    // can move them.
+    // Returns false if the input is not valid json (the records read before the error were passed).
+    template<typename OnRecord>
+    static bool readArray(JsonTokenizer& tokenizer, OnRecord&& onRecord);
+    template<typename OnRecord>
+    static bool readArray(std::string_view json, OnRecord&& onRecord) {
+        Arena::Scope scratch; // the index only lives for this parse
+        StructuralIndex index(scratch.resource());
+        JsonTokenizer tokenizer = index.build(json) ? JsonTokenizer(json, index) : JsonTokenizer(json);
+        return readArray(tokenizer, onRecord);
+    }
+};
+
+template<typename Schema>
+bool JsonSchemaReader<Schema>::readObject(JsonTokenizer& tokenizer, Record& record, jMap* others) {
+    using TokenType = JsonTokenizer::TokenType;
+    std::string unescaped; // only used for the keys with escape sequences
+    while (true) {
+        auto token = tokenizer.next();
+        if (token.type == TokenType::EndObject) return true;
+        if (token.type != TokenType::Key) return false;
+        std::string_view key = token.text;
+        if (token.escaped) {
+            JsonTokenizer::unescape(token.text, unescaped);
+            key = unescaped;
+        }
+        auto value = tokenizer.nextValue();
+        if (value.type == TokenType::Error) return false;
+        const int index = KEYS.find(key);
+        if (index >= 0 && Schema::set(record, static_cast<size_t>(index), value)) continue;
+        if (others != nullptr) JsonReader::storeValue(value, (*others)[std::string(key)]);
+    }
+}
+
+template<typename Schema>
+template<typename OnRecord>
+bool JsonSchemaReader<Schema>::readArray(JsonTokenizer& tokenizer, OnRecord&& onRecord) {
+    using TokenType = JsonTokenizer::TokenType;
+    bool afterArray = false;
+    for (auto token = tokenizer.next(); token.type != TokenType::Error; token = tokenizer.next()) {
+        if (token.type == TokenType::End) return true; // no array of objects
+        if (afterArray && token.type == TokenType::BeginObject) {
+            do {
+                Record record{};
+                jMap* others = nullptr;
+                if constexpr (HasOthers<Record>::value) others = &record.others;
+                if (!readObject(tokenizer, record, others)) return false;
+                onRecord(record);
+                token = tokenizer.next();
+            } while (token.type == TokenType::BeginObject);
+            return token.type == TokenType::EndArray;
+        }
+        afterArray = token.type == TokenType::BeginArray;
+    }
+    return false;
+}
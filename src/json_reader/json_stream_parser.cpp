@@ -0,0 +1,204 @@
+#include "json_stream_parser.h"
+#include <cctype>
+
+void JsonStreamParser::reset() {
+    stack_.clear();
+    recordDepth_ = -1;
+    inRecord_ = done_ = failed_ = started_ = false;
+    objects_ = 0;
+    inString_ = escape_ = false;
+    unicode_.clear();
+    highSurrogate_ = 0;
+    record_.clear();
+    key_.clear();
+    value_.clear();
+    afterColon_ = false;
+    raw_.clear();
+}
+
+void JsonStreamParser::feed(const char* data, size_t size) {
+    for (size_t i = 0; i < size && !failed_; ++i) process(data[i]);
+}
+
+bool JsonStreamParser::finish() {
+    if (!started_ || !stack_.empty() || inString_) fail();
+    return !failed_;
+}
+
+void JsonStreamParser::process(char c) {
+    bool capturing = inRecord_ && static_cast<int>(stack_.size()) > recordDepth_;
+    if (inString_) {
+        if (capturing) {
+            raw_ += c;
+            if (escape_) escape_ = false;
+            else if (c == '\\') escape_ = true;
+            else if (c == '"') inString_ = false;
+        } else {
+            onStringChar(c);
+        }
+        return;
+    }
+
+    switch (c) {
+        case ' ': case '\t': case '\r': case '\n':
+            return;
+        case '"':
+            inString_ = true;
+            if (capturing) raw_ += c;
+            return;
+        case '{': case '[':
+            open(c);
+            return;
+        case '}': case ']':
+            close(c);
+            return;
+        case ':':
+            if (capturing) raw_ += c;
+            else if (inRecord_) afterColon_ = true;
+            return;
+        case ',':
+            if (capturing) raw_ += c;
+            else if (inRecord_) commitPair();
+            return;
+        default:
+            if (stack_.empty()) return fail(); // scalars are only accepted inside arrays and objects
+            if (capturing) raw_ += c;
+            else if (inRecord_ && afterColon_) value_ += c; // number, true, false or null
+    }
+}
+
+void JsonStreamParser::onStringChar(char c) {
+    if (!unicode_.empty() || (escape_ && c == 'u')) {
+        // \uXXXX escape, possibly split in a surrogate pair
+        if (escape_) {
+            escape_ = false;
+            unicode_ = "u";
+            return;
+        }
+        if (!std::isxdigit(static_cast<unsigned char>(c))) return fail();
+        unicode_ += c;
+        if (unicode_.size() < 5) return;
+        unsigned codePoint = std::stoul(unicode_.substr(1), nullptr, 16);
+        unicode_.clear();
+        if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+            highSurrogate_ = codePoint;
+            return;
+        }
+        if (codePoint >= 0xDC00 && codePoint < 0xE000 && highSurrogate_ != 0) {
+            codePoint = 0x10000 + ((highSurrogate_ - 0xD800) << 10) + (codePoint - 0xDC00);
+        }
+        highSurrogate_ = 0;
+        return appendCodePoint(codePoint);
+    }
+    if (escape_) {
+        escape_ = false;
+        char decoded;
+        switch (c) {
+            case 'b': decoded = '\b'; break;
+            case 'f': decoded = '\f'; break;
+            case 'n': decoded = '\n'; break;
+            case 'r': decoded = '\r'; break;
+            case 't': decoded = '\t'; break;
+            default: decoded = c; // '"', '\\' and '/'
+        }
+        return append(&decoded, 1);
+    }
+    if (c == '\\') escape_ = true;
+    else if (c == '"') inString_ = false;
+    else append(&c, 1);
+}
+
+void JsonStreamParser::append(const char* s, size_t n) {
+    if (!inRecord_) return;
+    if (afterColon_) value_.append(s, n);
+    else key_.append(s, n);
+}
+
+void JsonStreamParser::appendCodePoint(unsigned codePoint) {
+    char utf8[4];
+    size_t n;
+    if (codePoint < 0x80) {
+        utf8[0] = static_cast<char>(codePoint);
+        n = 1;
+    } else if (codePoint < 0x800) {
+        utf8[0] = static_cast<char>(0xC0 | (codePoint >> 6));
+        utf8[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        n = 2;
+    } else if (codePoint < 0x10000) {
+        utf8[0] = static_cast<char>(0xE0 | (codePoint >> 12));
+        utf8[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        utf8[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        n = 3;
+    } else {
+        utf8[0] = static_cast<char>(0xF0 | (codePoint >> 18));
+        utf8[1] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        utf8[2] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        utf8[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        n = 4;
+    }
+    append(utf8, n);
+}
+
+void JsonStreamParser::open(char c) {
+    if (inRecord_) {
+        // Nested value of the current record: captured as json text
+        raw_ += c;
+        stack_.push_back(c);
+        return;
+    }
+
+    bool parentIsArray = !stack_.empty() && stack_.back() == '[';
+    stack_.push_back(c);
+    started_ = true;
+    if (c != '{' || done_) return;
+
+    int depth = static_cast<int>(stack_.size());
+    if (recordDepth_ < 0) {
+        if (mode_ == Mode::Object && depth == 1) recordDepth_ = 1;
+        if (mode_ == Mode::Records && parentIsArray) recordDepth_ = depth;
+    }
+    if (depth == recordDepth_ && (mode_ == Mode::Object || parentIsArray)) {
+        inRecord_ = true;
+        record_.clear();
+        key_.clear();
+        value_.clear();
+        afterColon_ = false;
+    }
+}
+
+void JsonStreamParser::close(char c) {
+    char expected = c == '}' ? '{' : '[';
+    if (stack_.empty() || stack_.back() != expected) return fail();
+    int depth = static_cast<int>(stack_.size());
+
+    if (inRecord_ && depth > recordDepth_) {
+        // End of (a part of) a nested value
+        raw_ += c;
+        stack_.pop_back();
+        if (depth - 1 == recordDepth_) {
+            value_ = std::move(raw_);
+            raw_.clear();
+        }
+        return;
+    }
+
+    stack_.pop_back();
+    if (inRecord_) {
+        // End of a record
+        commitPair();
+        inRecord_ = false;
+        ++objects_;
+        if (mode_ == Mode::Object) done_ = true;
+        handler_(std::move(record_));
+        record_.clear();
+        return;
+    }
+    if (c == ']' && depth == recordDepth_ - 1) done_ = true; // end of the array of records
+}
+
+void JsonStreamParser::commitPair() {
+    if (!key_.empty() || afterColon_) record_[key_] = value_;
+    key_.clear();
+    value_.clear();
+    afterColon_ = false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "json_reader.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * Incremental (push) json parser. The input is fed in chunks of any size, e.g. as they are received
+ * from the network, and each json object is passed to the handler as soon as its closing brace is
+ * parsed, so that parsing overlaps the transfer and the memory used does not depend on the size of
+ * the input. In Records mode the objects are the elements of the first array of objects found in
+ * the input (e.g. the candles of an ohlc response, or the tickers of the all-tickers response); in
+ * Object mode the object is the top-level one. As with JsonReader, the objects are converted into
+ * maps of strings: string values are unquoted, while nested arrays and objects are kept as json text.
+ */
+class JsonStreamParser {
+
+public:
+    enum class Mode {Records, Object};
+    using Handler = std::function<void(jMap&&)>;
+
+    JsonStreamParser(Mode mode, Handler handler): mode_(mode), handler_(std::move(handler)) {}
+
+    // Parses the next chunk of the input
+    void feed(const char* data, size_t size);
+    void feed(const std::string& data) {feed(data.data(), data.size());}
+
+    // Notifies the end of the input; returns false if the input was not a complete json document
+    bool finish();
+
+    bool failed() const {return failed_;}
+
+    // Number of objects passed to the handler
+    size_t objects() const {return objects_;}
+
+    // Prepares the parser for a new input
+    void reset();
+
+private:
+    Mode mode_;
+    Handler handler_;
+
+    std::vector<char> stack_;  // open arrays and objects
+    int recordDepth_ = -1;     // depth of the objects passed to the handler (-1 until the first one is found)
+    bool inRecord_ = false;
+    bool done_ = false;        // the array of records (or the top-level object) was closed
+    bool failed_ = false;
+    bool started_ = false;
+    size_t objects_ = 0;
+
+    // Lexer state
+    bool inString_ = false;
+    bool escape_ = false;
+    std::string unicode_;      // hex digits of a \u escape
+    unsigned highSurrogate_ = 0;
+
+    // Current record
+    jMap record_;
+    std::string key_;
+    std::string value_;
+    bool afterColon_ = false;
+    std::string raw_;          // json text of the nested value being captured
+
+    void process(char c);
+    void onStringChar(char c);
+    void open(char c);
+    void close(char c);
+    void commitPair();
+    void append(const char* s, size_t n); // appends decoded string characters to the key or to the value
+    void appendCodePoint(unsigned codePoint);
+    void fail() {failed_ = true;}
+};
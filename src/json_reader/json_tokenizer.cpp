@@ -0,0 +1,238 @@
+#include "json_tokenizer.h"
+#include <cstring>
+
+namespace {
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Validates a number according to the json grammar, e.g. -12.5e+3
+bool isNumber(std::string_view text) {
+    size_t i = 0;
+    size_t n = text.size();
+    if (i < n && text[i] == '-') ++i;
+    if (i == n || !isDigit(text[i])) return false;
+    if (text[i] == '0') ++i;
+    else while (i < n && isDigit(text[i])) ++i;
+    if (i < n && text[i] == '.') {
+        if (++i == n || !isDigit(text[i])) return false;
+        while (i < n && isDigit(text[i])) ++i;
+    }
+    if (i < n && (text[i] == 'e' || text[i] == 'E')) {
+        if (++i < n && (text[i] == '+' || text[i] == '-')) ++i;
+        if (i == n || !isDigit(text[i])) return false;
+        while (i < n && isDigit(text[i])) ++i;
+    }
+    return i == n;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Reads the 4 hex digits of a \u escape starting at text[i]; returns -1 if they are not valid
+long hex4(std::string_view text, size_t i) {
+    if (i + 4 > text.size()) return -1;
+    long value = 0;
+    for (size_t k = i; k < i + 4; ++k) {
+        int digit = hexValue(text[k]);
+        if (digit < 0) return -1;
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+void appendUtf8(unsigned codePoint, std::string& out) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+} // namespace
+
+JsonTokenizer::Token JsonTokenizer::next() {
+    if (failed_) return error();
+    const size_t size = input_.size();
+    while (true) {
+        skipSpace();
+        if (pos_ == size) return expect_ == Expect::Done ? Token{TokenType::End, {}, false} : error();
+
+        const char c = input_[pos_];
+        switch (c) {
+            case ':':
+                if (expect_ != Expect::Colon) return error();
+                ++pos_;
+                expect_ = Expect::Value;
+                continue;
+            case ',':
+                if (expect_ != Expect::CommaOrEnd) return error();
+                ++pos_;
+                expect_ = stack_.back() == '{' ? Expect::Key : Expect::Value;
+                continue;
+            case '{':
+            case '[':
+                if (expect_ != Expect::Value && expect_ != Expect::ValueOrEnd) return error();
+                stack_ += c;
+                expect_ = c == '{' ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+                return {c == '{' ? TokenType::BeginObject : TokenType::BeginArray, input_.substr(pos_++, 1), false};
+            case '}':
+            case ']': {
+                // The closing bracket must match the innermost open container
+                const bool object = c == '}';
+                if (expect_ != Expect::CommaOrEnd && expect_ != (object ? Expect::KeyOrEnd : Expect::ValueOrEnd)) return error();
+                if (stack_.empty() || stack_.back() != (object ? '{' : '[')) return error();
+                stack_.pop_back();
+                afterValue();
+                return {object ? TokenType::EndObject : TokenType::EndArray, input_.substr(pos_++, 1), false};
+            }
+            case '"':
+                if (expect_ == Expect::Key || expect_ == Expect::KeyOrEnd) return scanString(TokenType::Key);
+                if (expect_ == Expect::Value || expect_ == Expect::ValueOrEnd) return scanString(TokenType::String);
+                return error();
+            default:
+                if (expect_ != Expect::Value && expect_ != Expect::ValueOrEnd) return error(); // also after the top-level value
+                return scanLiteral();
+        }
+    }
+}
+
+// Without an index the whitespace is skipped character by character; with an index, only the gap up to
+// the next structural character or quote is read (it holds whitespace, or a number or literal)
+void JsonTokenizer::skipSpace() {
+    size_t stop = input_.size();
+    if (next_ != nullptr) {
+        while (next_ < last_ && *next_ < pos_) ++next_;
+        if (next_ < last_) stop = *next_;
+    }
+    while (pos_ < stop && isSpace(input_[pos_])) ++pos_;
+}
+
+JsonTokenizer::Token JsonTokenizer::scanString(TokenType type) {
+    const char* const data = input_.data();
+    const char* const end = data + input_.size();
+    const char* begin = data + pos_ + 1;
+    const char* quote = begin;
+    bool escaped = false;
+
+    if (next_ != nullptr) {
+        // The closing quote is the next position of the index
+        if (next_ + 1 >= last_ || *next_ != pos_) return error();
+        quote = data + next_[1];
+        next_ += 2;
+        escaped = !noEscapes_ && std::memchr(begin, '\\', quote - begin) != nullptr;
+    } else {
+        // The closing quote is the first quote not preceded by a backslash
+        while (quote < end && *quote != '"' && *quote != '\\') ++quote;
+        escaped = quote < end && *quote == '\\';
+        while (quote < end && *quote != '"') quote += *quote == '\\' ? 2 : 1;
+        if (quote >= end) return error();
+    }
+
+    pos_ = quote + 1 - data;
+    if (type == TokenType::Key) expect_ = Expect::Colon;
+    else afterValue();
+    return {type, std::string_view(begin, quote - begin), escaped};
+}
+
+JsonTokenizer::Token JsonTokenizer::scanLiteral() {
+    const size_t begin = pos_;
+    const size_t size = input_.size();
+    if (next_ != nullptr) {
+        // The literal ends at the next whitespace, structural character or quote
+        const size_t stop = next_ < last_ ? *next_ : size;
+        while (pos_ < stop && !isSpace(input_[pos_])) ++pos_;
+    } else {
+        while (pos_ < size) {
+            const char c = input_[pos_];
+            if (c == ',' || c == '}' || c == ']' || c == ':' || c == '{' || c == '[' || c == '"' || isSpace(c)) break;
+            ++pos_;
+        }
+    }
+    auto text = input_.substr(begin, pos_ - begin);
+    bool valid = text == "true" || text == "false" || text == "null" || isNumber(text);
+    if (!valid) return error();
+    afterValue();
+    return {TokenType::Literal, text, false};
+}
+
+JsonTokenizer::Token JsonTokenizer::nextValue() {
+    auto token = next();
+    if (token.type != TokenType::BeginObject && token.type != TokenType::BeginArray) return token;
+    size_t begin = token.text.data() - input_.data();
+    size_t depth = stack_.size();
+    while (stack_.size() >= depth) {
+        if (next().type == TokenType::Error) return error();
+    }
+    token.text = input_.substr(begin, pos_ - begin);
+    return token;
+}
+
+std::string JsonTokenizer::unescape(std::string_view text) {
+    std::string out;
+    unescape(text, out);
+    return out;
+}
+
+void JsonTokenizer::unescape(std::string_view text, std::string& out) {
+    out.clear();
+    out.reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+        // Copies the run of characters up to the next escape in one go
+        size_t escape = text.find('\\', i);
+        if (escape == std::string_view::npos) escape = text.size();
+        out.append(text.data() + i, escape - i);
+        i = escape;
+        if (i + 1 >= text.size()) break;
+
+        const char c = text[i + 1];
+        i += 2;
+        switch (c) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                long codePoint = hex4(text, i);
+                if (codePoint < 0) {
+                    out += "\xEF\xBF\xBD"; // replacement character
+                    break;
+                }
+                i += 4;
+                // A high surrogate is combined with the low surrogate of the following escape
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF && i + 1 < text.size() && text[i] == '\\' && text[i + 1] == 'u') {
+                    long low = hex4(text, i + 2);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                if (codePoint >= 0xD800 && codePoint <= 0xDFFF) out += "\xEF\xBF\xBD"; // unpaired surrogate
+                else appendUtf8(static_cast<unsigned>(codePoint), out);
+                break;
+            }
+            default: out += c; // \" \\ \/
+        }
+    }
+}
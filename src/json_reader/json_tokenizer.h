@@ -0,0 +1,72 @@
+#pragma once
+
+#include "structural_index.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * Single-pass json tokenizer over a contiguous buffer (e.g. a whole response, or a WebSocket message).
+ * The tokens are spans of the input: keys and string values are returned without their quotes and
+ * without decoding their escapes (the escaped flag tells whether unescape() is needed), numbers and
+ * literals (true, false, null) as they appear in the input. Nothing is allocated while tokenizing,
+ * except when the nesting is deeper than the small buffer of the container stack. The input must
+ * outlive the tokens. The structure of the document is validated (unescaped control characters within
+ * strings are tolerated): a malformed input yields an Error token, after which the tokenizer only
+ * returns Error.
+ */
+class JsonTokenizer {
+
+public:
+    enum class TokenType {BeginObject, EndObject, BeginArray, EndArray, Key, String, Literal, End, Error};
+
+    struct Token {
+        TokenType type = TokenType::Error;
+        std::string_view text;   // span of the input (for Begin/End tokens, the bracket)
+        bool escaped = false;    // the key or string contains escape sequences
+    };
+
+    explicit JsonTokenizer(std::string_view input): input_(input) {}
+
+    // Walks the structural index of the input (see StructuralIndex) instead of reading every character:
+    // the tokens are the same. The index must have been built from the same input, and outlive the tokenizer.
+    JsonTokenizer(std::string_view input, const StructuralIndex& index):
+        input_(input), next_(index.begin()), last_(index.end()), noEscapes_(!index.hasBackslashes()) {}
+
+    // Returns the next token; End once the top-level value is complete and only whitespace follows
+    Token next();
+
+    // Returns the next token, reading nested values as a whole: when the next value is an array or an
+    // object, the token (BeginArray or BeginObject) spans its json text, brackets included
+    Token nextValue();
+
+    // Offset of the first character not consumed yet
+    size_t position() const {return pos_;}
+
+    // Decodes the escape sequences of a key or string value (\uXXXX escapes are converted into UTF-8)
+    static std::string unescape(std::string_view text);
+    static void unescape(std::string_view text, std::string& out);
+
+private:
+    // What the grammar allows at the current position
+    enum class Expect : unsigned char {Value, ValueOrEnd, Key, KeyOrEnd, Colon, CommaOrEnd, Done};
+
+    std::string_view input_;
+    size_t pos_ = 0;
+    Expect expect_ = Expect::Value;
+    std::string stack_;   // '{' and '[' of the open containers (short stacks do not allocate)
+    bool failed_ = false;
+    const uint32_t* next_ = nullptr;   // with a structural index: first position not consumed yet
+    const uint32_t* last_ = nullptr;
+    bool noEscapes_ = false;           // with a structural index: the input has no backslashes
+
+    Token error() {
+        failed_ = true;
+        return {TokenType::Error, {}, false};
+    }
+    void skipSpace();
+    Token scanString(TokenType type);
+    Token scanLiteral();
+    void afterValue() {expect_ = stack_.empty() ? Expect::Done : Expect::CommaOrEnd;}
+};
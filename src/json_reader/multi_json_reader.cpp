@@ -1,31 +1,40 @@
 #include "multi_json_reader.h"
+#include "../utils/arena.h"
 
 // Reads a vector of json strings, and it turns them into a vector 
 // of unordered maps. Note: the json vector is assumed to have form
-// [{}, {}, {}, ..., {}] 
-void MultiJsonReader::setFromString(const std::string& inputString) {
+// [{}, {}, {}, ..., {}]; the first such array of the input is read, 
+// wherever it is nested (e.g. {"data": {"ohlc": [{}, {}]}}). With a projection, the other keys 
+// of the objects are skipped while they are tokenized 
+void MultiJsonReader::setFromString(const std::string& inputString, const JsonProjection& keys) {
     if (inputString.size() == 0) return; 
     multiJsonObject.clear(); 
 
-    size_t openSquareBracketPos = inputString.find("[{");
-    if (openSquareBracketPos == std::string::npos) return; 
-    size_t closeSquareBracketPos = inputString.find("}]");
-    if (closeSquareBracketPos == std::string::npos) return; 
-    auto dataList = inputString.substr(openSquareBracketPos+1, closeSquareBracketPos-openSquareBracketPos);
-
-    std::stringstream ss{dataList};
-    std::string tmpData; 
-    while (std::getline(ss, tmpData, '}')) {
-        size_t openBracket = tmpData.find(" {"); 
-        if (openBracket != std::string::npos) tmpData = tmpData.substr(openBracket + 1); 
-        JsonReader tmpJsonObject(tmpData + '}', false); 
-        multiJsonObject.push_back(tmpJsonObject.get()); 
-    } 
+    // The tokenizer walks the structural index of the input: the content of the strings is not read again 
+    using TokenType = JsonTokenizer::TokenType; 
+    Arena::Scope scratch; // the index only lives for this parse 
+    StructuralIndex index(scratch.resource()); 
+    JsonTokenizer tokenizer = index.build(inputString) ? JsonTokenizer(inputString, index) : JsonTokenizer(inputString); 
+    bool afterArray = false; 
+    for (auto token = tokenizer.next(); token.type != TokenType::End && token.type != TokenType::Error; token = tokenizer.next()) {
+        if (afterArray && token.type == TokenType::BeginObject) {
+            do {
+                // The objects of an array usually have the same keys: the buckets are allocated once 
+                jMap object; 
+                if (!multiJsonObject.empty()) object.reserve(multiJsonObject.back().size()); 
+                if (!JsonReader::readObject(tokenizer, object, keys)) return; 
+                multiJsonObject.push_back(std::move(object)); 
+                token = tokenizer.next(); 
+            } while (token.type == TokenType::BeginObject); 
+            return; 
+        }
+        afterArray = token.type == TokenType::BeginArray; 
+    }
 }
 
 // Reads a vector of json objects from file, and it turns them into a vector 
 // of unordered maps. To achieve this, it makes use of the setToString method
-void MultiJsonReader::setFromFile(const std::string& inputFileName) {
+void MultiJsonReader::setFromFile(const std::string& inputFileName, const JsonProjection& keys) {
 
     std::fstream inputFile(inputFileName, std::ios::in); 
 
@@ -37,7 +46,7 @@ void MultiJsonReader::setFromFile(const std::string& inputFileName) {
     std::stringstream stringFileStream; 
     std::string jsonLine;  
     while (std::getline(inputFile, jsonLine)) stringFileStream << jsonLine; 
-    setFromString(stringFileStream.str()); 
+    setFromString(stringFileStream.str(), keys); 
     inputFile.close(); 
 }
 
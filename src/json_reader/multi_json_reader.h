@@ -30,9 +30,23 @@ public:
         else this->setFromFile(inputString); 
     }
 
-    void setFromString(const std::string&); 
-    void setFromFile(const std::string&); 
-    auto get() const -> std::vector<jMap> {return multiJsonObject;}
+    // Only the keys of the projection are read from each object (see JsonProjection) 
+    MultiJsonReader(std::string inputString, const JsonProjection& keys, bool isFile=false) {
+        this->multiJsonObject.reserve(5); 
+        if (!isFile) this->setFromString(inputString, keys);
+        else this->setFromFile(inputString, keys); 
+    }
+
+    void setFromString(const std::string&, const JsonProjection& keys = {}); 
+    void setFromFile(const std::string&, const JsonProjection& keys = {}); 
+    auto get() const -> const std::vector<jMap>& {return multiJsonObject;}
+
+    // Same as JsonReader::take and JsonReader::release: the vector given back keeps its capacity 
+    std::vector<jMap> take() {return std::move(multiJsonObject);}
+    void release(std::vector<jMap>&& objects) {
+        multiJsonObject = std::move(objects); 
+        multiJsonObject.clear(); 
+    }
 
     jMap& operator[](size_t i) {
         return multiJsonObject.at(i);  
@@ -42,6 +56,5 @@ public:
 
 
 private:
-    JsonReader current; 
     std::vector<jMap> multiJsonObject; 
 }; 
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "structural_index.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CMDF_X86_KERNELS 1
+#endif
+
+namespace {
+
+constexpr size_t BLOCK = 64;
+
+// Carried from one block to the next
+struct BlockState {
+    uint64_t escaped = 0;   // the first character of the block is escaped by the last backslash of the previous one
+    uint64_t inString = 0;  // all ones if the previous block ended within a string
+    uint64_t backslashes = 0;
+};
+
+// Characters preceded by an odd number of backslashes (runs of backslashes can span blocks)
+inline uint64_t findEscaped(uint64_t backslash, uint64_t& previous) {
+    if (backslash == 0) {
+        uint64_t escaped = previous;
+        previous = 0;
+        return escaped;
+    }
+    backslash &= ~previous;
+    const uint64_t followsEscape = backslash << 1 | previous;
+    const uint64_t evenBits = 0x5555555555555555ULL;
+    const uint64_t oddSequenceStarts = backslash & ~evenBits & ~followsEscape;
+    unsigned long long sequencesStartingOnEvenBits;
+    previous = __builtin_uaddll_overflow(oddSequenceStarts, backslash, &sequencesStartingOnEvenBits);
+    const uint64_t invertMask = sequencesStartingOnEvenBits << 1;
+    return (evenBits ^ invertMask) & followsEscape;
+}
+
+// Bit i of the result is the xor of the bits 0..i of x: with x marking the quotes, it marks the characters
+// from an opening quote (included) to the closing one (excluded)
+inline uint64_t prefixXor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+// Turns the character masks of a block into positions; returns the number of positions written
+inline size_t emitBlock(uint64_t quote, uint64_t backslash, uint64_t structural, BlockState& state, uint32_t base, uint32_t* out) {
+    state.backslashes |= backslash;
+    const uint64_t quotes = quote & ~findEscaped(backslash, state.escaped);
+    const uint64_t inString = prefixXor(quotes) ^ state.inString;
+    state.inString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+    uint64_t bits = (structural & ~inString) | quotes;
+    size_t count = 0;
+    while (bits != 0) {
+        out[count++] = base + static_cast<uint32_t>(__builtin_ctzll(bits));
+        bits &= bits - 1;
+    }
+    return count;
+}
+
+// Character classes of the scalar kernel
+enum : uint8_t {QUOTE = 1, BACKSLASH = 2, STRUCTURAL = 4};
+
+struct ClassTable {
+    uint8_t classes[256] = {};
+    constexpr ClassTable() {
+        classes[static_cast<uint8_t>('"')] = QUOTE;
+        classes[static_cast<uint8_t>('\\')] = BACKSLASH;
+        for (char c: {'{', '}', '[', ']', ':', ','}) classes[static_cast<uint8_t>(c)] = STRUCTURAL;
+    }
+};
+constexpr ClassTable CLASS_TABLE;
+
+// Each kernel indexes the full blocks of data[0, size) (size is a multiple of BLOCK), writing at most
+// size positions to out; returns the number of positions written
+size_t indexScalar(const char* data, size_t size, uint32_t base, BlockState& state, uint32_t* out) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i += BLOCK) {
+        uint64_t quote = 0, backslash = 0, structural = 0;
+        for (size_t k = 0; k < BLOCK; ++k) {
+            const uint8_t c = CLASS_TABLE.classes[static_cast<uint8_t>(data[i + k])];
+            quote |= static_cast<uint64_t>(c & QUOTE) << k;
+            backslash |= static_cast<uint64_t>((c & BACKSLASH) >> 1) << k;
+            structural |= static_cast<uint64_t>((c & STRUCTURAL) >> 2) << k;
+        }
+        count += emitBlock(quote, backslash, structural, state, base + static_cast<uint32_t>(i), out + count);
+    }
+    return count;
+}
+
+#ifdef CMDF_X86_KERNELS
+
+// '{' and '[' (and '}' and ']') only differ by the 0x20 bit: the six structural characters take four comparisons
+__attribute__((target("avx2"), always_inline))
+inline void avx2Masks(const char* data, uint32_t& quote, uint32_t& backslash, uint32_t& structural) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    const __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    const __m256i brackets = _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}')));
+    const __m256i separators = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(',')));
+    quote = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))));
+    backslash = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))));
+    structural = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(brackets, separators)));
+}
+
+__attribute__((target("avx2")))
+size_t indexAvx2(const char* data, size_t size, uint32_t base, BlockState& state, uint32_t* out) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i += BLOCK) {
+        uint32_t q0, b0, s0, q1, b1, s1;
+        avx2Masks(data + i, q0, b0, s0);
+        avx2Masks(data + i + 32, q1, b1, s1);
+        count += emitBlock(q0 | static_cast<uint64_t>(q1) << 32, b0 | static_cast<uint64_t>(b1) << 32,
+                           s0 | static_cast<uint64_t>(s1) << 32, state, base + static_cast<uint32_t>(i), out + count);
+    }
+    return count;
+}
+
+__attribute__((target("sse4.2")))
+size_t indexSse42(const char* data, size_t size, uint32_t base, BlockState& state, uint32_t* out) {
+    const __m128i quoteChar = _mm_set1_epi8('"');
+    const __m128i backslashChar = _mm_set1_epi8('\\');
+    const __m128i openChar = _mm_set1_epi8('{');
+    const __m128i closeChar = _mm_set1_epi8('}');
+    const __m128i colonChar = _mm_set1_epi8(':');
+    const __m128i commaChar = _mm_set1_epi8(',');
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+
+    size_t count = 0;
+    for (size_t i = 0; i < size; i += BLOCK) {
+        uint64_t quote = 0, backslash = 0, structural = 0;
+        for (size_t k = 0; k < BLOCK; k += 16) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + k));
+            const __m128i folded = _mm_or_si128(v, caseBit);
+            const __m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(folded, openChar), _mm_cmpeq_epi8(folded, closeChar));
+            const __m128i separators = _mm_or_si128(_mm_cmpeq_epi8(v, colonChar), _mm_cmpeq_epi8(v, commaChar));
+            quote |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quoteChar)))) << k;
+            backslash |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslashChar)))) << k;
+            structural |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_or_si128(brackets, separators)))) << k;
+        }
+        count += emitBlock(quote, backslash, structural, state, base + static_cast<uint32_t>(i), out + count);
+    }
+    return count;
+}
+
+#endif
+
+using IndexFunction = size_t (*)(const char*, size_t, uint32_t, BlockState&, uint32_t*);
+
+IndexFunction indexFunction(StructuralIndex::Kernel kernel) {
+    kernel = std::min(kernel, StructuralIndex::bestKernel()); // the kernels not supported by the CPU are never run
+#ifdef CMDF_X86_KERNELS
+    if (kernel == StructuralIndex::Kernel::Avx2) return indexAvx2;
+    if (kernel == StructuralIndex::Kernel::Sse42) return indexSse42;
+#endif
+    return indexScalar;
+}
+
+} // namespace
+
+StructuralIndex::Kernel StructuralIndex::bestKernel() {
+#ifdef CMDF_X86_KERNELS
+    static const Kernel best = __builtin_cpu_supports("avx2") ? Kernel::Avx2
+                             : __builtin_cpu_supports("sse4.2") ? Kernel::Sse42 : Kernel::Scalar;
+    return best;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+const char* StructuralIndex::kernelName(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Avx2: return "avx2";
+        case Kernel::Sse42: return "sse4.2";
+        default: return "scalar";
+    }
+}
+
+void StructuralIndex::reserve(size_t capacity) {
+    if (capacity <= capacity_) return;
+    auto* positions = static_cast<uint32_t*>(resource_->allocate(capacity * sizeof(uint32_t), alignof(uint32_t)));
+    if (size_ > 0) std::memcpy(positions, positions_, size_ * sizeof(uint32_t));
+    deallocate();
+    positions_ = positions;
+    capacity_ = capacity;
+}
+
+bool StructuralIndex::build(std::string_view input, Kernel kernel) {
+    size_ = 0;
+    unclosedString_ = hasBackslashes_ = false;
+    if (input.size() >= std::numeric_limits<uint32_t>::max()) return false;
+
+    // The positions are far fewer than the characters in practice: the buffer starts small and grows
+    // when a chunk could overflow it (a chunk of n bytes writes at most n positions)
+    const IndexFunction index = indexFunction(kernel);
+    const size_t full = input.size() - input.size() % BLOCK;
+    BlockState state;
+    reserve(input.size() / 4 + BLOCK);
+    size_t done = 0;
+    while (done < full) {
+        size_t room = (capacity_ - size_) / BLOCK * BLOCK;
+        if (room == 0) {
+            reserve(capacity_ * 2);
+            continue;
+        }
+        size_t chunk = std::min(room, full - done);
+        size_ += index(input.data() + done, chunk, static_cast<uint32_t>(done), state, positions_ + size_);
+        done += chunk;
+    }
+
+    // The last partial block is padded with spaces
+    if (done < input.size()) {
+        char block[BLOCK];
+        std::memset(block, ' ', BLOCK);
+        std::memcpy(block, input.data() + done, input.size() - done);
+        reserve(size_ + BLOCK);
+        size_ += index(block, BLOCK, static_cast<uint32_t>(done), state, positions_ + size_);
+    }
+    unclosedString_ = state.inString != 0;
+    hasBackslashes_ = state.backslashes != 0;
+    return true;
+}
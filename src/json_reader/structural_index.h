@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+
+/*
+ * First stage of the parsing of large json inputs (e.g. an ohlc response with 1000 candles): a single
+ * pass over the input, 64 bytes at a time, collects the positions of the structural characters
+ * ({ } [ ] : ,) and of the quotes delimiting the strings. Quotes preceded by an odd number of backslashes
+ * are escaped, and the characters within strings are not structural. The second stage (JsonTokenizer)
+ * then jumps from one position to the next instead of reading every character: the content of the
+ * strings is never scanned. The block classification is vectorized with AVX2 or SSE4.2 when the CPU
+ * supports them (checked at runtime), with a portable scalar kernel as a fallback; all the kernels
+ * produce the same index. The positions are allocated from a memory resource, e.g. the scratch arena
+ * of the thread (see Arena) when the index only lives for one parse.
+ */
+class StructuralIndex {
+
+public:
+    enum class Kernel {Scalar, Sse42, Avx2};
+
+    explicit StructuralIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource()): resource_(resource) {}
+    explicit StructuralIndex(std::string_view input, Kernel kernel = bestKernel()) {build(input, kernel);}
+    StructuralIndex(const StructuralIndex&) = delete;
+    StructuralIndex& operator=(const StructuralIndex&) = delete;
+    ~StructuralIndex() {deallocate();}
+
+    // Indexes the input (the previous index is discarded, its memory is reused); inputs of 4 GB or more
+    // are not indexed (build returns false). A kernel not supported by the CPU is replaced by the best one.
+    bool build(std::string_view input, Kernel kernel = bestKernel());
+
+    const uint32_t* begin() const {return positions_;}
+    const uint32_t* end() const {return positions_ + size_;}
+    size_t size() const {return size_;}
+
+    // True if the input ends within a string
+    bool unclosedString() const {return unclosedString_;}
+
+    // True if the input contains backslashes (otherwise no string needs to be unescaped)
+    bool hasBackslashes() const {return hasBackslashes_;}
+
+    // Fastest kernel supported by the CPU
+    static Kernel bestKernel();
+    static const char* kernelName(Kernel kernel);
+
+private:
+    std::pmr::memory_resource* resource_ = std::pmr::get_default_resource();
+    uint32_t* positions_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    bool unclosedString_ = false;
+    bool hasBackslashes_ = false;
+
+    void reserve(size_t capacity);
+    void deallocate() {
+        if (positions_ != nullptr) resource_->deallocate(positions_, capacity_ * sizeof(uint32_t), alignof(uint32_t));
+    }
+};
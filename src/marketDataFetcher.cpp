@@ -10,6 +10,8 @@
 
 #include "api/api.h"
 #include "api/bitstamp_api.h"
+#include "api/bitstamp_stream_api.h"
+#include "api/coalescing_api.h"
 #include "crypto_market_data/market_data_fetcher.h"
 #include "utils/utils.h"
 #include <exception>
@@ -19,10 +21,14 @@
 #include <memory.h> 
 
 /*
- *  The main function can read 0 to 3 optional arguments: 
+ *  The main function can read 0 to 4 optional arguments: 
  *      - the first one is the path of the file containing the coin names for wich we want to fetch the market data
  *      - the second one is the optional fiat currency name against which the crypto is valuated, defalts to "USD"
  *      -the third one is the wait time which specifies the number of seconds to wait for the next data refresh 
+ *      - the fourth one can be any alphanumeric value; whenever it is different from '0', the market data of all 
+ *        the coins are fetched with a single (bulk) request at every refresh, instead of one request per coin. 
+ *        With the value 'stream', the market data are not polled: they are pushed by the exchange through a 
+ *        WebSocket connection as soon as they change (the wait time is then ignored) 
  */
 int main (int argc, char** argv) {
 
@@ -32,6 +38,8 @@ int main (int argc, char** argv) {
     std::string cryptoNamesFilePath; 
     std::string fiatName; 
     int wait_time; 
+    bool batchMode; 
+    bool streamMode; 
 
     cryptoNamesFilePath = argc > 1 ? std::string(argv[1]) : "./config/crypto_names.txt";
     fiatName = argc > 2 ? std::string(argv[2]) : "USD"; 
@@ -42,6 +50,8 @@ int main (int argc, char** argv) {
         std::cerr << "Invalid wait time (please specify an integer)." << std::endl; 
         return 1; 
     }
+    streamMode = argc > 4 ? std::string(argv[4]) == "stream" : false; 
+    batchMode = argc > 4 ? std::string(argv[4]) != "0" && !streamMode : false; 
 
     // Import crypto names from file
     std::vector<std::string> cryptoNames;
@@ -53,15 +63,34 @@ int main (int argc, char** argv) {
         return 1; 
     }
 
-    // Create Api request handlers -- in this case, from Bitstamp Api service
+    // In stream mode, a single WebSocket connection carries the updates of all the coins 
+    if (streamMode) {
+        BitstampStreamApi streamApi; 
+        MarketDataFetcher marketDataFetcher; 
+        marketDataFetcher.streamMultiCoinMarketData(cryptoNames, streamApi, {}, fiatName); 
+        return 0; 
+    }
+
+    // In batch mode, a single Api request handler serves all the coins 
+    if (batchMode) {
+        std::unique_ptr<Api> apiRequester = std::make_unique<CoalescingApi>(std::make_unique<BitstampApi>(wait_time)); 
+        MarketDataFetcher marketDataFetcher; 
+        marketDataFetcher.pollMultiCoinMarketData(cryptoNames, apiRequester, "timestamp", {}, fiatName); 
+        MarketDataFetcher::printRequestStats(); 
+        return 0; 
+    }
+
+    // Create Api request handlers -- in this case, from Bitstamp Api service. 
+    // Identical requests of different handlers (e.g. a coin listed twice) are sent once 
     std::vector<std::unique_ptr<Api>> apiRequesters; 
     for (size_t i=0; i < cryptoNames.size(); ++i) {
-        apiRequesters.push_back(std::make_unique<BitstampApi>(wait_time)); 
+        apiRequesters.push_back(std::make_unique<CoalescingApi>(std::make_unique<BitstampApi>(wait_time))); 
     }
 
     // Create the market data fetcher object and fetch the data
     MarketDataFetcher marketDataFetcher; 
     marketDataFetcher.fetchMultiCoinMarketData(cryptoNames, apiRequesters, "timestamp", {}, fiatName); 
+    MarketDataFetcher::printRequestStats(); 
 
     return 0; 
 }
@@ -0,0 +1,247 @@
+#include "candle_archive.h"
+#include "../utils/decimal.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'C', 'M', 'D', 'F', 'C', 'N', 'D', 'L'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t MAX_PAIR = 64;
+
+// Header of an archive, at its beginning (the integers are in the byte order of the machine)
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockCandles;
+    int64_t resolution;
+    uint64_t count;
+    unsigned char scale[CandleSeries::COLUMNS];
+    unsigned char decimals[CandleSeries::COLUMNS];
+    unsigned char columns;
+    unsigned char pairLength;
+    char pair[MAX_PAIR];
+};
+static_assert(sizeof(Header) <= CandleArchive::HEADER_SIZE, "the header must fit its page");
+
+size_t blockBytes(size_t blockCandles) {
+    return CandleSeries::COLUMNS * blockCandles * sizeof(int64_t);
+}
+
+size_t blocks(size_t count, size_t blockCandles) {
+    return (count + blockCandles - 1) / blockCandles;
+}
+
+// Offset of the value of the column of the i-th candle
+size_t offset(size_t blockCandles, size_t column, size_t i) {
+    return CandleArchive::HEADER_SIZE + (i / blockCandles) * blockBytes(blockCandles) + (column * blockCandles + i % blockCandles) * sizeof(int64_t);
+}
+
+// Checks the header of a file of the given size
+bool valid(const Header& header, size_t size) {
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) return false;
+    if (header.blockCandles == 0 || header.pairLength > MAX_PAIR) return false;
+    return size >= CandleArchive::HEADER_SIZE + blocks(header.count, header.blockCandles) * blockBytes(header.blockCandles);
+}
+
+// Descriptor closed at the end of the scope
+struct File {
+    int fd;
+    ~File() {if (fd >= 0) ::close(fd);}
+};
+
+bool writeAll(int fd, const void* data, size_t size, size_t offset) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = ::pwrite(fd, p, size, static_cast<off_t>(offset));
+        if (written <= 0) return false;
+        p += written;
+        size -= static_cast<size_t>(written);
+        offset += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool readAll(int fd, void* data, size_t size, size_t offset) {
+    char* p = static_cast<char*>(data);
+    while (size > 0) {
+        const ssize_t read = ::pread(fd, p, size, static_cast<off_t>(offset));
+        if (read <= 0) return false;
+        p += read;
+        size -= static_cast<size_t>(read);
+        offset += static_cast<size_t>(read);
+    }
+    return true;
+}
+
+} // namespace
+
+bool CandleArchive::open(const std::string& path) {
+    close();
+    File file{::open(path.c_str(), O_RDONLY)};
+    struct stat status;
+    if (file.fd < 0 || ::fstat(file.fd, &status) != 0 || static_cast<size_t>(status.st_size) < HEADER_SIZE) return false;
+    const size_t bytes = static_cast<size_t>(status.st_size);
+    void* map = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, file.fd, 0);
+    if (map == MAP_FAILED) return false;
+
+    Header header;
+    std::memcpy(&header, map, sizeof(Header));
+    if (!valid(header, bytes)) {
+        ::munmap(map, bytes);
+        return false;
+    }
+    data_ = static_cast<const unsigned char*>(map);
+    bytes_ = bytes;
+    pair_.assign(header.pair, header.pairLength);
+    resolution_ = header.resolution;
+    count_ = static_cast<size_t>(header.count);
+    blockCandles_ = header.blockCandles;
+    columns_ = header.columns;
+    std::copy(header.scale, header.scale + CandleSeries::COLUMNS, scale_);
+    std::copy(header.decimals, header.decimals + CandleSeries::COLUMNS, decimals_);
+    index_.resize(blocks(count_, blockCandles_));
+    for (size_t b = 0; b < index_.size(); ++b) index_[b] = timestamp(b * blockCandles_);
+    return true;
+}
+
+void CandleArchive::close() {
+    if (data_ != nullptr) ::munmap(const_cast<unsigned char*>(data_), bytes_);
+    data_ = nullptr;
+    bytes_ = 0;
+    count_ = 0;
+    index_.clear();
+}
+
+const int64_t* CandleArchive::column(CandleSeries::Column column, size_t i) const {
+    return reinterpret_cast<const int64_t*>(data_ + offset(blockCandles_, column, i - i % blockCandles_));
+}
+
+// The sparse index gives the block, and the timestamps of the block the candle
+size_t CandleArchive::lowerBound(int64_t time) const {
+    const auto next = std::lower_bound(index_.begin(), index_.end(), time);
+    if (next == index_.begin()) return 0;
+    const size_t first = static_cast<size_t>(next - index_.begin() - 1) * blockCandles_;
+    const int64_t* timestamps = column(CandleSeries::Timestamp, first);
+    const size_t n = std::min(blockCandles_, count_ - first);
+    return first + static_cast<size_t>(std::lower_bound(timestamps, timestamps + n, time) - timestamps);
+}
+
+bool CandleArchive::copy(size_t first, size_t last, CandleSeries& out) const {
+    out.clear();
+    last = std::min(last, count_);
+    if (first >= last) return false;
+    out.columns = columns_ | CandleSeries::bit(CandleSeries::Timestamp);
+    const size_t n = last - first;
+    for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        if (!out.has(column)) continue;
+        auto& values = column == CandleSeries::Timestamp ? out.timestamp : out.values(column);
+        values.resize(n);
+        // The values are copied block by block, as they are contiguous within a block
+        for (size_t i = first; i < last;) {
+            const size_t chunk = std::min(last - i, blockCandles_ - i % blockCandles_);
+            std::memcpy(values.data() + (i - first), this->column(column, i) + i % blockCandles_, chunk * sizeof(int64_t));
+            i += chunk;
+        }
+        out.scale[c] = scale_[c];
+        out.decimals[c] = decimals_[c];
+    }
+    return true;
+}
+
+bool CandleArchive::read(int64_t from, int64_t to, CandleSeries& out) const {
+    const size_t last = to == std::numeric_limits<int64_t>::max() ? count_ : lowerBound(to + 1);
+    return copy(lowerBound(from), last, out);
+}
+
+// The values are converted and checked before anything is written; they are then written column by column
+// within each block, and the header last
+bool CandleArchive::append(const std::string& path, const std::string& pair, const CandleSeries& series, size_t* added) {
+    if (added != nullptr) *added = 0;
+    if (series.empty()) return true;
+    File file{::open(path.c_str(), O_RDWR | O_CREAT, 0644)};
+    struct stat status;
+    if (file.fd < 0 || ::fstat(file.fd, &status) != 0) return false;
+
+    Header header;
+    const int64_t step = series.step();
+    if (status.st_size == 0) {
+        if (pair.size() > MAX_PAIR) return false;
+        std::memset(&header, 0, sizeof(Header));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.blockCandles = static_cast<uint32_t>(BLOCK_CANDLES);
+        header.resolution = step;
+        std::copy(series.scale, series.scale + CandleSeries::COLUMNS, header.scale);
+        header.pairLength = static_cast<unsigned char>(pair.size());
+        std::memcpy(header.pair, pair.data(), pair.size());
+    } else if (!readAll(file.fd, &header, sizeof(Header), 0) || !valid(header, static_cast<size_t>(status.st_size))) {
+        return false;
+    }
+    if (header.resolution == 0) header.resolution = step;
+    if (step != 0 && step != header.resolution) return false;
+    const size_t blockCandles = header.blockCandles;
+    size_t count = static_cast<size_t>(header.count);
+
+    // The candles written go to the positions [start, start + n): from the last one archived, if it is replaced
+    int64_t archived = std::numeric_limits<int64_t>::min();
+    if (count > 0 && !readAll(file.fd, &archived, sizeof(archived), offset(blockCandles, CandleSeries::Timestamp, count - 1))) return false;
+    std::vector<size_t> rows;
+    int64_t last = archived;
+    for (size_t i = 0; i < series.size(); ++i) {
+        const int64_t time = series.timestamp[i];
+        const bool replacing = rows.empty() && count > 0 && time == archived;
+        if (!replacing && time <= last) continue;
+        rows.push_back(i);
+        last = time;
+    }
+    if (rows.empty()) return true;
+    const bool replaced = count > 0 && series.timestamp[rows.front()] == archived;
+    const size_t start = replaced ? count - 1 : count;
+    const size_t n = rows.size();
+
+    // A column which was not held takes the scale of the series (its values archived so far are all missing)
+    std::vector<int64_t> values[CandleSeries::COLUMNS];
+    for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        const bool held = (header.columns & CandleSeries::bit(column)) != 0;
+        if (c != CandleSeries::Timestamp && !held && series.has(column)) header.scale[c] = series.scale[c];
+        values[c].resize(n);
+        for (size_t r = 0; r < n; ++r) {
+            if (column == CandleSeries::Timestamp) {
+                values[c][r] = series.timestamp[rows[r]];
+                continue;
+            }
+            const int64_t value = series.has(column) ? series.values(column)[rows[r]] : CandleSeries::MISSING;
+            if (value == CandleSeries::MISSING) values[c][r] = value;
+            else if (!Decimal::rescale(value, series.scale[c], header.scale[c], values[c][r])) return false;
+        }
+    }
+
+    // The blocks are allocated whole
+    const size_t end = start + n;
+    const size_t size = HEADER_SIZE + blocks(end, blockCandles) * blockBytes(blockCandles);
+    if (size > static_cast<size_t>(status.st_size) && ::ftruncate(file.fd, static_cast<off_t>(size)) != 0) return false;
+    for (size_t i = start; i < end;) {
+        const size_t chunk = std::min(end - i, blockCandles - i % blockCandles);
+        for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) {
+            if (!writeAll(file.fd, values[c].data() + (i - start), chunk * sizeof(int64_t), offset(blockCandles, c, i))) return false;
+        }
+        i += chunk;
+    }
+
+    header.count = end;
+    header.columns |= series.columns | CandleSeries::bit(CandleSeries::Timestamp);
+    for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) {
+        if (series.has(static_cast<CandleSeries::Column>(c))) header.decimals[c] = std::max(header.decimals[c], series.decimals[c]);
+    }
+    if (!writeAll(file.fd, &header, sizeof(Header), 0)) return false;
+    if (added != nullptr) *added = end - count;
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../api/candle_series.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Binary archive of the candles of a pair at a given resolution, read through a memory mapping: the
+ * values are stored as in a CandleSeries (fixed-point integers with a scale per column), so reading
+ * them involves no parsing at all.
+ *
+ * Layout: a header of HEADER_SIZE bytes (magic, version, pair, resolution, scales and decimals of the
+ * columns, number of candles), followed by blocks of blockCandles candles. A block holds the six columns
+ * one after the other, each as a fixed-width array of int64 (the last block is allocated whole, and
+ * filled as candles are appended). The candle i is thus at a fixed offset of its block i / blockCandles.
+ * The first timestamp of each block forms a sparse index (one entry per block, loaded when the archive is
+ * opened), through which a time range is found by two binary searches: over the blocks, then within the
+ * timestamps of a block. The candles are in increasing timestamp order: the archive is append-only,
+ * except for its last candle, which is replaced by a candle with the same timestamp (the candle which was
+ * still open when it was written). The header is written last, so that a reader never sees a candle
+ * whose values are not all written.
+ */
+class CandleArchive {
+
+public:
+    static constexpr size_t HEADER_SIZE = 4096;
+    static constexpr size_t BLOCK_CANDLES = 1024;
+
+    CandleArchive() = default;
+    CandleArchive(const CandleArchive&) = delete;
+    CandleArchive& operator=(const CandleArchive&) = delete;
+    ~CandleArchive() {close();}
+
+    // Maps an archive; returns false if the file cannot be read or is not a valid archive
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const {return data_ != nullptr;}
+
+    // Pair name (e.g. "btc/usd"), interval between two candles in seconds, and number of candles
+    const std::string& pair() const {return pair_;}
+    int64_t resolution() const {return resolution_;}
+    size_t size() const {return count_;}
+    bool empty() const {return count_ == 0;}
+
+    // Columns held, and scale and decimals of a column (see CandleSeries)
+    CandleSeries::Mask columns() const {return columns_;}
+    unsigned scale(CandleSeries::Column column) const {return scale_[column];}
+
+    // Values of the i-th candle, read in place
+    int64_t timestamp(size_t i) const {return column(CandleSeries::Timestamp, i)[i % blockCandles_];}
+    int64_t units(CandleSeries::Column column, size_t i) const {return this->column(column, i)[i % blockCandles_];}
+
+    // Position of the first candle whose timestamp is not less than time (size() if there is none)
+    size_t lowerBound(int64_t time) const;
+
+    // Copies the candles of the positions [first, last), or the candles whose timestamp is within [from, to],
+    // into out (whose buffers are reused); returns false if no candle was copied
+    bool copy(size_t first, size_t last, CandleSeries& out) const;
+    bool read(int64_t from, int64_t to, CandleSeries& out) const;
+
+    // Appends the candles of a series to the archive at path, creating it if needed with the pair and the
+    // resolution, columns and scales of the series (so that it should hold at least two candles). The
+    // candles newer than the last one archived are appended, a candle with its timestamp replaces it, and
+    // the older ones are skipped. Returns false if the file cannot be written or is not a valid archive,
+    // if the resolution of the series differs, or if one of its values has more decimals than the scale of
+    // its column in the archive (nothing is written then); added receives the number of candles added.
+    static bool append(const std::string& path, const std::string& pair, const CandleSeries& series, size_t* added = nullptr);
+
+private:
+    const unsigned char* data_ = nullptr;
+    size_t bytes_ = 0;
+    std::string pair_;
+    int64_t resolution_ = 0;
+    size_t count_ = 0;
+    size_t blockCandles_ = BLOCK_CANDLES;
+    CandleSeries::Mask columns_ = 0;
+    unsigned char scale_[CandleSeries::COLUMNS] = {};
+    unsigned char decimals_[CandleSeries::COLUMNS] = {};
+    std::vector<int64_t> index_; // first timestamp of each block
+
+    // Column of the block holding the i-th candle
+    const int64_t* column(CandleSeries::Column column, size_t i) const;
+};
@@ -0,0 +1,154 @@
+#include "candle_csv.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <memory>
+
+namespace {
+
+// Candles formatted at a time when an archive is converted
+constexpr size_t CHUNK = 1 << 16;
+
+// Days from 1970-01-01 to a date of the proleptic Gregorian calendar
+int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+    const unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+}
+
+// Value of the digits of text at [position, position + n); returns false if one of them is not a digit
+bool digits(std::string_view text, size_t position, size_t n, unsigned& value) {
+    value = 0;
+    for (size_t i = position; i < position + n; ++i) {
+        if (text[i] < '0' || text[i] > '9') return false;
+        value = value * 10 + static_cast<unsigned>(text[i] - '0');
+    }
+    return true;
+}
+
+// Next line of the text from position (without its line break), and position moved past it
+bool nextLine(std::string_view text, size_t& position, std::string_view& line) {
+    if (position >= text.size()) return false;
+    size_t end = text.find('\n', position);
+    if (end == std::string_view::npos) end = text.size();
+    line = text.substr(position, end - position);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    position = end + 1;
+    return true;
+}
+
+struct FileCloser {
+    void operator()(std::FILE* file) const {std::fclose(file);}
+};
+using FilePointer = std::unique_ptr<std::FILE, FileCloser>;
+
+bool writeText(std::FILE* file, const std::string& text) {
+    return std::fwrite(text.data(), 1, text.size(), file) == text.size();
+}
+
+} // namespace
+
+bool CandleCsv::parseTimestamp(std::string_view text, int64_t& timestamp) {
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), timestamp);
+    if (result.ec == std::errc() && result.ptr == text.data() + text.size()) return true;
+    unsigned year, month, day, hour, minute, second;
+    if (text.size() != 19 || text[4] != '-' || text[7] != '-' || text[10] != ' ' || text[13] != ':' || text[16] != ':') return false;
+    if (!digits(text, 0, 4, year) || !digits(text, 5, 2, month) || !digits(text, 8, 2, day)) return false;
+    if (!digits(text, 11, 2, hour) || !digits(text, 14, 2, minute) || !digits(text, 17, 2, second)) return false;
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) return false;
+    timestamp = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+// The values are converted straight from the text, by CandleSeries::append
+bool CandleCsv::parse(std::string_view csv, CandleSeries& out, std::string* pair) {
+    out.clear();
+    size_t position = 0;
+    std::string_view line;
+    if (!nextLine(csv, position, line)) return false;
+
+    // Column of each field of the header (COLUMNS for the fields which are not candle columns)
+    std::vector<size_t> fields;
+    CandleSeries::Mask mask = 0;
+    for (size_t start = 0; start <= line.size();) {
+        size_t end = line.find(',', start);
+        if (end == std::string_view::npos) end = line.size();
+        const auto field = line.substr(start, end - start);
+        const size_t separator = field.find_last_of("_-");
+        if (fields.empty() && pair != nullptr) pair->assign(separator == std::string_view::npos ? std::string_view() : field.substr(0, separator));
+        CandleSeries::Column column;
+        const bool found = CandleSeries::find(separator == std::string_view::npos ? field : field.substr(separator + 1), column) && (mask & CandleSeries::bit(column)) == 0;
+        fields.push_back(found ? column : CandleSeries::COLUMNS);
+        if (found) mask |= CandleSeries::bit(column);
+        start = end + 1;
+    }
+    if ((mask & CandleSeries::bit(CandleSeries::Timestamp)) == 0) return false;
+    out.columns = mask;
+    out.reserve(static_cast<size_t>(std::count(csv.begin() + static_cast<std::ptrdiff_t>(std::min(position, csv.size())), csv.end(), '\n')) + 1);
+
+    char buffer[24];
+    while (nextLine(csv, position, line)) {
+        if (line.empty()) continue;
+        std::string_view values[CandleSeries::COLUMNS];
+        size_t start = 0;
+        for (size_t j = 0; j < fields.size() && start <= line.size(); ++j) {
+            size_t end = line.find(',', start);
+            if (end == std::string_view::npos) end = line.size();
+            if (fields[j] < CandleSeries::COLUMNS) values[fields[j]] = line.substr(start, end - start);
+            start = end + 1;
+        }
+        // The timestamps are handed to the series as numbers of seconds
+        int64_t timestamp;
+        if (!parseTimestamp(values[CandleSeries::Timestamp], timestamp)) {
+            out.clear();
+            return false;
+        }
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), timestamp);
+        values[CandleSeries::Timestamp] = std::string_view(buffer, static_cast<size_t>(result.ptr - buffer));
+        out.append(values);
+    }
+    return true;
+}
+
+bool CandleCsv::read(const std::string& path, CandleSeries& out, std::string* pair) {
+    out.clear();
+    FilePointer file(std::fopen(path.c_str(), "rb"));
+    if (!file) return false;
+    std::string text;
+    char buffer[1 << 16];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file.get())) > 0) text.append(buffer, read);
+    return parse(text, out, pair);
+}
+
+bool CandleCsv::write(const std::string& path, const std::string& pair, const CandleSeries& series) {
+    FilePointer file(std::fopen(path.c_str(), "wb"));
+    if (!file) return false;
+    std::string text;
+    series.appendFormat(text, pair + '_', {}, true, true);
+    return writeText(file.get(), text);
+}
+
+bool CandleCsv::write(const std::string& path, const CandleArchive& archive) {
+    FilePointer file(std::fopen(path.c_str(), "wb"));
+    if (!file) return false;
+    const std::string prefix = archive.pair() + '_';
+    CandleSeries series;
+    std::string text;
+    if (archive.empty()) {
+        series.columns = archive.columns() | CandleSeries::bit(CandleSeries::Timestamp);
+        series.appendFormat(text, prefix, {}, true, true);
+        return writeText(file.get(), text);
+    }
+    for (size_t first = 0; first < archive.size(); first += CHUNK) {
+        archive.copy(first, first + CHUNK, series);
+        text.clear();
+        series.appendFormat(text, prefix, {}, true, true);
+        if (first > 0) text.erase(0, text.find('\n') + 1); // the header is only written once
+        if (!writeText(file.get(), text)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../api/candle_series.h"
+#include "candle_archive.h"
+#include <string>
+#include <string_view>
+
+/*
+ * Csv files of candles, as written by candlestickDataDownloader (see CandleSeries::format): a header
+ * line naming the columns, prefixed with the pair (e.g. "btc/usd_close"), then one line per candle,
+ * whose timestamp is either a date and time in UTC (e.g. "2024-07-10 07:21:00") or a number of seconds.
+ * The columns which are not candle columns are skipped.
+ */
+class CandleCsv {
+
+public:
+    // Decodes csv text into out; pair receives the prefix of the first column, without its separator (e.g.
+    // "btc/usd"). Returns false (and leaves out empty) if the header names no timestamp column, or if a
+    // timestamp is invalid.
+    static bool parse(std::string_view csv, CandleSeries& out, std::string* pair = nullptr);
+    static bool read(const std::string& path, CandleSeries& out, std::string* pair = nullptr);
+
+    // Writes candles in csv format, the columns being prefixed with the pair and an underscore, and the
+    // timestamps written as dates. The candles of an archive are converted a chunk at a time, so that the
+    // memory used does not grow with the size of the archive. Return false if the file cannot be written.
+    static bool write(const std::string& path, const std::string& pair, const CandleSeries& series);
+    static bool write(const std::string& path, const CandleArchive& archive);
+
+    // Number of seconds since the epoch of a date and time in UTC ("YYYY-MM-DD HH:MM:SS"), or of a number of
+    // seconds; returns false if the text is neither
+    static bool parseTimestamp(std::string_view text, int64_t& timestamp);
+};
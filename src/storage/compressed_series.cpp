@@ -0,0 +1,481 @@
+#include "compressed_series.h"
+#include "../utils/decimal.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+constexpr char CANDLES_MAGIC[8] = {'C', 'M', 'D', 'F', 'C', 'C', 'N', 'D'};
+constexpr char TICKERS_MAGIC[8] = {'C', 'M', 'D', 'F', 'C', 'T', 'C', 'K'};
+
+// A candle block starts with its columns, then the scale and the decimals of each column
+constexpr size_t CANDLE_META = 1 + 2 * CandleSeries::COLUMNS;
+
+// Encoding of each price and volume column
+constexpr SeriesCodec::Encoding CANDLE_ENCODING[CandleSeries::COLUMNS] = {
+    SeriesCodec::DeltaOfDelta, SeriesCodec::Delta, SeriesCodec::Delta, SeriesCodec::Delta, SeriesCodec::Delta, SeriesCodec::Varint
+};
+
+SeriesCodec::Encoding tickerEncoding(Ticker::Field field) {
+    if (field == Ticker::Timestamp) return SeriesCodec::DeltaOfDelta;
+    return field == Ticker::Side ? SeriesCodec::Runs : SeriesCodec::Delta;
+}
+
+struct FileCloser {
+    void operator()(std::FILE* file) const {std::fclose(file);}
+};
+using FilePointer = std::unique_ptr<std::FILE, FileCloser>;
+
+// Decodes a candle block into out, with the columns, scales and decimals of the block
+bool decodeCandles(const char* p, const char* end, size_t n, CandleSeries& out) {
+    out.clear();
+    if (end - p < static_cast<std::ptrdiff_t>(CANDLE_META)) return false;
+    out.columns = static_cast<CandleSeries::Mask>(*p++) | CandleSeries::bit(CandleSeries::Timestamp);
+    for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) out.scale[c] = static_cast<unsigned char>(*p++);
+    for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) out.decimals[c] = static_cast<unsigned char>(*p++);
+    for (size_t c = 0; c < CandleSeries::COLUMNS && p != nullptr; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        if (!out.has(column)) continue;
+        auto& values = column == CandleSeries::Timestamp ? out.timestamp : out.values(column);
+        values.resize(n);
+        p = SeriesCodec::decode(CANDLE_ENCODING[c], p, end, values.data(), n);
+    }
+    if (p == nullptr) out.clear();
+    return p != nullptr;
+}
+
+// Appends the candles [first, last) of a part to out, whose columns and scales are those of all the parts
+bool appendCandles(const CandleSeries& part, size_t first, size_t last, CandleSeries& out) {
+    out.timestamp.insert(out.timestamp.end(), part.timestamp.begin() + first, part.timestamp.begin() + last);
+    for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        if (!out.has(column)) continue;
+        auto& values = out.values(column);
+        if (!part.has(column)) {
+            values.insert(values.end(), last - first, CandleSeries::MISSING);
+            continue;
+        }
+        const auto& units = part.values(column);
+        if (part.scale[c] == out.scale[c]) {
+            values.insert(values.end(), units.begin() + first, units.begin() + last);
+            continue;
+        }
+        for (size_t i = first; i < last; ++i) {
+            int64_t value = units[i];
+            if (value != CandleSeries::MISSING && !Decimal::rescale(value, part.scale[c], out.scale[c], value)) return false;
+            values.push_back(value);
+        }
+    }
+    return true;
+}
+
+// Range of the candles of a part whose timestamp is within [from, to]
+void range(const std::vector<int64_t>& timestamps, int64_t from, int64_t to, size_t& first, size_t& last) {
+    first = static_cast<size_t>(std::lower_bound(timestamps.begin(), timestamps.end(), from) - timestamps.begin());
+    last = static_cast<size_t>(std::upper_bound(timestamps.begin(), timestamps.end(), to) - timestamps.begin());
+}
+
+} // namespace
+
+void CompressedBlocks::frame(size_t count, int64_t first, int64_t last, const std::string& payload, std::string& out) {
+    SeriesCodec::putVarint(count, out);
+    SeriesCodec::putVarint(SeriesCodec::zigzag(first), out);
+    SeriesCodec::putVarint(SeriesCodec::zigzag(last), out);
+    SeriesCodec::putVarint(payload.size(), out);
+    out += payload;
+}
+
+void CompressedBlocks::add(size_t count, int64_t first, int64_t last, const std::string& payload) {
+    const size_t offset = data_.size();
+    frame(count, first, last, payload, data_);
+    blocks_.push_back({first, last, count, offset, data_.size() - payload.size(), data_.size()});
+}
+
+void CompressedBlocks::removeLast() {
+    data_.resize(blocks_.back().offset);
+    blocks_.pop_back();
+}
+
+// The blocks after it move to the front of the buffer
+void CompressedBlocks::removeFirst() {
+    const size_t size = blocks_.front().end;
+    data_.erase(0, size);
+    blocks_.erase(blocks_.begin());
+    for (auto& block: blocks_) {
+        block.offset -= size;
+        block.payload -= size;
+        block.end -= size;
+    }
+}
+
+size_t CompressedBlocks::firstBlock(int64_t time) const {
+    return static_cast<size_t>(std::partition_point(blocks_.begin(), blocks_.end(), [time](const Block& block) {return block.last < time;}) - blocks_.begin());
+}
+
+bool CompressedBlocks::save(const std::string& path, const char (&magic)[8], const std::string& tail) const {
+    FilePointer file(std::fopen(path.c_str(), "wb"));
+    if (!file) return false;
+    return std::fwrite(magic, 1, sizeof(magic), file.get()) == sizeof(magic)
+        && std::fwrite(data_.data(), 1, data_.size(), file.get()) == data_.size()
+        && std::fwrite(tail.data(), 1, tail.size(), file.get()) == tail.size();
+}
+
+// The frames are read one after the other: the payloads are skipped
+bool CompressedBlocks::load(const std::string& path, const char (&magic)[8]) {
+    data_.clear();
+    blocks_.clear();
+    FilePointer file(std::fopen(path.c_str(), "rb"));
+    if (!file) return false;
+    char header[sizeof(magic)];
+    if (std::fread(header, 1, sizeof(header), file.get()) != sizeof(header) || std::memcmp(header, magic, sizeof(magic)) != 0) return false;
+    char buffer[1 << 16];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file.get())) > 0) data_.append(buffer, read);
+
+    const char* begin = data_.data();
+    const char* end = begin + data_.size();
+    for (const char* p = begin; p < end;) {
+        uint64_t count, first, last, size;
+        const char* offset = p;
+        if ((p = SeriesCodec::getVarint(p, end, count)) == nullptr || (p = SeriesCodec::getVarint(p, end, first)) == nullptr
+            || (p = SeriesCodec::getVarint(p, end, last)) == nullptr || (p = SeriesCodec::getVarint(p, end, size)) == nullptr
+            || count == 0 || size > static_cast<uint64_t>(end - p)) {
+            data_.clear();
+            blocks_.clear();
+            return false;
+        }
+        const auto payload = static_cast<size_t>(p - begin);
+        blocks_.push_back({SeriesCodec::unzigzag(first), SeriesCodec::unzigzag(last), count, static_cast<size_t>(offset - begin), payload, payload + size});
+        p += size;
+    }
+    return true;
+}
+
+int64_t CompressedCandles::front() const {
+    if (!blocks_.empty()) return blocks_.front().first;
+    return open_.empty() ? 0 : open_.timestamp.front();
+}
+
+int64_t CompressedCandles::back() const {
+    if (!open_.empty()) return open_.timestamp.back();
+    return blocks_.empty() ? 0 : blocks_.back().last;
+}
+
+bool CompressedCandles::append(const CandleSeries& series, size_t* added) {
+    if (added != nullptr) *added = 0;
+    const size_t before = size();
+    for (size_t i = 0; i < series.size(); ++i) {
+        const int64_t time = series.timestamp[i];
+        const bool replace = !empty() && time == back();
+        if (!empty() && time < back()) continue;
+        // The last block is completed (or its last candle replaced) before a new block is started
+        if (open_.empty() && !blocks_.empty() && (replace || blocks_.back().count < BLOCK_CANDLES) && !unseal()) {
+            if (added != nullptr) *added = size() - before;
+            return false;
+        }
+        if (!replace && open_.size() == BLOCK_CANDLES) seal();
+        if (!push(series, i, replace)) {
+            if (added != nullptr) *added = size() - before;
+            return false;
+        }
+    }
+    if (added != nullptr) *added = size() - before;
+    return true;
+}
+
+// The open block takes the columns of the series it does not hold, and the larger scales
+bool CompressedCandles::push(const CandleSeries& series, size_t i, bool replace) {
+    if (open_.empty()) {
+        replace = false;
+        open_.clear();
+        open_.columns = series.columns | CandleSeries::bit(CandleSeries::Timestamp);
+        std::copy(series.scale, series.scale + CandleSeries::COLUMNS, open_.scale);
+    }
+    int64_t row[CandleSeries::COLUMNS];
+    row[CandleSeries::Timestamp] = series.timestamp[i];
+    for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        if (series.has(column) && !open_.has(column)) {
+            open_.columns |= CandleSeries::bit(column);
+            open_.values(column).assign(open_.size(), CandleSeries::MISSING);
+            open_.scale[c] = series.scale[c];
+        } else if (series.has(column) && series.scale[c] > open_.scale[c] && !open_.rescale(column, series.scale[c])) {
+            return false;
+        }
+        if (!open_.has(column)) continue;
+        row[c] = series.has(column) ? series.values(column)[i] : CandleSeries::MISSING;
+        if (row[c] != CandleSeries::MISSING && !Decimal::rescale(row[c], series.scale[c], open_.scale[c], row[c])) return false;
+        if (series.has(column)) open_.decimals[c] = std::max(open_.decimals[c], series.decimals[c]);
+    }
+    for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        if (!open_.has(column)) continue;
+        auto& values = column == CandleSeries::Timestamp ? open_.timestamp : open_.values(column);
+        if (replace) values.back() = row[c];
+        else values.push_back(row[c]);
+    }
+    return true;
+}
+
+void CompressedCandles::encode(const CandleSeries& candles, std::string& payload) const {
+    payload.push_back(static_cast<char>(candles.columns));
+    payload.append(reinterpret_cast<const char*>(candles.scale), CandleSeries::COLUMNS);
+    payload.append(reinterpret_cast<const char*>(candles.decimals), CandleSeries::COLUMNS);
+    for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) {
+        const auto column = static_cast<CandleSeries::Column>(c);
+        if (!candles.has(column)) continue;
+        const auto& values = column == CandleSeries::Timestamp ? candles.timestamp : candles.values(column);
+        SeriesCodec::encode(CANDLE_ENCODING[c], values.data(), values.size(), payload);
+    }
+}
+
+void CompressedCandles::seal() {
+    std::string payload;
+    encode(open_, payload);
+    add(open_.size(), open_.timestamp.front(), open_.timestamp.back(), payload);
+    count_ += open_.size();
+    open_.clear();
+}
+
+// A block which cannot be decoded stays sealed, rather than being lost
+bool CompressedCandles::unseal() {
+    const Block& block = blocks_.back();
+    if (!decodeCandles(data_.data() + block.payload, data_.data() + block.end, block.count, open_)) {
+        open_.clear();
+        return false;
+    }
+    count_ -= block.count;
+    removeLast();
+    return true;
+}
+
+// The columns and scales of the candles read are found first, from the beginning of the blocks
+bool CompressedCandles::read(int64_t from, int64_t to, CandleSeries& out) const {
+    out.clear();
+    out.columns = CandleSeries::bit(CandleSeries::Timestamp);
+    if (from > to) return false;
+    const size_t first = firstBlock(from);
+    size_t last = first;
+    size_t n = 0;
+    for (; last < blocks_.size() && blocks_[last].first <= to; ++last) {
+        const auto* meta = reinterpret_cast<const unsigned char*>(data_.data() + blocks_[last].payload);
+        out.columns |= meta[0];
+        for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) {
+            out.scale[c] = std::max(out.scale[c], meta[1 + c]);
+            out.decimals[c] = std::max(out.decimals[c], meta[1 + CandleSeries::COLUMNS + c]);
+        }
+        n += blocks_[last].count;
+    }
+    const bool open = !open_.empty() && open_.timestamp.front() <= to && open_.timestamp.back() >= from;
+    if (open) {
+        out.columns |= open_.columns;
+        for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) {
+            out.scale[c] = std::max(out.scale[c], open_.scale[c]);
+            out.decimals[c] = std::max(out.decimals[c], open_.decimals[c]);
+        }
+        n += open_.size();
+    }
+    out.reserve(n);
+
+    CandleSeries block;
+    size_t begin, end;
+    for (size_t b = first; b < last; ++b) {
+        if (!decodeCandles(data_.data() + blocks_[b].payload, data_.data() + blocks_[b].end, blocks_[b].count, block)) {
+            out.clear();
+            return false;
+        }
+        range(block.timestamp, from, to, begin, end);
+        if (!appendCandles(block, begin, end, out)) {
+            out.clear();
+            return false;
+        }
+    }
+    if (open) {
+        range(open_.timestamp, from, to, begin, end);
+        if (!appendCandles(open_, begin, end, out)) {
+            out.clear();
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+void CompressedCandles::clear() {
+    data_.clear();
+    blocks_.clear();
+    count_ = 0;
+    open_.clear();
+}
+
+bool CompressedCandles::dropOldest() {
+    if (blocks_.empty()) return false;
+    count_ -= blocks_.front().count;
+    removeFirst();
+    return true;
+}
+
+bool CompressedCandles::save(const std::string& path) const {
+    std::string tail;
+    if (!open_.empty()) {
+        std::string payload;
+        encode(open_, payload);
+        frame(open_.size(), open_.timestamp.front(), open_.timestamp.back(), payload, tail);
+    }
+    return CompressedBlocks::save(path, CANDLES_MAGIC, tail);
+}
+
+bool CompressedCandles::load(const std::string& path) {
+    clear();
+    if (!CompressedBlocks::load(path, CANDLES_MAGIC)) return false;
+    for (const auto& block: blocks_) {
+        if (block.count > BLOCK_CANDLES || block.end - block.payload < CANDLE_META) {
+            clear();
+            return false;
+        }
+        count_ += block.count;
+    }
+    return true;
+}
+
+bool CompressedTickers::append(const Ticker& ticker) {
+    if (!ticker.has(Ticker::Timestamp)) return false;
+    const int64_t time = ticker.units[Ticker::Timestamp];
+    const int64_t last = !open_.empty() ? open_.back().units[Ticker::Timestamp] : (blocks_.empty() ? 0 : blocks_.back().last);
+    const bool replace = !empty() && time == last;
+    if (!empty() && time < last) return false;
+    if (open_.empty() && !blocks_.empty() && (replace || blocks_.back().count < BLOCK_TICKERS) && !unseal()) return false;
+    if (replace && !open_.empty()) {
+        open_.back() = ticker;
+        return true;
+    }
+    if (open_.size() == BLOCK_TICKERS) seal();
+    open_.push_back(ticker);
+    return true;
+}
+
+// The fields which are missing take the values of the previous record, so that they cost one byte
+void CompressedTickers::encode(const Ticker* tickers, size_t n, std::string& payload) {
+    assert(n <= BLOCK_TICKERS);
+    int64_t values[BLOCK_TICKERS] = {}; // the values past n are never read, but gcc cannot tell
+    for (size_t i = 0; i < n; ++i) values[i] = tickers[i].present | static_cast<int64_t>(tickers[i].nulls) << Ticker::FIELDS;
+    SeriesCodec::encode(SeriesCodec::Runs, values, n, payload);
+    for (size_t f = 0; f < Ticker::FIELDS; ++f) {
+        const auto field = static_cast<Ticker::Field>(f);
+        int64_t previous = 0;
+        for (size_t i = 0; i < n; ++i) previous = values[i] = tickers[i].has(field) ? tickers[i].decimals[f] : previous;
+        SeriesCodec::encode(SeriesCodec::Runs, values, n, payload);
+        previous = 0;
+        for (size_t i = 0; i < n; ++i) previous = values[i] = tickers[i].has(field) ? tickers[i].units[f] : previous;
+        SeriesCodec::encode(tickerEncoding(field), values, n, payload);
+    }
+}
+
+bool CompressedTickers::decode(const char* p, const char* end, Ticker* tickers, size_t n) {
+    int64_t values[BLOCK_TICKERS];
+    if (n > BLOCK_TICKERS || (p = SeriesCodec::decode(SeriesCodec::Runs, p, end, values, n)) == nullptr) return false;
+    for (size_t i = 0; i < n; ++i) {
+        tickers[i] = Ticker();
+        tickers[i].present = static_cast<Ticker::Mask>(values[i] & Ticker::ALL);
+        tickers[i].nulls = static_cast<Ticker::Mask>(values[i] >> Ticker::FIELDS & Ticker::ALL);
+    }
+    for (size_t f = 0; f < Ticker::FIELDS; ++f) {
+        const auto field = static_cast<Ticker::Field>(f);
+        if ((p = SeriesCodec::decode(SeriesCodec::Runs, p, end, values, n)) == nullptr) return false;
+        for (size_t i = 0; i < n; ++i) {
+            if (tickers[i].has(field)) tickers[i].decimals[f] = static_cast<unsigned char>(values[i]);
+        }
+        if ((p = SeriesCodec::decode(tickerEncoding(field), p, end, values, n)) == nullptr) return false;
+        for (size_t i = 0; i < n; ++i) {
+            if (tickers[i].has(field)) tickers[i].units[f] = values[i];
+        }
+    }
+    return true;
+}
+
+void CompressedTickers::seal() {
+    std::string payload;
+    encode(open_.data(), open_.size(), payload);
+    add(open_.size(), open_.front().units[Ticker::Timestamp], open_.back().units[Ticker::Timestamp], payload);
+    count_ += open_.size();
+    open_.clear();
+}
+
+// A block which cannot be decoded stays sealed, rather than being lost
+bool CompressedTickers::unseal() {
+    const Block& block = blocks_.back();
+    open_.resize(block.count);
+    if (!decode(data_.data() + block.payload, data_.data() + block.end, open_.data(), block.count)) {
+        open_.clear();
+        return false;
+    }
+    count_ -= block.count;
+    removeLast();
+    return true;
+}
+
+// The records of a block are decoded in place, then those out of the range are dropped
+bool CompressedTickers::read(int64_t from, int64_t to, std::vector<Ticker>& out) const {
+    out.clear();
+    if (from > to) return false;
+    const auto outside = [from, to](const Ticker& ticker) {
+        return ticker.units[Ticker::Timestamp] < from || ticker.units[Ticker::Timestamp] > to;
+    };
+    const size_t first = firstBlock(from);
+    size_t last = first;
+    size_t n = open_.size();
+    for (; last < blocks_.size() && blocks_[last].first <= to; ++last) n += blocks_[last].count;
+    out.reserve(n);
+    for (size_t b = first; b < last; ++b) {
+        const size_t start = out.size();
+        out.resize(start + blocks_[b].count);
+        if (!decode(data_.data() + blocks_[b].payload, data_.data() + blocks_[b].end, out.data() + start, blocks_[b].count)) {
+            out.clear();
+            return false;
+        }
+        out.erase(std::remove_if(out.begin() + static_cast<std::ptrdiff_t>(start), out.end(), outside), out.end());
+    }
+    for (const auto& ticker: open_) {
+        if (!outside(ticker)) out.push_back(ticker);
+    }
+    return !out.empty();
+}
+
+void CompressedTickers::clear() {
+    data_.clear();
+    blocks_.clear();
+    count_ = 0;
+    open_.clear();
+}
+
+bool CompressedTickers::dropOldest() {
+    if (blocks_.empty()) return false;
+    count_ -= blocks_.front().count;
+    removeFirst();
+    return true;
+}
+
+bool CompressedTickers::save(const std::string& path) const {
+    std::string tail;
+    if (!open_.empty()) {
+        std::string payload;
+        encode(open_.data(), open_.size(), payload);
+        frame(open_.size(), open_.front().units[Ticker::Timestamp], open_.back().units[Ticker::Timestamp], payload, tail);
+    }
+    return CompressedBlocks::save(path, TICKERS_MAGIC, tail);
+}
+
+bool CompressedTickers::load(const std::string& path) {
+    clear();
+    if (!CompressedBlocks::load(path, TICKERS_MAGIC)) return false;
+    for (const auto& block: blocks_) {
+        if (block.count > BLOCK_TICKERS) {
+            clear();
+            return false;
+        }
+        count_ += block.count;
+    }
+    return true;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "../api/candle_series.h"
+#include "../api/ticker.h"
+#include "series_codec.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+/*
+ * Blocks of compressed records (see series_codec.h), held one after the other in a single buffer. Each
+ * block starts with a frame giving its number of records, its first and last timestamps and the size of
+ * its payload: the frames form a sparse index (kept in memory), through which the blocks of a time range
+ * are found without decoding the others. The buffer is written to disk as it is, so that a file is loaded
+ * with one read and the index rebuilt by hopping from frame to frame.
+ */
+class CompressedBlocks {
+
+public:
+    // Number of blocks, and bytes taken by the blocks (as written to disk)
+    size_t blocks() const {return blocks_.size();}
+    size_t bytes() const {return data_.size();}
+
+protected:
+    struct Block {
+        int64_t first;
+        int64_t last;
+        size_t count;
+        size_t offset;   // offset of the frame in the buffer
+        size_t payload;  // offset of the payload in the buffer
+        size_t end;      // end of the payload
+    };
+
+    std::string data_;
+    std::vector<Block> blocks_;
+
+    // Appends the frame of a block, followed by its payload, to out
+    static void frame(size_t count, int64_t first, int64_t last, const std::string& payload, std::string& out);
+
+    // Appends a block to the buffer, and drops the last or the first block of the buffer
+    void add(size_t count, int64_t first, int64_t last, const std::string& payload);
+    void removeLast();
+    void removeFirst();
+
+    // Position of the first block whose last timestamp is not less than time (blocks() if there is none)
+    size_t firstBlock(int64_t time) const;
+
+    // Writes the blocks to a file after a magic number, followed by the frame of tail (the block which is
+    // still open, if any); reads them back, returning false if the file is not valid
+    bool save(const std::string& path, const char (&magic)[8], const std::string& tail) const;
+    bool load(const std::string& path, const char (&magic)[8]);
+};
+
+/*
+ * Candles kept compressed, for the long histories of many pairs: about a quarter of their size in a
+ * CandleSeries (e.g. 12 bytes per 1-minute candle of BTC/USD instead of 48, the volumes taking a third of
+ * them). The candles are encoded by blocks of BLOCK_CANDLES, column by column:
+ * the timestamps as deltas of deltas, the prices as deltas of their fixed-point values, the volumes as
+ * varints. A block decodes into 24 KB, within the L1 cache, and a time range only decodes its blocks.
+ * Each block keeps the columns, scales and decimals of its candles; the candles read are converted to
+ * the largest scale of the blocks read. The last block is kept uncompressed until it is full, so that
+ * appending a candle is O(1) and the candle still open can be replaced.
+ */
+class CompressedCandles : public CompressedBlocks {
+
+public:
+    static constexpr size_t BLOCK_CANDLES = 512;
+
+    // Number of candles, and timestamps of the first and last one (0 if there is none)
+    size_t size() const {return count_ + open_.size();}
+    bool empty() const {return size() == 0;}
+    int64_t front() const;
+    int64_t back() const;
+
+    // Appends the candles of a series (as CandleArchive::append): the candles newer than the last one held
+    // are appended, a candle with its timestamp replaces it, the older ones are skipped. Returns false if a
+    // value does not fit the scale of its column, or if the last block cannot be decoded to be completed
+    // (the candles before it are kept); added receives the number of candles added.
+    bool append(const CandleSeries& series, size_t* added = nullptr);
+
+    // Decodes the candles whose timestamp is within [from, to] into out (whose buffers are reused);
+    // returns false if no candle was read
+    bool read(int64_t from, int64_t to, CandleSeries& out) const;
+    bool read(CandleSeries& out) const {return read(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), out);}
+
+    void clear();
+
+    // Drops the oldest block of candles (never the open block), e.g. to bound the memory of a history;
+    // returns false if there is none
+    bool dropOldest();
+
+    // Writes the candles to a file, and reads them back (replacing the candles held); return false if the
+    // file cannot be written, or read as compressed candles
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+private:
+    size_t count_ = 0;   // candles of the compressed blocks
+    CandleSeries open_;  // candles of the last block, not compressed yet
+
+    // Compresses the open block, and decompresses the last block into the open block (false if it cannot
+    // be decoded, the block then stays compressed)
+    void seal();
+    bool unseal();
+
+    // Appends the i-th candle of a series to the open block (replacing its last candle if replace is set)
+    bool push(const CandleSeries& series, size_t i, bool replace);
+
+    void encode(const CandleSeries& candles, std::string& payload) const;
+};
+
+/*
+ * Market data records (see ticker.h) kept compressed, by blocks of BLOCK_TICKERS: the timestamps as deltas
+ * of deltas, the prices and volumes as deltas (the volume over 24 hours moves by small steps between two
+ * records), the side, the decimals and the fields present (and null) as runs. The records must have a
+ * timestamp; a record with the timestamp of the last one replaces it, the older ones are skipped.
+ */
+class CompressedTickers : public CompressedBlocks {
+
+public:
+    static constexpr size_t BLOCK_TICKERS = 128;
+
+    size_t size() const {return count_ + open_.size();}
+    bool empty() const {return size() == 0;}
+
+    // Appends a record; returns false if it is older than the last one held (or has no timestamp), or if
+    // the last block cannot be decoded to be completed
+    bool append(const Ticker& ticker);
+
+    // Decodes the records whose timestamp is within [from, to] into out; returns false if none was read
+    bool read(int64_t from, int64_t to, std::vector<Ticker>& out) const;
+    bool read(std::vector<Ticker>& out) const {return read(std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), out);}
+
+    void clear();
+
+    // Drops the oldest block of records (as CompressedCandles::dropOldest)
+    bool dropOldest();
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+private:
+    size_t count_ = 0;
+    std::vector<Ticker> open_;
+
+    void seal();
+    bool unseal();
+
+    static void encode(const Ticker* tickers, size_t n, std::string& payload);
+    static bool decode(const char* p, const char* end, Ticker* tickers, size_t n);
+};
@@ -0,0 +1,165 @@
+#include "series_codec.h"
+
+namespace {
+
+// Largest size of a varint, and of an encoded value (a value and its run)
+constexpr size_t MAX_VARINT = 10;
+constexpr size_t MAX_VALUE = 2 * MAX_VARINT;
+
+// Difference and sum modulo 2^64, so that they never overflow
+int64_t difference(int64_t a, int64_t b) {return static_cast<int64_t>(static_cast<uint64_t>(a) - static_cast<uint64_t>(b));}
+int64_t sum(int64_t a, int64_t b) {return static_cast<int64_t>(static_cast<uint64_t>(a) + static_cast<uint64_t>(b));}
+
+// The numbers are written straight into the output, which is grown once per column
+inline char* putVarint(uint64_t value, char* out) {
+    while (value >= 0x80) {
+        *out++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+}
+
+inline char* put(int64_t value, char* out) {return putVarint(SeriesCodec::zigzag(value), out);}
+
+// Reads a varint byte by byte
+inline const char* getVarint(const char* p, const char* end, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        const auto byte = static_cast<unsigned char>(*p++);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (byte < 0x80) return p;
+    }
+    return nullptr;
+}
+
+// Most of the numbers (the differences of the prices, the deltas of deltas) take one or two bytes: they are
+// read without a loop
+inline const char* getFast(const char* p, const char* end, uint64_t& value) {
+    if (end - p >= 2) {
+        const auto first = static_cast<unsigned char>(p[0]);
+        if (first < 0x80) {
+            value = first;
+            return p + 1;
+        }
+        const auto second = static_cast<unsigned char>(p[1]);
+        if (second < 0x80) {
+            value = (first & 0x7fu) | (static_cast<uint64_t>(second) << 7);
+            return p + 2;
+        }
+    }
+    return getVarint(p, end, value);
+}
+
+inline const char* get(const char* p, const char* end, int64_t& value) {
+    uint64_t varint;
+    p = getFast(p, end, varint);
+    value = SeriesCodec::unzigzag(varint);
+    return p;
+}
+
+} // namespace
+
+void SeriesCodec::putVarint(uint64_t value, std::string& out) {
+    char buffer[MAX_VARINT];
+    out.append(buffer, static_cast<size_t>(::putVarint(value, buffer) - buffer));
+}
+
+const char* SeriesCodec::getVarint(const char* p, const char* end, uint64_t& value) {
+    return ::getVarint(p, end, value);
+}
+
+void SeriesCodec::encode(Encoding encoding, const int64_t* values, size_t n, std::string& out) {
+    if (n == 0) return;
+    const size_t start = out.size();
+    out.resize(start + n * MAX_VALUE);
+    char* const begin = &out[start];
+    char* p = begin;
+    switch (encoding) {
+    case DeltaOfDelta: {
+        p = put(values[0], p);
+        if (n == 1) break;
+        int64_t delta = difference(values[1], values[0]);
+        p = put(delta, p);
+        for (size_t i = 2; i < n;) {
+            const int64_t next = difference(values[i], values[i - 1]);
+            const int64_t deltaOfDelta = difference(next, delta);
+            delta = next;
+            p = put(deltaOfDelta, p);
+            ++i;
+            if (deltaOfDelta != 0) continue;
+            size_t run = 0;
+            while (i < n && difference(values[i], values[i - 1]) == delta) {
+                ++run;
+                ++i;
+            }
+            p = ::putVarint(run, p);
+        }
+        break;
+    }
+    case Delta:
+        p = put(values[0], p);
+        for (size_t i = 1; i < n; ++i) p = put(difference(values[i], values[i - 1]), p);
+        break;
+    case Varint:
+        for (size_t i = 0; i < n; ++i) p = put(values[i], p);
+        break;
+    case Runs:
+        for (size_t i = 0; i < n;) {
+            size_t run = 1;
+            while (i + run < n && values[i + run] == values[i]) ++run;
+            p = ::putVarint(run, put(values[i], p));
+            i += run;
+        }
+        break;
+    }
+    out.resize(start + static_cast<size_t>(p - begin));
+}
+
+const char* SeriesCodec::decode(Encoding encoding, const char* p, const char* end, int64_t* out, size_t n) {
+    if (n == 0) return p;
+    switch (encoding) {
+    case DeltaOfDelta: {
+        if ((p = get(p, end, out[0])) == nullptr) return nullptr;
+        if (n == 1) return p;
+        int64_t delta;
+        if ((p = get(p, end, delta)) == nullptr) return nullptr;
+        out[1] = sum(out[0], delta);
+        for (size_t i = 2; i < n;) {
+            int64_t deltaOfDelta;
+            if ((p = get(p, end, deltaOfDelta)) == nullptr) return nullptr;
+            delta = sum(delta, deltaOfDelta);
+            out[i] = sum(out[i - 1], delta);
+            ++i;
+            if (deltaOfDelta != 0) continue;
+            uint64_t run;
+            if ((p = ::getVarint(p, end, run)) == nullptr || run > n - i) return nullptr;
+            for (const size_t last = i + run; i < last; ++i) out[i] = sum(out[i - 1], delta);
+        }
+        return p;
+    }
+    case Delta:
+        if ((p = get(p, end, out[0])) == nullptr) return nullptr;
+        for (size_t i = 1; i < n; ++i) {
+            int64_t delta;
+            if ((p = get(p, end, delta)) == nullptr) return nullptr;
+            out[i] = sum(out[i - 1], delta);
+        }
+        return p;
+    case Varint:
+        for (size_t i = 0; i < n; ++i) {
+            if ((p = get(p, end, out[i])) == nullptr) return nullptr;
+        }
+        return p;
+    case Runs:
+        for (size_t i = 0; i < n;) {
+            int64_t value;
+            uint64_t run;
+            if ((p = get(p, end, value)) == nullptr || (p = ::getVarint(p, end, run)) == nullptr) return nullptr;
+            if (run == 0 || run > n - i) return nullptr;
+            for (const size_t last = i + run; i < last; ++i) out[i] = value;
+        }
+        return p;
+    }
+    return nullptr;
+}
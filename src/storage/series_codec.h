@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Encodings of a column of fixed-point integers (timestamps, prices and volumes as stored in a CandleSeries
+ * or a Ticker), in the spirit of the Gorilla time-series compression but byte-aligned, so that decoding
+ * needs no bit shuffling: every number is written as a varint (7 bits per byte) of its zigzag transform,
+ * so that the small negative numbers take as few bytes as the small positive ones. The differences are
+ * computed modulo 2^64, so that any value (MISSING included) is encoded exactly.
+ *  - DeltaOfDelta (timestamps): the first value, the first difference, then the differences between two
+ *    consecutive differences; a run of zeros (candles or tickers at a regular interval) is written as a
+ *    zero and its length, so that a block of regular timestamps takes a few bytes
+ *  - Delta (prices): the first value, then the differences between consecutive values, which are small
+ *    as the prices move by a few ticks (e.g. 12 cents is 12 units, one byte)
+ *  - Varint (volumes): the values themselves, which do not follow each other
+ *  - Runs (flags, decimals): pairs of a value and the number of times it is repeated
+ */
+class SeriesCodec {
+
+public:
+    enum Encoding : unsigned char {DeltaOfDelta, Delta, Varint, Runs};
+
+    // Appends the encoding of n values to out
+    static void encode(Encoding encoding, const int64_t* values, size_t n, std::string& out);
+
+    // Decodes n values from the bytes at [p, end) into out; returns the end of the encoded values, or nullptr
+    // if the bytes are not a valid encoding of n values
+    static const char* decode(Encoding encoding, const char* p, const char* end, int64_t* out, size_t n);
+
+    // Unsigned varint, the building block of the encodings
+    static void putVarint(uint64_t value, std::string& out);
+    static const char* getVarint(const char* p, const char* end, uint64_t& value);
+
+    static uint64_t zigzag(int64_t value) {return (static_cast<uint64_t>(value) << 1) ^ (value < 0 ? ~uint64_t(0) : 0);}
+    static int64_t unzigzag(uint64_t value) {return static_cast<int64_t>((value >> 1) ^ (0 - (value & 1)));}
+};
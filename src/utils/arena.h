@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+/*
+ * Bump allocator for the scratch memory of one poll cycle (or of one response): the transient buffers,
+ * strings and containers of a parse or of a formatting are carved out of a few large blocks, and are all
+ * released at once at the end of the cycle by rewinding the arena, instead of being freed one by one.
+ * The blocks are kept from one cycle to the next, so that once the arena has grown to the size of a
+ * cycle, nothing goes to the global allocator anymore.
+ *
+ * The arena is a std::pmr::memory_resource: the containers using it are the std::pmr ones, e.g.
+ * std::pmr::vector<std::pmr::string>. Every thread has its own arena (see local()), used without any
+ * lock; an arena must not be shared between threads. Deallocations are no-ops: the memory is only given
+ * back when the arena is rewound, so the objects allocated within a Scope must be destroyed (or at least
+ * no longer used) before the end of the Scope.
+ */
+class Arena : public std::pmr::memory_resource {
+
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    explicit Arena(size_t blockSize = BLOCK_SIZE, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()):
+        blockSize_(std::max<size_t>(blockSize, 1024)), upstream_(upstream) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() override {release();}
+
+    // Arena of the calling thread
+    static Arena& local() {
+        thread_local Arena arena;
+        return arena;
+    }
+
+    // Position of the arena: rewinding to a mark releases everything allocated after it, in O(1)
+    struct Mark {
+        size_t block = 0;
+        size_t offset = 0;
+        size_t before = 0;  // size of the blocks before the marked one
+    };
+    Mark mark() const {return {current_, offset_, usedBefore_};}
+    inline void rewind(Mark mark);
+
+    // Releases everything allocated from the arena; its blocks are kept. If the last cycle did not fit
+    // in one block, the blocks are merged into one as large as all of them, so that the next cycles are
+    // served by a single block.
+    void reset() {rewind(Mark{});}
+
+    // Gives the blocks back to the upstream resource
+    inline void release();
+
+    /*
+     * Scope of the scratch memory of a cycle: what is allocated from the arena during the scope is
+     * released at its end. Scopes nest (an inner scope only releases what was allocated after it began),
+     * so a function can open its own scope on the arena of its thread whatever its caller does.
+     */
+    class Scope {
+    public:
+        explicit Scope(Arena& arena = local()): arena_(arena), mark_(arena.mark()) {}
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope() {arena_.rewind(mark_);}
+
+        Arena& arena() const {return arena_;}
+        std::pmr::memory_resource* resource() const {return &arena_;}
+
+    private:
+        Arena& arena_;
+        Mark mark_;
+    };
+
+    // Statistics: bytes held in blocks, bytes in use, highest use since the creation of the arena,
+    // and number of blocks requested from the upstream resource
+    size_t capacity() const {return capacity_;}
+    size_t used() const {return used_;}
+    size_t peak() const {return peak_;}
+    size_t upstreamAllocations() const {return upstreamAllocations_;}
+
+protected:
+    inline void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {return this == &other;}
+
+private:
+    struct Block {
+        std::byte* data = nullptr;
+        size_t size = 0;
+    };
+
+    const size_t blockSize_;
+    std::pmr::memory_resource* const upstream_;
+    std::vector<Block> blocks_;
+    size_t current_ = 0;        // block being filled
+    size_t offset_ = 0;         // first free byte of the current block
+    size_t capacity_ = 0;
+    size_t used_ = 0;           // usedBefore_ + offset_
+    size_t usedBefore_ = 0;     // bytes of the blocks before the current one
+    size_t peak_ = 0;
+    size_t upstreamAllocations_ = 0;
+
+    Block allocateBlock(size_t size) {
+        ++upstreamAllocations_;
+        capacity_ += size;
+        return {static_cast<std::byte*>(upstream_->allocate(size, alignof(std::max_align_t))), size};
+    }
+    void freeBlock(const Block& block) {
+        capacity_ -= block.size;
+        upstream_->deallocate(block.data, block.size, alignof(std::max_align_t));
+    }
+};
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    while (true) {
+        if (current_ < blocks_.size()) {
+            const Block& block = blocks_[current_];
+            const uintptr_t address = reinterpret_cast<uintptr_t>(block.data) + offset_;
+            const size_t padding = (alignment - address % alignment) % alignment;
+            if (offset_ + padding + bytes <= block.size) {
+                void* p = block.data + offset_ + padding;
+                offset_ += padding + bytes;
+                used_ = usedBefore_ + offset_;
+                peak_ = std::max(peak_, used_);
+                return p;
+            }
+            if (offset_ > 0) {
+                // The rest of the block is left unused: the allocation goes to the next block
+                usedBefore_ += block.size;
+                ++current_;
+                offset_ = 0;
+                continue;
+            }
+        }
+        // No block left, or the current one is empty but too small: it is replaced by a larger one
+        const size_t size = std::max({bytes + alignment, blockSize_, blocks_.empty() ? 0 : blocks_.back().size * 2});
+        if (current_ < blocks_.size()) {
+            freeBlock(blocks_[current_]);
+            blocks_[current_] = allocateBlock(size);
+        } else {
+            blocks_.push_back(allocateBlock(size));
+        }
+    }
+}
+
+void Arena::rewind(Mark mark) {
+    if (mark.block > current_ || (mark.block == current_ && mark.offset >= offset_)) return;
+    if (mark.block == 0 && mark.offset == 0 && current_ > 0) {
+        // End of a cycle which needed several blocks: they are merged for the next cycles
+        const size_t size = capacity_;
+        for (const auto& block: blocks_) freeBlock(block);
+        blocks_.assign(1, allocateBlock(size));
+    }
+    current_ = mark.block;
+    offset_ = mark.offset;
+    usedBefore_ = mark.before;
+    used_ = usedBefore_ + offset_;
+}
+
+void Arena::release() {
+    for (const auto& block: blocks_) freeBlock(block);
+    blocks_.clear();
+    current_ = offset_ = used_ = usedBefore_ = 0;
+}
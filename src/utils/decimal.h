@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+
+/*
+ * Exact conversions between decimal strings (e.g. the prices and volumes sent by the exchanges, "57844.5")
+ * and fixed-point integers: a value is stored as an int64_t number of units of 10^-scale (57844.5 with
+ * scale 8 is 5784450000000). No floating point is involved, so the values are kept exactly, and sums and
+ * differences of values with the same scale are exact too. Nothing is allocated, except by toString.
+ */
+class Decimal {
+
+public:
+    static constexpr unsigned MAX_SCALE = 18;
+
+    // Parses a decimal string (an optional sign, digits, and an optional fraction; no exponent) into units
+    // of 10^-scale. Returns false if the text is not a decimal number, if it has nonzero digits beyond the
+    // scale, or if the value does not fit into an int64_t.
+    static inline bool parse(std::string_view text, unsigned scale, int64_t& units);
+
+    // Number of decimals written in a decimal string, trailing zeros included (e.g. 2 for "70.00")
+    static inline unsigned decimals(std::string_view text);
+
+    // Writes units of 10^-scale with the given number of decimals; more decimals are written if needed
+    // to keep the value exact, e.g. (12345, 2, 0) is written as "123.45"
+    static inline void append(int64_t units, unsigned scale, unsigned decimals, std::string& out);
+    static std::string toString(int64_t units, unsigned scale, unsigned decimals) {
+        std::string out;
+        append(units, scale, decimals, out);
+        return out;
+    }
+    static std::string toString(int64_t units, unsigned scale) {return toString(units, scale, scale);}
+
+    // Converts units of 10^-from into units of 10^-to; returns false if the value does not fit or if
+    // nonzero digits would be dropped
+    static inline bool rescale(int64_t units, unsigned from, unsigned to, int64_t& out);
+
+    // Approximation of the value, for the computations which do not need to be exact
+    static double toDouble(int64_t units, unsigned scale) {return static_cast<double>(units) / static_cast<double>(pow10(scale));}
+
+    static int64_t pow10(unsigned n) {return n <= MAX_SCALE ? POW10[n] : 0;}
+
+private:
+    static constexpr int64_t POW10[MAX_SCALE + 1] = {
+        1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL, 1000000000LL,
+        10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL, 100000000000000LL,
+        1000000000000000LL, 10000000000000000LL, 100000000000000000LL, 1000000000000000000LL
+    };
+
+    static bool isDigit(char c) {return c >= '0' && c <= '9';}
+    static inline bool parseLong(const char* p, const char* end, unsigned scale, uint64_t& value);
+    static inline bool eightDigits(const char* p, uint64_t& value);
+};
+
+bool Decimal::parse(std::string_view text, unsigned scale, int64_t& units) {
+    if (scale > MAX_SCALE) return false;
+    const char* p = text.data();
+    const char* const end = p + text.size();
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+    // Up to 19 digits always fit into a uint64_t: the digits are counted, and only checked at the end
+    uint64_t value = 0;
+    unsigned digits = 0;
+    const char* const integer = p;
+    uint64_t eight;
+    while (end - p >= 8 && eightDigits(p, eight)) {
+        value = value * 100000000 + eight;
+        digits += 8;
+        p += 8;
+    }
+    while (p < end && isDigit(*p)) {
+        value = value * 10 + static_cast<unsigned>(*p++ - '0');
+        ++digits;
+    }
+    bool any = p > integer;
+
+    unsigned fraction = 0;
+    if (p < end && *p == '.') {
+        const char* const first = ++p;
+        while (scale - fraction >= 8 && end - p >= 8 && eightDigits(p, eight)) {
+            value = value * 100000000 + eight;
+            digits += 8;
+            fraction += 8;
+            p += 8;
+        }
+        while (p < end && isDigit(*p)) {
+            if (fraction < scale) {
+                value = value * 10 + static_cast<unsigned>(*p - '0');
+                ++digits;
+                ++fraction;
+            } else if (*p != '0') {
+                return false; // a significant digit beyond the scale
+            }
+            ++p;
+        }
+        any = any || p > first;
+    }
+    if (p != end || !any) return false;
+    if (digits > 19 && !parseLong(integer, end, scale, value)) return false;
+
+    if (fraction < scale && __builtin_mul_overflow(value, static_cast<uint64_t>(POW10[scale - fraction]), &value)) return false;
+    const uint64_t max = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+    if (value > max + (negative ? 1 : 0)) return false;
+    units = negative ? static_cast<int64_t>(0 - value) : static_cast<int64_t>(value);
+    return true;
+}
+
+// Numbers with more than 19 digits (leading zeros included) are parsed again, checking every digit
+bool Decimal::parseLong(const char* p, const char* end, unsigned scale, uint64_t& value) {
+    const uint64_t limit = (std::numeric_limits<uint64_t>::max() - 9) / 10;
+    unsigned fraction = 0;
+    bool point = false;
+    value = 0;
+    for (; p < end; ++p) {
+        if (*p == '.') {
+            point = true;
+            continue;
+        }
+        if (point && fraction == scale) break; // the remaining digits are zeros
+        if (value > limit) return false;
+        value = value * 10 + static_cast<unsigned>(*p - '0');
+        if (point) ++fraction;
+    }
+    return true;
+}
+
+// Converts 8 digits at once (SWAR): returns false if one of the 8 characters is not a digit
+bool Decimal::eightDigits(const char* p, uint64_t& value) {
+    uint64_t chunk;
+    std::memcpy(&chunk, p, sizeof(chunk));
+    if ((((chunk & 0xF0F0F0F0F0F0F0F0ULL) | (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4))) != 0x3333333333333333ULL) return false;
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);
+    value = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) + (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    return true;
+}
+
+unsigned Decimal::decimals(std::string_view text) {
+    size_t point = text.find('.');
+    if (point == std::string_view::npos) return 0;
+    size_t end = point + 1;
+    while (end < text.size() && isDigit(text[end])) ++end;
+    return static_cast<unsigned>(end - point - 1);
+}
+
+void Decimal::append(int64_t units, unsigned scale, unsigned decimals, std::string& out) {
+    if (scale > MAX_SCALE) return;
+    uint64_t magnitude = units < 0 ? 0 - static_cast<uint64_t>(units) : static_cast<uint64_t>(units);
+
+    // Digits from the least significant one, with at least one integer digit
+    char digits[24];
+    unsigned count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0 || count <= scale);
+
+    // The trailing zeros of the fraction are dropped down to the requested decimals
+    unsigned shown = scale;
+    while (shown > decimals && digits[scale - shown] == '0') --shown;
+
+    char buffer[48];
+    char* p = buffer;
+    if (units < 0) *p++ = '-';
+    for (unsigned i = count; i > scale; --i) *p++ = digits[i - 1];
+    if (shown > 0 || decimals > scale) *p++ = '.';
+    for (unsigned i = 0; i < shown; ++i) *p++ = digits[scale - 1 - i];
+    for (unsigned i = scale; i < decimals && p < buffer + sizeof(buffer); ++i) *p++ = '0';
+    out.append(buffer, p - buffer);
+}
+
+bool Decimal::rescale(int64_t units, unsigned from, unsigned to, int64_t& out) {
+    if (from > MAX_SCALE || to > MAX_SCALE) return false;
+    if (to >= from) return !__builtin_mul_overflow(units, POW10[to - from], &out);
+    const int64_t divisor = POW10[from - to];
+    if (units % divisor != 0) return false;
+    out = units / divisor;
+    return true;
+}
@@ -51,9 +51,11 @@ std::string Utils::formatMapVector(
     const std::vector<std::string>& exclude, 
     bool toCsv
 ) {
+    // The matrix only lives for the formatting: it is scratch memory of the thread 
+    Arena::Scope scratch; 
     std::vector<std::string> header; 
     int timestampPos = -1; 
-    auto mapData = mapVectorToMatrix(mapVector, header, timestampPos, timestampName); 
+    auto mapData = mapVectorToMatrix(mapVector, header, timestampPos, timestampName, scratch.resource()); 
 
     return toCsv ? 
         matrixToCsvFormat(mapData, header, exclude, headerPrefix, timestampPos) :
@@ -62,23 +64,9 @@ std::string Utils::formatMapVector(
 }
 
 std::string Utils::timestampToString(int timestamp, bool toUtc) {
-    // Convert the integer to a time_t type
-    time_t rawTime = static_cast<time_t>(timestamp);
-
-    // Convert the time_t to a tm structure in UTC
-    struct tm *timeInfo = toUtc? gmtime(&rawTime) : localtime(&rawTime);
-
-    // Check if the conversion was successful
-    if (timeInfo == nullptr) {
-        throw std::runtime_error("Error converting timestamp to UTC time.");
-    }
-
-    // Format the date and time into a readable string
-    char buffer[20];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeInfo);
-
-    // Return the formatted string
-    return std::string(buffer);
+    std::string out; 
+    appendTimestamp(timestamp, out, toUtc); 
+    return out; 
 }
 
 int Utils::stringToTimestamp(const std::string& dateTimeStr, bool fromUtc) {
@@ -100,24 +88,40 @@ std::stringstream Utils::mapToMessage(
     const std::unordered_map<std::string, std::string>& map,
     const std::vector<std::string>& fields) {
 
+    std::string out; 
+    appendMessage(name, map, fields, out); 
     std::stringstream msg; 
-    msg << name << " << "; 
+    msg << out; 
+    return msg; 
+}
+
+void Utils::appendMessage(
+    const std::string& name, 
+    const std::unordered_map<std::string, std::string>& map,
+    const std::vector<std::string>& fields, 
+    std::string& out) {
+
+    out += name; 
+    out += " << "; 
 
     if (fields.empty()) {
         for (auto it = map.begin(); it != map.end(); ++it) {
-            msg << it->first << ": " << it->second; 
-            if (std::next(it) != map.end()) msg << " << "; 
+            out += it->first; 
+            out += ": "; 
+            out += it->second; 
+            if (std::next(it) != map.end()) out += " << "; 
         }
     } else {
         for (size_t i = 0; i < fields.size(); ++i) {
             auto it = map.find(fields.at(i)); 
             if (it != map.end()) {
-                msg << it->first << ": " << it->second; 
-                if (i < fields.size()-1) msg << " << "; 
+                out += it->first; 
+                out += ": "; 
+                out += it->second; 
+                if (i < fields.size()-1) out += " << "; 
             }
         }
     }
-    return msg; 
 }
 
 int Utils::writeStringToFile(
@@ -140,27 +144,10 @@ std::stringstream Utils::matrixToMsg(
     const std::vector<std::string>& timestampVector, 
     const std::vector<std::vector<std::string>>& values
 ) {
-
+        std::string out; 
+        appendMatrixMsg(names, timestampVector, values, out); 
         std::stringstream msg; 
-
-        const int timestampWidth = 25;
-        const int valueWidth = 15;
-
-        // Header
-        msg << std::left << std::setw(timestampWidth) << "Timestamp";
-        for (const auto& n: names) msg << std::left << std::setw(valueWidth) << n; 
-        msg << "\n"; 
-        msg << std::string(timestampWidth + valueWidth * names.size(), '-') << "\n"; 
-
-        // Values 
-        for (size_t i = 0; i < timestampVector.size(); ++i) {
-            msg << std::left << std::setw(timestampWidth) << timestampVector.at(i); 
-            for (size_t j = 0; j < values.size(); ++j) {
-                msg << std::left << std::setw(valueWidth) << values.at(j).at(i); 
-            }
-            msg << "\n"; 
-        }
-        msg << std::string(timestampWidth + valueWidth * names.size(), '-') << "\n"; 
+        msg << out; 
         return msg; 
 }
 
@@ -185,17 +172,20 @@ std::vector<std::string> Utils::readTxtLines(const std::string& fileName) {
 /************************
 *   Private Functions   * 
 *************************/ 
-std::vector<std::vector<std::string>> Utils::mapVectorToMatrix(
+Utils::Matrix Utils::mapVectorToMatrix(
     const std::vector<std::unordered_map<std::string, std::string>>& mapVector,
     std::vector<std::string>& header, 
     int& timestampPos, 
-    const std::string& timestampName
+    const std::string& timestampName, 
+    std::pmr::memory_resource* resource
 ) {
-    std::vector<std::vector<std::string>> mapData; 
+    Matrix mapData(resource); 
+    mapData.reserve(mapVector.size()); 
 
-    // Create a "data matrix" (vector of vectors) with the data
+    // Create a "data matrix" (vector of vectors) with the data; the rows and their strings 
+    // are allocated from the resource of the matrix 
     for (size_t i = 0; i < mapVector.size(); ++i) {
-        std::vector<std::string> tmp(mapVector.at(i).size()); 
+        auto& tmp = mapData.emplace_back(mapVector.at(i).size()); 
         for (const auto& item: mapVector.at(i)) {
             if (i == 0) header.push_back(item.first); 
             size_t vecPos = std::distance(
@@ -207,13 +197,12 @@ std::vector<std::vector<std::string>> Utils::mapVectorToMatrix(
             }
             tmp.at(vecPos) = item.second;  
         }
-        mapData.push_back(tmp); 
     }
     return mapData; 
 }
 
 std::string Utils::matrixToTableFormat(
-    const std::vector<std::vector<std::string>>& mapData, 
+    const Matrix& mapData, 
     const std::vector<std::string>& header, 
     const std::vector<std::string>& exclude, 
     const std::string& headerPrefix, 
@@ -235,7 +224,7 @@ std::string Utils::matrixToTableFormat(
         size_t j = 0; 
         for (const auto& col: row) {
             if (timestampPos >= 0 && j == timestampPos) {
-                out << std::left << std::setw(colWidth) << timestampToString(std::stoi(col));
+                out << std::left << std::setw(colWidth) << timestampToString(std::stoi(std::string(col)));
                 continue; 
             }
             if (std::find(exclude.begin(), exclude.end(), header.at(j)) != exclude.end()) {++j; continue;} 
@@ -250,7 +239,7 @@ std::string Utils::matrixToTableFormat(
 }
 
 std::string Utils::matrixToCsvFormat(
-    const std::vector<std::vector<std::string>>& mapData, 
+    const Matrix& mapData, 
     const std::vector<std::string>& header, 
     const std::vector<std::string>& exclude, 
     const std::string& headerPrefix, 
@@ -268,7 +257,7 @@ std::string Utils::matrixToCsvFormat(
         size_t j = 0; 
         for (const auto& col: row) {
             if (timestampPos >= 0 && j == timestampPos) {
-                out << timestampToString(std::stoi(col));
+                out << timestampToString(std::stoi(std::string(col)));
                 if (j < row.size()-1) out << ","; 
                 continue; 
             }
@@ -1,5 +1,7 @@
 #pragma once 
 
+#include "arena.h" 
+
 #include <string> 
 #include <cstdlib> 
 #include <unordered_map> 
@@ -10,6 +12,7 @@
 #include <iomanip> 
 #include <iostream> 
 #include <fstream> 
+#include <stdexcept> 
 
 /*
  * Class containing a set of utility methods.
@@ -46,6 +49,7 @@ public:
     // Turns a timestamp integer (taken as input) and returns the corresponding 
     // datetime object, into string format. 
     static inline std::string timestampToString(int timestamp, bool toUtc=true); 
+    static inline void appendTimestamp(int timestamp, std::string& out, bool toUtc=true); 
 
     // It takes a datetime string as an input, and it returns the corresponding 
     // timestamp as an integer. 
@@ -57,6 +61,12 @@ public:
         const std::unordered_map<std::string, std::string>& map,
         const std::vector<std::string>& fields = {}
     );  
+    static inline void appendMessage(
+        const std::string& name, 
+        const std::unordered_map<std::string, std::string>& map,
+        const std::vector<std::string>& fields, 
+        std::string& out
+    );  
 
     /* Converts a "matrix" (vector of vectors of std::string's) into a 
      * message that can be screen-printed; each column will corresponds to 
@@ -69,6 +79,16 @@ public:
         const std::vector<std::vector<std::string>>& values
     );
 
+    // Same, but the message is written at the end of out; the vectors can be of any kind 
+    // (e.g. std::pmr vectors, from the scratch arena of a poll cycle) 
+    template<typename Strings, typename StringMatrix> 
+    static void appendMatrixMsg(
+        const std::vector<std::string>& names, 
+        const Strings& timestampVector, 
+        const StringMatrix& values, 
+        std::string& out
+    );
+
     // It takes a string and a filename as input, and writes 
     // the string into the given file. 
     static inline int writeStringToFile(
@@ -82,18 +102,28 @@ public:
 
 private: 
 
+    // Matrix of strings allocated from a memory resource (e.g. the scratch arena of the thread) 
+    using Matrix = std::pmr::vector<std::pmr::vector<std::pmr::string>>; 
+
+    // Pads the text written from start with spaces up to the width (longer texts are not cut), 
+    // as std::left << std::setw does 
+    static void padFrom(std::string& out, size_t start, size_t width) {
+        if (out.size() - start < width) out.append(width - (out.size() - start), ' '); 
+    }
+
     // Turns a vector of unordered_map's into a vector of string vectors (matrix), 
-    // where each of the map's keys corresponds to a column. 
-    static inline std::vector<std::vector<std::string>>  mapVectorToMatrix(
+    // where each of the map's keys corresponds to a column. The matrix is allocated from the resource. 
+    static inline Matrix mapVectorToMatrix(
         const std::vector<std::unordered_map<std::string, std::string>>& mapVector,
         std::vector<std::string>& header, 
         int& timestampPos, 
-        const std::string& timestampName
+        const std::string& timestampName, 
+        std::pmr::memory_resource* resource
     ); 
 
     // Converts a vector of string vectors (matrix) into a tabular format. 
     static inline std::string matrixToTableFormat(
-        const std::vector<std::vector<std::string>>& mapData, 
+        const Matrix& mapData, 
         const std::vector<std::string>& header, 
         const std::vector<std::string>& exclude, 
         const std::string& headerPrefix, 
@@ -103,10 +133,64 @@ private:
 
     // It turns a vector of string vectors into a csv format. 
     static inline std::string matrixToCsvFormat(
-            const std::vector<std::vector<std::string>>& mapData, 
+        const Matrix& mapData, 
         const std::vector<std::string>& header, 
         const std::vector<std::string>& exclude, 
         const std::string& headerPrefix, 
         int timestampPos
     );
-}; 
\ No newline at end of file
+};
+
+// Defined in the header rather than in utils.cpp, so that the units which only include utils.h can use them 
+void Utils::appendTimestamp(int timestamp, std::string& out, bool toUtc) {
+    // Convert the integer to a time_t type
+    time_t rawTime = static_cast<time_t>(timestamp);
+
+    // Convert the time_t to a tm structure in UTC (the reentrant functions, as the timestamps 
+    // are formatted by several threads)
+    struct tm timeInfo; 
+    if ((toUtc ? gmtime_r(&rawTime, &timeInfo) : localtime_r(&rawTime, &timeInfo)) == nullptr) {
+        throw std::runtime_error("Error converting timestamp to UTC time.");
+    }
+
+    // Format the date and time into a readable string
+    char buffer[20];
+    out.append(buffer, strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeInfo));
+}
+
+template<typename Strings, typename StringMatrix> 
+void Utils::appendMatrixMsg(
+    const std::vector<std::string>& names, 
+    const Strings& timestampVector, 
+    const StringMatrix& values, 
+    std::string& out
+) {
+        const size_t timestampWidth = 25;
+        const size_t valueWidth = 15;
+
+        // Header
+        size_t start = out.size(); 
+        out += "Timestamp"; 
+        padFrom(out, start, timestampWidth); 
+        for (const auto& n: names) {
+            start = out.size(); 
+            out += n; 
+            padFrom(out, start, valueWidth); 
+        }
+        out += "\n"; 
+        out.append(timestampWidth + valueWidth * names.size(), '-') += "\n"; 
+
+        // Values 
+        for (size_t i = 0; i < timestampVector.size(); ++i) {
+            start = out.size(); 
+            out += timestampVector.at(i); 
+            padFrom(out, start, timestampWidth); 
+            for (size_t j = 0; j < values.size(); ++j) {
+                start = out.size(); 
+                out += values.at(j).at(i); 
+                padFrom(out, start, valueWidth); 
+            }
+            out += "\n"; 
+        }
+        out.append(timestampWidth + valueWidth * names.size(), '-') += "\n"; 
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <iostream>
+
+/*
+ * Minimal checks of the unit tests: a failed check is reported with its location and the test goes on,
+ * so that a run shows all the failures. Each test program returns result(), a non-zero exit status
+ * (reported as a failure by ctest) if a check failed.
+ */
+namespace check {
+
+inline int failures = 0;
+
+inline int result() {
+    if (failures > 0) std::cerr << failures << " check(s) failed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace check
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            ++check::failures; \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        const auto& actualValue = (actual); \
+        const auto& expectedValue = (expected); \
+        if (!(actualValue == expectedValue)) { \
+            ++check::failures; \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #actual ", " #expected ") failed: got " \
+                      << actualValue << ", expected " << expectedValue << std::endl; \
+        } \
+    } while (0)
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../src/api/candle_series.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unistd.h>
+
+/*
+ * Candles shared by the tests of the series and of their storage: a regular series whose values vary
+ * with the timestamps, the comparison of two series as the text of their values (so that the scales
+ * need not be the same), and the paths of the temporary files, unique to each test process.
+ */
+namespace fixtures {
+
+// Text of the close of the i-th candle of a series
+using Close = std::function<std::string(size_t i)>;
+
+// n candles from time, step seconds apart: prices with 2 decimals (the low missing every 7th step),
+// volumes with 4 decimals, and the closes given by close if set
+inline CandleSeries candles(int64_t time, size_t n, int64_t step = 60, const Close& close = nullptr) {
+    CandleSeries series;
+    for (size_t i = 0; i < n; ++i) {
+        const int64_t t = time + step * static_cast<int64_t>(i);
+        const std::string price = std::to_string(60000 + t % 997) + "." + std::to_string(10 + t % 90);
+        const std::string closed = close ? close(i) : price;
+        series.append({std::to_string(t), price, price, t / step % 7 == 0 ? "" : price, closed, std::to_string(t % 13) + ".0001"});
+    }
+    return series;
+}
+
+// The candles of actual are the candles of expected from first on (compared as text)
+inline bool sameCandles(const CandleSeries& expected, size_t first, const CandleSeries& actual) {
+    if (first + actual.size() > expected.size()) return false;
+    for (size_t i = 0; i < actual.size(); ++i) {
+        for (size_t c = 0; c < CandleSeries::COLUMNS; ++c) {
+            const auto column = static_cast<CandleSeries::Column>(c);
+            if (expected.text(column, first + i) != actual.text(column, i)) return false;
+        }
+    }
+    return true;
+}
+
+inline bool sameCandles(const CandleSeries& expected, const CandleSeries& actual) {
+    return expected.size() == actual.size() && sameCandles(expected, 0, actual);
+}
+
+// Path of a temporary file of the test process
+inline std::string temporaryPath(const char* name) {
+    return "/tmp/cmdf_test_" + std::to_string(::getpid()) + "_" + name;
+}
+
+} // namespace fixtures
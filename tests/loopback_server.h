@@ -0,0 +1,136 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Stand-in server of the tests and benchmarks: listens on an ephemeral port of 127.0.0.1, and serves
+ * each accepted connection on its own thread with the handler given (the connection is closed when the
+ * handler returns). Stopping the server shuts the connections down, so that the handlers blocked in a
+ * read return, and joins their threads. The static helpers read the requests and write the responses of
+ * the plain HTTP stand-ins.
+ */
+class LoopbackServer {
+
+public:
+    using Handler = std::function<void(int fd)>;
+
+    explicit LoopbackServer(Handler handler): handler_(std::move(handler)) {
+        listener_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        const int yes = 1;
+        ::setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (::bind(listener_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener_, 128) != 0 ||
+            ::getsockname(listener_, reinterpret_cast<sockaddr*>(&address), &length) != 0) return;
+        port_ = ntohs(address.sin_port);
+        acceptor_ = std::thread([this] {accept();});
+    }
+
+    LoopbackServer(const LoopbackServer&) = delete;
+    LoopbackServer& operator=(const LoopbackServer&) = delete;
+    ~LoopbackServer() {stop();}
+
+    int port() const {return port_;}
+    std::string url(const std::string& target = "/") const {return "http://127.0.0.1:" + std::to_string(port_) + target;}
+
+    // Number of connections accepted so far
+    size_t accepted() const {return accepted_.load();}
+
+    // Stops accepting connections, shuts the open ones down and waits for their handlers
+    void stop() {
+        if (stopping_.exchange(true)) return;
+        if (acceptor_.joinable()) acceptor_.join();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const int fd: open_) {
+                if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+            }
+        }
+        for (auto& worker: workers_) worker.join();
+        ::close(listener_);
+    }
+
+    // Reads the head of a request (up to the empty line) into head; the bytes received after it are kept
+    // in buffer, for the next request of the connection. Returns false if the connection was closed first.
+    static bool readRequest(int fd, std::string& buffer, std::string& head) {
+        for (;;) {
+            const size_t end = buffer.find("\r\n\r\n");
+            if (end != std::string::npos) {
+                head = buffer.substr(0, end + 4);
+                buffer.erase(0, end + 4);
+                return true;
+            }
+            char chunk[4096];
+            const ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) return false;
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    }
+
+    static bool writeAll(int fd, const std::string& data) {
+        for (size_t sent = 0; sent < data.size();) {
+            const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // A 200 response delimited by its Content-Length; headers are full header lines, each ending with "\r\n"
+    static std::string response(const std::string& body, const std::string& headers = "") {
+        return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" + headers + "\r\n" + body;
+    }
+
+    // Serves the response given (built from the target requested) to every request of a connection
+    static Handler serve(std::function<std::string(const std::string& head)> respond) {
+        return [respond = std::move(respond)](int fd) {
+            std::string buffer, head;
+            while (readRequest(fd, buffer, head) && writeAll(fd, respond(head))) {}
+        };
+    }
+
+private:
+    Handler handler_;
+    int listener_ = -1;
+    int port_ = 0;
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> accepted_{0};
+    std::thread acceptor_;
+    std::mutex mutex_;
+    std::vector<int> open_;
+    std::vector<std::thread> workers_; // only touched by the acceptor, then by stop() once it has been joined
+
+    void accept() {
+        while (!stopping_.load()) {
+            pollfd p{listener_, POLLIN, 0};
+            if (::poll(&p, 1, 20) <= 0) continue;
+            const int fd = ::accept(listener_, nullptr, nullptr);
+            if (fd < 0) continue;
+            ++accepted_;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                open_.push_back(fd);
+            }
+            workers_.emplace_back([this, fd] {
+                handler_(fd);
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (auto& open: open_) {
+                    if (open == fd) open = -1;
+                }
+                ::close(fd);
+            });
+        }
+    }
+};
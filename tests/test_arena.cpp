@@ -0,0 +1,117 @@
+#include "check.h"
+#include "../src/utils/arena.h"
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool aligned(const void* p, size_t alignment) {return reinterpret_cast<uintptr_t>(p) % alignment == 0;}
+
+// Allocates bytes from the arena and writes them
+void* fill(Arena& arena, size_t bytes, size_t alignment = 8) {
+    void* p = arena.allocate(bytes, alignment);
+    std::memset(p, 'x', bytes);
+    return p;
+}
+
+void testNestedScopes() {
+    // The inner scope spans several blocks; its end only releases what it allocated, and the memory of the
+    // outer scope is left as it was
+    Arena arena(1024);
+    Arena::Scope outer(arena);
+    char* kept = static_cast<char*>(arena.allocate(600, 1));
+    std::memset(kept, 'k', 600);
+    const size_t used = arena.used();
+    {
+        Arena::Scope inner(arena);
+        for (int i = 0; i < 10; ++i) fill(arena, 700);
+        CHECK(arena.used() > used + 7000);
+        {
+            Arena::Scope innermost(arena);
+            fill(arena, 3000, 16);
+        }
+        CHECK(arena.used() > used + 7000);
+    }
+    CHECK_EQ(arena.used(), used);
+    CHECK_EQ(std::string(kept, 600), std::string(600, 'k'));
+
+    // The next allocation reuses the released memory, right after the memory of the outer scope
+    char* next = static_cast<char*>(arena.allocate(100, 1));
+    CHECK(next == kept + 600);
+}
+
+void testResetMergesBlocks() {
+    Arena arena(1024);
+    for (int i = 0; i < 20; ++i) fill(arena, 500);
+    const size_t capacity = arena.capacity();
+    CHECK(capacity >= 20 * 500);
+    CHECK(arena.upstreamAllocations() > 1);
+    arena.reset();
+    CHECK_EQ(arena.used(), size_t(0));
+    CHECK_EQ(arena.capacity(), capacity);
+
+    // The blocks were merged into a single one, as large as all of them: the same cycle fits in it
+    const size_t allocations = arena.upstreamAllocations();
+    for (int i = 0; i < 20; ++i) fill(arena, 500);
+    fill(arena, capacity - arena.used() - 64, 8);
+    CHECK_EQ(arena.upstreamAllocations(), allocations);
+    CHECK_EQ(arena.capacity(), capacity);
+}
+
+void testLargeAllocations() {
+    // An empty block too small for an allocation is replaced by a larger one, rather than kept unused
+    Arena arena(1024);
+    fill(arena, 100, 8);
+    arena.reset();
+    CHECK_EQ(arena.capacity(), size_t(1024));
+    fill(arena, 5000);
+    CHECK(arena.capacity() >= 5000 && arena.capacity() < 1024 + 5000);
+}
+
+void testAlignment() {
+    Arena arena(1024);
+    bool ok = true;
+    for (size_t alignment = 1; alignment <= 256; alignment *= 2) {
+        for (size_t bytes: {size_t(1), size_t(3), size_t(17), size_t(600)}) {
+            fill(arena, 1, 1); // an odd offset before each allocation
+            ok = ok && aligned(arena.allocate(bytes, alignment), alignment);
+        }
+    }
+    CHECK(ok);
+
+    // The pmr containers get memory aligned for their elements
+    Arena::Scope scratch(arena);
+    std::pmr::vector<long double> values(scratch.resource());
+    fill(arena, 1, 1);
+    values.resize(10);
+    CHECK(aligned(values.data(), alignof(long double)));
+}
+
+void testCycles() {
+    // Once the arena has grown to the size of a cycle, the cycles do not go to the upstream resource
+    Arena arena(4096);
+    size_t grown = 0;
+    for (int cycle = 0; cycle < 100; ++cycle) {
+        Arena::Scope scratch(arena);
+        std::pmr::vector<std::pmr::string> strings(scratch.resource());
+        for (int i = 0; i < 200; ++i) strings.emplace_back(std::string(40 + i % 50, 'x'));
+        if (cycle == 1) grown = arena.upstreamAllocations();
+    }
+    CHECK_EQ(arena.upstreamAllocations(), grown);
+    CHECK_EQ(arena.used(), size_t(0));
+    CHECK(arena.peak() > 0 && arena.peak() <= arena.capacity());
+}
+
+} // namespace
+
+int main() {
+    testNestedScopes();
+    testResetMergesBlocks();
+    testLargeAllocations();
+    testAlignment();
+    testCycles();
+    return check::result();
+}
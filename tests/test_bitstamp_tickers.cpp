@@ -0,0 +1,176 @@
+#include "check.h"
+#include "loopback_server.h"
+#include "../src/api/bitstamp_api.h"
+#include "../src/api/ticker_catalog.h"
+#include "../src/json_reader/json_reader.h"
+#include "../src/utils/utils.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Response of the ticker endpoint without a pair (all pairs), as recorded from the api, cut to a few pairs
+const std::string ALL_TICKERS = R"([
+{"timestamp": "1729166400", "open": "67380", "high": "68424", "low": "66984", "last": "67412", "volume": "1523.61098052", "vwap": "67703", "bid": "67410", "ask": "67413", "side": "0", "open_24": "67390", "percent_change_24": "0.03", "pair": "BTC/USD"},
+{"timestamp": "1729166400", "open": "62105", "high": "63012", "low": "61790", "last": "62133", "volume": "402.10473661", "vwap": "62466", "bid": "62126", "ask": "62137", "side": "1", "open_24": "62140", "percent_change_24": "-0.01", "pair": "BTC/EUR"},
+{"timestamp": "1729166399", "open": "2610.9", "high": "2689.4", "low": "2588.7", "last": "2614.2", "volume": "9821.04281539", "vwap": "2638.6", "bid": "2614.1", "ask": "2614.5", "side": "0", "open_24": "2611.8", "percent_change_24": "0.09", "pair": "ETH/USD"},
+{"timestamp": "1729166398", "open": "0.53760", "high": "0.55210", "low": "0.53102", "last": "0.54034", "volume": "4110512.48201044", "vwap": "0.54123", "bid": "0.54011", "ask": "0.54052", "side": "1", "open_24": null, "percent_change_24": null, "pair": "XRP/USD"}
+])";
+
+// Response of the ohlc endpoint, as recorded from the api, cut to three candles
+const std::string OHLC = R"({"data": {"pair": "BTC/USD", "ohlc": [
+{"high": "57950", "timestamp": "1720719600", "volume": "12.50000000", "low": "57650", "close": "57844.5", "open": "57700"},
+{"high": "57901", "timestamp": "1720719660", "volume": "3.04811362", "low": "57802", "close": "57880", "open": "57844"},
+{"high": "57912", "timestamp": "1720719720", "volume": "0.41250000", "low": "57860", "close": "57871.25", "open": "57881"}
+]}})";
+
+std::string target(const std::string& head) {
+    const size_t begin = head.find(' ') + 1;
+    return head.substr(begin, head.find(' ', begin) - begin);
+}
+
+// Same fields present, with the same values (the values of the missing fields are left unspecified)
+bool same(const Ticker& a, const Ticker& b) {
+    if (a.present != b.present || a.nulls != b.nulls) return false;
+    for (unsigned f = 0; f < Ticker::FIELDS; ++f) {
+        if (!a.has(static_cast<Ticker::Field>(f))) continue;
+        if (a.units[f] != b.units[f] || a.decimals[f] != b.decimals[f]) return false;
+    }
+    return true;
+}
+
+// Stand-in of the api serving the recorded response (also the list of the pairs of the catalog)
+LoopbackServer::Handler serveTickers(const std::string& body) {
+    return LoopbackServer::serve([body](const std::string& head) {
+        if (target(head) == "/ticker/") return LoopbackServer::response(body);
+        if (target(head).rfind("/ohlc/btcusd/?", 0) == 0) return LoopbackServer::response(OHLC);
+        if (target(head).rfind("/ohlc/ethusd/?", 0) == 0) return LoopbackServer::response(OHLC.substr(0, OHLC.find("1720719720")));
+        return std::string("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    });
+}
+
+void testAllPairsResponse() {
+    LoopbackServer server(serveTickers(ALL_TICKERS));
+    BitstampApi api(5, server.url("/"));
+    const PairId btcusd = api.pairId("btcusd");
+    const PairId ethusd = api.pairId("ethusd");
+    const PairId xrpusd = api.pairId("xrpusd");
+    CHECK(btcusd != INVALID_PAIR_ID && ethusd != INVALID_PAIR_ID && xrpusd != INVALID_PAIR_ID);
+    CHECK_EQ(api.pairId("ltcusd"), INVALID_PAIR_ID);
+
+    // A pair listed twice gets its record in both slots; an unknown id leaves its slot empty
+    std::vector<Ticker> out;
+    CHECK(api.fetchTickers({ethusd, btcusd, INVALID_PAIR_ID, xrpusd, btcusd}, out));
+    CHECK_EQ(out.size(), size_t(5));
+    CHECK_EQ(out[0].text(Ticker::Last), std::string("2614.2"));
+    CHECK_EQ(out[0].text(Ticker::Volume), std::string("9821.04281539"));
+    CHECK_EQ(out[1].text(Ticker::Last), std::string("67412"));
+    CHECK_EQ(out[1].text(Ticker::PercentChange24), std::string("0.03"));
+    CHECK(out[2].empty());
+    CHECK_EQ(out[3].text(Ticker::Bid), std::string("0.54011"));
+    CHECK(!out[3].has(Ticker::Open24) && !out[3].has(Ticker::PercentChange24)); // null in the response
+    CHECK(out[3].isNull(Ticker::Open24) && out[3].isNull(Ticker::PercentChange24));
+    const std::string message = out[3].message("XRP/USD");
+    CHECK_EQ(message.substr(message.find(" << side")), std::string(" << side: 1 << open_24: null << percent_change_24: null"));
+    CHECK(same(out[4], out[1]));
+    CHECK_EQ(out[4].text(Ticker::Timestamp), std::string("1729166400"));
+
+    // The records hold what the single ticker endpoint decodes from the same objects
+    auto marketData = api.fetchMarketTickers({btcusd, ethusd, xrpusd});
+    CHECK_EQ(marketData.size(), size_t(3));
+    CHECK(same(Ticker::fromMap(marketData[btcusd]), out[1]));
+    CHECK(same(Ticker::fromMap(marketData[ethusd]), out[0]));
+    CHECK(same(Ticker::fromMap(marketData[xrpusd]), out[3]));
+
+    CHECK(api.fetchTickers({}, out));
+    CHECK(out.empty());
+}
+
+void testMalformedResponse() {
+    // The catalog is loaded from the complete response, the records from a truncated one
+    LoopbackServer complete(serveTickers(ALL_TICKERS));
+    BitstampApi loaded(5, complete.url("/"));
+    const PairId btcusd = loaded.pairId("btcusd");
+
+    LoopbackServer truncated(serveTickers(ALL_TICKERS.substr(0, ALL_TICKERS.find("ETH/USD"))));
+    BitstampApi api(5, truncated.url("/"));
+    std::vector<Ticker> out;
+    CHECK(!api.fetchTickers({btcusd}, out));
+    CHECK_EQ(out.size(), size_t(1));
+    CHECK(out[0].empty());
+}
+
+void testMessages() {
+    // Without a list of fields, the fields are printed in the order of their declaration
+    const std::string response = R"({"timestamp": "1729166400", "open": "67380", "high": "68424", "low": "66984", "last": "67412", "volume": "1523.61098052", "vwap": "67703", "bid": "67410", "ask": "67413", "side": "0", "open_24": "67390", "percent_change_24": "0.03"})";
+    const jMap marketData = JsonReader(response).get();
+    const Ticker record = Ticker::fromMap(marketData);
+    CHECK_EQ(record.message("BTC/USD"), std::string("BTC/USD << timestamp: 1729166400 << open: 67380 << high: 68424 << low: 66984 << last: 67412 << "
+                                                    "volume: 1523.61098052 << vwap: 67703 << bid: 67410 << ask: 67413 << side: 0 << open_24: 67390 << percent_change_24: 0.03"));
+    Ticker partial = record;
+    partial.select(Ticker::bit(Ticker::Bid) | Ticker::bit(Ticker::Ask));
+    CHECK_EQ(partial.message("BTC/USD"), std::string("BTC/USD << bid: 67410 << ask: 67413"));
+
+    // With a list of fields, the fields are printed in its order, the unknown and missing ones skipped
+    const std::vector<std::string> fields = {"bid", "pair", "volume", "ask", "unknown"};
+    CHECK_EQ(record.message("BTC/USD", Ticker::project(fields)), Utils::mapToMessage("BTC/USD", marketData, fields).str());
+}
+
+void testCandleSeries() {
+    LoopbackServer server(serveTickers(ALL_TICKERS));
+    BitstampApi api(5, server.url("/"));
+    const std::unordered_map<std::string, std::string> args{{"step", "60"}, {"limit", "3"}};
+
+    // The candles are decoded while received, into the columns asked for
+    const auto series = api.fetchCandleSeries("btcusd", args, CandleSeries::bit(CandleSeries::Close));
+    CHECK_EQ(series.size(), size_t(3));
+    CHECK_EQ(series.step(), int64_t(60));
+    CHECK(series.has(CandleSeries::Close) && !series.has(CandleSeries::Open));
+    CHECK_EQ(series.text(CandleSeries::Close, 0), std::string("57844.50")); // at the scale of the column
+    CHECK_EQ(series.text(CandleSeries::Close, 2), std::string("57871.25"));
+    CHECK(api.fetchCandleSeries("ethusd", args, CandleSeries::ALL).empty()); // truncated
+    CHECK_EQ(api.candlestickResolution(args), int64_t(60));
+    CHECK_EQ(api.candlestickResolution({{"limit", "3"}}), int64_t(0));
+
+    // The series lent to the request is handed back filled, or empty on failure
+    std::mutex mutex;
+    std::condition_variable done;
+    std::vector<CandleSeries> results;
+    auto collect = [&](CandleSeries result) {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+        done.notify_all();
+    };
+    CandleSeries lent = api.fetchCandleSeries("btcusd", args, CandleSeries::ALL);
+    api.fetchCandleSeriesIntoAsync("btcusd", args, std::move(lent), collect, CandleSeries::ALL);
+    api.fetchCandleSeriesIntoAsync("ethusd", args, CandleSeries{}, collect, CandleSeries::ALL);
+    std::unique_lock<std::mutex> lock(mutex);
+    CHECK(done.wait_for(lock, std::chrono::seconds(5), [&] {return results.size() == 2;}));
+    if (results.size() != 2) return;
+    const auto& filled = results[0].empty() ? results[1] : results[0];
+    CHECK_EQ(filled.size(), size_t(3));
+    CHECK_EQ(filled.text(CandleSeries::Volume, 1), std::string("3.04811362"));
+    CHECK_EQ(filled.text(CandleSeries::Open, 2), std::string("57881"));
+    CHECK(results[0].empty() != results[1].empty());
+}
+
+} // namespace
+
+int main() {
+    // The catalog caches the pairs under a temporary directory, not under the working directory
+    char directory[] = "/tmp/test_bitstamp_tickersXXXXXX";
+    if (::mkdtemp(directory) == nullptr) return 1;
+    TickerCatalog::setCacheDirectory(std::string(directory) + "/");
+    testAllPairsResponse();
+    testMalformedResponse();
+    testMessages();
+    testCandleSeries();
+    TickerCatalog::shutdown();
+    std::system(("rm -rf " + std::string(directory)).c_str());
+    return check::result();
+}
@@ -0,0 +1,82 @@
+#include "check.h"
+#include "fixtures.h"
+#include "../src/storage/candle_archive.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+using fixtures::candles;
+using fixtures::sameCandles;
+using fixtures::temporaryPath;
+
+void testRoundTrip() {
+    const std::string path = temporaryPath("round_trip");
+    std::remove(path.c_str());
+
+    // More than one block, appended in two parts whose first candle replaces the last one archived
+    const size_t n = CandleArchive::BLOCK_CANDLES + 300;
+    const CandleSeries series = candles(1700000000, n);
+    CandleSeries first = candles(1700000000, 700);
+    first.close.back() += 1;
+    size_t added = 0;
+    CHECK(CandleArchive::append(path, "btcusd", first, &added));
+    CHECK_EQ(added, size_t(700));
+    CHECK(CandleArchive::append(path, "btcusd", series, &added));
+    CHECK_EQ(added, n - 700);
+    CHECK(CandleArchive::append(path, "btcusd", series, &added));
+    CHECK_EQ(added, size_t(0));
+
+    CandleArchive archive;
+    CHECK(archive.open(path));
+    CHECK_EQ(archive.pair(), std::string("btcusd"));
+    CHECK_EQ(archive.resolution(), int64_t(60));
+    CHECK_EQ(archive.size(), n);
+
+    CandleSeries out;
+    CHECK(archive.read(INT64_MIN, INT64_MAX, out));
+    CHECK_EQ(out.size(), n);
+    CHECK(out.timestamp == series.timestamp);
+    CHECK(sameCandles(series, out));
+
+    // A range across the boundary of the blocks, and bounds between two candles
+    const int64_t from = series.timestamp[1000] - 30;
+    const int64_t to = series.timestamp[1100] + 30;
+    CHECK(archive.read(from, to, out));
+    CHECK_EQ(out.size(), size_t(101));
+    CHECK_EQ(out.timestamp.front(), series.timestamp[1000]);
+    CHECK(sameCandles(series, 1000, out));
+    CHECK_EQ(archive.lowerBound(from), size_t(1000));
+    CHECK(!archive.read(0, 1000, out));
+
+    // Another resolution, or a value with more decimals than the archive, is refused
+    archive.close();
+    CHECK(!CandleArchive::append(path, "btcusd", candles(1800000000, 3, 300)));
+    CandleSeries precise = candles(series.timestamp.back() + 60, 2);
+    precise.append({std::to_string(series.timestamp.back() + 180), "1.001", "1", "1", "1", "1"});
+    CHECK(!CandleArchive::append(path, "btcusd", precise));
+    CHECK(archive.open(path));
+    CHECK_EQ(archive.size(), n);
+    std::remove(path.c_str());
+}
+
+void testInvalid() {
+    const std::string path = temporaryPath("invalid");
+    FILE* file = std::fopen(path.c_str(), "w");
+    std::fputs("not an archive", file);
+    std::fclose(file);
+    CandleArchive archive;
+    CHECK(!archive.open(path));
+    CHECK(!CandleArchive::append(path, "btcusd", candles(0, 2)));
+    CHECK(!archive.open(temporaryPath("missing")));
+    std::remove(path.c_str());
+}
+
+} // namespace
+
+int main() {
+    testRoundTrip();
+    testInvalid();
+    return check::result();
+}
@@ -0,0 +1,104 @@
+#include "check.h"
+#include "fixtures.h"
+#include "../src/api/candle_series.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Candles of one minute from time (see fixtures::candles), with a close of close + i (with the decimals given)
+CandleSeries closes(int64_t time, size_t n, const std::string& close = "100") {
+    return fixtures::candles(time, n, 60, [&close](size_t i) {return std::to_string(i) + close;});
+}
+
+std::vector<int64_t> times(int64_t time, size_t n) {
+    std::vector<int64_t> out;
+    for (size_t i = 0; i < n; ++i) out.push_back(time + 60 * static_cast<int64_t>(i));
+    return out;
+}
+
+void testReplaceAndAppend() {
+    CandleSeries series = closes(0, 5);
+    // The last candle (still open) is replaced, and two are appended
+    CandleSeries newer = closes(240, 3, "200");
+    CHECK(series.merge(newer, 100));
+    CHECK(series.timestamp == times(0, 7));
+    CHECK_EQ(series.text(CandleSeries::Close, 3), std::string("3100"));
+    CHECK_EQ(series.text(CandleSeries::Close, 4), std::string("200"));
+    CHECK_EQ(series.text(CandleSeries::Close, 6), std::string("2200"));
+
+    // The candles matched in the middle are replaced as well
+    CHECK(series.merge(closes(60, 2, "300"), 100));
+    CHECK(series.timestamp == times(0, 7));
+    CHECK_EQ(series.text(CandleSeries::Close, 2), std::string("1300"));
+    CHECK_EQ(series.text(CandleSeries::Close, 3), std::string("3100"));
+}
+
+void testWindow() {
+    CandleSeries series = closes(0, 5);
+    CHECK(series.merge(closes(240, 4), 5));
+    CHECK(series.timestamp == times(180, 5));
+    CHECK_EQ(series.size(), series.close.size());
+    CHECK_EQ(series.size(), series.volume.size());
+    // Without a window, the series keeps its size
+    CHECK(series.merge(closes(420, 3)));
+    CHECK(series.timestamp == times(300, 5));
+}
+
+void testScales() {
+    CandleSeries series = closes(0, 3);
+    CHECK(series.merge(closes(120, 2, "100.25"), 100));
+    CHECK_EQ(unsigned(series.scale[CandleSeries::Close]), 2u);
+    CHECK_EQ(series.close[0], int64_t(10000));
+    CHECK_EQ(series.close[3], int64_t(110025));
+    CHECK_EQ(series.text(CandleSeries::Close, 3), std::string("1100.25"));
+    // A newer series of a lower scale is converted to the scale of the series
+    CHECK(series.merge(closes(180, 1, "7"), 100));
+    CHECK_EQ(series.close[3], int64_t(700));
+}
+
+void testFailures() {
+    const CandleSeries original = closes(600, 4);
+    auto unchanged = [&](const CandleSeries& series) {
+        return series.timestamp == original.timestamp && series.close == original.close && series.scale[CandleSeries::Close] == original.scale[CandleSeries::Close];
+    };
+
+    CandleSeries series = original;
+    CHECK(!series.merge(CandleSeries()));
+    CHECK(!series.merge(closes(0, 2)));            // older than the series, no overlap
+    CHECK(!series.merge(closes(900, 2)));          // a gap: after the last candle
+    CHECK(unchanged(series));
+
+    CandleSeries shifted = closes(630, 2);         // not aligned with the candles held
+    CHECK(!series.merge(shifted));
+    CHECK(unchanged(series));
+
+    CandleSeries unordered;
+    unordered.append({"780", "1", "1", "1", "1", "1"});
+    unordered.append({"840", "1", "1", "1", "1", "1"});
+    unordered.append({"840", "1", "1", "1", "1", "1"});
+    CHECK(!series.merge(unordered));
+    CHECK(unchanged(series));
+
+    CandleSeries fewer = closes(780, 2);
+    fewer.select(CandleSeries::bit(CandleSeries::Timestamp) | CandleSeries::bit(CandleSeries::Close));
+    CHECK(!series.merge(fewer));                    // other columns
+    CHECK(unchanged(series));
+
+    // A scale which the values held do not fit leaves the series unchanged
+    CandleSeries huge;
+    huge.append({"780", "100", "110", "90", "1.000000000000000001", "2.5"});
+    CHECK(!series.merge(huge));
+    CHECK(unchanged(series));
+}
+
+} // namespace
+
+int main() {
+    testReplaceAndAppend();
+    testWindow();
+    testScales();
+    testFailures();
+    return check::result();
+}
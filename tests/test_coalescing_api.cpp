@@ -0,0 +1,206 @@
+#include "check.h"
+#include "../src/api/coalescing_api.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void waitFor(const std::function<bool()>& condition) {
+    for (int i = 0; i < 500 && !condition(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+/*
+ * Api counting the requests it receives. The requests block until the gate is opened, so that the
+ * identical requests of the other callers arrive while the first one is in flight; the asynchronous
+ * ticker requests are answered by reply.
+ */
+class CountingApi : public Api {
+
+public:
+    explicit CountingApi(std::string source): source_(std::move(source)) {}
+
+    std::atomic<int> calls{0};
+
+    void open() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        opened_.notify_all();
+    }
+
+    // Answers the pending asynchronous ticker requests
+    void reply() {
+        std::vector<std::function<void(Ticker)>> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            callbacks.swap(pending_);
+        }
+        Ticker ticker;
+        ticker.set(Ticker::Last, "57844.5");
+        for (auto& callback: callbacks) callback(ticker);
+    }
+
+    int getMaxConnectionTime() const override {return 5;}
+    void setMaxConnectionTime(int) override {}
+    DataMapVec fetchCurrencyData() override {return {};}
+    DataMapVec fetchAllPairs() override {return {};}
+    DataMap fetchMarketTicker(const std::string& ticker) override {
+        const int call = ++calls;
+        wait();
+        if (ticker.empty()) throw std::invalid_argument("no pair");
+        return {{"pair", ticker}, {"call", std::to_string(call)}};
+    }
+    DataMap fetchHourlyTicker(const std::string&) override {return {};}
+    DataMapVec fetchCandlestickData(const std::string&, const std::unordered_map<std::string,std::string>&) override {return {};}
+    CandleSeries fetchCandleSeries(
+        const std::string&,
+        const std::unordered_map<std::string,std::string>& otherArgs,
+        CandleSeries::Mask columns
+    ) override {
+        ++calls;
+        wait();
+        // Two candles one step apart
+        const std::string candle = "\"open\": \"57700\", \"high\": \"57950\", \"low\": \"57650\", \"close\": \"57844\", \"volume\": \"12.5\"}";
+        const int64_t step = std::stoll(otherArgs.at("step"));
+        CandleSeries series;
+        series.parse("[{\"timestamp\": \"1720719600\", " + candle + ", {\"timestamp\": \"" + std::to_string(1720719600 + step) + "\", " + candle + "]", columns);
+        return series;
+    }
+    void fetchTickerAsync(const std::string&, std::function<void(Ticker)> callback) override {
+        ++calls;
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(callback));
+    }
+    std::vector<std::string> fetchAllTickers() override {return {};}
+    std::string makePair(const std::string& cryptoSymbol, const std::string& fiatSymbol) const override {return cryptoSymbol + fiatSymbol;}
+    bool validatePair(const std::string&) const override {return true;}
+    std::string getSource() const override {return source_;}
+
+private:
+    std::string source_;
+    std::mutex mutex_;
+    std::condition_variable opened_;
+    bool open_ = false;
+    std::vector<std::function<void(Ticker)>> pending_;
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        opened_.wait(lock, [this] {return open_;});
+    }
+};
+
+void testConcurrentCalls() {
+    const int callers = 8;
+    auto* upstream = new CountingApi("counting://concurrent");
+    CoalescingApi api{std::unique_ptr<Api>(upstream)};
+
+    std::vector<DataMap> results(callers);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < callers; ++i) threads.emplace_back([&, i] {results[i] = api.fetchMarketTicker("btcusd");});
+    // Every caller but the first one joins the request in flight
+    waitFor([&] {return api.stats().deduplicated == callers - 1;});
+    upstream->open();
+    for (auto& thread: threads) thread.join();
+
+    CHECK_EQ(upstream->calls.load(), 1);
+    CHECK_EQ(api.stats().requests, uint64_t(callers));
+    CHECK_EQ(api.stats().deduplicated, uint64_t(callers - 1));
+    for (const auto& result: results) CHECK(result == (DataMap{{"pair", "btcusd"}, {"call", "1"}}));
+
+    // The key is released with the result: a later call is a new request
+    CHECK_EQ(api.fetchMarketTicker("btcusd").at("call"), std::string("2"));
+    CHECK_EQ(api.stats().deduplicated, uint64_t(callers - 1));
+}
+
+void testDistinctCalls() {
+    const CandleSeries::Mask CLOSE = CandleSeries::bit(CandleSeries::Close);
+    auto* upstream = new CountingApi("counting://distinct");
+    CoalescingApi api{std::unique_ptr<Api>(upstream)};
+
+    // Different columns, different arguments and different pairs are distinct requests, in flight together
+    std::vector<CandleSeries> series(4);
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {series[0] = api.fetchCandleSeries("btcusd", {{"step", "60"}, {"limit", "10"}}, CandleSeries::ALL);});
+    threads.emplace_back([&] {series[1] = api.fetchCandleSeries("btcusd", {{"step", "60"}, {"limit", "10"}}, CLOSE);});
+    threads.emplace_back([&] {series[2] = api.fetchCandleSeries("btcusd", {{"step", "3600"}, {"limit", "10"}}, CandleSeries::ALL);});
+    threads.emplace_back([&] {series[3] = api.fetchCandleSeries("ethusd", {{"step", "60"}, {"limit", "10"}}, CandleSeries::ALL);});
+    waitFor([&] {return upstream->calls.load() == 4;});
+    CHECK_EQ(upstream->calls.load(), 4);
+    // The same arguments in another order are the same request
+    std::thread same([&] {api.fetchCandleSeries("btcusd", {{"limit", "10"}, {"step", "60"}}, CandleSeries::ALL);});
+    waitFor([&] {return api.stats().deduplicated == 1;});
+    upstream->open();
+    for (auto& thread: threads) thread.join();
+    same.join();
+
+    CHECK_EQ(upstream->calls.load(), 4);
+    CHECK_EQ(api.stats().requests, uint64_t(5));
+    CHECK_EQ(api.stats().deduplicated, uint64_t(1));
+    CHECK(series[0].has(CandleSeries::Open));
+    CHECK(series[1].has(CandleSeries::Close) && !series[1].has(CandleSeries::Open));
+    CHECK_EQ(series[2].step(), int64_t(3600));
+    CHECK_EQ(CoalescingApi::canonicalArgs({{"step", "60"}, {"limit", "10"}}), std::string("limit=10&step=60"));
+
+    // Another source does not share the requests of the first one
+    auto* other = new CountingApi("counting://other");
+    other->open();
+    CoalescingApi otherApi{std::unique_ptr<Api>(other)};
+    otherApi.fetchCandleSeries("btcusd", {{"step", "60"}, {"limit", "10"}}, CandleSeries::ALL);
+    CHECK_EQ(other->calls.load(), 1);
+    CHECK_EQ(otherApi.stats().deduplicated, uint64_t(0));
+}
+
+void testAsyncCalls() {
+    const int callers = 5;
+    auto* upstream = new CountingApi("counting://async");
+    CoalescingApi api{std::unique_ptr<Api>(upstream)};
+
+    std::vector<Ticker> results;
+    for (int i = 0; i < callers; ++i) api.fetchTickerAsync("btcusd", [&](Ticker ticker) {results.push_back(ticker);});
+    CHECK_EQ(upstream->calls.load(), 1);
+    CHECK_EQ(api.stats().deduplicated, uint64_t(callers - 1));
+    CHECK(results.empty());
+    upstream->reply();
+    CHECK_EQ(results.size(), size_t(callers));
+    for (const auto& ticker: results) CHECK_EQ(ticker.text(Ticker::Last), std::string("57844.5"));
+}
+
+void testErrors() {
+    // The callers joining a request which throws receive its exception
+    const int callers = 3;
+    auto* upstream = new CountingApi("counting://errors");
+    CoalescingApi api{std::unique_ptr<Api>(upstream)};
+    std::atomic<int> errors{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < callers; ++i) {
+        threads.emplace_back([&] {
+            try {
+                api.fetchMarketTicker("");
+            } catch (const std::invalid_argument&) {
+                ++errors;
+            }
+        });
+    }
+    waitFor([&] {return api.stats().deduplicated == callers - 1;});
+    upstream->open();
+    for (auto& thread: threads) thread.join();
+    CHECK_EQ(upstream->calls.load(), 1);
+    CHECK_EQ(errors.load(), callers);
+}
+
+} // namespace
+
+int main() {
+    testConcurrentCalls();
+    testDistinctCalls();
+    testAsyncCalls();
+    testErrors();
+    return check::result();
+}
@@ -0,0 +1,230 @@
+#include "check.h"
+#include "loopback_server.h"
+#include "../src/api/async_http_client.h"
+#include "../src/api/connection_pool.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Holds the connections open until the client closes them
+void hold(int fd) {
+    char buffer[256];
+    while (::recv(fd, buffer, sizeof(buffer), 0) > 0) {}
+}
+
+Url url(const LoopbackServer& server) {
+    Url parsed;
+    Url::parse(server.url(), parsed);
+    return parsed;
+}
+
+std::unique_ptr<Connection> checkout(ConnectionPool& pool, const Url& url, bool& reused, int seconds = 5) {
+    std::string error;
+    return pool.checkout(url, Deadline::in(seconds), reused, error);
+}
+
+void waitFor(const std::function<bool()>& condition) {
+    for (int i = 0; i < 500 && !condition(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+void testReuse() {
+    LoopbackServer server(hold);
+    ConnectionPool pool;
+    CHECK_EQ(pool.getMaxConnectionsPerHost(), size_t(8));
+    CHECK_EQ(pool.getIdleTimeout(), 60);
+    const Url host = url(server);
+
+    bool reused = true;
+    auto connection = checkout(pool, host, reused);
+    CHECK(connection != nullptr && !reused);
+    const int fd = connection->fd();
+    pool.checkin(std::move(connection), true);
+    CHECK_EQ(pool.idleConnections(host.hostKey()), size_t(1));
+
+    connection = checkout(pool, host, reused);
+    CHECK(connection != nullptr && reused);
+    CHECK_EQ(connection->fd(), fd);
+    // A connection given back without keep-alive is closed
+    pool.checkin(std::move(connection), false);
+    CHECK_EQ(pool.idleConnections(host.hostKey()), size_t(0));
+    connection = checkout(pool, host, reused);
+    CHECK(connection != nullptr && !reused);
+    pool.checkin(std::move(connection), true);
+
+    const auto stats = pool.stats();
+    CHECK_EQ(stats.hits, uint64_t(1));
+    CHECK_EQ(stats.misses, uint64_t(2));
+    CHECK_EQ(stats.waits, uint64_t(0));
+    waitFor([&] {return server.accepted() == 2;});
+    CHECK_EQ(server.accepted(), size_t(2));
+}
+
+void testHostCapAndFifo() {
+    LoopbackServer server(hold);
+    ConnectionPool pool;
+    const Url host = url(server);
+    std::vector<std::unique_ptr<Connection>> held;
+    bool reused;
+    for (int i = 0; i < 8; ++i) held.push_back(checkout(pool, host, reused));
+    for (const auto& connection: held) CHECK(connection != nullptr);
+
+    // A ninth connection is not opened: the checkout waits, and fails with its deadline
+    std::string error;
+    CHECK(pool.checkout(host, Deadline::in(1), reused, error) == nullptr);
+    CHECK_EQ(error, std::string("timeout while waiting for a connection"));
+    CHECK_EQ(server.accepted(), size_t(8));
+
+    // The waiting threads are served in their order of arrival
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<std::thread> waiters;
+    for (int k = 0; k < 3; ++k) {
+        waiters.emplace_back([&, k] {
+            bool reused = false;
+            auto connection = checkout(pool, host, reused, 10);
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(reused ? k : -1);
+            held.push_back(std::move(connection));
+        });
+        waitFor([&] {return pool.stats().waits == uint64_t(k + 2);});
+    }
+    for (int k = 0; k < 3; ++k) {
+        std::unique_ptr<Connection> connection;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            connection = std::move(held[static_cast<size_t>(k)]);
+        }
+        pool.checkin(std::move(connection), true);
+        waitFor([&] {std::lock_guard<std::mutex> lock(mutex); return order.size() == static_cast<size_t>(k + 1);});
+    }
+    for (auto& waiter: waiters) waiter.join();
+    CHECK(order == std::vector<int>({0, 1, 2}));
+    CHECK_EQ(server.accepted(), size_t(8));
+    const auto stats = pool.stats();
+    CHECK_EQ(stats.waits, uint64_t(4));
+    CHECK_EQ(stats.hits, uint64_t(3));
+    CHECK(stats.maxWaitUs > 0);
+
+    // A larger cap lets the waiting threads open new connections
+    pool.setMaxConnectionsPerHost(9);
+    auto ninth = checkout(pool, host, reused, 1);
+    CHECK(ninth != nullptr && !reused);
+    pool.checkin(std::move(ninth), false);
+    for (auto& connection: held) pool.checkin(std::move(connection), true);
+}
+
+void testEviction() {
+    LoopbackServer server(hold);
+    ConnectionPool pool(8, 1);
+    const Url host = url(server);
+    bool reused;
+    pool.checkin(checkout(pool, host, reused), true);
+    pool.checkin(checkout(pool, host, reused), true);
+    CHECK(reused);
+    // Idle for longer than the timeout: closed at the next checkout
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    auto connection = checkout(pool, host, reused);
+    CHECK(connection != nullptr && !reused);
+    CHECK_EQ(pool.stats().evictions, uint64_t(1));
+    pool.checkin(std::move(connection), true);
+
+    // A connection closed by the server while idle is not handed out
+    LoopbackServer closing([](int) {});
+    const Url other = url(closing);
+    pool.checkin(checkout(pool, other, reused), true);
+    waitFor([&] {return closing.accepted() == 1;});
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    connection = checkout(pool, other, reused);
+    CHECK(connection != nullptr && !reused);
+    CHECK_EQ(pool.stats().evictions, uint64_t(2));
+    pool.checkin(std::move(connection), false);
+
+    pool.clear();
+    CHECK_EQ(pool.idleConnections(host.hostKey()), size_t(0));
+    pool.checkin(checkout(pool, host, reused), true);
+    CHECK(!reused);
+}
+
+// The requests of the event loop go through the pool: same cap, same idle connections, same stats
+void testAsyncCheckouts() {
+    LoopbackServer server(LoopbackServer::serve([](const std::string&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return LoopbackServer::response("{}");
+    }));
+    ConnectionPool pool(2, 60);
+    const Url host = url(server);
+    std::atomic<int> completed{0};
+    std::atomic<int> succeeded{0};
+    {
+        AsyncHttpClient client(pool);
+        for (int i = 0; i < 10; ++i) {
+            client.get(server.url(), {}, Deadline::in(5), [&](HttpResponse response) {
+                if (response.ok() && response.body == "{}") ++succeeded;
+                ++completed;
+            });
+        }
+        waitFor([&] {return completed.load() == 10;});
+        CHECK_EQ(succeeded.load(), 10);
+        CHECK_EQ(server.accepted(), size_t(2));
+        auto stats = pool.stats();
+        CHECK_EQ(stats.misses, uint64_t(2));
+        CHECK_EQ(stats.hits, uint64_t(8));
+        CHECK(stats.waits >= uint64_t(8));
+        CHECK_EQ(pool.idleConnections(host.hostKey()), size_t(2));
+
+        // Both connections are taken by threads: the request waits in the pool until one is given back
+        bool reused;
+        auto first = checkout(pool, host, reused);
+        auto second = checkout(pool, host, reused);
+        CHECK(reused);
+        client.get(server.url(), {}, Deadline::in(5), [&](HttpResponse response) {
+            if (response.ok()) ++succeeded;
+            ++completed;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK_EQ(completed.load(), 10);
+        pool.checkin(std::move(first), true);
+        waitFor([&] {return completed.load() == 11;});
+        CHECK_EQ(succeeded.load(), 11);
+        pool.checkin(std::move(second), true);
+
+        // A thread reuses the connection the request gave back
+        first = checkout(pool, host, reused);
+        CHECK(first != nullptr && reused);
+        pool.checkin(std::move(first), true);
+        CHECK_EQ(server.accepted(), size_t(2));
+
+        // A request expiring while it waits leaves the queue of the pool
+        first = checkout(pool, host, reused);
+        second = checkout(pool, host, reused);
+        client.get(server.url(), {}, Deadline::in(1), [&](HttpResponse response) {
+            if (response.error == "timeout") ++succeeded;
+            ++completed;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+        CHECK_EQ(completed.load(), 12);
+        CHECK_EQ(succeeded.load(), 12);
+        pool.checkin(std::move(first), true);
+        auto third = checkout(pool, host, reused, 1);
+        CHECK(third != nullptr && reused);
+        pool.checkin(std::move(third), true);
+        pool.checkin(std::move(second), true);
+    }
+}
+
+} // namespace
+
+int main() {
+    testReuse();
+    testHostCapAndFifo();
+    testEviction();
+    testAsyncCheckouts();
+    return check::result();
+}
@@ -0,0 +1,102 @@
+#include "check.h"
+#include "../src/api/candle_series.h"
+#include "../src/utils/decimal.h"
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace {
+
+int64_t parse(const std::string& text, unsigned scale) {
+    int64_t units = CandleSeries::MISSING;
+    return Decimal::parse(text, scale, units) ? units : CandleSeries::MISSING;
+}
+
+void testParse() {
+    CHECK_EQ(parse("57844.5", 8), int64_t(5784450000000));
+    CHECK_EQ(parse("-0.07330", 5), int64_t(-7330));
+    CHECK_EQ(parse("+12", 0), int64_t(12));
+    CHECK_EQ(parse(".5", 1), int64_t(5));
+    CHECK_EQ(parse("5.", 1), int64_t(50));
+    CHECK_EQ(parse("1.2300000000", 2), int64_t(123));             // trailing zeros beyond the scale
+    CHECK_EQ(parse("12345678.87654321", 8), int64_t(1234567887654321)); // the 8-digit (SWAR) path
+    CHECK_EQ(parse("00000000000000000000001.5", 1), int64_t(15));  // more than 19 digits, leading zeros
+    CHECK_EQ(parse("9223372036854775807", 0), std::numeric_limits<int64_t>::max());
+    CHECK_EQ(parse("-9223372036854775808", 0), std::numeric_limits<int64_t>::min());
+
+    // Not decimals, significant digits beyond the scale, overflows
+    for (const char* text: {"", "-", ".", "1e5", "1.2.3", "12a", " 1", "0x10", "NaN"}) CHECK_EQ(parse(text, 2), CandleSeries::MISSING);
+    CHECK_EQ(parse("1.234", 2), CandleSeries::MISSING);
+    CHECK_EQ(parse("9223372036854775808", 0), CandleSeries::MISSING);
+    CHECK_EQ(parse("92233720368547758.08", 3), CandleSeries::MISSING);
+    CHECK_EQ(parse("1", Decimal::MAX_SCALE + 1), CandleSeries::MISSING);
+
+    CHECK_EQ(Decimal::decimals("70.00"), 2u);
+    CHECK_EQ(Decimal::decimals("70"), 0u);
+}
+
+void testFormat() {
+    CHECK_EQ(Decimal::toString(12345, 2, 0), std::string("123.45"));
+    CHECK_EQ(Decimal::toString(7000, 2, 2), std::string("70.00"));
+    CHECK_EQ(Decimal::toString(7000, 2, 0), std::string("70"));
+    CHECK_EQ(Decimal::toString(-7330, 5, 5), std::string("-0.07330"));
+    CHECK_EQ(Decimal::toString(5, 0, 3), std::string("5.000"));
+    CHECK_EQ(Decimal::toString(std::numeric_limits<int64_t>::min(), 0), std::string("-9223372036854775808"));
+
+    // Parsing and formatting with the decimals received gives back the text
+    for (const char* text: {"57844.5", "0.00012345", "-3.10", "1000000", "0.1"}) {
+        CHECK_EQ(Decimal::toString(parse(text, 8), 8, Decimal::decimals(text)), std::string(text));
+    }
+}
+
+void testRescale() {
+    int64_t out = 0;
+    CHECK(Decimal::rescale(123, 2, 5, out));
+    CHECK_EQ(out, int64_t(123000));
+    CHECK(Decimal::rescale(123000, 5, 2, out));
+    CHECK_EQ(out, int64_t(123));
+    CHECK(!Decimal::rescale(123001, 5, 2, out));                 // nonzero digits would be dropped
+    CHECK(!Decimal::rescale(std::numeric_limits<int64_t>::max() / 10 + 1, 0, 1, out)); // overflow
+    CHECK(!Decimal::rescale(1, 0, Decimal::MAX_SCALE + 1, out));
+}
+
+void testSeriesRescale() {
+    CandleSeries series;
+    series.append({"1721664000", "67530", "68200.5", "66911", "67840.12", "1.5"});
+    CHECK_EQ(unsigned(series.scale[CandleSeries::Close]), 2u);
+    CHECK_EQ(series.close[0], int64_t(6784012));
+    CHECK_EQ(series.high[0], int64_t(682005));
+
+    // A value with more decimals rescales its column; the values keep their text
+    series.append({"1721664060", "67530", "68200.25", "66911", "67841", "0.00012345"});
+    CHECK_EQ(unsigned(series.scale[CandleSeries::High]), 2u);
+    CHECK_EQ(series.high[0], int64_t(6820050));
+    CHECK_EQ(series.text(CandleSeries::High, 0), std::string("68200.50"));
+    CHECK_EQ(series.text(CandleSeries::Volume, 1), std::string("0.00012345"));
+    CHECK_EQ(series.volume[0], int64_t(150000000));
+
+    CHECK(series.rescale(CandleSeries::Close, 8));
+    CHECK_EQ(series.close[1], int64_t(6784100000000));
+    CHECK(series.rescale(CandleSeries::Close, 2));
+    CHECK_EQ(series.close[0], int64_t(6784012));
+    // The column is left unchanged if a value cannot be converted
+    CHECK(!series.rescale(CandleSeries::Close, 1));
+    CHECK_EQ(unsigned(series.scale[CandleSeries::Close]), 2u);
+    CHECK_EQ(series.close[0], int64_t(6784012));
+    CHECK(!series.rescale(CandleSeries::Timestamp, 2));
+
+    // An invalid value is missing, and formatted as empty
+    series.append({"1721664120", "x", "", "66911", "67841", "1"});
+    CHECK_EQ(series.open[2], CandleSeries::MISSING);
+    CHECK(series.text(CandleSeries::Open, 2).empty());
+}
+
+} // namespace
+
+int main() {
+    testParse();
+    testFormat();
+    testRescale();
+    testSeriesRescale();
+    return check::result();
+}
@@ -0,0 +1,168 @@
+#include "check.h"
+#include "loopback_server.h"
+#include "../src/api/async_http_client.h"
+#include "../src/api/connection_pool.h"
+#include "../src/api/hedging_http_client.h"
+#include "../src/api/request_scheduler.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Endpoint = HedgingHttpClient::Endpoint;
+using Lane = HedgingHttpClient::Lane;
+
+// A scheduler admitting every request at once
+void unlimited(RequestScheduler& scheduler) {
+    scheduler.setGlobalBudget(RequestScheduler::Budget{0, 1});
+    for (const auto endpoint: {Endpoint::Ticker, Endpoint::Ohlc, Endpoint::Catalog}) scheduler.setBudget(endpoint, RequestScheduler::Budget{0, 1});
+}
+
+// Bodies of the attempts of a request, one per attempt
+struct Bodies {
+    std::mutex mutex;
+    std::vector<std::string> bodies;
+
+    HedgingHttpClient::SinkFactory sinks() {
+        return [this](size_t attempt) -> HttpResponseParser::BodySink {
+            std::lock_guard<std::mutex> lock(mutex);
+            bodies.resize(std::max(bodies.size(), attempt + 1));
+            return [this, attempt](const char* data, size_t size) {
+                std::lock_guard<std::mutex> lock(mutex);
+                bodies[attempt].append(data, size);
+            };
+        };
+    }
+};
+
+void testHedgeWins() {
+    // The first request is held by the server; the following ones are answered at once
+    std::atomic<int> requests{0};
+    std::atomic<bool> release{false};
+    LoopbackServer server([&](int fd) {
+        std::string buffer, head;
+        while (LoopbackServer::readRequest(fd, buffer, head)) {
+            if (++requests == 1) {
+                for (int i = 0; i < 500 && !release.load(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                LoopbackServer::writeAll(fd, LoopbackServer::response("slow"));
+            } else {
+                LoopbackServer::writeAll(fd, LoopbackServer::response("fast"));
+            }
+        }
+    });
+    ConnectionPool pool;
+    AsyncHttpClient client(pool);
+    RequestScheduler scheduler;
+    unlimited(scheduler);
+    HedgingHttpClient hedging(client, scheduler);
+    HedgingHttpClient::Policy policy;
+    policy.maxHedgeDelay = std::chrono::milliseconds(100); // the delay until enough latencies are recorded
+    hedging.setPolicy(Endpoint::Ticker, policy);
+
+    Bodies bodies;
+    size_t attempt = 0;
+    const auto start = std::chrono::steady_clock::now();
+    const auto response = hedging.request(Endpoint::Ticker, Lane::Live, server.url("/ticker/"), {}, 5, bodies.sinks(), attempt);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    release = true;
+
+    // The hedge was sent after the hedge delay, on another connection, and its response won
+    CHECK(response.ok());
+    CHECK_EQ(attempt, size_t(1));
+    CHECK_EQ(bodies.bodies.size(), size_t(2));
+    CHECK_EQ(bodies.bodies[1], std::string("fast"));
+    CHECK(bodies.bodies[0].empty());
+    CHECK(elapsed >= std::chrono::milliseconds(100) && elapsed < std::chrono::seconds(2));
+    CHECK_EQ(server.accepted(), size_t(2));
+
+    const auto stats = hedging.stats(Endpoint::Ticker);
+    CHECK_EQ(stats.requests, uint64_t(1));
+    CHECK_EQ(stats.attempts, uint64_t(2));
+    CHECK_EQ(stats.hedges, uint64_t(1));
+    CHECK_EQ(stats.hedgeWins, uint64_t(1));
+    CHECK_EQ(stats.failures, uint64_t(0));
+
+    // The latencies are recorded per endpoint class: the winner and the abandoned attempt, for one request
+    CHECK_EQ(hedging.attemptLatencies(Endpoint::Ticker).count(), uint64_t(2));
+    CHECK_EQ(hedging.requestLatencies(Endpoint::Ticker).count(), uint64_t(1));
+    CHECK(hedging.requestLatencies(Endpoint::Ticker).maxMs() >= 100);
+    CHECK_EQ(hedging.attemptLatencies(Endpoint::Ohlc).count(), uint64_t(0));
+    CHECK_EQ(hedging.requestLatencies(Endpoint::Ohlc).count(), uint64_t(0));
+    CHECK(hedging.report().find("ticker: requests n=1 ") == 0);
+    CHECK(hedging.report().find("ohlc") == std::string::npos);
+
+    // Fast responses are not hedged
+    const auto fast = hedging.request(Endpoint::Ticker, Lane::Live, server.url("/ticker/"), {}, 5, nullptr, attempt);
+    CHECK(fast.ok());
+    CHECK_EQ(fast.body, std::string("fast"));
+    CHECK_EQ(attempt, size_t(0));
+    CHECK_EQ(hedging.stats(Endpoint::Ticker).hedges, uint64_t(1));
+    CHECK_EQ(hedging.requestLatencies(Endpoint::Ticker).count(), uint64_t(2));
+}
+
+void testRetries() {
+    // The server closes the first connections without answering
+    std::atomic<int> failing{2};
+    LoopbackServer server([&](int fd) {
+        std::string buffer, head;
+        if (!LoopbackServer::readRequest(fd, buffer, head) || failing-- > 0) return;
+        LoopbackServer::writeAll(fd, LoopbackServer::response("ohlc", "Connection: close\r\n"));
+    });
+    ConnectionPool pool;
+    AsyncHttpClient client(pool);
+    RequestScheduler scheduler;
+    unlimited(scheduler);
+    HedgingHttpClient hedging(client, scheduler);
+    HedgingHttpClient::Policy policy;
+    policy.hedge = false;
+    policy.maxRetries = 2;
+    policy.retryBackoff = std::chrono::milliseconds(10);
+    hedging.setPolicy(Endpoint::Ohlc, policy);
+
+    // Two transport errors, then the response: the last retry wins
+    size_t attempt = 0;
+    auto response = hedging.request(Endpoint::Ohlc, Lane::Backfill, server.url("/ohlc/"), {}, 5, nullptr, attempt);
+    CHECK(response.ok());
+    CHECK_EQ(response.body, std::string("ohlc"));
+    CHECK_EQ(attempt, size_t(2));
+    CHECK_EQ(server.accepted(), size_t(3));
+    auto stats = hedging.stats(Endpoint::Ohlc);
+    CHECK_EQ(stats.attempts, uint64_t(3));
+    CHECK_EQ(stats.retries, uint64_t(2));
+    CHECK_EQ(stats.failures, uint64_t(0));
+
+    // Three transport errors: the request fails once its retries are spent
+    failing = 3;
+    response = hedging.request(Endpoint::Ohlc, Lane::Backfill, server.url("/ohlc/"), {}, 5, nullptr, attempt);
+    CHECK(!response.ok());
+    CHECK(!response.error.empty());
+    CHECK_EQ(attempt, size_t(2));
+    CHECK_EQ(server.accepted(), size_t(6));
+    stats = hedging.stats(Endpoint::Ohlc);
+    CHECK_EQ(stats.requests, uint64_t(2));
+    CHECK_EQ(stats.attempts, uint64_t(6));
+    CHECK_EQ(stats.retries, uint64_t(4));
+    CHECK_EQ(stats.failures, uint64_t(1));
+    CHECK_EQ(stats.hedges, uint64_t(0));
+    // The failed attempts have no latency; the requests do
+    CHECK_EQ(hedging.attemptLatencies(Endpoint::Ohlc).count(), uint64_t(1));
+    CHECK_EQ(hedging.requestLatencies(Endpoint::Ohlc).count(), uint64_t(2));
+    CHECK_EQ(hedging.stats(Endpoint::Ticker).requests, uint64_t(0));
+
+    // The scheduler shut down: the request is cancelled
+    scheduler.shutdown();
+    response = hedging.request(Endpoint::Ohlc, Lane::Backfill, server.url("/ohlc/"), {}, 5, nullptr, attempt);
+    CHECK_EQ(response.error, std::string("cancelled"));
+}
+
+} // namespace
+
+int main() {
+    testHedgeWins();
+    testRetries();
+    return check::result();
+}
@@ -0,0 +1,267 @@
+#include "check.h"
+#include "loopback_server.h"
+#include "../src/api/connection_pool.h"
+#include "../src/api/http_client.h"
+#include "../src/api/web_requests.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#ifdef CMDF_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// Target of a request head, e.g. "/ticker" for "GET /ticker HTTP/1.1"
+std::string target(const std::string& head) {
+    const size_t begin = head.find(' ') + 1;
+    return head.substr(begin, head.find(' ', begin) - begin);
+}
+
+void testKeepAlive() {
+    LoopbackServer server(LoopbackServer::serve([](const std::string& head) {return LoopbackServer::response("body of " + target(head));}));
+    ConnectionPool pool;
+    HttpClient client(pool);
+    for (const char* path: {"/a", "/b?x=1", "/c"}) {
+        const auto response = client.get(server.url(path), {"User-Agent: test"}, Deadline::in(5));
+        CHECK(response.ok());
+        CHECK_EQ(response.status, 200);
+        CHECK_EQ(response.body, "body of " + std::string(path));
+    }
+    // The three requests went through the same connection
+    CHECK_EQ(server.accepted(), size_t(1));
+    CHECK_EQ(pool.stats().misses, uint64_t(1));
+    CHECK_EQ(pool.stats().hits, uint64_t(2));
+}
+
+void testRequestHead() {
+    std::string received;
+    LoopbackServer server(LoopbackServer::serve([&](const std::string& head) {
+        received = head;
+        return LoopbackServer::response("");
+    }));
+    ConnectionPool pool;
+    HttpClient client(pool);
+    CHECK(client.get(server.url("/v2/ticker/btcusd/"), {"User-Agent: Mozilla/5.0"}, Deadline::in(5)).ok());
+    CHECK_EQ(received.rfind("GET /v2/ticker/btcusd/ HTTP/1.1\r\n", 0), size_t(0));
+    CHECK(received.find("Host: 127.0.0.1:" + std::to_string(server.port()) + "\r\n") != std::string::npos);
+    CHECK(received.find("User-Agent: Mozilla/5.0\r\n") != std::string::npos);
+    CHECK(received.find("Connection: keep-alive\r\n") != std::string::npos);
+}
+
+void testChunkedAndSink() {
+    const std::string body(100000, 'x');
+    LoopbackServer server([&](int fd) {
+        std::string buffer, head;
+        while (LoopbackServer::readRequest(fd, buffer, head)) {
+            std::string response = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+            for (size_t i = 0; i < body.size(); i += 30000) {
+                const std::string chunk = body.substr(i, 30000);
+                char size[16];
+                std::snprintf(size, sizeof(size), "%zx\r\n", chunk.size());
+                response += size + chunk + "\r\n";
+            }
+            response += "0\r\n\r\n";
+            // Sent in small pieces, so that the client reads them in several calls
+            for (size_t i = 0; i < response.size(); i += 7000) LoopbackServer::writeAll(fd, response.substr(i, 7000));
+        }
+    });
+    ConnectionPool pool;
+    HttpClient client(pool);
+    auto response = client.get(server.url("/ohlc"), {}, Deadline::in(5));
+    CHECK(response.ok());
+    CHECK_EQ(response.body.size(), body.size());
+    CHECK(response.body == body);
+
+    // With a sink, the body goes to the sink instead of the response
+    std::string streamed;
+    size_t calls = 0;
+    response = client.get(server.url("/ohlc"), {}, Deadline::in(5), [&](const char* data, size_t size) {
+        streamed.append(data, size);
+        ++calls;
+    });
+    CHECK(response.ok());
+    CHECK(response.body.empty());
+    CHECK(streamed == body);
+    CHECK(calls > 1);
+    CHECK_EQ(server.accepted(), size_t(1));
+}
+
+void testConnectionClose() {
+    // A response without length, delimited by the closing of the connection, which is not reused
+    LoopbackServer server([](int fd) {
+        std::string buffer, head;
+        if (LoopbackServer::readRequest(fd, buffer, head)) LoopbackServer::writeAll(fd, "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\nuntil close");
+    });
+    ConnectionPool pool;
+    HttpClient client(pool);
+    for (int i = 0; i < 2; ++i) {
+        const auto response = client.get(server.url(), {}, Deadline::in(5));
+        CHECK(response.ok());
+        CHECK_EQ(response.body, std::string("until close"));
+    }
+    CHECK_EQ(server.accepted(), size_t(2));
+    CHECK_EQ(pool.stats().hits, uint64_t(0));
+}
+
+void testStaleConnectionRetry() {
+    // The server answers the first request of a connection, and closes it when it receives the second
+    // one (as a server does when its keep-alive timeout ends just as the request arrives)
+    LoopbackServer server([](int fd) {
+        std::string buffer, head;
+        if (LoopbackServer::readRequest(fd, buffer, head)) LoopbackServer::writeAll(fd, LoopbackServer::response("first"));
+        LoopbackServer::readRequest(fd, buffer, head);
+    });
+    ConnectionPool pool;
+    HttpClient client(pool);
+    CHECK_EQ(client.get(server.url(), {}, Deadline::in(5)).body, std::string("first"));
+    // The request is sent again on a new connection
+    const auto response = client.get(server.url(), {}, Deadline::in(5));
+    CHECK(response.ok());
+    CHECK_EQ(response.body, std::string("first"));
+    CHECK_EQ(server.accepted(), size_t(2));
+    CHECK_EQ(pool.stats().hits, uint64_t(1));
+}
+
+void testFailures() {
+    ConnectionPool pool;
+    HttpClient client(pool);
+
+    // A server which never answers: the request ends with its deadline
+    std::atomic<bool> done{false};
+    LoopbackServer silent([&](int fd) {
+        std::string buffer, head;
+        LoopbackServer::readRequest(fd, buffer, head);
+        while (!done.load()) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    });
+    const auto start = std::chrono::steady_clock::now();
+    auto response = client.get(silent.url(), {}, Deadline::in(1));
+    CHECK(!response.ok());
+    CHECK_EQ(response.error, std::string("timeout"));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(3));
+    done = true;
+
+    // A truncated body, a malformed response, a closed port and an invalid url
+    LoopbackServer truncated([](int fd) {
+        std::string buffer, head;
+        if (LoopbackServer::readRequest(fd, buffer, head)) LoopbackServer::writeAll(fd, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort");
+    });
+    response = client.get(truncated.url(), {}, Deadline::in(5));
+    CHECK(!response.ok());
+    LoopbackServer garbage(LoopbackServer::serve([](const std::string&) {return std::string("SSH-2.0-OpenSSH\r\n\r\n");}));
+    CHECK(!client.get(garbage.url(), {}, Deadline::in(5)).ok());
+    const int port = garbage.port();
+    garbage.stop();
+    response = client.get("http://127.0.0.1:" + std::to_string(port) + "/", {}, Deadline::in(5));
+    CHECK(!response.ok());
+    CHECK_EQ(response.status, 0);
+    CHECK(!client.get("ftp://127.0.0.1/", {}, Deadline::in(5)).ok());
+}
+
+void testHttpRequest() {
+    // HttpRequest goes through the client for plain http urls
+    LoopbackServer server(LoopbackServer::serve([](const std::string& head) {return LoopbackServer::response("{\"path\": \"" + target(head) + "\"}");}));
+    HttpRequest request(5);
+    CHECK_EQ(request.request(server.url("/v2/ticker/")), std::string("{\"path\": \"/v2/ticker/\"}"));
+    std::string streamed;
+    CHECK(request.request(server.url("/x"), [&](const char* data, size_t size) {streamed.append(data, size);}));
+    CHECK_EQ(streamed, std::string("{\"path\": \"/x\"}"));
+    server.stop();
+    CHECK(request.request(server.url("/")).empty());
+}
+
+
+#ifdef CMDF_WITH_ZLIB
+// Compresses data with the header given by windowBits: 15 + 16 for gzip, 15 for zlib, -15 for raw deflate
+std::string compress(const std::string& data, int windowBits) {
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+void testCompressedBodies() {
+    std::string body;
+    for (int i = 0; i < 2000; ++i) body += "[" + std::to_string(1720719943 + 60 * i) + ", \"57700\", \"59516\", \"57072\", \"57844\"], ";
+    const std::string gzip = compress(body, 15 + 16);
+    std::string corrupted = gzip;
+    for (size_t i = corrupted.size() / 2; i < corrupted.size() / 2 + 16; ++i) corrupted[i] = static_cast<char>(~corrupted[i]);
+
+    std::string received;
+    LoopbackServer server(LoopbackServer::serve([&](const std::string& head) {
+        received = head;
+        const auto path = target(head);
+        if (path == "/zlib") return LoopbackServer::response(compress(body, 15), "Content-Encoding: deflate\r\n");
+        if (path == "/raw") return LoopbackServer::response(compress(body, -15), "Content-Encoding: deflate\r\n");
+        if (path == "/corrupted") return LoopbackServer::response(corrupted, "Content-Encoding: gzip\r\n");
+        if (path == "/truncated") return LoopbackServer::response(gzip.substr(0, gzip.size() / 2), "Content-Encoding: gzip\r\n");
+        if (path == "/chunked") {
+            std::string response = "HTTP/1.1 200 OK\r\nContent-Encoding: gzip\r\nTransfer-Encoding: chunked\r\n\r\n";
+            for (size_t i = 0; i < gzip.size(); i += 100) {
+                const std::string chunk = gzip.substr(i, 100);
+                char size[16];
+                std::snprintf(size, sizeof(size), "%zx\r\n", chunk.size());
+                response += size + chunk + "\r\n";
+            }
+            return response + "0\r\n\r\n";
+        }
+        return LoopbackServer::response(gzip, "Content-Encoding: gzip\r\n");
+    }));
+    ConnectionPool pool;
+    HttpClient client(pool);
+    Url url;
+    Url::parse(server.url(), url);
+
+    for (const char* path: {"/gzip", "/zlib", "/raw", "/chunked"}) {
+        const auto response = client.get(server.url(path), {}, Deadline::in(5));
+        CHECK(response.ok());
+        CHECK(response.body == body);
+        CHECK(response.bodyBytes < body.size());
+    }
+    CHECK(received.find("Accept-Encoding: gzip, deflate\r\n") != std::string::npos);
+    CHECK_EQ(client.get(server.url("/gzip"), {}, Deadline::in(5)).bodyBytes, gzip.size());
+
+    // The sink receives the decoded body
+    std::string streamed;
+    CHECK(client.get(server.url("/chunked"), {}, Deadline::in(5), [&](const char* data, size_t size) {streamed.append(data, size);}).ok());
+    CHECK(streamed == body);
+    CHECK_EQ(server.accepted(), size_t(1));
+
+    // A corrupted or truncated body fails the request, and its connection is closed rather than reused
+    for (const char* path: {"/corrupted", "/truncated"}) {
+        const auto accepted = server.accepted();
+        const auto response = client.get(server.url(path), {}, Deadline::in(5));
+        CHECK(!response.ok());
+        CHECK(!response.error.empty());
+        CHECK_EQ(pool.idleConnections(url.hostKey()), size_t(0));
+        CHECK(client.get(server.url("/gzip"), {}, Deadline::in(5)).body == body);
+        CHECK_EQ(server.accepted(), accepted + 1);
+    }
+}
+#endif
+
+} // namespace
+
+int main() {
+    testKeepAlive();
+    testRequestHead();
+    testChunkedAndSink();
+    testConnectionClose();
+    testStaleConnectionRetry();
+    testFailures();
+    testHttpRequest();
+#ifdef CMDF_WITH_ZLIB
+    testCompressedBodies();
+#endif
+    return check::result();
+}
@@ -0,0 +1,159 @@
+#include "check.h"
+#include "../src/api/http_client.h"
+#include <string>
+
+namespace {
+
+// Feeds the bytes in pieces of the given size (1: byte by byte); returns the number of bytes consumed
+size_t feed(HttpResponseParser& parser, const std::string& bytes, size_t piece) {
+    size_t consumed = 0;
+    while (consumed < bytes.size() && !parser.done() && !parser.failed()) {
+        consumed += parser.feed(bytes.data() + consumed, std::min(piece, bytes.size() - consumed));
+    }
+    return consumed;
+}
+
+void testContentLength() {
+    const std::string first = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 13\r\n\r\n{\"price\": 42}";
+    const std::string second = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    for (size_t piece: {1, 7, 4096}) {
+        HttpResponse response;
+        HttpResponseParser parser(response);
+        // Two pipelined responses: the parser stops at the end of the first one
+        CHECK_EQ(feed(parser, first + second, piece), first.size());
+        CHECK(parser.done());
+        CHECK(parser.keepAlive());
+        CHECK_EQ(response.status, 200);
+        CHECK_EQ(response.body, std::string("{\"price\": 42}"));
+        CHECK_EQ(response.headers["content-type"], std::string("application/json"));
+
+        HttpResponse next;
+        HttpResponseParser nextParser(next);
+        CHECK_EQ(feed(nextParser, second, piece), second.size());
+        CHECK(nextParser.done());
+        CHECK_EQ(next.status, 404);
+        CHECK(next.body.empty());
+    }
+}
+
+void testChunked() {
+    // Chunks of 5, 10 (with an extension) and 9 bytes, then a trailer
+    const std::string body = "[{\"a\": \"1\"}, {\"a\": \"2\"}]";
+    const std::string bytes =
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5\r\n" + body.substr(0, 5) + "\r\n"
+        "A;name=value\r\n" + body.substr(5, 10) + "\r\n"
+        "9\r\n" + body.substr(15) + "\r\n"
+        "0\r\nX-Trailer: 1\r\n\r\n";
+    for (size_t piece: {1, 3, 4096}) {
+        HttpResponse response;
+        HttpResponseParser parser(response);
+        CHECK_EQ(feed(parser, bytes + "HTTP/1.1", piece), bytes.size());
+        CHECK(parser.done());
+        CHECK(parser.keepAlive());
+        CHECK_EQ(response.body, body);
+    }
+
+    // The body goes to the sink instead of the response
+    HttpResponse response;
+    std::string received;
+    HttpResponseParser parser(response, [&received](const char* data, size_t size) {received.append(data, size);});
+    feed(parser, bytes, 2);
+    CHECK(parser.done());
+    CHECK_EQ(received, body);
+    CHECK(response.body.empty());
+
+    // A connection closed within the chunks is an error
+    HttpResponse truncated;
+    HttpResponseParser truncatedParser(truncated);
+    feed(truncatedParser, bytes.substr(0, bytes.size() - 20), 4096);
+    CHECK(!truncatedParser.done());
+    truncatedParser.finish();
+    CHECK(truncatedParser.failed());
+}
+
+void testKeepAlive() {
+    struct Case {
+        const char* head;
+        bool keepAlive;
+    };
+    const Case cases[] = {
+        {"HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n", true},
+        {"HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 2\r\n\r\n", false},
+        {"HTTP/1.1 200 OK\r\nConnection: Close\r\nContent-Length: 2\r\n\r\n", false},
+        {"HTTP/1.0 200 OK\r\nContent-Length: 2\r\n\r\n", false},
+        {"HTTP/1.0 200 OK\r\nConnection: keep-alive\r\nContent-Length: 2\r\n\r\n", true},
+    };
+    for (const auto& c: cases) {
+        HttpResponse response;
+        HttpResponseParser parser(response);
+        feed(parser, std::string(c.head) + "ok", 4096);
+        CHECK(parser.done());
+        CHECK_EQ(parser.keepAlive(), c.keepAlive);
+        CHECK_EQ(response.body, std::string("ok"));
+    }
+
+    // Without framing, the body ends when the connection is closed, which cannot be reused
+    HttpResponse response;
+    HttpResponseParser parser(response);
+    feed(parser, "HTTP/1.1 200 OK\r\n\r\nuntil close", 4);
+    CHECK(!parser.done());
+    parser.finish();
+    CHECK(parser.done());
+    CHECK(!parser.keepAlive());
+    CHECK_EQ(response.body, std::string("until close"));
+}
+
+void testInterimAndErrors() {
+    HttpResponse response;
+    HttpResponseParser parser(response);
+    feed(parser, "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 201 Created\r\nContent-Length: 1\r\n\r\nx", 5);
+    CHECK(parser.done());
+    CHECK_EQ(response.status, 201);
+    CHECK_EQ(response.body, std::string("x"));
+
+    HttpResponse malformed;
+    HttpResponseParser malformedParser(malformed);
+    feed(malformedParser, "SSH-2.0-OpenSSH\r\n\r\n", 4096);
+    CHECK(malformedParser.failed());
+
+    HttpResponse closed;
+    HttpResponseParser closedParser(closed);
+    feed(closedParser, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nshort", 4096);
+    closedParser.finish();
+    CHECK(closedParser.failed());
+
+    // Invalid sizes fail the response, instead of ending the body or reserving the length announced
+    for (const std::string head: {"Content-Length: 1x", "Content-Length: -1", "Content-Length: 99999999999999999999999",
+                                  "Content-Length: 18446744073709551615"}) {
+        HttpResponse invalid;
+        HttpResponseParser invalidParser(invalid);
+        feed(invalidParser, "HTTP/1.1 200 OK\r\n" + head + "\r\n\r\n{}", 4096);
+        if (head.find("18446744073709551615") != std::string::npos) {
+            CHECK(!invalidParser.failed()); // valid, but only 1 MB reserved: the body is short
+            invalidParser.finish();
+        }
+        CHECK(invalidParser.failed());
+    }
+    for (const std::string size: {"zz", "", "-5", "5 x", "fffffffffffffffffffff"}) {
+        HttpResponse invalid;
+        HttpResponseParser invalidParser(invalid);
+        feed(invalidParser, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n" + size + "\r\nhello\r\n0\r\n\r\n", 4096);
+        CHECK(invalidParser.failed());
+    }
+    HttpResponse extension;
+    HttpResponseParser extensionParser(extension);
+    feed(extensionParser, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5 ;a=b\r\nhello\r\n0\r\n\r\n", 4096);
+    CHECK(extensionParser.done());
+    CHECK_EQ(extension.body, std::string("hello"));
+}
+
+} // namespace
+
+int main() {
+    testContentLength();
+    testChunked();
+    testKeepAlive();
+    testInterimAndErrors();
+    return check::result();
+}
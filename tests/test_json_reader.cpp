@@ -0,0 +1,187 @@
+#include "check.h"
+#include "../src/json_reader/json_object_stream.h"
+#include "../src/json_reader/json_reader.h"
+#include "../src/json_reader/json_tokenizer.h"
+#include "../src/json_reader/multi_json_reader.h"
+#include "../src/json_reader/structural_index.h"
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// The character-based reader the tokenizer replaced, kept as a reference: on flat objects whose values hold
+// no spaces, quotes or escapes (e.g. the responses of the exchanges), both readers yield the same maps
+jMap baselineRead(const std::string& inputString) {
+    jMap object;
+    std::stringstream ss{inputString};
+    std::string key, value;
+    bool doValue = false;
+    bool isList = false;
+    char currentChar;
+    char skip = ss.peek();
+    if (skip == '{' || skip == '"') ss.ignore();
+    skip = ss.peek();
+    if (skip == '"') ss.ignore();
+    while (ss.get(currentChar)) {
+        if (currentChar == '"' || currentChar == ' ') continue;
+        if (currentChar == ':') {
+            doValue = true;
+            continue;
+        }
+        if (currentChar == '[' && !isList) isList = true;
+        if (currentChar == ']' && isList) isList = false;
+        if (currentChar != '}' && (currentChar != ',' || isList)) {
+            if (!doValue) key += currentChar;
+            else value += currentChar;
+            continue;
+        }
+        object[key] = value;
+        key.clear();
+        value.clear();
+        doValue = false;
+        ss.ignore();
+    }
+    return object;
+}
+
+std::vector<jMap> baselineReadList(const std::string& inputString) {
+    std::vector<jMap> objects;
+    size_t open = inputString.find("[{");
+    size_t close = inputString.find("}]");
+    if (open == std::string::npos || close == std::string::npos) return objects;
+    std::stringstream ss{inputString.substr(open + 1, close - open)};
+    std::string item;
+    while (std::getline(ss, item, '}')) {
+        size_t brace = item.find(" {");
+        if (brace != std::string::npos) item = item.substr(brace + 1);
+        objects.push_back(baselineRead(item + '}'));
+    }
+    return objects;
+}
+
+std::string tokens(JsonTokenizer tokenizer) {
+    std::string out;
+    while (true) {
+        auto token = tokenizer.next();
+        out += std::to_string(static_cast<int>(token.type)) + ':' + std::string(token.text) + (token.escaped ? "\\" : "") + '\n';
+        if (token.type == JsonTokenizer::TokenType::End || token.type == JsonTokenizer::TokenType::Error) return out;
+    }
+}
+
+const std::string TICKER =
+    "{\"timestamp\": \"1721664000\", \"open\": \"67530\", \"high\": \"68200.5\", \"low\": \"66911\", "
+    "\"last\": \"67840.12\", \"volume\": \"1123.45678901\", \"vwap\": \"67612\", \"bid\": \"67840\", "
+    "\"ask\": \"67841\", \"side\": \"0\", \"open_24\": \"67420\", \"percent_change_24\": \"0.62\"}";
+
+void testReaderAgainstBaseline() {
+    const std::vector<std::string> inputs = {
+        TICKER,
+        "{\"pair\": \"BTC/USD\", \"market_type\": \"SPOT\", \"trading\": \"Enabled\", \"decimals\": 8}",
+        "{\"buy\": \"1.0871\", \"sell\": \"1.0869\"}",
+        "{\"a\": true, \"b\": null, \"c\": -1.5e3}",
+    };
+    for (const auto& input: inputs) {
+        JsonReader reader(input);
+        CHECK(reader.get() == baselineRead(input));
+    }
+
+    // Projection: only the keys asked for are read
+    JsonReader projected(TICKER, JsonProjection({"last", "timestamp"}));
+    CHECK_EQ(projected.get().size(), size_t(2));
+    CHECK_EQ(projected.get().at("last"), std::string("67840.12"));
+
+    // Values the baseline could not read: escapes, spaces, nested values (kept as json text)
+    JsonReader nested("{\"name\": \"Bit \\\"coin\\\" \\u00e9\", \"list\": [1, {\"x\": 2}], \"o\": {\"y\": \"z\"}}");
+    CHECK_EQ(nested.get().at("name"), std::string("Bit \"coin\" \xc3\xa9"));
+    CHECK_EQ(nested.get().at("list"), std::string("[1, {\"x\": 2}]"));
+    CHECK_EQ(nested.get().at("o"), std::string("{\"y\": \"z\"}"));
+}
+
+void testListAgainstBaseline() {
+    std::string ohlc = "{\"data\": {\"pair\": \"BTC/USD\", \"ohlc\": [";
+    for (int i = 0; i < 50; ++i) {
+        if (i > 0) ohlc += ", ";
+        ohlc += "{\"close\": \"" + std::to_string(67000 + i) + ".5\", \"high\": \"" + std::to_string(67100 + i) +
+                "\", \"low\": \"66900\", \"open\": \"67000\", \"timestamp\": \"" + std::to_string(1721664000 + 60 * i) +
+                "\", \"volume\": \"" + std::to_string(i) + ".00012345\"}";
+    }
+    ohlc += "]}}";
+    MultiJsonReader reader(ohlc);
+    const auto expected = baselineReadList(ohlc);
+    CHECK_EQ(reader.get().size(), size_t(50));
+    CHECK(reader.get() == expected);
+}
+
+void testIndexedTokenizer() {
+    // Strings longer than a block of the index, structural characters and escaped quotes within strings,
+    // backslashes at the end of a block
+    std::string longString(100, 'x');
+    longString[63] = '\\';
+    longString[64] = '"';
+    std::vector<std::string> inputs = {
+        TICKER,
+        "[1, 2.5, -3e2, true, false, null, \"\", {}, [], [[]], {\"a\": {\"b\": [\"c\"]}}]",
+        "{\"k\": \"" + longString + "\", \"s\": \"{[,:]}\", \"e\": \"\\\\\", \"q\": \"\\\\\\\"\"}",
+        "  {\"spaces\" :\t[ 1 ,\n 2 ] }  ",
+        "{\"a\": 1,}",
+        "{\"a\" 1}",
+        "[1, 2",
+        "{\"unclosed\": \"abc",
+        "[1] 2",
+    };
+    std::string large = "[";
+    for (int i = 0; i < 200; ++i) large += (i > 0 ? ", " : "") + std::string("{\"t\": \"") + std::to_string(i) + "\\n\", \"v\": " + std::to_string(i * 7) + "}";
+    inputs.push_back(large + "]");
+
+    const StructuralIndex::Kernel kernels[] = {StructuralIndex::Kernel::Scalar, StructuralIndex::Kernel::Sse42, StructuralIndex::Kernel::Avx2};
+    for (const auto& input: inputs) {
+        const std::string expected = tokens(JsonTokenizer(input));
+        StructuralIndex scalar(input, StructuralIndex::Kernel::Scalar);
+        for (const auto kernel: kernels) {
+            StructuralIndex index(input, kernel);
+            CHECK(std::vector<uint32_t>(index.begin(), index.end()) == std::vector<uint32_t>(scalar.begin(), scalar.end()));
+            CHECK_EQ(index.unclosedString(), scalar.unclosedString());
+            CHECK_EQ(index.hasBackslashes(), scalar.hasBackslashes());
+            CHECK_EQ(tokens(JsonTokenizer(input, index)), expected);
+        }
+    }
+    CHECK_EQ(JsonTokenizer::unescape("a\\tb\\u0041\\ud83d\\ude00\\/"), std::string("a\tbA\xf0\x9f\x98\x80/"));
+}
+
+// Objects cut by a JsonObjectStream from the input fed in chunks of the size given; empty if it failed
+std::vector<std::string> splitObjects(const std::string& input, JsonObjectStream::Mode mode, size_t chunk) {
+    std::vector<std::string> objects;
+    JsonObjectStream stream(mode, [&](std::string_view object) {
+        objects.emplace_back(object);
+        return object.find("bad") == std::string_view::npos;
+    });
+    for (size_t i = 0; i < input.size(); i += chunk) stream.feed(input.data() + i, std::min(chunk, input.size() - i));
+    return stream.finish() ? objects : std::vector<std::string>{};
+}
+
+void testObjectStream() {
+    using Mode = JsonObjectStream::Mode;
+    const std::string records = "[{\"a\": \"}\", \"b\": {\"c\": [1, 2]}}, 3, {\"d\": \"\\\"{\"} ]";
+    const std::vector<std::string> expected = {"{\"a\": \"}\", \"b\": {\"c\": [1, 2]}}", "{\"d\": \"\\\"{\"}"};
+    for (const size_t chunk: {size_t(1), size_t(7), records.size()}) {
+        CHECK(splitObjects(records, Mode::Records, chunk) == expected);
+        CHECK(splitObjects(TICKER, Mode::Object, chunk) == std::vector<std::string>{TICKER});
+    }
+    // Incomplete and malformed inputs, and objects rejected by the handler
+    for (const std::string input: {"[{\"a\": 1}", "[{\"a\": 1}}", "{\"a\": 1}", "[1] 2", "[{}] []", "[\"x\"", "[{\"bad\": 1}]"}) {
+        CHECK(splitObjects(input, Mode::Records, 3).empty());
+    }
+    CHECK(splitObjects("[{\"a\": 1}]", Mode::Object, 3).empty());
+}
+
+} // namespace
+
+int main() {
+    testReaderAgainstBaseline();
+    testListAgainstBaseline();
+    testIndexedTokenizer();
+    testObjectStream();
+    return check::result();
+}
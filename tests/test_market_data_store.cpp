@@ -0,0 +1,144 @@
+#include "check.h"
+#include "fixtures.h"
+#include "../src/crypto_market_data/market_data_store.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr PairId PAIR = 1;
+constexpr int64_t START = 1720656000;
+
+using fixtures::sameCandles;
+
+int64_t time(size_t i) {return START + 60 * static_cast<int64_t>(i);}
+
+// Candles [first, first + n) of a regular 1-minute series from START
+CandleSeries candles(size_t first, size_t n) {return fixtures::candles(time(first), n);}
+
+void testCandleHistory() {
+    MarketDataStore store(MarketDataStore::DEFAULT_BUDGET, 64);
+    // Polled 16 candles at a time, the last one (still open) sent again with the next poll
+    const size_t n = 3000;
+    for (size_t first = 0; first + 1 < n; first += 15) {
+        CandleSeries poll = candles(first, std::min<size_t>(16, n - first));
+        poll.close.back() += 100; // the open candle differs from its final value
+        CHECK(store.append(PAIR, 60, poll));
+    }
+    CHECK(store.append(PAIR, 60, candles(n - 2, 2)));
+    auto ring = store.findCandles(PAIR, 60);
+    CHECK(ring != nullptr && ring->size() == ring->capacity() && ring->size() < n);
+    CHECK(store.stats().historyBytes > 0);
+    CHECK(store.stats().historyBytes < n * 48 / 2);
+
+    // The range of the ring, a range older than the ring, and one across its start, decoded from the history
+    CandleSeries out;
+    CHECK(store.range(PAIR, 60, time(n - 20), time(n - 1), out));
+    CHECK(sameCandles(candles(n - 20, 20), out));
+    const std::pair<size_t, size_t> ranges[] = {{0, n - 1}, {100, 1200}, {2000, n - 30}, {n - 200, n - 1}};
+    for (const auto& range: ranges) {
+        CHECK(store.range(PAIR, 60, time(range.first) - 30, time(range.second) + 30, out));
+        CHECK(sameCandles(candles(range.first, range.second - range.first + 1), out));
+    }
+    CHECK(!store.range(PAIR, 60, time(0) - 600, time(0) - 60, out));
+
+    // A candle of the ring replaced in place is read from the ring, not from the history
+    CandleSeries replaced = candles(n - 40, 40);
+    for (auto& close: replaced.close) close += 100;
+    CHECK(store.append(PAIR, 60, replaced));
+    CHECK(store.range(PAIR, 60, time(0), time(n - 1), out));
+    CHECK_EQ(out.size(), n);
+    CHECK_EQ(out.text(CandleSeries::Close, n - 1), replaced.text(CandleSeries::Close, 39));
+    CHECK_EQ(out.text(CandleSeries::Close, 0), candles(0, 1).text(CandleSeries::Close, 0));
+
+    CHECK(store.latest(PAIR, 60, 10, out));
+    CHECK(sameCandles(replaced, 30, out));
+}
+
+void testResolution() {
+    // The candles are kept at the resolution they were requested at: a single candle (an incremental poll)
+    // and a series with gaps join the ring of the series, though their timestamps do not tell its step
+    MarketDataStore store;
+    CHECK(store.append(PAIR, 60, candles(0, 10)));
+    CHECK(store.append(PAIR, 60, candles(10, 1)));
+    CandleSeries gaps = candles(11, 1);
+    const std::string later = std::to_string(time(14));
+    gaps.append({later, "60014", "60014", "60014", "14.25", "0.5"});
+    CHECK(store.append(PAIR, 60, gaps));
+    CHECK_EQ(store.stats().rings, size_t(1));
+    CandleSeries out;
+    CHECK(store.latest(PAIR, 60, 0, out));
+    CHECK_EQ(out.size(), size_t(13));
+    CHECK_EQ(out.timestamp.back(), time(14));
+    CHECK(!store.append(PAIR, 0, candles(20, 1)));
+    CHECK_EQ(store.stats().rings, size_t(1));
+}
+
+void testTickerHistory() {
+    MarketDataStore store(MarketDataStore::DEFAULT_BUDGET, 64, 16);
+    std::vector<Ticker> stored;
+    for (size_t i = 0; i < 1000; ++i) {
+        Ticker ticker;
+        ticker.set(Ticker::Timestamp, std::to_string(START + 2 * static_cast<int64_t>(i)));
+        ticker.set(Ticker::Last, std::to_string(57000 + i % 37) + ".5");
+        ticker.set(Ticker::Volume, std::to_string(1000 + i) + ".125");
+        CHECK(store.append(PAIR, ticker));
+        stored.push_back(ticker);
+    }
+    std::vector<Ticker> out;
+    CHECK(store.range(PAIR, START + 200, START + 399, out));
+    CHECK_EQ(out.size(), size_t(100));
+    bool same = out.size() == 100;
+    for (size_t i = 0; same && i < out.size(); ++i) {
+        same = out[i].text(Ticker::Last) == stored[100 + i].text(Ticker::Last) && out[i].text(Ticker::Volume) == stored[100 + i].text(Ticker::Volume);
+    }
+    CHECK(same);
+    CHECK(store.range(PAIR, START, START + 2000, out));
+    CHECK_EQ(out.size(), stored.size());
+}
+
+void testHistoryLimit() {
+    // A pair polled for long drops the oldest blocks of its history, rather than evicting the other pairs
+    const size_t limit = 8 << 10;
+    MarketDataStore store(64 << 10, 64, 16, limit);
+    CHECK(store.append(PAIR + 1, 60, candles(0, 10)));
+    for (size_t first = 0; first < 20000; first += 100) store.append(PAIR, 60, candles(first, 100));
+    const auto stats = store.stats();
+    CHECK(stats.historyBytes > 0 && stats.historyBytes <= limit);
+    CHECK_EQ(stats.evictions, size_t(0));
+    CHECK(store.findCandles(PAIR + 1, 60) != nullptr);
+
+    // The newest candles are still read through the history, the oldest ones are gone
+    CandleSeries out;
+    CHECK(store.range(PAIR, 60, time(19500), time(19999), out));
+    CHECK(sameCandles(candles(19500, 500), out));
+    CHECK(!store.range(PAIR, 60, time(0), time(1000), out));
+}
+
+void testEviction() {
+    // The histories count against the budget, and are evicted along with their rings
+    MarketDataStore store(32 << 10, 64);
+    for (PairId id = 1; id <= 4; ++id) {
+        for (size_t first = 0; first < 2000; first += 100) store.append(id, 60, candles(first, 100));
+    }
+    const auto stats = store.stats();
+    CHECK(stats.bytes <= stats.budget);
+    CHECK(stats.historyBytes > 0);
+    CHECK(stats.evictions > 0);
+    CHECK(store.findCandles(4, 60) != nullptr);
+    store.setBudget(0);
+    CHECK_EQ(store.stats().historyBytes, size_t(0));
+    CHECK_EQ(store.stats().bytes, size_t(0));
+}
+
+} // namespace
+
+int main() {
+    testCandleHistory();
+    testResolution();
+    testTickerHistory();
+    testHistoryLimit();
+    testEviction();
+    return check::result();
+}
@@ -0,0 +1,133 @@
+#include "check.h"
+#include "../src/api/request_scheduler.h"
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = RequestScheduler::Clock;
+using EndpointClass = RequestScheduler::EndpointClass;
+using Lane = RequestScheduler::Lane;
+
+double elapsedMs(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+void waitFor(const std::function<bool()>& condition) {
+    for (int i = 0; i < 1000 && !condition(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+}
+
+// Grants recording the order and the time of the admissions
+struct Admissions {
+    std::mutex mutex;
+    std::string order;
+    std::vector<Clock::time_point> times;
+
+    RequestScheduler::Grant grant(char name) {
+        return [this, name](bool admitted) {
+            std::lock_guard<std::mutex> lock(mutex);
+            order += admitted ? name : '-';
+            times.push_back(Clock::now());
+        };
+    }
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return times.size();
+    }
+};
+
+void testTokenBucket() {
+    // A burst of 3 tokens, then one token every 100 ms; the ticker class is not limited by itself
+    RequestScheduler scheduler;
+    scheduler.setGlobalBudget(RequestScheduler::Budget{10, 3});
+    Admissions admissions;
+    const auto start = Clock::now();
+    for (const char name: std::string("abcde")) scheduler.submit(EndpointClass::Ticker, Lane::Live, admissions.grant(name));
+    waitFor([&] {return admissions.size() == 5;});
+
+    CHECK_EQ(admissions.order, std::string("abcde"));
+    const auto& times = admissions.times;
+    CHECK(elapsedMs(start, times[2]) < 90);
+    // The tokens are refilled continuously: the requests after the burst are spread by the rate
+    CHECK(elapsedMs(times[2], times[3]) >= 80);
+    CHECK(elapsedMs(times[3], times[4]) >= 80);
+    CHECK(elapsedMs(start, times[4]) < 1000);
+
+    const auto stats = scheduler.stats();
+    CHECK_EQ(stats.lanes[0].admitted, uint64_t(5));
+    CHECK_EQ(stats.admitted[0], uint64_t(5));
+    CHECK(stats.lanes[0].maxDelayMs >= 180);
+    CHECK(stats.lanes[0].meanDelayMs > 0 && stats.lanes[0].meanDelayMs < stats.lanes[0].maxDelayMs);
+
+    // The budget of an endpoint class holds even when the global budget has tokens left
+    scheduler.setGlobalBudget(RequestScheduler::Budget{0, 1});
+    scheduler.setBudget(EndpointClass::Catalog, RequestScheduler::Budget{10, 1});
+    Admissions catalog;
+    scheduler.acquire(EndpointClass::Catalog, Lane::Live); // takes the token of the bucket
+    const auto catalogStart = Clock::now();
+    for (const char name: std::string("xy")) scheduler.submit(EndpointClass::Catalog, Lane::Live, catalog.grant(name));
+    waitFor([&] {return catalog.size() == 2;});
+    CHECK(elapsedMs(catalogStart, catalog.times[1]) >= 150);
+}
+
+void testLanes() {
+    // No token left and none before long: the requests stay queued until the budget is raised. Only the
+    // global budget limits them, so that the order of the admissions depends on the lanes alone.
+    RequestScheduler scheduler;
+    scheduler.setBudget(EndpointClass::Ohlc, RequestScheduler::Budget{0, 1});
+    scheduler.setGlobalBudget(RequestScheduler::Budget{0.001, 1});
+    CHECK(scheduler.acquire(EndpointClass::Ticker, Lane::Live));
+
+    Admissions admissions;
+    scheduler.submit(EndpointClass::Ohlc, Lane::Backfill, admissions.grant('a'));
+    scheduler.submit(EndpointClass::Ticker, Lane::Backfill, admissions.grant('b'));
+    scheduler.submit(EndpointClass::Ticker, Lane::Live, admissions.grant('c'));
+    scheduler.submit(EndpointClass::Ohlc, Lane::Live, admissions.grant('d'));
+    scheduler.submit(EndpointClass::Ticker, Lane::Backfill, admissions.grant('e'));
+    auto stats = scheduler.stats();
+    CHECK_EQ(stats.lanes[0].queued, size_t(2));
+    CHECK_EQ(stats.lanes[1].queued, size_t(3));
+    CHECK_EQ(stats.lanes[1].maxQueued, size_t(3));
+    CHECK_EQ(admissions.size(), size_t(0));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    scheduler.setGlobalBudget(RequestScheduler::Budget{0, 1});
+    waitFor([&] {return admissions.size() == 5;});
+
+    // The live lane goes first, whatever the age of the backfill requests; the oldest first within a lane
+    CHECK_EQ(admissions.order, std::string("cdabe"));
+    stats = scheduler.stats();
+    CHECK_EQ(stats.lanes[0].queued, size_t(0));
+    CHECK_EQ(stats.lanes[1].queued, size_t(0));
+    CHECK_EQ(stats.lanes[0].admitted, uint64_t(3));
+    CHECK_EQ(stats.lanes[1].admitted, uint64_t(3));
+    CHECK(stats.lanes[1].meanDelayMs >= 100);
+    CHECK(stats.lanes[1].maxDelayMs >= 100);
+    CHECK_EQ(stats.admitted[1], uint64_t(2));
+}
+
+void testShutdown() {
+    RequestScheduler scheduler;
+    scheduler.setGlobalBudget(RequestScheduler::Budget{0.001, 1});
+    CHECK(scheduler.acquire(EndpointClass::Ticker, Lane::Live));
+    Admissions admissions;
+    scheduler.submit(EndpointClass::Ticker, Lane::Live, admissions.grant('a'));
+    scheduler.submit(EndpointClass::Ticker, Lane::Backfill, admissions.grant('b'));
+    // The requests still queued are cancelled, and so are the later ones
+    scheduler.shutdown();
+    CHECK_EQ(admissions.order, std::string("--"));
+    CHECK(!scheduler.acquire(EndpointClass::Ticker, Lane::Live));
+}
+
+} // namespace
+
+int main() {
+    testTokenBucket();
+    testLanes();
+    testShutdown();
+    return check::result();
+}
@@ -0,0 +1,263 @@
+#include "check.h"
+#include "fixtures.h"
+#include "../src/storage/compressed_series.h"
+#include "../src/storage/series_codec.h"
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr SeriesCodec::Encoding ENCODINGS[] = {SeriesCodec::DeltaOfDelta, SeriesCodec::Delta, SeriesCodec::Varint, SeriesCodec::Runs};
+
+using fixtures::candles;
+using fixtures::sameCandles;
+using fixtures::temporaryPath;
+
+bool roundTrip(SeriesCodec::Encoding encoding, const std::vector<int64_t>& values) {
+    std::string encoded = "prefix";
+    SeriesCodec::encode(encoding, values.data(), values.size(), encoded);
+    encoded += "suffix";
+    std::vector<int64_t> decoded(values.size());
+    const char* begin = encoded.data() + 6;
+    const char* end = SeriesCodec::decode(encoding, begin, encoded.data() + encoded.size(), decoded.data(), decoded.size());
+    return end == encoded.data() + encoded.size() - 6 && decoded == values;
+}
+
+void testCodec() {
+    const int64_t min = std::numeric_limits<int64_t>::min();
+    const int64_t max = std::numeric_limits<int64_t>::max();
+    std::vector<int64_t> regular, prices, runs;
+    for (int64_t i = 0; i < 1000; ++i) {
+        regular.push_back(1700000000 + 60 * i + (i == 500 ? 30 : 0));
+        prices.push_back(5784450 + (i * 7919) % 23 - 11);
+        runs.push_back(i / 100 % 3);
+    }
+    const std::vector<std::vector<int64_t>> inputs = {
+        {}, {0}, {-1}, {max}, {min}, {min, max, min, 0, max}, {CandleSeries::MISSING, 5, CandleSeries::MISSING},
+        {1, 1, 1, 1}, {0, 1 << 7, 1 << 14, int64_t(1) << 62}, regular, prices, runs,
+    };
+    for (const auto encoding: ENCODINGS) {
+        for (const auto& values: inputs) CHECK(roundTrip(encoding, values));
+    }
+
+    // A block of regular timestamps takes a few bytes
+    std::string encoded;
+    SeriesCodec::encode(SeriesCodec::DeltaOfDelta, regular.data(), 500, encoded);
+    CHECK(encoded.size() < 12);
+
+    // Truncated or inconsistent encodings are refused
+    encoded.clear();
+    SeriesCodec::encode(SeriesCodec::Delta, prices.data(), prices.size(), encoded);
+    std::vector<int64_t> decoded(prices.size());
+    CHECK(SeriesCodec::decode(SeriesCodec::Delta, encoded.data(), encoded.data() + encoded.size() - 1, decoded.data(), decoded.size()) == nullptr);
+    encoded.clear();
+    SeriesCodec::encode(SeriesCodec::Runs, runs.data(), runs.size(), encoded);
+    CHECK(SeriesCodec::decode(SeriesCodec::Runs, encoded.data(), encoded.data() + encoded.size(), decoded.data(), 999) == nullptr);
+    const std::string overlong(11, '\xff');
+    uint64_t varint;
+    CHECK(SeriesCodec::getVarint(overlong.data(), overlong.data() + overlong.size(), varint) == nullptr);
+}
+
+void testCandles() {
+    const size_t n = 3 * CompressedCandles::BLOCK_CANDLES + 100;
+    const CandleSeries series = candles(1700000000, n);
+    CompressedCandles compressed;
+    CandleSeries first = candles(1700000000, 1000);
+    first.close.back() += 3;
+    size_t added = 0;
+    CHECK(compressed.append(first, &added));
+    CHECK_EQ(added, size_t(1000));
+    // The first candle replaces the last one held, across the end of a block
+    CHECK(compressed.append(series, &added));
+    CHECK_EQ(added, n - 1000);
+    CHECK_EQ(compressed.size(), n);
+    CHECK_EQ(compressed.front(), series.timestamp.front());
+    CHECK_EQ(compressed.back(), series.timestamp.back());
+    CHECK_EQ(compressed.blocks(), size_t(3));
+
+    CandleSeries out;
+    CHECK(compressed.read(out));
+    CHECK_EQ(out.size(), n);
+    CHECK(sameCandles(series, out));
+
+    // A range within a block, across blocks, and reaching into the open block
+    const std::pair<size_t, size_t> ranges[] = {{10, 20}, {500, 1100}, {1500, n - 1}, {n - 1, n - 1}};
+    for (const auto& range: ranges) {
+        CHECK(compressed.read(series.timestamp[range.first], series.timestamp[range.second], out));
+        CHECK_EQ(out.size(), range.second - range.first + 1);
+        CHECK(sameCandles(series, range.first, out));
+    }
+    CHECK(!compressed.read(0, 1000, out));
+
+    const std::string path = temporaryPath("candles");
+    CHECK(compressed.save(path));
+    CompressedCandles loaded;
+    CHECK(loaded.load(path));
+    CHECK_EQ(loaded.size(), n);
+    CHECK(loaded.read(series.timestamp[100], series.timestamp[1500], out));
+    CHECK(sameCandles(series, 100, out));
+    // Appending after a load goes on from the open block
+    CHECK(loaded.append(candles(series.timestamp.back() + 60, 5), &added));
+    CHECK_EQ(added, size_t(5));
+    CHECK_EQ(loaded.size(), n + 5);
+    std::remove(path.c_str());
+
+    FILE* file = std::fopen(path.c_str(), "w");
+    std::fputs("garbage", file);
+    std::fclose(file);
+    CHECK(!loaded.load(path));
+    std::remove(path.c_str());
+
+    // Dropping the oldest blocks keeps the newer candles, and the open block
+    const size_t block = CompressedCandles::BLOCK_CANDLES;
+    CHECK(compressed.dropOldest());
+    CHECK_EQ(compressed.size(), n - block);
+    CHECK_EQ(compressed.front(), series.timestamp[block]);
+    CHECK(compressed.read(series.timestamp[block + 10], series.timestamp[n - 1], out));
+    CHECK(sameCandles(series, block + 10, out));
+    CHECK(compressed.dropOldest() && compressed.dropOldest());
+    CHECK(!compressed.dropOldest());
+    CHECK_EQ(compressed.size(), size_t(100));
+    CHECK_EQ(compressed.blocks(), size_t(0));
+    CHECK(compressed.read(out));
+    CHECK(sameCandles(series, n - 100, out));
+
+    compressed.clear();
+    CHECK(compressed.empty());
+    CHECK(!compressed.read(out));
+}
+
+// Blocks of different scales are read at the largest one, without changing the values
+void testRescaledBlocks() {
+    const CandleSeries series = candles(1700000000, CompressedCandles::BLOCK_CANDLES + 10);
+    CandleSeries finer;
+    for (size_t i = 0; i < 10; ++i) {
+        const int64_t t = series.timestamp.back() + 60 * static_cast<int64_t>(i + 1);
+        const std::string price = std::to_string(60000 + i) + ".125";
+        finer.append({std::to_string(t), price, price, price, price, "0.5"});
+    }
+    CompressedCandles compressed;
+    CHECK(compressed.append(series));
+    CHECK(compressed.append(finer));
+    CHECK_EQ(compressed.blocks(), size_t(1));
+
+    CandleSeries out;
+    const size_t first = 500;
+    CHECK(compressed.read(series.timestamp[first], finer.timestamp.back(), out));
+    CHECK_EQ(out.size(), series.size() - first + finer.size());
+    bool same = out.size() == series.size() - first + finer.size();
+    for (size_t i = 0; same && i < out.size(); ++i) {
+        const bool older = first + i < series.size();
+        const CandleSeries& source = older ? series : finer;
+        const size_t j = older ? first + i : first + i - series.size();
+        same = out.timestamp[i] == source.timestamp[j];
+        for (size_t c = CandleSeries::Open; c < CandleSeries::COLUMNS; ++c) {
+            const auto column = static_cast<CandleSeries::Column>(c);
+            const bool missing = source.text(column, j).empty();
+            same = same && out.text(column, i).empty() == missing && (missing || out.value(column, i) == source.value(column, j));
+        }
+    }
+    CHECK(same);
+    CHECK_EQ(out.text(CandleSeries::Close, out.size() - 1), std::string("60009.125"));
+}
+
+Ticker ticker(int64_t time, size_t i) {
+    Ticker record;
+    record.set(Ticker::Timestamp, std::to_string(time));
+    record.set(Ticker::Last, std::to_string(57000 + i % 50) + ".5");
+    record.set(Ticker::Volume, std::to_string(1200 + i) + ".12345678");
+    record.set(Ticker::Side, std::to_string(i % 2));
+    if (i % 3 != 0) record.set(Ticker::Bid, std::to_string(57000 + i % 50));
+    if (i % 5 == 0) record.setNull(Ticker::Open24);
+    return record;
+}
+
+bool sameTicker(const Ticker& a, const Ticker& b) {
+    for (unsigned f = 0; f < Ticker::FIELDS; ++f) {
+        if (a.text(static_cast<Ticker::Field>(f)) != b.text(static_cast<Ticker::Field>(f))) return false;
+    }
+    return a.present == b.present && a.nulls == b.nulls;
+}
+
+void testTickers() {
+    const size_t n = 2 * CompressedTickers::BLOCK_TICKERS + 30;
+    std::vector<Ticker> tickers;
+    CompressedTickers compressed;
+    for (size_t i = 0; i < n; ++i) {
+        tickers.push_back(ticker(1700000000 + static_cast<int64_t>(i) * 2, i));
+        CHECK(compressed.append(tickers.back()));
+    }
+    CHECK(!compressed.append(ticker(0, 0)));
+    CHECK(!compressed.append(Ticker()));
+    CHECK_EQ(compressed.size(), n);
+
+    const std::string path = temporaryPath("tickers");
+    CHECK(compressed.save(path));
+    CompressedTickers loaded;
+    CHECK(loaded.load(path));
+    std::remove(path.c_str());
+
+    std::vector<Ticker> out;
+    CHECK(loaded.read(out));
+    CHECK_EQ(out.size(), n);
+    bool same = out.size() == n;
+    for (size_t i = 0; same && i < n; ++i) same = sameTicker(tickers[i], out[i]);
+    CHECK(same);
+
+    CHECK(loaded.read(tickers[100].units[Ticker::Timestamp], tickers[200].units[Ticker::Timestamp], out));
+    CHECK_EQ(out.size(), size_t(101));
+    CHECK(!out.empty() && sameTicker(tickers[100], out.front()) && sameTicker(tickers[200], out.back()));
+
+    const size_t block = CompressedTickers::BLOCK_TICKERS;
+    CHECK(loaded.dropOldest());
+    CHECK_EQ(loaded.size(), n - block);
+    CHECK(loaded.read(out));
+    CHECK(!out.empty() && sameTicker(tickers[block], out.front()) && sameTicker(tickers[n - 1], out.back()));
+}
+
+// Overwrites the end of a file (the last payload of the blocks saved) with bytes that cannot be decoded
+void corruptEnd(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "r+b");
+    std::fseek(file, -10, SEEK_END);
+    std::fwrite(std::string(10, '\xff').data(), 1, 10, file);
+    std::fclose(file);
+}
+
+// The last block is only completed if it can be decoded: otherwise the append fails and the block is kept
+void testCorruptLastBlock() {
+    const std::string path = temporaryPath("corrupt");
+    CompressedCandles candleBlocks;
+    CHECK(candleBlocks.append(candles(1700000000, 100)));
+    CHECK(candleBlocks.save(path));
+    corruptEnd(path);
+    CHECK(candleBlocks.load(path));
+    size_t added = 1;
+    CHECK(!candleBlocks.append(candles(1700000000 + 100 * 60, 5), &added));
+    CHECK_EQ(added, size_t(0));
+    CHECK_EQ(candleBlocks.size(), size_t(100));
+    CHECK_EQ(candleBlocks.blocks(), size_t(1));
+
+    CompressedTickers tickerBlocks;
+    for (size_t i = 0; i < 30; ++i) CHECK(tickerBlocks.append(ticker(1700000000 + static_cast<int64_t>(i), i)));
+    CHECK(tickerBlocks.save(path));
+    corruptEnd(path);
+    CHECK(tickerBlocks.load(path));
+    CHECK(!tickerBlocks.append(ticker(1700000100, 30)));
+    CHECK_EQ(tickerBlocks.size(), size_t(30));
+    CHECK_EQ(tickerBlocks.blocks(), size_t(1));
+    std::remove(path.c_str());
+}
+
+} // namespace
+
+int main() {
+    testCodec();
+    testCandles();
+    testRescaledBlocks();
+    testTickers();
+    testCorruptLastBlock();
+    return check::result();
+}
@@ -0,0 +1,107 @@
+#include "check.h"
+#include "../src/api/symbol_table.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string pair(size_t i) {return "c" + std::to_string(i) + "usd";}
+
+void testIntern() {
+    // The ids are dense, in the order of the first interning, and interning again returns the same id
+    SymbolTable table;
+    CHECK_EQ(table.intern("btcusd"), PairId(0));
+    CHECK_EQ(table.intern("ethusd"), PairId(1));
+    CHECK_EQ(table.intern("btcusd"), PairId(0));
+    CHECK_EQ(table.intern(std::string("ethusd")), PairId(1));
+    CHECK_EQ(table.size(), size_t(2));
+    CHECK_EQ(table.find("ethusd"), PairId(1));
+    CHECK_EQ(table.name(0), std::string("btcusd"));
+    CHECK_EQ(table.name(1), std::string("ethusd"));
+
+    // The unknown names and ids are not found, and lookups do not intern them
+    CHECK_EQ(table.find("xrpusd"), INVALID_PAIR_ID);
+    CHECK_EQ(table.find(""), INVALID_PAIR_ID);
+    CHECK_EQ(table.find("btcus"), INVALID_PAIR_ID);
+    CHECK_EQ(table.name(2), std::string());
+    CHECK_EQ(table.name(INVALID_PAIR_ID), std::string());
+    CHECK_EQ(table.size(), size_t(2));
+}
+
+void testGrowth() {
+    // The names keep their ids across the growths of the table (64 slots at first)
+    SymbolTable table;
+    const size_t n = 5000;
+    bool dense = true;
+    for (size_t i = 0; i < n; ++i) dense = dense && table.intern(pair(i)) == PairId(i);
+    CHECK(dense);
+    CHECK_EQ(table.size(), n);
+    bool stable = true;
+    for (size_t i = 0; i < n; ++i) {
+        stable = stable && table.find(pair(i)) == PairId(i) && table.intern(pair(i)) == PairId(i) && table.name(PairId(i)) == pair(i);
+    }
+    CHECK(stable);
+    CHECK_EQ(table.find(pair(n)), INVALID_PAIR_ID);
+    CHECK_EQ(table.size(), n);
+}
+
+void testConcurrentIntern() {
+    // Threads interning overlapping names while another looks them up: every name gets a single id, the
+    // ids stay dense, and a name found once is found with the same id afterwards
+    SymbolTable table;
+    const size_t names = 2000, threads = 4;
+    const size_t steps[threads] = {1, 3, 7, 9}; // prime with the number of names: every name is visited
+    std::vector<std::vector<PairId>> ids(threads, std::vector<PairId>(names));
+    std::atomic<bool> consistent{true};
+    std::atomic<size_t> interning{threads};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (size_t k = 0; k < names; ++k) {
+                const size_t i = (k * steps[t] + t * 131) % names; // another order in each thread
+                ids[t][i] = table.intern(pair(i));
+            }
+            --interning;
+        });
+    }
+    workers.emplace_back([&] {
+        std::vector<PairId> seen(names, INVALID_PAIR_ID);
+        while (interning.load() > 0) {
+            for (size_t i = 0; i < names; ++i) {
+                const PairId id = table.find(pair(i));
+                if (id == INVALID_PAIR_ID) {
+                    if (seen[i] != INVALID_PAIR_ID) consistent = false;
+                    continue;
+                }
+                if ((seen[i] != INVALID_PAIR_ID && seen[i] != id) || id >= names) consistent = false;
+                seen[i] = id;
+            }
+        }
+    });
+    for (auto& worker: workers) worker.join();
+
+    CHECK(consistent.load());
+    CHECK_EQ(table.size(), names);
+    std::vector<bool> used(names, false);
+    bool same = true, unique = true;
+    for (size_t i = 0; i < names; ++i) {
+        const PairId id = ids[0][i];
+        for (size_t t = 1; t < threads; ++t) same = same && ids[t][i] == id;
+        if (id >= names || used[id]) unique = false;
+        else used[id] = true;
+        same = same && table.find(pair(i)) == id;
+    }
+    CHECK(same);
+    CHECK(unique);
+}
+
+} // namespace
+
+int main() {
+    testIntern();
+    testGrowth();
+    testConcurrentIntern();
+    return check::result();
+}
@@ -0,0 +1,106 @@
+#include "check.h"
+#include "loopback_server.h"
+#include "../src/api/bitstamp_api.h"
+#include "../src/api/ticker_catalog.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+// List of the pairs served by the stand-ins of the api (the ticker endpoint without a pair)
+const std::string PAIRS = R"([{"pair": "BTC/USD", "last": "67412"}, {"pair": "ETH/USD", "last": "2614.2"}, {"pair": "XRP/USD", "last": "0.54034"}])";
+
+// Stand-in of the api counting the downloads of the list; the responses wait until open is set
+struct CatalogServer {
+    std::atomic<size_t> requests{0};
+    std::atomic<bool> open{true};
+    LoopbackServer server{LoopbackServer::serve([this](const std::string& head) {
+        if (head.rfind("GET /ticker/ ", 0) != 0) return std::string("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        ++requests;
+        while (!open.load()) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        return LoopbackServer::response(PAIRS);
+    })};
+
+    std::string url() const {return server.url("/");}
+};
+
+std::string readFile(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream(path, std::ios::trunc) << content;
+}
+
+void testColdAndWarmLoads() {
+    // Cold: no cache file, the list is downloaded once for all the objects of the source, and cached
+    CatalogServer cold;
+    BitstampApi first(5, cold.url());
+    BitstampApi second(5, cold.url());
+    CHECK_EQ(cold.requests.load(), size_t(1));
+    CHECK(first.validatePair("ethusd") && second.validatePair("xrpusd"));
+    CHECK(!first.validatePair("ltcusd"));
+    auto& catalog = TickerCatalog::forSource(cold.url());
+    CHECK_EQ(catalog.stats().networkLoads, size_t(1));
+    const std::string cached = readFile(catalog.cacheFile());
+    CHECK(cached.find("\nbtcusd\nethusd\nxrpusd\n") != std::string::npos);
+
+    // Warm: the cache file of another source (the same list) is loaded without any request
+    CatalogServer warm;
+    auto& warmCatalog = TickerCatalog::forSource(warm.url());
+    writeFile(warmCatalog.cacheFile(), cached);
+    BitstampApi api(5, warm.url());
+    CHECK_EQ(warm.requests.load(), size_t(0));
+    CHECK_EQ(warmCatalog.stats().cacheLoads, size_t(1));
+    CHECK_EQ(warmCatalog.stats().networkLoads, size_t(0));
+    CHECK(api.validatePair("btcusd") && api.validatePair("xrpusd"));
+    CHECK_EQ(api.pairId("ethusd"), first.pairId("ethusd"));
+}
+
+void testStaleCache() {
+    // A stale list is served at once, while the fresh one is downloaded in the background and cached
+    CatalogServer stale;
+    stale.open = false;
+    auto& catalog = TickerCatalog::forSource(stale.url());
+    writeFile(catalog.cacheFile(), "1000\nbtcusd\nltcusd\n");
+    BitstampApi api(5, stale.url());
+    CHECK(api.validatePair("btcusd") && api.validatePair("ltcusd"));
+    CHECK(!api.validatePair("ethusd"));
+    CHECK_EQ(catalog.stats().cacheLoads, size_t(1));
+
+    stale.open = true;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (readFile(catalog.cacheFile()).rfind("1000\n", 0) == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const std::string cached = readFile(catalog.cacheFile());
+    const long long updatedAt = std::atoll(cached.c_str());
+    const long long now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    CHECK(updatedAt > now - 60 && updatedAt <= now);
+    CHECK(cached.find("\nethusd\n") != std::string::npos && cached.find("ltcusd") == std::string::npos);
+    CHECK_EQ(stale.requests.load(), size_t(1));
+    CHECK_EQ(catalog.stats().networkLoads, size_t(1));
+    CHECK(api.validatePair("ethusd"));
+    CHECK(!api.validatePair("ltcusd"));
+}
+
+} // namespace
+
+int main() {
+    char directory[] = "/tmp/test_ticker_catalogXXXXXX";
+    if (::mkdtemp(directory) == nullptr) return 1;
+    TickerCatalog::setCacheDirectory(std::string(directory) + "/");
+    testColdAndWarmLoads();
+    testStaleCache();
+    TickerCatalog::shutdown();
+    std::system(("rm -rf " + std::string(directory)).c_str());
+    return check::result();
+}
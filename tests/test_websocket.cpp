@@ -0,0 +1,273 @@
+#include "check.h"
+#include "loopback_server.h"
+#include "websocket_server.h"
+#include "../src/api/bitstamp_stream_api.h"
+#include "../src/api/ticker_catalog.h"
+#include "../src/api/websocket.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void waitFor(const std::function<bool()>& condition, int seconds = 5) {
+    const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (!condition() && std::chrono::steady_clock::now() < end) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+std::string target(const std::string& head) {
+    const size_t begin = head.find(' ') + 1;
+    return head.substr(begin, head.find(' ', begin) - begin);
+}
+
+void testAcceptKey() {
+    // Sample handshake of RFC 6455, section 1.3
+    CHECK_EQ(WebSocket::acceptKey("dGhlIHNhbXBsZSBub25jZQ=="), std::string("s3pPLMBiTxaQ9kYGzzhZRbK+xOo="));
+
+    std::string head;
+    std::atomic<bool> done{false};
+    WebSocketServer server([&](WebSocketServer::Peer& peer) {
+        head = peer.head();
+        done = true;
+        std::string message;
+        while (peer.receiveText(message)) {}
+    });
+    std::string error;
+    auto socket = WebSocket::connect(server.url("/stream"), {"User-Agent: test"}, Deadline::in(5), error);
+    CHECK(socket != nullptr);
+    waitFor([&] {return done.load();});
+    CHECK_EQ(head.rfind("GET /stream HTTP/1.1\r\n", 0), size_t(0));
+    CHECK_EQ(WebSocketServer::header(head, "Upgrade"), std::string("websocket"));
+    CHECK_EQ(WebSocketServer::header(head, "Sec-WebSocket-Version"), std::string("13"));
+    CHECK_EQ(WebSocketServer::header(head, "Sec-WebSocket-Key").size(), size_t(24));
+    CHECK_EQ(WebSocketServer::header(head, "User-Agent"), std::string("test"));
+
+    // A server answering without the upgrade is refused
+    LoopbackServer http(LoopbackServer::serve([](const std::string&) {return LoopbackServer::response("not a websocket");}));
+    CHECK(WebSocket::connect("ws://127.0.0.1:" + std::to_string(http.port()) + "/", {}, Deadline::in(5), error) == nullptr);
+    CHECK(error.find("upgrade refused") != std::string::npos);
+    CHECK(WebSocket::connect(http.url("/"), {}, Deadline::in(5), error) == nullptr);
+}
+
+void testFrames() {
+    using Server = WebSocketServer;
+    const std::string medium(300, 'm');   // 16-bit length
+    const std::string large(70000, 'l');  // 64-bit length
+    std::mutex mutex;
+    std::vector<Server::Frame> received; // frames of the client, in order
+    std::atomic<bool> done{false};
+
+    Server server([&](Server::Peer& peer) {
+        Server::Frame frame;
+        auto record = [&]() {
+            if (!peer.receive(frame)) return false;
+            std::lock_guard<std::mutex> lock(mutex);
+            received.push_back(frame);
+            return true;
+        };
+        // The three messages of the client, in the three length forms
+        for (int i = 0; i < 3; ++i) record();
+        peer.send(Server::frame(Server::Text, "unmasked"));
+        peer.send(Server::frame(Server::Text, "masked", true, true));
+        peer.send(Server::frame(Server::Text, medium));
+        peer.send(Server::frame(Server::Binary, large));
+        // A fragmented message, with a ping between its fragments, sent byte by byte
+        const std::string fragmented = Server::frame(Server::Text, "frag", false) + Server::frame(Server::Ping, "beat") +
+                                       Server::frame(Server::Continuation, "men", false) + Server::frame(Server::Continuation, "ted", true, true);
+        for (const char byte: fragmented) peer.send(std::string(1, byte));
+        record(); // the pong
+        peer.send(Server::frame(Server::Close, std::string("\x03\xe8", 2)));
+        record(); // the echo of the close frame
+        done = true;
+    });
+
+    std::string error;
+    auto socket = WebSocket::connect(server.url(), {}, Deadline::in(5), error);
+    CHECK(socket != nullptr);
+    if (!socket) return;
+    CHECK(socket->sendText("hello", Deadline::in(5)));
+    CHECK(socket->sendText(medium, Deadline::in(5)));
+    CHECK(socket->sendText(large, Deadline::in(5)));
+
+    std::string message;
+    for (const auto& expected: {std::string("unmasked"), std::string("masked"), medium, large, std::string("fragmented")}) {
+        CHECK(socket->receive(message, Deadline::in(5)) == WebSocket::ReceiveStatus::Message);
+        CHECK(message == expected);
+    }
+    CHECK(socket->receive(message, Deadline::in(5)) == WebSocket::ReceiveStatus::Closed);
+    waitFor([&] {return done.load();});
+
+    std::lock_guard<std::mutex> lock(mutex);
+    CHECK_EQ(received.size(), size_t(5));
+    if (received.size() != 5) return;
+    // The frames of the client are final and masked
+    for (const auto& frame: received) CHECK(frame.final && frame.masked);
+    CHECK_EQ(received[0].payload, std::string("hello"));
+    CHECK(received[1].payload == medium);
+    CHECK(received[2].payload == large);
+    CHECK_EQ(int(received[3].opcode), int(Server::Pong));
+    CHECK_EQ(received[3].payload, std::string("beat"));
+    CHECK_EQ(int(received[4].opcode), int(Server::Close));
+    CHECK_EQ(received[4].payload, std::string("\x03\xe8", 2));
+}
+
+void testReceiveErrors() {
+    // No message before the deadline, then a continuation without a first fragment
+    std::atomic<bool> send{false};
+    WebSocketServer server([&](WebSocketServer::Peer& peer) {
+        waitFor([&] {return send.load();});
+        peer.send(WebSocketServer::frame(WebSocketServer::Continuation, "orphan"));
+        std::string message;
+        while (peer.receiveText(message)) {}
+    });
+    std::string error;
+    auto socket = WebSocket::connect(server.url(), {}, Deadline::in(5), error);
+    CHECK(socket != nullptr);
+    if (!socket) return;
+    std::string message;
+    CHECK(socket->receive(message, Deadline::in(0)) == WebSocket::ReceiveStatus::Timeout);
+    send = true;
+    CHECK(socket->receive(message, Deadline::in(5)) == WebSocket::ReceiveStatus::Error);
+}
+
+// Stand-in of the RESTful api of Bitstamp: the list of the pairs, and the ticker seeding the market data
+LoopbackServer::Handler serveRest() {
+    return LoopbackServer::serve([](const std::string& head) {
+        const std::string ticker = R"({"timestamp": "1729166400", "open": "67380", "high": "68424", "low": "66984", "last": "67412", )"
+                                   R"("volume": "1523.61098052", "vwap": "67703", "bid": "67410", "ask": "67413", "side": "0")";
+        if (target(head) == "/ticker/") return LoopbackServer::response("[" + ticker + R"(, "pair": "BTC/USD"}])");
+        if (target(head) == "/ticker/btcusd") return LoopbackServer::response(ticker + "}");
+        return std::string("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    });
+}
+
+void testStreamReconnection() {
+    LoopbackServer rest(serveRest());
+    const std::string trade = R"({"event": "trade", "channel": "live_trades_btcusd", "data": {"timestamp": "1729166460", "price_str": "68500", "type": 1}})";
+    const std::string book = R"({"event": "data", "channel": "order_book_btcusd", "data": {"timestamp": "1729166470", "bids": [["68490", "0.5"]], "asks": [["68510", "0.2"]]}})";
+
+    // The first connection replays a trade once both channels are subscribed, and is dropped by the server;
+    // the second one replays the order book and stays open
+    std::mutex mutex;
+    std::vector<std::vector<std::string>> subscriptions(2);
+    WebSocketServer server([&](WebSocketServer::Peer& peer) {
+        const size_t connection = peer.connection();
+        std::string message;
+        for (int i = 0; i < 2 && peer.receiveText(message); ++i) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (connection < subscriptions.size()) subscriptions[connection].push_back(message);
+        }
+        peer.sendText(R"({"event": "bts:subscription_succeeded", "channel": "live_trades_btcusd", "data": {}})");
+        peer.sendText(connection == 0 ? trade : book);
+        if (connection == 0) return;
+        while (peer.receiveText(message)) {}
+    });
+
+    BitstampStreamApi stream(server.url(), rest.url("/"), 10);
+    const PairId btcusd = stream.pairId("btcusd");
+    CHECK(btcusd != INVALID_PAIR_ID);
+    std::mutex dataMutex;
+    DataMap latest;
+    stream.subscribeMarketData({btcusd}, [&](PairId id, const DataMap& marketData) {
+        std::lock_guard<std::mutex> lock(dataMutex);
+        if (id == btcusd) latest = marketData;
+    });
+    waitFor([&] {
+        std::lock_guard<std::mutex> lock(dataMutex);
+        return latest["bid"] == "68490" && latest["last"] == "68500" && latest.count("vwap") > 0;
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(dataMutex);
+        CHECK_EQ(latest["last"], std::string("68500"));
+        CHECK_EQ(latest["bid"], std::string("68490"));
+        CHECK_EQ(latest["ask"], std::string("68510"));
+        CHECK_EQ(latest["vwap"], std::string("67703")); // seeded by the RESTful api
+    }
+    CHECK(stream.connected());
+    CHECK_EQ(stream.stats().connections, uint64_t(2));
+    CHECK_EQ(server.accepted(), size_t(2));
+
+    // The channels are subscribed again on the new connection
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::vector<std::string> expected = {
+        R"({"event":"bts:subscribe","data":{"channel":"live_trades_btcusd"}})",
+        R"({"event":"bts:subscribe","data":{"channel":"order_book_btcusd"}})"
+    };
+    CHECK(subscriptions[0] == expected);
+    CHECK(subscriptions[1] == expected);
+}
+
+void testHeartbeatTimeout() {
+    // A server which stops answering: a heartbeat is sent after a second of silence, and the connection
+    // is given up after two
+    LoopbackServer rest(serveRest());
+    std::mutex mutex;
+    std::vector<std::string> received;
+    WebSocketServer server([&](WebSocketServer::Peer& peer) {
+        std::string message;
+        while (peer.receiveText(message)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            received.push_back(message);
+        }
+    });
+    const auto start = std::chrono::steady_clock::now();
+    BitstampStreamApi stream(server.url(), rest.url("/"), 1);
+    waitFor([&] {return server.accepted() == 2;});
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    CHECK_EQ(server.accepted(), size_t(2));
+    CHECK(elapsed >= std::chrono::seconds(2));
+    CHECK_EQ(stream.stats().heartbeats, uint64_t(1));
+    std::lock_guard<std::mutex> lock(mutex);
+    CHECK(!received.empty() && received[0] == R"({"event":"bts:heartbeat"})");
+}
+
+void testReplay() {
+    // The replay script sends the recorded messages once the client has spoken
+    std::mutex mutex;
+    std::vector<std::string> received;
+    WebSocketServer server(WebSocketServer::replay({"first", "second"}, [&](size_t, const std::string& message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.push_back(message);
+    }));
+    std::string error;
+    auto socket = WebSocket::connect(server.url(), {}, Deadline::in(5), error);
+    CHECK(socket != nullptr);
+    if (!socket) return;
+    std::string message;
+    CHECK(socket->receive(message, Deadline::in(0)) == WebSocket::ReceiveStatus::Timeout);
+    CHECK(socket->sendText("subscribe", Deadline::in(5)));
+    CHECK(socket->receive(message, Deadline::in(5)) == WebSocket::ReceiveStatus::Message);
+    CHECK_EQ(message, std::string("first"));
+    CHECK(socket->receive(message, Deadline::in(5)) == WebSocket::ReceiveStatus::Message);
+    CHECK_EQ(message, std::string("second"));
+    CHECK(socket->sendText("bye", Deadline::in(5)));
+    socket->close(Deadline::in(5));
+    CHECK(socket->receive(message, Deadline::in(5)) == WebSocket::ReceiveStatus::Closed);
+    server.stop();
+    CHECK(received == (std::vector<std::string>{"subscribe", "bye"}));
+}
+
+} // namespace
+
+int main() {
+    // The catalog caches the pairs under a temporary directory, not under the working directory
+    char directory[] = "/tmp/test_websocketXXXXXX";
+    if (::mkdtemp(directory) == nullptr) return 1;
+    TickerCatalog::setCacheDirectory(std::string(directory) + "/");
+    testAcceptKey();
+    testFrames();
+    testReceiveErrors();
+    testReplay();
+    testStreamReconnection();
+    testHeartbeatTimeout();
+    TickerCatalog::shutdown();
+    std::system(("rm -rf " + std::string(directory)).c_str());
+    return check::result();
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "loopback_server.h"
+#include "../src/api/websocket.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * WebSocket stand-in server of the tests: a LoopbackServer answering the opening handshake of each
+ * connection, then running the script given with the peer of the connection (the connection is closed
+ * when the script returns). The frames are built as the script asks (unmasked by default, with the
+ * shortest length form), so that the scripts can send any valid frame sequence, and the frames of the
+ * client are read and unmasked as they are received. replay builds the script of a server replaying
+ * recorded messages.
+ */
+class WebSocketServer {
+
+public:
+    enum Opcode : uint8_t {Continuation = 0x0, Text = 0x1, Binary = 0x2, Close = 0x8, Ping = 0x9, Pong = 0xA};
+
+    struct Frame {
+        uint8_t opcode = 0;
+        bool final = false;
+        bool masked = false;
+        std::string payload;
+    };
+
+    // Server end of a connection, after the handshake
+    class Peer {
+
+    public:
+        Peer(int fd, size_t connection, std::string head, std::string buffer):
+            fd_(fd), connection_(connection), head_(std::move(head)), buffer_(std::move(buffer)) {}
+
+        // Index of the connection (0 for the first one accepted), and head of its handshake request
+        size_t connection() const {return connection_;}
+        const std::string& head() const {return head_;}
+
+        bool send(const std::string& frames) {return LoopbackServer::writeAll(fd_, frames);}
+        bool sendText(const std::string& message) {return send(frame(Text, message));}
+
+        // Reads the next frame of the client; returns false if the connection was closed first
+        bool receive(Frame& frame) {
+            while (!parse(frame)) {
+                char chunk[16384];
+                const ssize_t n = ::recv(fd_, chunk, sizeof(chunk), 0);
+                if (n <= 0) return false;
+                buffer_.append(chunk, static_cast<size_t>(n));
+            }
+            return true;
+        }
+
+        // Reads the next text message of the client, answering its pings; returns false once the client
+        // closed the connection (its close frame is echoed)
+        bool receiveText(std::string& message) {
+            Frame frame;
+            while (receive(frame)) {
+                if (frame.opcode == Ping) {
+                    send(WebSocketServer::frame(Pong, frame.payload));
+                } else if (frame.opcode == Close) {
+                    send(WebSocketServer::frame(Close, frame.payload.substr(0, 2)));
+                    return false;
+                } else if (frame.opcode == Text) {
+                    message = std::move(frame.payload);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        int fd_;
+        size_t connection_;
+        std::string head_;
+        std::string buffer_;
+
+        bool parse(Frame& frame) {
+            if (buffer_.size() < 2) return false;
+            const auto* bytes = reinterpret_cast<const uint8_t*>(buffer_.data());
+            uint64_t length = bytes[1] & 0x7F;
+            size_t header = 2;
+            if (length >= 126) {
+                header = length == 126 ? 4 : 10;
+                if (buffer_.size() < header) return false;
+                length = 0;
+                for (size_t i = 2; i < header; ++i) length = (length << 8) | bytes[i];
+            }
+            const bool masked = (bytes[1] & 0x80) != 0;
+            const size_t maskOffset = header;
+            if (masked) header += 4;
+            if (buffer_.size() < header + length) return false;
+
+            frame.opcode = bytes[0] & 0x0F;
+            frame.final = (bytes[0] & 0x80) != 0;
+            frame.masked = masked;
+            frame.payload.assign(buffer_, header, static_cast<size_t>(length));
+            if (masked) {
+                for (size_t i = 0; i < frame.payload.size(); ++i) frame.payload[i] = static_cast<char>(frame.payload[i] ^ bytes[maskOffset + i % 4]);
+            }
+            buffer_.erase(0, header + static_cast<size_t>(length));
+            return true;
+        }
+    };
+
+    using Script = std::function<void(Peer& peer)>;
+
+    explicit WebSocketServer(Script script): server_([this, script = std::move(script)](int fd) {
+        std::string buffer, head;
+        if (!LoopbackServer::readRequest(fd, buffer, head)) return;
+        const size_t connection = connections_++;
+        if (!LoopbackServer::writeAll(fd, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                          "Sec-WebSocket-Accept: " + WebSocket::acceptKey(header(head, "Sec-WebSocket-Key")) + "\r\n\r\n")) return;
+        Peer peer(fd, connection, head, buffer);
+        script(peer);
+    }) {}
+
+    int port() const {return server_.port();}
+    std::string url(const std::string& target = "/") const {return "ws://127.0.0.1:" + std::to_string(server_.port()) + target;}
+
+    // Number of connections accepted so far
+    size_t accepted() const {return server_.accepted();}
+
+    // Stops accepting connections, shuts the open ones down and waits for their scripts
+    void stop() {server_.stop();}
+
+    // A frame as sent by the server: unmasked unless masked is set (the mask key is fixed)
+    static std::string frame(uint8_t opcode, const std::string& payload, bool final = true, bool masked = false) {
+        std::string frame(1, static_cast<char>((final ? 0x80 : 0) | opcode));
+        const char maskBit = masked ? static_cast<char>(0x80) : 0;
+        if (payload.size() < 126) {
+            frame += static_cast<char>(maskBit | static_cast<char>(payload.size()));
+        } else if (payload.size() <= 0xFFFF) {
+            frame += static_cast<char>(maskBit | 126);
+            for (int i = 1; i >= 0; --i) frame += static_cast<char>((payload.size() >> (i * 8)) & 0xFF);
+        } else {
+            frame += static_cast<char>(maskBit | 127);
+            for (int i = 7; i >= 0; --i) frame += static_cast<char>((static_cast<uint64_t>(payload.size()) >> (i * 8)) & 0xFF);
+        }
+        if (!masked) return frame + payload;
+        const char key[4] = {0x37, static_cast<char>(0xfa), 0x21, 0x3d};
+        frame.append(key, 4);
+        for (size_t i = 0; i < payload.size(); ++i) frame += static_cast<char>(payload[i] ^ key[i % 4]);
+        return frame;
+    }
+
+    // Script replaying recorded messages: they are sent once the client has sent its first message (e.g. a
+    // subscription), then the messages of the client are read (and recorded into received, if given) until
+    // it closes the connection
+    static Script replay(std::vector<std::string> messages, std::function<void(size_t connection, const std::string&)> received = nullptr) {
+        return [messages = std::move(messages), received = std::move(received)](Peer& peer) {
+            std::string message;
+            if (!peer.receiveText(message)) return;
+            if (received) received(peer.connection(), message);
+            for (const auto& recorded: messages) {
+                if (!peer.sendText(recorded)) return;
+            }
+            while (peer.receiveText(message)) {
+                if (received) received(peer.connection(), message);
+            }
+        };
+    }
+
+    // Value of a header of a request head (empty if missing)
+    static std::string header(const std::string& head, const std::string& name) {
+        const size_t begin = head.find("\r\n" + name + ": ");
+        if (begin == std::string::npos) return "";
+        const size_t value = begin + name.size() + 4;
+        return head.substr(value, head.find("\r\n", value) - value);
+    }
+
+private:
+    std::atomic<size_t> connections_{0};
+    LoopbackServer server_; // last: its handlers use the members above, until it is stopped
+};